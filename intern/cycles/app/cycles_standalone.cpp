@@ -19,7 +19,9 @@
 #include "device/device.h"
 #include "render/buffers.h"
 #include "render/camera.h"
+#include "render/distributed.h"
 #include "render/integrator.h"
+#include "render/pass.h"
 #include "render/scene.h"
 #include "render/session.h"
 
@@ -29,7 +31,9 @@
 #include "util/util_image.h"
 #include "util/util_logging.h"
 #include "util/util_path.h"
+#include "util/util_profiling.h"
 #include "util/util_progress.h"
+#include "util/util_stats.h"
 #include "util/util_string.h"
 #include "util/util_time.h"
 #include "util/util_transform.h"
@@ -54,6 +58,16 @@ struct Options {
   bool quiet;
   bool show_help, interactive, pause;
   string output_filepath;
+
+  /* Distributed rendering. The coordinator only merges the regions rendered by the workers, a
+   * worker renders the region assigned to it by the coordinator. */
+  int distributed_workers;
+  int distributed_port;
+  string distributed_address;
+  string distributed_token;
+  float distributed_timeout;
+  string distributed_coordinator;
+  DistributedAssignment distributed_assignment;
 } options;
 
 static void session_print(const string &str)
@@ -89,30 +103,56 @@ static void session_print_status()
   session_print(status);
 }
 
-static bool write_render(const uchar *pixels, int w, int h, int channels)
+static bool write_render(const float *pixels, int w, int h, int channels)
 {
-  string msg = string_printf("Writing image %s", options.output_path.c_str());
+  string msg = string_printf("Writing image %s", options.output_filepath.c_str());
   session_print(msg);
 
-  unique_ptr<ImageOutput> out = unique_ptr<ImageOutput>(ImageOutput::create(options.output_path));
+  unique_ptr<ImageOutput> out = unique_ptr<ImageOutput>(
+      ImageOutput::create(options.output_filepath));
   if (!out) {
     return false;
   }
 
-  ImageSpec spec(w, h, channels, TypeDesc::UINT8);
-  if (!out->open(options.output_path, spec)) {
+  ImageSpec spec(w, h, channels, TypeDesc::FLOAT);
+  if (!out->open(options.output_filepath, spec)) {
     return false;
   }
 
   /* conversion for different top/bottom convention */
-  out->write_image(
-      TypeDesc::UINT8, pixels + (h - 1) * w * channels, AutoStride, -w * channels, AutoStride);
+  out->write_image(TypeDesc::FLOAT,
+                   pixels + (size_t)(h - 1) * w * channels,
+                   AutoStride,
+                   -(stride_t)(w * channels * sizeof(float)),
+                   AutoStride);
 
   out->close();
 
   return true;
 }
 
+/* Pixels of the combined pass of the render result, rows from bottom to top. */
+static vector<float> render_pixels;
+
+/* Render buffers with all passes of the region rendered by a distributed rendering worker. */
+static unique_ptr<RenderBuffers> worker_buffers;
+
+static void write_render_tile()
+{
+  if (!options.distributed_coordinator.empty()) {
+    worker_buffers = make_unique<RenderBuffers>(options.session->device);
+    options.session->copy_render_tile_to_buffers(worker_buffers.get());
+    return;
+  }
+
+  const int2 size = options.session->get_render_tile_size();
+
+  render_pixels.resize((size_t)size.x * size.y * 4);
+  if (!options.session->get_render_tile_pixels("combined", 4, render_pixels.data())) {
+    render_pixels.clear();
+  }
+}
+
 static BufferParams &session_buffer_params()
 {
   static BufferParams buffer_params;
@@ -121,6 +161,14 @@ static BufferParams &session_buffer_params()
   buffer_params.full_width = options.width;
   buffer_params.full_height = options.height;
 
+  if (!options.distributed_coordinator.empty()) {
+    const DistributedAssignment &assignment = options.distributed_assignment;
+    buffer_params.full_x = assignment.x;
+    buffer_params.full_y = assignment.y;
+    buffer_params.width = assignment.width;
+    buffer_params.height = assignment.height;
+  }
+
   return buffer_params;
 }
 
@@ -143,12 +191,19 @@ static void scene_init()
 
   /* Calculate Viewplane */
   options.scene->camera->compute_auto_viewplane();
+
+  /* Name the default pass, so that its pixels can be read back for the output. */
+  for (Pass *pass : options.scene->passes) {
+    if (pass->get_type() == PASS_COMBINED && pass->get_name().empty()) {
+      pass->set_name(ustring("combined"));
+    }
+  }
 }
 
 static void session_init()
 {
-  options.session_params.write_render_cb = write_render;
   options.session = new Session(options.session_params, options.scene_params);
+  options.session->write_render_tile_cb = write_render_tile;
 
   if (options.session_params.background && !options.quiet)
     options.session->progress.set_update_callback(function_bind(&session_print_status));
@@ -166,6 +221,15 @@ static void session_init()
 
 static void session_exit()
 {
+  /* Workers send their region to the coordinator instead. */
+  if (!options.output_filepath.empty() && options.distributed_coordinator.empty() &&
+      !render_pixels.empty()) {
+    write_render(render_pixels.data(), options.width, options.height, 4);
+  }
+
+  /* Buffers are allocated on the device of the session. */
+  worker_buffers.reset();
+
   if (options.session) {
     delete options.session;
     options.session = NULL;
@@ -177,6 +241,99 @@ static void session_exit()
   }
 }
 
+static int distributed_coordinator_run()
+{
+  DistributedCoordinator coordinator;
+  if (!coordinator.listen(
+          options.distributed_port, options.distributed_address, options.distributed_token)) {
+    fprintf(stderr, "%s\n", coordinator.get_error().c_str());
+    return EXIT_FAILURE;
+  }
+  coordinator.set_timeout(options.distributed_timeout);
+
+  if (!options.quiet) {
+    printf("Waiting for %d workers on port %d\n",
+           options.distributed_workers,
+           coordinator.get_port());
+    fflush(stdout);
+  }
+
+  /* The workers render, the merged buffers are only read on the host. */
+  Stats stats;
+  Profiler profiler;
+  unique_ptr<Device> device(
+      Device::create(Device::available_devices(DEVICE_MASK_CPU).front(), stats, profiler));
+
+  RenderBuffers buffers(device.get());
+  if (!coordinator.render(options.width,
+                          options.height,
+                          options.session_params.samples,
+                          options.distributed_workers,
+                          &buffers)) {
+    fprintf(stderr, "%s\n", coordinator.get_error().c_str());
+    return EXIT_FAILURE;
+  }
+
+  if (!options.output_filepath.empty()) {
+    vector<float> pixels((size_t)options.width * options.height * 4);
+    if (!distributed_get_render_pixels(&buffers, "combined", 4, pixels.data())) {
+      fprintf(stderr, "Error reading merged render result\n");
+      return EXIT_FAILURE;
+    }
+    write_render(pixels.data(), options.width, options.height, 4);
+  }
+
+  if (!options.quiet) {
+    session_print("Finished Rendering.");
+    printf("\n");
+  }
+
+  return EXIT_SUCCESS;
+}
+
+static int distributed_worker_run()
+{
+  const string &coordinator = options.distributed_coordinator;
+  const size_t separator = coordinator.rfind(':');
+  if (separator == string::npos) {
+    fprintf(stderr, "Coordinator is to be specified as host:port\n");
+    return EXIT_FAILURE;
+  }
+
+  DistributedWorker worker;
+  DistributedAssignment &assignment = options.distributed_assignment;
+  if (!worker.connect(coordinator.substr(0, separator),
+                      atoi(coordinator.c_str() + separator + 1),
+                      options.distributed_token) ||
+      !worker.receive_assignment(assignment)) {
+    fprintf(stderr, "%s\n", worker.get_error().c_str());
+    return EXIT_FAILURE;
+  }
+
+  /* The frame resolution and number of samples are defined by the coordinator. */
+  options.width = assignment.full_width;
+  options.height = assignment.full_height;
+  options.session_params.samples = assignment.num_samples;
+
+  session_init();
+  options.session->wait();
+
+  bool success = false;
+  if (worker_buffers) {
+    success = worker.send_result(assignment, worker_buffers.get());
+    if (!success) {
+      fprintf(stderr, "%s\n", worker.get_error().c_str());
+    }
+  }
+  else {
+    fprintf(stderr, "Error reading rendered region\n");
+  }
+
+  session_exit();
+
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
 #ifdef WITH_CYCLES_STANDALONE_GUI
 static void display_info(Progress &progress)
 {
@@ -366,6 +523,12 @@ static void options_parse(int argc, const char **argv)
   options.quiet = false;
   options.session_params.use_auto_tile = false;
   options.session_params.tile_size = 0;
+  options.distributed_workers = 0;
+  options.distributed_port = 5120;
+  options.distributed_address = "127.0.0.1";
+  options.distributed_token = "";
+  options.distributed_timeout = 0.0f;
+  options.distributed_coordinator = "";
 
   /* device names */
   string device_names = "";
@@ -384,6 +547,9 @@ static void options_parse(int argc, const char **argv)
   /* shading system */
   string ssname = "svm";
 
+  /* out-of-core scene data */
+  string memory_map_directory = "";
+
   /* parse options */
   ArgParse ap;
   bool help = false, debug = false, version = false;
@@ -410,6 +576,9 @@ static void options_parse(int argc, const char **argv)
              "--samples %d",
              &options.session_params.samples,
              "Number of samples to render",
+             "--sample-offset %d",
+             &options.session_params.sample_offset,
+             "Index of the first sample to render",
              "--output %s",
              &options.output_filepath,
              "File path to write output image",
@@ -425,6 +594,30 @@ static void options_parse(int argc, const char **argv)
              "--tile-size %d",
              &options.session_params.tile_size,
              "Tile size in pixels",
+             "--memory-map-dir %s",
+             &memory_map_directory,
+             "Directory for files backing scene data, to page it in on demand (CPU only)",
+             "--distributed-workers %d",
+             &options.distributed_workers,
+             "Split the frame between given number of worker processes and merge their results, "
+             "without rendering or reading a scene",
+             "--distributed-port %d",
+             &options.distributed_port,
+             "Port the distributed rendering coordinator listens on",
+             "--distributed-address %s",
+             &options.distributed_address,
+             "Address the distributed rendering coordinator listens on, loopback by default, other "
+             "addresses require a token",
+             "--distributed-token %s",
+             &options.distributed_token,
+             "Token which workers present to the distributed rendering coordinator",
+             "--distributed-timeout %f",
+             &options.distributed_timeout,
+             "Seconds the distributed rendering coordinator waits for the results of all workers, "
+             "no limit by default",
+             "--distributed-coordinator %s",
+             &options.distributed_coordinator,
+             "Render the region assigned by the distributed rendering coordinator at host:port",
              "--list-devices",
              &list,
              "List information about all available devices",
@@ -472,7 +665,7 @@ static void options_parse(int argc, const char **argv)
     printf("%s\n", CYCLES_VERSION_STRING);
     exit(EXIT_SUCCESS);
   }
-  else if (help || options.filepath == "") {
+  else if (help || (options.filepath == "" && options.distributed_workers == 0)) {
     ap.usage();
     exit(EXIT_SUCCESS);
   }
@@ -486,6 +679,10 @@ static void options_parse(int argc, const char **argv)
   options.session_params.background = true;
 #endif
 
+  if (options.distributed_workers > 0 || !options.distributed_coordinator.empty()) {
+    options.session_params.background = true;
+  }
+
   if (options.session_params.tile_size > 0) {
     options.session_params.use_auto_tile = true;
   }
@@ -497,6 +694,7 @@ static void options_parse(int argc, const char **argv)
   bool device_available = false;
   if (!devices.empty()) {
     options.session_params.device = devices.front();
+    options.session_params.device.memory_map_directory = memory_map_directory;
     device_available = true;
   }
 
@@ -516,11 +714,23 @@ static void options_parse(int argc, const char **argv)
     exit(EXIT_FAILURE);
   }
 #endif
+  else if (options.session_params.sample_offset < 0) {
+    fprintf(stderr, "Invalid sample offset: %d\n", options.session_params.sample_offset);
+    exit(EXIT_FAILURE);
+  }
   else if (options.session_params.samples < 0) {
     fprintf(stderr, "Invalid number of samples: %d\n", options.session_params.samples);
     exit(EXIT_FAILURE);
   }
-  else if (options.filepath == "") {
+  else if (options.distributed_workers < 0) {
+    fprintf(stderr, "Invalid number of workers: %d\n", options.distributed_workers);
+    exit(EXIT_FAILURE);
+  }
+  else if (options.distributed_workers > 0 && !options.distributed_coordinator.empty()) {
+    fprintf(stderr, "Process can not be both distributed rendering coordinator and worker\n");
+    exit(EXIT_FAILURE);
+  }
+  else if (options.filepath == "" && options.distributed_workers == 0) {
     fprintf(stderr, "No file path specified\n");
     exit(EXIT_FAILURE);
   }
@@ -536,6 +746,13 @@ int main(int argc, const char **argv)
   path_init();
   options_parse(argc, argv);
 
+  if (options.distributed_workers > 0) {
+    return distributed_coordinator_run();
+  }
+  else if (!options.distributed_coordinator.empty()) {
+    return distributed_worker_run();
+  }
+
 #ifdef WITH_CYCLES_STANDALONE_GUI
   if (options.session_params.background) {
 #endif
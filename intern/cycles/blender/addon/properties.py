@@ -275,6 +275,13 @@ class CyclesRenderSettings(bpy.types.PropertyGroup):
         items=enum_denoising_input_passes,
         default='RGB_ALBEDO_NORMAL',
     )
+    denoising_memory_limit: IntProperty(
+        name="Denoising Memory Limit",
+        description="Approximate memory in megabytes used for denoising a frame with OpenImageDenoise. "
+        "Bigger frames are denoised in overlapping tiles. Zero disables the limit",
+        min=0,
+        default=0,
+    )
 
     use_preview_denoising: BoolProperty(
         name="Use Viewport Denoising",
@@ -335,6 +342,25 @@ class CyclesRenderSettings(bpy.types.PropertyGroup):
         items=enum_sampling_pattern,
         default='PROGRESSIVE_MUTI_JITTER',
     )
+    use_blue_noise: BoolProperty(
+        name="Blue Noise",
+        description="Distribute the noise of neighboring pixels as blue noise, which is less visible "
+        "and easier to denoise at low sample counts",
+        default=False,
+    )
+
+    use_guiding: BoolProperty(
+        name="Path Guiding",
+        description="Learn the distribution of incoming light during the first samples, and use it to sample "
+        "directions of indirect light bounces (only supported on the CPU)",
+        default=False,
+    )
+    guiding_training_samples: IntProperty(
+        name="Training Samples",
+        description="Number of samples used to learn the distribution of incoming light for path guiding",
+        min=1, max=(1 << 24),
+        default=128,
+    )
 
     use_layer_samples: EnumProperty(
         name="Layer Samples",
@@ -619,6 +645,11 @@ class CyclesRenderSettings(bpy.types.PropertyGroup):
         description="Use special type BVH optimized for hair (uses more ram but renders faster)",
         default=True,
     )
+    debug_use_compressed_bvh: BoolProperty(
+        name="Use Compressed BVH",
+        description="Store BVH nodes with quantized bounds (uses less memory but might render slower)",
+        default=False,
+    )
     debug_bvh_time_steps: IntProperty(
         name="BVH Time Steps",
         description="Split BVH primitives by this number of time steps to speed up render time in cost of memory",
@@ -258,6 +258,7 @@ class CYCLES_RENDER_PT_sampling_render_denoise(CyclesButtonsPanel, Panel):
         col.prop(cscene, "denoising_input_passes", text="Passes")
         if cscene.denoiser == 'OPENIMAGEDENOISE':
             col.prop(cscene, "denoising_prefilter", text="Prefilter")
+            col.prop(cscene, "denoising_memory_limit", text="Memory Limit")
 
 
 class CYCLES_RENDER_PT_sampling_advanced(CyclesButtonsPanel, Panel):
@@ -278,8 +279,16 @@ class CYCLES_RENDER_PT_sampling_advanced(CyclesButtonsPanel, Panel):
         row.prop(cscene, "use_animated_seed", text="", icon='TIME')
 
         col = layout.column(align=True)
-        col.active = not(cscene.use_adaptive_sampling)
-        col.prop(cscene, "sampling_pattern", text="Pattern")
+        sub = col.column(align=True)
+        sub.active = not(cscene.use_adaptive_sampling)
+        sub.prop(cscene, "sampling_pattern", text="Pattern")
+        col.prop(cscene, "use_blue_noise")
+
+        col = layout.column(align=True)
+        col.prop(cscene, "use_guiding")
+        sub = col.column(align=True)
+        sub.active = cscene.use_guiding
+        sub.prop(cscene, "guiding_training_samples")
 
         layout.separator()
 
@@ -660,6 +669,7 @@ class CYCLES_RENDER_PT_performance_acceleration_structure(CyclesButtonsPanel, Pa
         sub = col.column()
         sub.active = not use_embree
         sub.prop(cscene, "debug_use_hair_bvh")
+        sub.prop(cscene, "debug_use_compressed_bvh")
         sub = col.column()
         sub.active = not cscene.debug_use_spatial_splits and not use_embree
         sub.prop(cscene, "debug_bvh_time_steps")
@@ -183,6 +183,31 @@ Geometry *BlenderSync::sync_geometry(BL::Depsgraph &b_depsgraph,
   return geom;
 }
 
+void BlenderSync::sync_geometry_deduplicate()
+{
+  if (progress.get_cancel()) {
+    return;
+  }
+
+  set<Geometry *> geometry;
+  for (const auto &it : geometry_map.key_to_scene_data()) {
+    geometry.insert(it.second);
+  }
+
+  const set<Geometry *> duplicates = scene->geometry_manager->deduplicate(scene, geometry);
+  if (duplicates.empty()) {
+    return;
+  }
+
+  for (Geometry *geom : duplicates) {
+    geometry_synced.erase(geom);
+    geometry_motion_synced.erase(geom);
+    geometry_motion_attribute_synced.erase(geom);
+  }
+
+  geometry_map.remove(duplicates);
+}
+
 void BlenderSync::sync_geometry_motion(BL::Depsgraph &b_depsgraph,
                                        BObjectInfo &b_ob_info,
                                        Object *object,
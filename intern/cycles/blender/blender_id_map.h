@@ -152,6 +152,23 @@ template<typename K, typename T> class id_map {
     used_set.insert(data);
   }
 
+  /* Remove data from the map and delete it from the scene. */
+  void remove(const set<T *> &nodes)
+  {
+    typename map<K, T *>::iterator jt = b_map.begin();
+    while (jt != b_map.end()) {
+      if (nodes.find(jt->second) != nodes.end()) {
+        used_set.erase(jt->second);
+        jt = b_map.erase(jt);
+      }
+      else {
+        ++jt;
+      }
+    }
+
+    scene->delete_nodes(nodes);
+  }
+
   void set_default(T *data)
   {
     b_map[NULL] = data;
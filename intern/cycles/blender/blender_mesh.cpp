@@ -36,8 +36,50 @@
 
 #include "mikktspace.h"
 
+#include "DNA_meshdata_types.h"
+
 CCL_NAMESPACE_BEGIN
 
+/* Raw Mesh Arrays
+ *
+ * Reading the mesh arrays directly is much faster than going through RNA for every element,
+ * which matters for scenes with many or large meshes. */
+
+static const MVert *mesh_verts(BL::Mesh &b_mesh)
+{
+  return (b_mesh.vertices.length()) ? static_cast<const MVert *>(b_mesh.vertices[0].ptr.data) :
+                                      NULL;
+}
+
+static const MLoop *mesh_loops(BL::Mesh &b_mesh)
+{
+  return (b_mesh.loops.length()) ? static_cast<const MLoop *>(b_mesh.loops[0].ptr.data) : NULL;
+}
+
+static const MPoly *mesh_polys(BL::Mesh &b_mesh)
+{
+  return (b_mesh.polygons.length()) ? static_cast<const MPoly *>(b_mesh.polygons[0].ptr.data) :
+                                      NULL;
+}
+
+static const MLoopTri *mesh_looptris(BL::Mesh &b_mesh)
+{
+  return (b_mesh.loop_triangles.length()) ?
+             static_cast<const MLoopTri *>(b_mesh.loop_triangles[0].ptr.data) :
+             NULL;
+}
+
+static inline float3 mvert_co(const MVert &v)
+{
+  return make_float3(v.co[0], v.co[1], v.co[2]);
+}
+
+static inline float3 mvert_normal(const MVert &v)
+{
+  const float scale = 1.0f / 32767.0f;
+  return make_float3(v.no[0] * scale, v.no[1] * scale, v.no[2] * scale);
+}
+
 /* Tangent Space */
 
 struct MikkUserData {
@@ -584,12 +626,18 @@ static void attr_create_uv_map(Scene *scene, Mesh *mesh, BL::Mesh &b_mesh)
 
         float2 *fdata = uv_attr->data_float2();
 
-        for (BL::MeshLoopTriangle &t : b_mesh.loop_triangles) {
-          int3 li = get_int3(t.loops());
-          fdata[0] = get_float2(l.data[li[0]].uv());
-          fdata[1] = get_float2(l.data[li[1]].uv());
-          fdata[2] = get_float2(l.data[li[2]].uv());
-          fdata += 3;
+        const int numtris = b_mesh.loop_triangles.length();
+        if (numtris) {
+          const MLoopTri *looptris = mesh_looptris(b_mesh);
+          const MLoopUV *uvs = static_cast<const MLoopUV *>(l.data[0].ptr.data);
+
+          for (int i = 0; i < numtris; i++) {
+            for (int j = 0; j < 3; j++) {
+              const MLoopUV &uv = uvs[looptris[i].tri[j]];
+              fdata[j] = make_float2(uv.uv[0], uv.uv[1]);
+            }
+            fdata += 3;
+          }
         }
       }
 
@@ -937,17 +985,18 @@ static void create_mesh(Scene *scene,
   mesh->reserve_mesh(numverts, numtris);
 
   /* create vertex coordinates and normals */
-  BL::Mesh::vertices_iterator v;
-  for (b_mesh.vertices.begin(v); v != b_mesh.vertices.end(); ++v)
-    mesh->add_vertex(get_float3(v->co()));
+  const MVert *verts = mesh_verts(b_mesh);
+  for (int i = 0; i < numverts; i++) {
+    mesh->add_vertex(mvert_co(verts[i]));
+  }
 
   AttributeSet &attributes = (subdivision) ? mesh->subd_attributes : mesh->attributes;
   Attribute *attr_N = attributes.add(ATTR_STD_VERTEX_NORMAL);
   float3 *N = attr_N->data_float3();
 
-  for (b_mesh.vertices.begin(v); v != b_mesh.vertices.end(); ++v, ++N)
-    *N = get_float3(v->normal());
-  N = attr_N->data_float3();
+  for (int i = 0; i < numverts; i++) {
+    N[i] = mvert_normal(verts[i]);
+  }
 
   /* create generated coordinates from undeformed coordinates */
   const bool need_default_tangent = (subdivision == false) && (b_mesh.uv_layers.length() == 0) &&
@@ -962,6 +1011,7 @@ static void create_mesh(Scene *scene,
     float3 *generated = attr->data_float3();
     size_t i = 0;
 
+    BL::Mesh::vertices_iterator v;
     for (b_mesh.vertices.begin(v); v != b_mesh.vertices.end(); ++v) {
       generated[i++] = get_float3(v->undeformed_co()) * size - loc;
     }
@@ -969,18 +1019,23 @@ static void create_mesh(Scene *scene,
 
   /* create faces */
   if (!subdivision) {
-    for (BL::MeshLoopTriangle &t : b_mesh.loop_triangles) {
-      BL::MeshPolygon p = b_mesh.polygons[t.polygon_index()];
-      int3 vi = get_int3(t.vertices());
+    const MLoopTri *looptris = mesh_looptris(b_mesh);
+    const MLoop *loops = mesh_loops(b_mesh);
+    const MPoly *polys = mesh_polys(b_mesh);
 
-      int shader = clamp(p.material_index(), 0, used_shaders.size() - 1);
-      bool smooth = p.use_smooth() || use_loop_normals;
+    for (int i = 0; i < numtris; i++) {
+      const MLoopTri &t = looptris[i];
+      const MPoly &p = polys[t.poly];
+      const int vi[3] = {(int)loops[t.tri[0]].v, (int)loops[t.tri[1]].v, (int)loops[t.tri[2]].v};
+
+      int shader = clamp((int)p.mat_nr, 0, used_shaders.size() - 1);
+      bool smooth = (p.flag & ME_SMOOTH) || use_loop_normals;
 
       if (use_loop_normals) {
-        BL::Array<float, 9> loop_normals = t.split_normals();
-        for (int i = 0; i < 3; i++) {
-          N[vi[i]] = make_float3(
-              loop_normals[i * 3], loop_normals[i * 3 + 1], loop_normals[i * 3 + 2]);
+        BL::Array<float, 9> loop_normals = b_mesh.loop_triangles[i].split_normals();
+        for (int j = 0; j < 3; j++) {
+          N[vi[j]] = make_float3(
+              loop_normals[j * 3], loop_normals[j * 3 + 1], loop_normals[j * 3 + 2]);
         }
       }
 
@@ -1244,12 +1299,12 @@ void BlenderSync::sync_mesh_motion(BL::Depsgraph b_depsgraph,
     /* NOTE: We don't copy more that existing amount of vertices to prevent
      * possible memory corruption.
      */
-    BL::Mesh::vertices_iterator v;
-    int i = 0;
-    for (b_mesh.vertices.begin(v); v != b_mesh.vertices.end() && i < numverts; ++v, ++i) {
-      mP[i] = get_float3(v->co());
+    const MVert *verts = mesh_verts(b_mesh);
+    const int num_motion_verts = min((int)numverts, b_mesh.vertices.length());
+    for (int i = 0; i < num_motion_verts; i++) {
+      mP[i] = mvert_co(verts[i]);
       if (mN)
-        mN[i] = get_float3(v->normal());
+        mN[i] = mvert_normal(verts[i]);
     }
     if (new_attribute) {
       /* In case of new attribute, we verify if there really was any motion. */
@@ -34,6 +34,7 @@
 #include "util/util_hash.h"
 #include "util/util_logging.h"
 #include "util/util_task.h"
+#include "util/util_time.h"
 
 CCL_NAMESPACE_BEGIN
 
@@ -225,9 +226,11 @@ Object *BlenderSync::sync_object(BL::Depsgraph &b_depsgraph,
     return NULL;
   }
 
-  /* Use task pool only for non-instances, since sync_dupli_particle accesses
-   * geometry. This restriction should be removed for better performance. */
-  TaskPool *object_geom_task_pool = (is_instance) ? NULL : geom_task_pool;
+  /* Use task pool only for objects which are not particle instances, since sync_dupli_particle
+   * accesses geometry. Other instances, including those of geometry nodes, only synchronize
+   * their geometry once and can be done in parallel. */
+  const bool is_particle_instance = is_instance && b_instance.particle_system();
+  TaskPool *object_geom_task_pool = (is_particle_instance) ? NULL : geom_task_pool;
 
   /* key to lookup object */
   ObjectKey key(b_parent, persistent_id, b_ob_info.real_object, use_particle_hair);
@@ -546,6 +549,8 @@ void BlenderSync::sync_objects(BL::Depsgraph &b_depsgraph,
   /* Task pool for multithreaded geometry sync. */
   TaskPool geom_task_pool;
 
+  scoped_timer timer;
+
   /* layer data */
   bool motion = motion_time != 0.0f;
 
@@ -646,7 +651,12 @@ void BlenderSync::sync_objects(BL::Depsgraph &b_depsgraph,
     cancel = progress.get_cancel();
   }
 
+  const double objects_time = timer.get_time();
   geom_task_pool.wait_work();
+  const double geometry_time = timer.get_time() - objects_time;
+
+  VLOG(2) << "Synchronized objects " << ((motion) ? "motion " : "") << "in " << objects_time
+          << " seconds, waited " << geometry_time << " seconds for geometry.";
 
   progress.set_sync_status("");
 
@@ -251,6 +251,14 @@ void BlenderSync::sync_data(BL::RenderSettings &b_render,
 
   scoped_timer timer;
 
+  /* Time spent in every phase of the synchronization. */
+  double phase_start_time = 0.0;
+  auto log_phase_time = [&](const char *phase) {
+    const double time = timer.get_time();
+    VLOG(2) << "Time spent synchronizing " << phase << ": " << time - phase_start_time;
+    phase_start_time = time;
+  };
+
   BL::ViewLayer b_view_layer = b_depsgraph.view_layer_eval();
 
   /* TODO(sergey): This feels weak to pass view layer to the integrator, and even weaker to have an
@@ -260,8 +268,13 @@ void BlenderSync::sync_data(BL::RenderSettings &b_render,
   sync_view_layer(b_view_layer);
   sync_integrator(b_view_layer, background);
   sync_film(b_view_layer, b_v3d);
+  log_phase_time("settings");
+
   sync_shaders(b_depsgraph, b_v3d);
+  log_phase_time("shaders");
+
   sync_images();
+  log_phase_time("images");
 
   geometry_synced.clear(); /* use for objects and motion sync */
 
@@ -269,7 +282,18 @@ void BlenderSync::sync_data(BL::RenderSettings &b_render,
       scene->camera->get_motion_position() == Camera::MOTION_POSITION_CENTER) {
     sync_objects(b_depsgraph, b_v3d);
   }
+  log_phase_time("objects and geometry");
+
   sync_motion(b_render, b_depsgraph, b_v3d, b_override, width, height, python_thread_state);
+  log_phase_time("motion");
+
+  /* Share identical geometry between objects. Duplicates are deleted and synchronized again on
+   * the next update, so this is only done when the data is not kept for further updates. */
+  const bool is_persistent_data = b_engine.render() && b_engine.render().use_persistent_data();
+  if (background && !is_persistent_data) {
+    sync_geometry_deduplicate();
+    log_phase_time("geometry deduplication");
+  }
 
   geometry_synced.clear();
 
@@ -278,6 +302,7 @@ void BlenderSync::sync_data(BL::RenderSettings &b_render,
   shader_map.post_sync(false);
 
   free_data_after_sync(b_depsgraph);
+  log_phase_time("cleanup");
 
   VLOG(1) << "Total time spent synchronizing data: " << timer.get_time();
 
@@ -339,6 +364,10 @@ void BlenderSync::sync_integrator(BL::ViewLayer &b_view_layer, bool background)
   SamplingPattern sampling_pattern = (SamplingPattern)get_enum(
       cscene, "sampling_pattern", SAMPLING_NUM_PATTERNS, SAMPLING_PATTERN_SOBOL);
   integrator->set_sampling_pattern(sampling_pattern);
+  integrator->set_use_blue_noise(get_boolean(cscene, "use_blue_noise"));
+
+  integrator->set_use_guiding(get_boolean(cscene, "use_guiding"));
+  integrator->set_guiding_training_samples(get_int(cscene, "guiding_training_samples"));
 
   if (preview) {
     integrator->set_use_adaptive_sampling(
@@ -376,6 +405,7 @@ void BlenderSync::sync_integrator(BL::ViewLayer &b_view_layer, bool background)
     integrator->set_use_denoise_pass_albedo(denoise_params.use_pass_albedo);
     integrator->set_use_denoise_pass_normal(denoise_params.use_pass_normal);
     integrator->set_denoiser_prefilter(denoise_params.prefilter);
+    integrator->set_denoiser_memory_limit(denoise_params.memory_limit);
   }
 
   /* UPDATE_NONE as we don't want to tag the integrator as modified (this was done by the
@@ -751,6 +781,7 @@ SceneParams BlenderSync::get_scene_params(BL::Scene &b_scene, bool background)
 
   params.use_bvh_spatial_split = RNA_boolean_get(&cscene, "debug_use_spatial_splits");
   params.use_bvh_unaligned_nodes = RNA_boolean_get(&cscene, "debug_use_hair_bvh");
+  params.use_bvh_compressed_nodes = RNA_boolean_get(&cscene, "debug_use_compressed_bvh");
   params.num_bvh_time_steps = RNA_int_get(&cscene, "debug_bvh_time_steps");
 
   PointerRNA csscene = RNA_pointer_get(&b_scene.ptr, "cycles_curves");
@@ -887,6 +918,7 @@ DenoiseParams BlenderSync::get_denoise_params(BL::Scene &b_scene,
     denoising.type = (DenoiserType)get_enum(cscene, "denoiser", DENOISER_NUM, DENOISER_NONE);
     denoising.prefilter = (DenoiserPrefilter)get_enum(
         cscene, "denoising_prefilter", DENOISER_PREFILTER_NUM, DENOISER_PREFILTER_NONE);
+    denoising.memory_limit = get_int(cscene, "denoising_memory_limit");
 
     input_passes = (DenoiserInput)get_enum(
         cscene, "denoising_input_passes", DENOISER_INPUT_NUM, DENOISER_INPUT_RGB_ALBEDO_NORMAL);
@@ -178,6 +178,9 @@ class BlenderSync {
                           bool use_particle_hair,
                           TaskPool *task_pool);
 
+  /* Share geometry with identical content between objects. */
+  void sync_geometry_deduplicate();
+
   void sync_geometry_motion(BL::Depsgraph &b_depsgraph,
                             BObjectInfo &b_ob_info,
                             Object *object,
@@ -152,6 +152,17 @@ void BVH2::pack_aligned_inner(const BVHStackEntry &e,
                               const BVHStackEntry &e0,
                               const BVHStackEntry &e1)
 {
+  if (params.use_compressed_nodes) {
+    pack_compressed_node(e.idx,
+                         e0.node->bounds,
+                         e1.node->bounds,
+                         e0.encodeIdx(),
+                         e1.encodeIdx(),
+                         e0.node->visibility,
+                         e1.node->visibility);
+    return;
+  }
+
   pack_aligned_node(e.idx,
                     e0.node->bounds,
                     e1.node->bounds,
@@ -193,6 +204,107 @@ void BVH2::pack_aligned_node(int idx,
   memcpy(&pack.nodes[idx], data, sizeof(int4) * BVH_NODE_SIZE);
 }
 
+/* Biased power-of-two exponent of the quantization step, so that 255 steps cover
+ * the given extent. Matches the exponent bits of a single precision float. */
+static uint compressed_node_exponent(float origin, float extent)
+{
+  int exponent = 0;
+  if (extent > 0.0f) {
+    frexpf(extent / 255.0f, &exponent);
+  }
+  uint biased_exponent = (uint)clamp(exponent + 127, 1, 254);
+
+  /* Make sure the decoded upper bound covers the node, taking float rounding into account. */
+  while (biased_exponent < 254 &&
+         origin + 255.0f * __uint_as_float(biased_exponent << 23) < origin + extent) {
+    biased_exponent++;
+  }
+  return biased_exponent;
+}
+
+/* Quantize bounds conservatively: decoded lower bound never exceeds the actual one, decoded
+ * upper bound is never below the actual one. */
+static uint compressed_node_quantize(float origin, float scale, float value, bool upper)
+{
+  const float q = (value - origin) / scale;
+  int quantized = clamp(upper ? (int)ceilf(q) : (int)floorf(q), 0, 255);
+  if (upper) {
+    while (quantized < 255 && origin + (float)quantized * scale < value) {
+      quantized++;
+    }
+  }
+  else {
+    while (quantized > 0 && origin + (float)quantized * scale > value) {
+      quantized--;
+    }
+  }
+  return (uint)quantized;
+}
+
+void BVH2::pack_compressed_node(int idx,
+                                const BoundBox &b0,
+                                const BoundBox &b1,
+                                int c0,
+                                int c1,
+                                uint visibility0,
+                                uint visibility1)
+{
+  assert(idx + BVH_COMPRESSED_NODE_SIZE <= pack.nodes.size());
+  assert(c0 < 0 || c0 < pack.nodes.size());
+  assert(c1 < 0 || c1 < pack.nodes.size());
+
+  /* Children with empty bounds (which could happen after refit) are quantized to a degenerate
+   * box at the origin of the node. */
+  BoundBox bounds = BoundBox::empty;
+  if (b0.valid()) {
+    bounds.grow(b0);
+  }
+  if (b1.valid()) {
+    bounds.grow(b1);
+  }
+  if (!bounds.valid()) {
+    bounds = BoundBox(zero_float3());
+  }
+
+  const float3 origin = bounds.min;
+  const float3 extent = bounds.max - bounds.min;
+  const uint exponent_x = compressed_node_exponent(origin.x, extent.x);
+  const uint exponent_y = compressed_node_exponent(origin.y, extent.y);
+  const uint exponent_z = compressed_node_exponent(origin.z, extent.z);
+  const float3 scale = make_float3(__uint_as_float(exponent_x << 23),
+                                   __uint_as_float(exponent_y << 23),
+                                   __uint_as_float(exponent_z << 23));
+
+  const BoundBox q0 = b0.valid() ? b0 : BoundBox(origin);
+  const BoundBox q1 = b1.valid() ? b1 : BoundBox(origin);
+
+  uint quantized[3];
+  for (int axis = 0; axis < 3; axis++) {
+    const float o = origin[axis], s = scale[axis];
+    quantized[axis] = compressed_node_quantize(o, s, q0.min[axis], false) |
+                      (compressed_node_quantize(o, s, q1.min[axis], false) << 8) |
+                      (compressed_node_quantize(o, s, q0.max[axis], true) << 16) |
+                      (compressed_node_quantize(o, s, q1.max[axis], true) << 24);
+  }
+
+  int4 data[BVH_COMPRESSED_NODE_SIZE] = {
+      make_int4(
+          visibility0 & ~PATH_RAY_NODE_UNALIGNED, visibility1 & ~PATH_RAY_NODE_UNALIGNED, c0, c1),
+      make_int4(__float_as_int(origin.x),
+                __float_as_int(origin.y),
+                __float_as_int(origin.z),
+                (int)(exponent_x | (exponent_y << 8) | (exponent_z << 16))),
+      make_int4((int)quantized[0], (int)quantized[1], (int)quantized[2], 0),
+  };
+
+  memcpy(&pack.nodes[idx], data, sizeof(int4) * BVH_COMPRESSED_NODE_SIZE);
+}
+
+int BVH2::aligned_node_size() const
+{
+  return params.use_compressed_nodes ? BVH_COMPRESSED_NODE_SIZE : BVH_NODE_SIZE;
+}
+
 void BVH2::pack_unaligned_inner(const BVHStackEntry &e,
                                 const BVHStackEntry &e0,
                                 const BVHStackEntry &e1)
@@ -246,14 +358,15 @@ void BVH2::pack_nodes(const BVHNode *root)
   const size_t num_leaf_nodes = root->getSubtreeSize(BVH_STAT_LEAF_COUNT);
   assert(num_leaf_nodes <= num_nodes);
   const size_t num_inner_nodes = num_nodes - num_leaf_nodes;
+  const int aligned_size = aligned_node_size();
   size_t node_size;
   if (params.use_unaligned_nodes) {
     const size_t num_unaligned_nodes = root->getSubtreeSize(BVH_STAT_UNALIGNED_INNER_COUNT);
     node_size = (num_unaligned_nodes * BVH_UNALIGNED_NODE_SIZE) +
-                (num_inner_nodes - num_unaligned_nodes) * BVH_NODE_SIZE;
+                (num_inner_nodes - num_unaligned_nodes) * aligned_size;
   }
   else {
-    node_size = num_inner_nodes * BVH_NODE_SIZE;
+    node_size = num_inner_nodes * aligned_size;
   }
   /* Resize arrays */
   pack.nodes.clear();
@@ -276,7 +389,7 @@ void BVH2::pack_nodes(const BVHNode *root)
   }
   else {
     stack.push_back(BVHStackEntry(root, nextNodeIdx));
-    nextNodeIdx += root->has_unaligned() ? BVH_UNALIGNED_NODE_SIZE : BVH_NODE_SIZE;
+    nextNodeIdx += root->has_unaligned() ? BVH_UNALIGNED_NODE_SIZE : aligned_size;
   }
 
   while (stack.size()) {
@@ -298,7 +411,7 @@ void BVH2::pack_nodes(const BVHNode *root)
         else {
           idx[i] = nextNodeIdx;
           nextNodeIdx += e.node->get_child(i)->has_unaligned() ? BVH_UNALIGNED_NODE_SIZE :
-                                                                 BVH_NODE_SIZE;
+                                                                 aligned_size;
         }
       }
 
@@ -342,7 +455,7 @@ void BVH2::refit_node(int idx, bool leaf, BoundBox &bbox, uint &visibility)
     memcpy(&pack.leaf_nodes[idx], leaf_data, sizeof(float4) * BVH_NODE_LEAF_SIZE);
   }
   else {
-    assert(idx + BVH_NODE_SIZE <= pack.nodes.size());
+    assert(idx + aligned_node_size() <= pack.nodes.size());
 
     const int4 *data = &pack.nodes[idx];
     const bool is_unaligned = (data[0].x & PATH_RAY_NODE_UNALIGNED) != 0;
@@ -360,6 +473,9 @@ void BVH2::refit_node(int idx, bool leaf, BoundBox &bbox, uint &visibility)
       pack_unaligned_node(
           idx, aligned_space, aligned_space, bbox0, bbox1, c0, c1, visibility0, visibility1);
     }
+    else if (params.use_compressed_nodes) {
+      pack_compressed_node(idx, bbox0, bbox1, c0, c1, visibility0, visibility1);
+    }
     else {
       pack_aligned_node(idx, bbox0, bbox1, c0, c1, visibility0, visibility1);
     }
@@ -669,7 +785,7 @@ void BVH2::pack_instances(size_t nodes_size, size_t leaf_nodes_size)
           nsize_bbox = 0;
         }
         else {
-          nsize = BVH_NODE_SIZE;
+          nsize = aligned_node_size();
           nsize_bbox = 0;
         }
 
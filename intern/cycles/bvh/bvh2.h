@@ -29,6 +29,7 @@ CCL_NAMESPACE_BEGIN
 #define BVH_NODE_SIZE 4
 #define BVH_NODE_LEAF_SIZE 1
 #define BVH_UNALIGNED_NODE_SIZE 7
+#define BVH_COMPRESSED_NODE_SIZE 3
 
 /* Pack Utility */
 struct BVHStackEntry {
@@ -77,6 +78,17 @@ class BVH2 : public BVH {
                          uint visibility0,
                          uint visibility1);
 
+  void pack_compressed_node(int idx,
+                            const BoundBox &b0,
+                            const BoundBox &b1,
+                            int c0,
+                            int c1,
+                            uint visibility0,
+                            uint visibility1);
+
+  /* Size of an axis aligned inner node, depends on whether compressed nodes are used. */
+  int aligned_node_size() const;
+
   void pack_unaligned_inner(const BVHStackEntry &e,
                             const BVHStackEntry &e0,
                             const BVHStackEntry &e1);
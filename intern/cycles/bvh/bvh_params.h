@@ -95,6 +95,13 @@ class BVHParams {
    */
   bool use_unaligned_nodes;
 
+  /* Store aligned inner nodes with child bounds quantized to 8 bits relative
+   * to the node bounds. Only used for BVH2 layout.
+   *
+   * Reduces memory of inner nodes by a quarter, with slightly looser bounds.
+   */
+  bool use_compressed_nodes;
+
   /* Split time range to this number of steps and create leaf node for each
    * of this time steps.
    *
@@ -136,6 +143,7 @@ class BVHParams {
     top_level = false;
     bvh_layout = BVH_LAYOUT_BVH2;
     use_unaligned_nodes = false;
+    use_compressed_nodes = false;
 
     num_motion_curve_steps = 0;
     num_motion_triangle_steps = 0;
@@ -54,6 +54,7 @@
 #include "util/util_function.h"
 #include "util/util_logging.h"
 #include "util/util_map.h"
+#include "util/util_mapped_malloc.h"
 #include "util/util_openimagedenoise.h"
 #include "util/util_optimization.h"
 #include "util/util_progress.h"
@@ -119,6 +120,56 @@ bool CPUDevice::load_texture_info()
   return true;
 }
 
+void *CPUDevice::host_alloc(const MemoryType type, const size_t size)
+{
+  /* Scene data, textures and render buffers are accessed by the kernels directly from the host
+   * memory, so when a memory map directory is specified they are backed by files there. This way
+   * the operating system pages them in when they are accessed, and can evict them again under
+   * memory pressure, allowing to render scenes and resolutions which do not fit into the physical
+   * memory. Smaller allocations are not worth a file of their own. */
+  static const size_t min_mapped_size = 1024 * 1024;
+
+  if (!info.memory_map_directory.empty() &&
+      (type == MEM_GLOBAL || type == MEM_TEXTURE || type == MEM_READ_WRITE) &&
+      size >= min_mapped_size) {
+    void *ptr = util_mapped_malloc(size, info.memory_map_directory);
+    if (ptr) {
+      thread_scoped_lock lock(mapped_memory_mutex);
+      mapped_memory[ptr] = size;
+      stats.mem_mapped_alloc(size);
+      return ptr;
+    }
+  }
+
+  return Device::host_alloc(type, size);
+}
+
+void CPUDevice::host_free(const MemoryType type, void *host_pointer, const size_t size)
+{
+  {
+    thread_scoped_lock lock(mapped_memory_mutex);
+    map<void *, size_t>::iterator it = mapped_memory.find(host_pointer);
+    if (it != mapped_memory.end()) {
+      assert(it->second == size);
+      util_mapped_free(host_pointer, it->second);
+      stats.mem_mapped_free(it->second);
+      mapped_memory.erase(it);
+      return;
+    }
+  }
+
+  /* Not all host pointers originate from host_alloc(), for example data taken over from an array
+   * with steal_data(). Those were never mapped and are freed as regular memory. */
+  Device::host_free(type, host_pointer, size);
+}
+
+bool CPUDevice::host_is_transferable(const void *host_pointer)
+{
+  /* Mapped memory can not be freed by an array, it needs to be unmapped by host_free(). */
+  thread_scoped_lock lock(mapped_memory_mutex);
+  return mapped_memory.find(const_cast<void *>(host_pointer)) == mapped_memory.end();
+}
+
 void CPUDevice::mem_alloc(device_memory &mem)
 {
   if (mem.type == MEM_TEXTURE) {
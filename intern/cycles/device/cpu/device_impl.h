@@ -31,6 +31,9 @@
 #include "device/device.h"
 #include "device/device_memory.h"
 
+#include "util/util_map.h"
+#include "util/util_thread.h"
+
 // clang-format off
 #include "kernel/device/cpu/compat.h"
 #include "kernel/device/cpu/kernel.h"
@@ -59,6 +62,10 @@ class CPUDevice : public Device {
 
   CPUKernels kernels;
 
+  /* Host memory which is backed by a file mapping, with its size. */
+  thread_mutex mapped_memory_mutex;
+  map<void *, size_t> mapped_memory;
+
   CPUDevice(const DeviceInfo &info_, Stats &stats_, Profiler &profiler_);
   ~CPUDevice();
 
@@ -70,6 +77,10 @@ class CPUDevice : public Device {
    * re-initialization might be needed). */
   bool load_texture_info();
 
+  virtual void *host_alloc(const MemoryType type, const size_t size) override;
+  virtual void host_free(const MemoryType type, void *host_pointer, const size_t size) override;
+  virtual bool host_is_transferable(const void *host_pointer) override;
+
   virtual void mem_alloc(device_memory &mem) override;
   virtual void mem_copy_to(device_memory &mem) override;
   virtual void mem_copy_from(
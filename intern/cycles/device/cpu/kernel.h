@@ -33,6 +33,8 @@ class CPUKernels {
       CPUKernelFunction<void (*)(const KernelGlobals *kg, IntegratorStateCPU *state)>;
   using IntegratorShadeFunction = CPUKernelFunction<void (*)(
       const KernelGlobals *kg, IntegratorStateCPU *state, ccl_global float *render_buffer)>;
+  using IntegratorShadeBatchFunction = CPUKernelFunction<bool (*)(
+      const KernelGlobals *kg, IntegratorStateCPU *state, ccl_global float *render_buffer)>;
   using IntegratorInitFunction = CPUKernelFunction<bool (*)(const KernelGlobals *kg,
                                                             IntegratorStateCPU *state,
                                                             KernelWorkTile *tile,
@@ -50,6 +52,7 @@ class CPUKernels {
   IntegratorShadeFunction integrator_shade_surface;
   IntegratorShadeFunction integrator_shade_volume;
   IntegratorShadeFunction integrator_megakernel;
+  IntegratorShadeBatchFunction integrator_megakernel_shade;
 
   /* Shader evaluation. */
 
@@ -28,6 +28,7 @@
 #include "device/multi/device.h"
 #include "device/optix/device.h"
 
+#include "util/util_aligned_malloc.h"
 #include "util/util_foreach.h"
 #include "util/util_half.h"
 #include "util/util_logging.h"
@@ -54,6 +55,21 @@ Device::~Device() noexcept(false)
 {
 }
 
+void *Device::host_alloc(const MemoryType /*type*/, const size_t size)
+{
+  return util_aligned_malloc(size, MIN_ALIGNMENT_CPU_DATA_TYPES);
+}
+
+void Device::host_free(const MemoryType /*type*/, void *host_pointer, const size_t /*size*/)
+{
+  util_aligned_free(host_pointer);
+}
+
+bool Device::host_is_transferable(const void * /*host_pointer*/)
+{
+  return true;
+}
+
 void Device::build_bvh(BVH *bvh, Progress &progress, bool refit)
 {
   assert(bvh->params.bvh_layout == BVH_LAYOUT_BVH2);
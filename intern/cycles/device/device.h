@@ -78,6 +78,10 @@ class DeviceInfo {
   bool has_gpu_queue;         /* Device supports GPU queue. */
   DenoiserTypeMask denoisers; /* Supported denoiser types. */
   int cpu_threads;
+  /* Directory for files backing scene data, textures and render buffers, so that they can be
+   * paged in on demand instead of being resident in memory. Empty means regular memory is used.
+   * CPU only. */
+  string memory_map_directory;
   vector<DeviceInfo> multi_devices;
   string error_msg;
 
@@ -271,6 +275,12 @@ class Device {
   friend class DeviceServer;
   friend class device_memory;
 
+  /* Host side memory allocation of device memory. */
+  virtual void *host_alloc(const MemoryType type, const size_t size);
+  virtual void host_free(const MemoryType type, void *host_pointer, const size_t size);
+  /* Whether the host pointer is regular aligned memory which can be taken over by an array. */
+  virtual bool host_is_transferable(const void *host_pointer);
+
   virtual void mem_alloc(device_memory &mem) = 0;
   virtual void mem_copy_to(device_memory &mem) = 0;
   virtual void mem_copy_from(device_memory &mem, size_t y, size_t w, size_t h, size_t elem) = 0;
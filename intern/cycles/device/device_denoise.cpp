@@ -78,6 +78,8 @@ NODE_DEFINE(DenoiseParams)
 
   SOCKET_ENUM(prefilter, "Prefilter", *prefilter_enum, DENOISER_PREFILTER_FAST);
 
+  SOCKET_INT(memory_limit, "Memory Limit", 0);
+
   return type;
 }
 
@@ -74,6 +74,10 @@ class DenoiseParams : public Node {
 
   DenoiserPrefilter prefilter = DENOISER_PREFILTER_FAST;
 
+  /* Approximate memory limit in megabytes for denoising a frame, zero for no limit. Frames which
+   * do not fit are denoised in overlapping tiles. Only supported by OpenImageDenoise. */
+  int memory_limit = 0;
+
   static const NodeEnum *get_type_enum();
   static const NodeEnum *get_prefilter_enum();
 
@@ -83,7 +87,8 @@ class DenoiseParams : public Node {
   {
     return !(use == other.use && type == other.type && start_sample == other.start_sample &&
              use_pass_albedo == other.use_pass_albedo &&
-             use_pass_normal == other.use_pass_normal && prefilter == other.prefilter);
+             use_pass_normal == other.use_pass_normal && prefilter == other.prefilter &&
+             memory_limit == other.memory_limit);
   }
 };
 
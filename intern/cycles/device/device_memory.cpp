@@ -95,7 +95,7 @@ void *device_memory::host_alloc(size_t size)
     return 0;
   }
 
-  void *ptr = util_aligned_malloc(size, MIN_ALIGNMENT_CPU_DATA_TYPES);
+  void *ptr = device->host_alloc(type, size);
 
   if (ptr) {
     util_guarded_mem_alloc(size);
@@ -111,11 +111,16 @@ void device_memory::host_free()
 {
   if (host_pointer) {
     util_guarded_mem_free(memory_size());
-    util_aligned_free((void *)host_pointer);
+    device->host_free(type, host_pointer, memory_size());
     host_pointer = 0;
   }
 }
 
+bool device_memory::host_is_transferable()
+{
+  return device->host_is_transferable(host_pointer);
+}
+
 void device_memory::device_alloc()
 {
   assert(!device_pointer && type != MEM_TEXTURE && type != MEM_GLOBAL);
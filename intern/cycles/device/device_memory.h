@@ -291,6 +291,7 @@ class device_memory {
    * the same pointer for host and device. */
   void *host_alloc(size_t size);
   void host_free();
+  bool host_is_transferable();
 
   /* Device memory allocation and copying. */
   void device_alloc();
@@ -464,7 +465,16 @@ template<typename T> class device_vector : public device_memory {
   {
     device_free();
 
-    to.set_data((T *)host_pointer, data_size);
+    if (host_pointer && !host_is_transferable()) {
+      /* Memory which the device allocated in a special way is copied instead, and freed by the
+       * device. */
+      T *data = to.resize(data_size);
+      memcpy(data, host_pointer, data_size * sizeof(T));
+      host_free();
+    }
+    else {
+      to.set_data((T *)host_pointer, data_size);
+    }
     data_size = 0;
     data_width = 0;
     data_height = 0;
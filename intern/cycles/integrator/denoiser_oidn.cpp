@@ -25,6 +25,7 @@
 #include "util/util_array.h"
 #include "util/util_logging.h"
 #include "util/util_openimagedenoise.h"
+#include "util/util_tbb.h"
 
 #include "kernel/device/cpu/compat.h"
 #include "kernel/device/cpu/kernel.h"
@@ -146,7 +147,9 @@ class OIDNDenoiseContext {
     read_guiding_pass(oidn_normal_pass_);
   }
 
-  void denoise_pass(const PassType pass_type)
+  /* Denoise pass of the given type. A positive input scale overrides the automatic exposure of
+   * the denoiser, which is needed to get matching results for tiles of a frame. */
+  void denoise_pass(const PassType pass_type, const float input_scale = 0.0f)
   {
     OIDNPass oidn_color_pass(buffer_params_, "color", pass_type);
     if (oidn_color_pass.offset == PASS_UNUSED) {
@@ -184,6 +187,9 @@ class OIDNDenoiseContext {
         denoise_params_.prefilter == DENOISER_PREFILTER_ACCURATE) {
       oidn_filter.set("cleanAux", true);
     }
+    if (input_scale > 0.0f) {
+      oidn_filter.set("inputScale", input_scale);
+    }
     oidn_filter.commit();
 
     filter_guiding_pass_if_needed(oidn_device, oidn_albedo_pass_);
@@ -202,6 +208,37 @@ class OIDNDenoiseContext {
     postprocess_output(oidn_color_pass, oidn_output_pass);
   }
 
+  /* Read pixels of the color input of the given pass the same way as they are passed to the
+   * denoiser. Returns false if the pass does not exist. */
+  bool read_input_pass_pixels(const PassType pass_type, array<float> &pixels)
+  {
+    OIDNPass oidn_color_pass(buffer_params_, "color", pass_type);
+    if (oidn_color_pass.offset == PASS_UNUSED) {
+      return false;
+    }
+
+    const int64_t width = buffer_params_.width;
+    const int64_t height = buffer_params_.height;
+    pixels.resize(width * height * 3);
+
+    if (oidn_color_pass.use_compositing || is_pass_scale_needed(oidn_color_pass)) {
+      read_pass_pixels(oidn_color_pass, PassAccessor::Destination(pixels.data(), 3));
+      return true;
+    }
+
+    const int64_t pass_stride = buffer_params_.pass_stride;
+    const float *buffer_data = render_buffers_->buffer.data();
+
+    for (int64_t i = 0; i < width * height; ++i) {
+      const float *pass_pixel = buffer_data + i * pass_stride + oidn_color_pass.offset;
+      pixels[i * 3 + 0] = pass_pixel[0];
+      pixels[i * 3 + 1] = pass_pixel[1];
+      pixels[i * 3 + 2] = pass_pixel[2];
+    }
+
+    return true;
+  }
+
  protected:
   void filter_guiding_pass_if_needed(oidn::DeviceRef &oidn_device, OIDNPass &oidn_pass)
   {
@@ -540,6 +577,334 @@ class OIDNDenoiseContext {
    * the fake values and denoising of passes which do need albedo can no longer happen. */
   bool albedo_replaced_with_fake_ = false;
 };
+
+/* Passes which are denoised, in order. */
+static const std::array<PassType, 3> oidn_denoise_passes = {
+    {/* Passes which will use real albedo when it is available. */
+     PASS_COMBINED,
+     PASS_SHADOW_CATCHER_MATTE,
+
+     /* Passes which do not need albedo and hence if real is present it needs to become fake. */
+     PASS_SHADOW_CATCHER}};
+
+/* Denoising of frames which do not fit into the memory limit.
+ *
+ * The frame is split into tiles which are denoised one after another, each of them using all
+ * threads. Tiles are extended by an overlap which covers the receptive field of the denoiser
+ * network, and only the pixels inside of the tile are written back. Every tile works on a copy of
+ * its region of the render buffers, so that the in-place modifications done by the denoiser do not
+ * affect neighbor tiles.
+ *
+ * The automatic exposure of the denoiser is computed for the full frame using the same algorithm
+ * as OpenImageDenoise, so that all tiles use the same exposure. */
+class OIDNTiledDenoiser {
+ public:
+  /* Scratch memory of the denoiser: the same estimate which OpenImageDenoise 1.4 uses for its own
+   * memory limit, a base amount plus an amount per pixel. The per pixel amount is the one of its
+   * wider SIMD block size (AVX-512), which is the larger of the two. */
+  static constexpr int64_t kDenoiserBytesBase = 16 * 1024 * 1024;
+  static constexpr int64_t kDenoiserBytesPerPixel = 2185;
+
+  /* Number of pixels at the border of tiles which are only used as context. Covers half of the
+   * receptive field of the denoiser network, same as the overlap of the internal tiles of
+   * OpenImageDenoise. */
+  static constexpr int kOverlap = 128;
+
+  /* Smallest size of the inner region of a tile. The overlap is not reduced for small tiles, as
+   * that would change the result, so the inner region is kept at least as big as the overlap.
+   * Tiles are then up to 9 times bigger than their inner region, and the memory limit can not be
+   * respected for limits this small. */
+  static constexpr int kMinTileSize = kOverlap;
+
+  OIDNTiledDenoiser(OIDNDenoiser *denoiser,
+                    const DenoiseParams &denoise_params,
+                    const BufferParams &buffer_params,
+                    RenderBuffers *render_buffers,
+                    const int num_samples)
+      : denoiser_(denoiser),
+        denoise_params_(denoise_params),
+        buffer_params_(buffer_params),
+        render_buffers_(render_buffers),
+        num_samples_(num_samples)
+  {
+  }
+
+  /* Check whether denoising of the full frame at once fits into the memory limit. */
+  static bool need_tiles(const DenoiseParams &denoise_params, const BufferParams &buffer_params)
+  {
+    if (denoise_params.memory_limit <= 0) {
+      return false;
+    }
+
+    /* Scratch memory of the denoiser and scaled guiding passes of the full frame. */
+    const int64_t num_pixels = (int64_t)buffer_params.width * buffer_params.height;
+    const int64_t memory = kDenoiserBytesBase +
+                           num_pixels * (kDenoiserBytesPerPixel + 2 * 3 * sizeof(float));
+
+    return memory > get_memory_limit(denoise_params);
+  }
+
+  bool denoise()
+  {
+    const int tile_size = get_tile_size();
+    const int num_tiles_x = divide_up(buffer_params_.width, tile_size);
+    const int num_tiles_y = divide_up(buffer_params_.height, tile_size);
+
+    VLOG(3) << "Denoising " << buffer_params_.width << "x" << buffer_params_.height
+            << " frame in " << num_tiles_x * num_tiles_y << " tiles of size " << tile_size;
+
+    /* Exposure of the full frame. */
+    std::array<float, oidn_denoise_passes.size()> input_scale;
+    if (!compute_input_scale(tile_size, input_scale)) {
+      return false;
+    }
+
+    for (int tile_y = 0; tile_y < num_tiles_y; ++tile_y) {
+      for (int tile_x = 0; tile_x < num_tiles_x; ++tile_x) {
+        const int x = tile_x * tile_size;
+        const int y = tile_y * tile_size;
+        const int width = min(tile_size, buffer_params_.width - x);
+        const int height = min(tile_size, buffer_params_.height - y);
+
+        if (!denoise_tile(x, y, width, height, input_scale)) {
+          return false;
+        }
+      }
+    }
+
+    return true;
+  }
+
+ protected:
+  static int64_t get_memory_limit(const DenoiseParams &denoise_params)
+  {
+    return (int64_t)denoise_params.memory_limit * 1024 * 1024;
+  }
+
+  /* Size of the inner region of tiles, so that the tile with its overlap fits into the memory
+   * limit. */
+  int get_tile_size() const
+  {
+    /* Copy of the render buffers, the denoiser scratch memory and the fake albedo. */
+    const int64_t memory_per_pixel = buffer_params_.pass_stride * sizeof(float) +
+                                     kDenoiserBytesPerPixel + 3 * sizeof(float);
+    const int64_t memory = get_memory_limit(denoise_params_) - kDenoiserBytesBase;
+    const int64_t num_pixels = (memory > 0) ? memory / memory_per_pixel : 0;
+    const int size = (int)sqrt((double)num_pixels) - 2 * kOverlap;
+
+    if (size < kMinTileSize) {
+      LOG(WARNING) << "Denoising memory limit of " << denoise_params_.memory_limit
+                   << " MB is too small, using tiles of the minimum size.";
+      return kMinTileSize;
+    }
+
+    return size;
+  }
+
+  /* Copy region of the full frame into a tile buffer, using the same passes layout. */
+  void copy_region_to_tile(RenderBuffers &tile_buffers, const BufferParams &tile_params)
+  {
+    const int64_t pass_stride = buffer_params_.pass_stride;
+    const int64_t x = tile_params.full_x - buffer_params_.full_x;
+    const int64_t y = tile_params.full_y - buffer_params_.full_y;
+
+    const float *src = render_buffers_->buffer.data();
+    float *dst = tile_buffers.buffer.data();
+
+    tbb::parallel_for(0, tile_params.height, [&](int64_t row) {
+      memcpy(dst + row * tile_params.width * pass_stride,
+             src + ((y + row) * buffer_params_.width + x) * pass_stride,
+             sizeof(float) * tile_params.width * pass_stride);
+    });
+  }
+
+  /* Copy denoised pixels of the inner region of the tile back to the full frame. */
+  void copy_denoised_from_tile(const RenderBuffers &tile_buffers,
+                               const BufferParams &tile_params,
+                               const int x,
+                               const int y,
+                               const int width,
+                               const int height)
+  {
+    const int64_t pass_stride = buffer_params_.pass_stride;
+    const int64_t tile_x = x - (tile_params.full_x - buffer_params_.full_x);
+    const int64_t tile_y = y - (tile_params.full_y - buffer_params_.full_y);
+
+    const float *src = tile_buffers.buffer.data();
+    float *dst = render_buffers_->buffer.data();
+
+    for (const PassType pass_type : oidn_denoise_passes) {
+      const int offset = buffer_params_.get_pass_offset(pass_type, PassMode::DENOISED);
+      if (offset == PASS_UNUSED) {
+        continue;
+      }
+
+      const int num_components = Pass::get_info(pass_type).num_components;
+
+      tbb::parallel_for(0, height, [&](int64_t row) {
+        const float *src_pixel = src +
+                                 ((tile_y + row) * tile_params.width + tile_x) * pass_stride +
+                                 offset;
+        float *dst_pixel = dst + ((y + row) * buffer_params_.width + x) * pass_stride + offset;
+
+        for (int i = 0; i < width; ++i, src_pixel += pass_stride, dst_pixel += pass_stride) {
+          for (int c = 0; c < num_components; ++c) {
+            dst_pixel[c] = src_pixel[c];
+          }
+        }
+      });
+    }
+  }
+
+  /* Allocate tile buffers for the given inner region extended by the overlap, and copy the
+   * render buffers pixels into it. */
+  void create_tile(const int x,
+                   const int y,
+                   const int width,
+                   const int height,
+                   const int overlap,
+                   RenderBuffers &tile_buffers,
+                   BufferParams &tile_params)
+  {
+    const int x0 = max(x - overlap, 0);
+    const int y0 = max(y - overlap, 0);
+    const int x1 = min(x + width + overlap, buffer_params_.width);
+    const int y1 = min(y + height + overlap, buffer_params_.height);
+
+    tile_params = buffer_params_;
+    tile_params.full_x = buffer_params_.full_x + x0;
+    tile_params.full_y = buffer_params_.full_y + y0;
+    tile_params.width = x1 - x0;
+    tile_params.height = y1 - y0;
+    tile_params.update_offset_stride();
+
+    tile_buffers.buffer.alloc(tile_params.pass_stride * tile_params.width, tile_params.height);
+    copy_region_to_tile(tile_buffers, tile_params);
+  }
+
+  /* Compute exposure of the color input of every pass the same way as the automatic exposure of
+   * OpenImageDenoise: as a geometric mean of the luminance of bins of up to 16x16 pixels. */
+  bool compute_input_scale(const int tile_size,
+                           std::array<float, oidn_denoise_passes.size()> &input_scale)
+  {
+    const int width = buffer_params_.width;
+    const int height = buffer_params_.height;
+    const int max_bin_size = 16;
+    const int num_bins_x = divide_up(width, max_bin_size);
+    const int num_bins_y = divide_up(height, max_bin_size);
+
+    /* Bin of every column and row of the frame. */
+    vector<int> bin_x(width), bin_y(height);
+    vector<int> bin_width(num_bins_x), bin_height(num_bins_y);
+    for (int i = 0; i < num_bins_x; ++i) {
+      const int begin = (int)((int64_t)i * width / num_bins_x);
+      const int end = (int)((int64_t)(i + 1) * width / num_bins_x);
+      std::fill(bin_x.begin() + begin, bin_x.begin() + end, i);
+      bin_width[i] = end - begin;
+    }
+    for (int i = 0; i < num_bins_y; ++i) {
+      const int begin = (int)((int64_t)i * height / num_bins_y);
+      const int end = (int)((int64_t)(i + 1) * height / num_bins_y);
+      std::fill(bin_y.begin() + begin, bin_y.begin() + end, i);
+      bin_height[i] = end - begin;
+    }
+
+    vector<vector<double>> bin_luminance(oidn_denoise_passes.size());
+    for (vector<double> &luminance : bin_luminance) {
+      luminance.resize(num_bins_x * num_bins_y, 0.0);
+    }
+
+    /* Read the color input of tiles without overlap. */
+    array<float> pixels;
+    for (int y = 0; y < height; y += tile_size) {
+      for (int x = 0; x < width; x += tile_size) {
+        RenderBuffers tile_buffers(render_buffers_->buffer.device);
+        BufferParams tile_params;
+        create_tile(x, y, min(tile_size, width - x), min(tile_size, height - y), 0,
+                    tile_buffers, tile_params);
+
+        OIDNDenoiseContext context(
+            denoiser_, denoise_params_, tile_params, &tile_buffers, num_samples_, true);
+
+        for (size_t i = 0; i < oidn_denoise_passes.size(); ++i) {
+          if (!context.read_input_pass_pixels(oidn_denoise_passes[i], pixels)) {
+            continue;
+          }
+
+          for (int row = 0; row < tile_params.height; ++row) {
+            const float *pixel = pixels.data() + row * tile_params.width * 3;
+            double *bin_row = bin_luminance[i].data() + bin_y[y + row] * num_bins_x;
+            for (int col = 0; col < tile_params.width; ++col, pixel += 3) {
+              bin_row[bin_x[x + col]] += 0.212671f * pixel[0] + 0.715160f * pixel[1] +
+                                         0.072169f * pixel[2];
+            }
+          }
+        }
+
+        if (denoiser_->is_cancelled()) {
+          return false;
+        }
+      }
+    }
+
+    for (size_t i = 0; i < oidn_denoise_passes.size(); ++i) {
+      const float key = 0.18f;
+      const float eps = 1e-8f;
+
+      double sum = 0.0;
+      int count = 0;
+      for (int by = 0; by < num_bins_y; ++by) {
+        for (int bx = 0; bx < num_bins_x; ++bx) {
+          const double luminance = bin_luminance[i][by * num_bins_x + bx] /
+                                   (bin_width[bx] * bin_height[by]);
+          if (luminance > eps) {
+            sum += log2(luminance);
+            count++;
+          }
+        }
+      }
+
+      input_scale[i] = (count > 0) ? (float)(key / exp2(sum / count)) : 1.0f;
+    }
+
+    return true;
+  }
+
+  bool denoise_tile(const int x,
+                    const int y,
+                    const int width,
+                    const int height,
+                    const std::array<float, oidn_denoise_passes.size()> &input_scale)
+  {
+    RenderBuffers tile_buffers(render_buffers_->buffer.device);
+    BufferParams tile_params;
+    create_tile(x, y, width, height, kOverlap, tile_buffers, tile_params);
+
+    /* The tile is a copy, so in-place modification of its passes is always allowed. */
+    OIDNDenoiseContext context(
+        denoiser_, denoise_params_, tile_params, &tile_buffers, num_samples_, true);
+
+    context.read_guiding_passes();
+
+    for (size_t i = 0; i < oidn_denoise_passes.size(); ++i) {
+      context.denoise_pass(oidn_denoise_passes[i], input_scale[i]);
+      if (denoiser_->is_cancelled()) {
+        return false;
+      }
+    }
+
+    copy_denoised_from_tile(tile_buffers, tile_params, x, y, width, height);
+
+    return true;
+  }
+
+  OIDNDenoiser *denoiser_ = nullptr;
+
+  const DenoiseParams &denoise_params_;
+  const BufferParams &buffer_params_;
+  RenderBuffers *render_buffers_ = nullptr;
+  int num_samples_ = 0;
+};
 #endif
 
 static unique_ptr<DeviceQueue> create_device_queue(const RenderBuffers *render_buffers)
@@ -591,23 +956,22 @@ bool OIDNDenoiser::denoise_buffer(const BufferParams &buffer_params,
       this, params_, buffer_params, render_buffers, num_samples, allow_inplace_modification);
 
   if (context.need_denoising()) {
-    context.read_guiding_passes();
-
-    const std::array<PassType, 3> passes = {
-        {/* Passes which will use real albedo when it is available. */
-         PASS_COMBINED,
-         PASS_SHADOW_CATCHER_MATTE,
-
-         /* Passes which do not need albedo and hence if real is present it needs to become fake.
-          */
-         PASS_SHADOW_CATCHER}};
-
-    for (const PassType pass_type : passes) {
-      context.denoise_pass(pass_type);
-      if (is_cancelled()) {
+    if (OIDNTiledDenoiser::need_tiles(params_, buffer_params)) {
+      OIDNTiledDenoiser tiled_denoiser(this, params_, buffer_params, render_buffers, num_samples);
+      if (!tiled_denoiser.denoise()) {
         return false;
       }
     }
+    else {
+      context.read_guiding_passes();
+
+      for (const PassType pass_type : oidn_denoise_passes) {
+        context.denoise_pass(pass_type);
+        if (is_cancelled()) {
+          return false;
+        }
+      }
+    }
 
     /* TODO: It may be possible to avoid this copy, but we have to ensure that when other code
      * copies data from the device it doesn't overwrite the denoiser buffers. */
@@ -0,0 +1,107 @@
+/*
+ * Copyright 2011-2021 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "integrator/path_guiding.h"
+
+#include "kernel/kernel_types.h"
+
+#include "util/util_math.h"
+#include "util/util_tbb.h"
+
+CCL_NAMESPACE_BEGIN
+
+/* Number of samples rendered before the distribution is built for the first time. */
+static constexpr int kMinUpdateSamples = 4;
+
+/* Number of recorded contributions after which cell is considered to be trained. */
+static constexpr float kMinCellSamples = 16.0f;
+
+/* Fraction of the uniform distribution mixed into the learned one, so that no direction of a
+ * trained cell has zero probability. */
+static constexpr float kUniformProbability = 0.1f;
+
+PathGuiding::PathGuiding()
+{
+}
+
+int PathGuiding::align_samples(int start_sample, int num_samples) const
+{
+  if (!use || start_sample >= training_samples) {
+    return num_samples;
+  }
+
+  /* Number of samples after which the next update happens: the smallest power of two which is
+   * higher than the number of already rendered samples. */
+  const int next_update_num_samples = min(
+      max(kMinUpdateSamples, (int)next_power_of_two(start_sample)), training_samples);
+
+  const int num_samples_until_update = next_update_num_samples - start_sample;
+
+  return min(num_samples_until_update, num_samples);
+}
+
+bool PathGuiding::need_update(int sample) const
+{
+  if (!use) {
+    return false;
+  }
+
+  const int num_samples = sample + 1;
+  if (num_samples > training_samples) {
+    return false;
+  }
+
+  return num_samples == training_samples ||
+         (num_samples >= kMinUpdateSamples && is_power_of_two(num_samples));
+}
+
+void PathGuiding::update_distribution(const float *training, float *distribution, int num_cells)
+{
+  parallel_for(0, num_cells, [&](int cell) {
+    const float *cell_training = training + cell * GUIDING_TRAINING_STRIDE;
+    float *cell_distribution = distribution + cell * GUIDING_DIRECTION_BINS;
+
+    float total = 0.0f;
+    for (int bin = 0; bin < GUIDING_DIRECTION_BINS; bin++) {
+      total += cell_training[bin];
+    }
+
+    if (cell_training[GUIDING_DIRECTION_BINS] < kMinCellSamples || !(total > 0.0f)) {
+      for (int bin = 0; bin < GUIDING_DIRECTION_BINS; bin++) {
+        cell_distribution[bin] = 0.0f;
+      }
+      return;
+    }
+
+    const float inv_total = (1.0f - kUniformProbability) / total;
+    const float uniform = kUniformProbability / GUIDING_DIRECTION_BINS;
+
+    float cdf = 0.0f;
+    for (int bin = 0; bin < GUIDING_DIRECTION_BINS; bin++) {
+      cdf += cell_training[bin] * inv_total + uniform;
+      cell_distribution[bin] = cdf;
+    }
+
+    /* Normalize to avoid round-off, so that the last bin is exactly 1. */
+    const float inv_cdf = 1.0f / cdf;
+    for (int bin = 0; bin < GUIDING_DIRECTION_BINS; bin++) {
+      cell_distribution[bin] *= inv_cdf;
+    }
+    cell_distribution[GUIDING_DIRECTION_BINS - 1] = 1.0f;
+  });
+}
+
+CCL_NAMESPACE_END
@@ -0,0 +1,55 @@
+/*
+ * Copyright 2011-2021 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+CCL_NAMESPACE_BEGIN
+
+/* Online-learned path guiding.
+ *
+ * The guiding field is trained during the first `training_samples` samples of the render, and
+ * the sampling distribution is rebuilt from the training data at a power of two number of
+ * samples. The kernel side of the algorithm is implemented in `kernel_guiding.h`. */
+class PathGuiding {
+ public:
+  PathGuiding();
+
+  /* Align number of samples so that rendering stops at every sample after which the guiding
+   * distribution is to be rebuilt.
+   *
+   * Returns the new value for the `num_samples` so that after rendering so many samples on top
+   * of `start_sample` the distribution is to be updated, or the original value when no update is
+   * needed in this range of samples.
+   *
+   * `start_sample` is the 0-based index of sample. */
+  int align_samples(int start_sample, int num_samples) const;
+
+  /* Check whether the guiding distribution is to be rebuilt after rendering this sample.
+   * Returns false if the path guiding is not used.
+   *
+   * `sample` is the 0-based index of sample. */
+  bool need_update(int sample) const;
+
+  /* Build per-cell sampling distribution from the radiance accumulated in the training buffer.
+   * The distribution stores the CDF of the directional bins of every cell, with all zeros for
+   * cells which did not receive enough samples yet. */
+  static void update_distribution(const float *training, float *distribution, int num_cells);
+
+  bool use = false;
+  int training_samples = 0;
+};
+
+CCL_NAMESPACE_END
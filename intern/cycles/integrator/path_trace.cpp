@@ -48,6 +48,10 @@ PathTrace::PathTrace(Device *device,
     vector<DeviceInfo> cpu_devices;
     device_cpu_info(cpu_devices);
 
+    /* Full-frame buffers which are read back from disk at the end of tiled rendering live on this
+     * device, use file backed memory for them as well when it is requested. */
+    cpu_devices[0].memory_map_directory = device->info.memory_map_directory;
+
     cpu_device_.reset(device_cpu_create(cpu_devices[0], device->stats, device->profiler));
   }
 
@@ -196,6 +200,8 @@ void PathTrace::render_pipeline(RenderWork render_work)
     return;
   }
 
+  update_path_guiding(render_work);
+
   adaptive_sample(render_work);
   if (render_cancel_.is_requested) {
     return;
@@ -359,7 +365,10 @@ void PathTrace::path_trace(RenderWork &render_work)
     PathTraceWork *path_trace_work = path_trace_works_[i].get();
 
     PathTraceWork::RenderStatistics statistics;
-    path_trace_work->render_samples(statistics, render_work.path_trace.start_sample, num_samples);
+    path_trace_work->render_samples(statistics,
+                                    render_work.path_trace.start_sample,
+                                    num_samples,
+                                    render_work.path_trace.sample_offset);
 
     const double work_time = time_dt() - work_start_time;
     work_balance_infos_[i].time_spent += work_time;
@@ -381,6 +390,33 @@ void PathTrace::path_trace(RenderWork &render_work)
       render_work, time_dt() - start_time, is_cancel_requested());
 }
 
+void PathTrace::update_path_guiding(const RenderWork &render_work)
+{
+  if (!render_work.path_trace.num_samples || !device_scene_->data.integrator.use_guiding) {
+    return;
+  }
+
+  const int last_sample = render_work.path_trace.start_sample +
+                          render_work.path_trace.num_samples - 1;
+  if (!path_guiding_.need_update(last_sample)) {
+    return;
+  }
+
+  /* The guiding is only supported on the CPU, where the kernels accumulate the training data
+   * directly into the host memory. */
+  const double start_time = time_dt();
+
+  device_vector<float> &distribution = device_scene_->guiding_distribution;
+  const int num_cells = distribution.size() / GUIDING_DIRECTION_BINS;
+
+  PathGuiding::update_distribution(
+      device_scene_->guiding_training.data(), distribution.data(), num_cells);
+  distribution.copy_to_device();
+
+  VLOG(3) << "Updated path guiding distribution of " << num_cells << " cells after "
+          << last_sample + 1 << " samples in " << time_dt() - start_time << " seconds.";
+}
+
 void PathTrace::adaptive_sample(RenderWork &render_work)
 {
   if (!render_work.adaptive_sampling.filter) {
@@ -466,6 +502,27 @@ void PathTrace::set_adaptive_sampling(const AdaptiveSampling &adaptive_sampling)
   render_scheduler_.set_adaptive_sampling(adaptive_sampling);
 }
 
+void PathTrace::set_path_guiding(const PathGuiding &path_guiding)
+{
+  path_guiding_ = path_guiding;
+  render_scheduler_.set_path_guiding(path_guiding);
+}
+
+void PathTrace::reset_path_guiding()
+{
+  device_vector<float> &distribution = device_scene_->guiding_distribution;
+  device_vector<float> &training = device_scene_->guiding_training;
+
+  if (distribution.size() == 0) {
+    return;
+  }
+
+  memset(distribution.data(), 0, distribution.memory_size());
+  memset(training.data(), 0, training.memory_size());
+  distribution.copy_to_device();
+  training.copy_to_device();
+}
+
 void PathTrace::cryptomatte_postprocess(const RenderWork &render_work)
 {
   if (!render_work.cryptomatte.postprocess) {
@@ -836,6 +893,14 @@ void PathTrace::copy_to_render_buffers(RenderBuffers *render_buffers)
   render_buffers->copy_to_device();
 }
 
+void PathTrace::copy_render_tile_to_buffers(RenderBuffers *render_buffers)
+{
+  render_buffers->reset(render_state_.effective_big_tile_params);
+  copy_to_render_buffers(render_buffers);
+
+  render_buffers->params.samples = render_scheduler_.get_num_rendered_samples();
+}
+
 void PathTrace::copy_from_render_buffers(RenderBuffers *render_buffers)
 {
   render_buffers->copy_from_device();
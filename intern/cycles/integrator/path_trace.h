@@ -18,6 +18,7 @@
 
 #include "integrator/denoiser.h"
 #include "integrator/pass_accessor.h"
+#include "integrator/path_guiding.h"
 #include "integrator/path_trace_work.h"
 #include "integrator/work_balancer.h"
 #include "render/buffers.h"
@@ -98,6 +99,13 @@ class PathTrace {
    * Use this to configure the adaptive sampler before rendering any samples. */
   void set_adaptive_sampling(const AdaptiveSampling &adaptive_sampling);
 
+  /* Set parameters used for path guiding. */
+  void set_path_guiding(const PathGuiding &path_guiding);
+
+  /* Discard everything the path guiding has learned so far.
+   * Is to be called when the scene changes, while rendering is not happening. */
+  void reset_path_guiding();
+
   /* Set GPU display which takes care of drawing the render result. */
   void set_gpu_display(unique_ptr<GPUDisplay> gpu_display);
 
@@ -128,6 +136,10 @@ class PathTrace {
    * Return true if all copies are successful. */
   bool copy_render_tile_from_device();
 
+  /* Copy render buffers of the big tile into the given buffers, which are reset to the parameters
+   * of the tile. The number of rendered samples is stored in the buffer parameters. */
+  void copy_render_tile_to_buffers(RenderBuffers *render_buffers);
+
   /* Read given full-frame file from disk, perform needed processing and write it to the software
    * via the write callback. */
   void process_full_buffer_from_disk(string_view filename);
@@ -212,6 +224,7 @@ class PathTrace {
   void init_render_buffers(const RenderWork &render_work);
   void path_trace(RenderWork &render_work);
   void adaptive_sample(RenderWork &render_work);
+  void update_path_guiding(const RenderWork &render_work);
   void denoise(const RenderWork &render_work);
   void cryptomatte_postprocess(const RenderWork &render_work);
   void update_display(const RenderWork &render_work);
@@ -268,6 +281,8 @@ class PathTrace {
   /* Denoiser which takes care of denoising the big tile. */
   unique_ptr<Denoiser> denoiser_;
 
+  PathGuiding path_guiding_;
+
   /* State which is common for all the steps of the render work.
    * Is brought up to date in the `render()` call and is accessed from all the steps involved into
    * rendering the work. */
@@ -74,8 +74,13 @@ class PathTraceWork {
   virtual void init_execution() = 0;
 
   /* Render given number of samples as a synchronous blocking call.
-   * The samples are added to the render buffer associated with this work. */
-  virtual void render_samples(RenderStatistics &statistics, int start_sample, int samples_num) = 0;
+   * The samples are added to the render buffer associated with this work.
+   *
+   * The `sample_offset` is the index of the first sample rendered into the buffer. */
+  virtual void render_samples(RenderStatistics &statistics,
+                              int start_sample,
+                              int samples_num,
+                              int sample_offset) = 0;
 
   /* Copy render result from this work to the corresponding place of the GPU display.
    *
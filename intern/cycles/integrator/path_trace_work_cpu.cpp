@@ -25,8 +25,11 @@
 #include "render/gpu_display.h"
 #include "render/scene.h"
 
+#include "util/util_algorithm.h"
 #include "util/util_atomic.h"
+#include "util/util_boundbox.h"
 #include "util/util_logging.h"
+#include "util/util_map.h"
 #include "util/util_tbb.h"
 
 CCL_NAMESPACE_BEGIN
@@ -51,6 +54,58 @@ static inline CPUKernelThreadGlobals *kernel_thread_globals_get(
   return &kernel_thread_globals[thread_index];
 }
 
+/* Spread the lower 10 bits of the value so that there are two zero bits between each of them. */
+static inline uint64_t ray_sort_key_expand_bits(uint64_t v)
+{
+  v = (v * 0x00010001u) & 0xFF0000FFu;
+  v = (v * 0x00000101u) & 0x0F00F00Fu;
+  v = (v * 0x00000011u) & 0xC30C30C3u;
+  v = (v * 0x00000005u) & 0x49249249u;
+  return v;
+}
+
+/* Sort the batch of paths so that rays are traced in order of their direction octant and the
+ * Morton code of their origin within the bounds of the batch. Consecutive rays then traverse
+ * mostly the same BVH nodes, which stay in the CPU caches. */
+static void ray_batch_sort(vector<IntegratorStateCPU *> &batch,
+                           vector<pair<uint64_t, IntegratorStateCPU *>> &keys,
+                           const bool shadow)
+{
+  if (batch.size() < 2) {
+    return;
+  }
+
+  BoundBox bounds = BoundBox::empty;
+  for (const IntegratorStateCPU *state : batch) {
+    bounds.grow(shadow ? state->shadow_ray.P : state->ray.P);
+  }
+  const float3 size = bounds.size();
+  const float3 scale = make_float3((size.x > 0.0f) ? 1023.0f / size.x : 0.0f,
+                                   (size.y > 0.0f) ? 1023.0f / size.y : 0.0f,
+                                   (size.z > 0.0f) ? 1023.0f / size.z : 0.0f);
+
+  keys.clear();
+  for (IntegratorStateCPU *state : batch) {
+    const float3 P = shadow ? state->shadow_ray.P : state->ray.P;
+    const float3 D = shadow ? state->shadow_ray.D : state->ray.D;
+
+    const uint64_t octant = ((D.x < 0.0f) ? 1 : 0) | ((D.y < 0.0f) ? 2 : 0) |
+                            ((D.z < 0.0f) ? 4 : 0);
+    const float3 Q = (P - bounds.min) * scale;
+    const uint64_t morton = (ray_sort_key_expand_bits(clamp((int)Q.x, 0, 1023)) << 2) |
+                            (ray_sort_key_expand_bits(clamp((int)Q.y, 0, 1023)) << 1) |
+                            ray_sort_key_expand_bits(clamp((int)Q.z, 0, 1023));
+
+    keys.emplace_back((octant << 30) | morton, state);
+  }
+
+  sort(keys.begin(), keys.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+
+  for (size_t i = 0; i < keys.size(); ++i) {
+    batch[i] = keys[i].second;
+  }
+}
+
 PathTraceWorkCPU::PathTraceWorkCPU(Device *device,
                                    Film *film,
                                    DeviceScene *device_scene,
@@ -69,11 +124,17 @@ void PathTraceWorkCPU::init_execution()
 
 void PathTraceWorkCPU::render_samples(RenderStatistics &statistics,
                                       int start_sample,
-                                      int samples_num)
+                                      int samples_num,
+                                      int sample_offset)
 {
-  const int64_t image_width = effective_buffer_params_.width;
-  const int64_t image_height = effective_buffer_params_.height;
-  const int64_t total_pixels_num = image_width * image_height;
+  const int image_width = effective_buffer_params_.width;
+  const int image_height = effective_buffer_params_.height;
+
+  /* Pixels are scheduled in small square blocks. Paths of all pixels in a block are traced
+   * together, see render_samples_full_pipeline(). */
+  const int64_t num_blocks_x = divide_up(image_width, kPixelBlockSize);
+  const int64_t num_blocks_y = divide_up(image_height, kPixelBlockSize);
+  const int64_t total_blocks_num = num_blocks_x * num_blocks_y;
 
   for (CPUKernelThreadGlobals &kernel_globals : kernel_thread_globals_) {
     kernel_globals.start_profiling();
@@ -81,26 +142,28 @@ void PathTraceWorkCPU::render_samples(RenderStatistics &statistics,
 
   tbb::task_arena local_arena = local_tbb_arena_create(device_);
   local_arena.execute([&]() {
-    tbb::parallel_for(int64_t(0), total_pixels_num, [&](int64_t work_index) {
-      if (is_cancel_requested()) {
-        return;
-      }
+    tbb::parallel_for(int64_t(0), total_blocks_num, [&](int64_t block_index) {
+      const int block_y = block_index / num_blocks_x;
+      const int block_x = block_index - block_y * num_blocks_x;
+
+      const int x_start = block_x * kPixelBlockSize;
+      const int y_start = block_y * kPixelBlockSize;
+      const int x_end = min(x_start + kPixelBlockSize, image_width);
+      const int y_end = min(y_start + kPixelBlockSize, image_height);
 
-      const int y = work_index / image_width;
-      const int x = work_index - y * image_width;
+      CPUKernelThreadGlobals *kernel_globals = kernel_thread_globals_get(kernel_thread_globals_);
 
       KernelWorkTile work_tile;
-      work_tile.x = effective_buffer_params_.full_x + x;
-      work_tile.y = effective_buffer_params_.full_y + y;
-      work_tile.w = 1;
-      work_tile.h = 1;
+      work_tile.x = effective_buffer_params_.full_x + x_start;
+      work_tile.y = effective_buffer_params_.full_y + y_start;
+      work_tile.w = x_end - x_start;
+      work_tile.h = y_end - y_start;
       work_tile.start_sample = start_sample;
       work_tile.num_samples = 1;
+      work_tile.sample_offset = sample_offset;
       work_tile.offset = effective_buffer_params_.offset;
       work_tile.stride = effective_buffer_params_.stride;
 
-      CPUKernelThreadGlobals *kernel_globals = kernel_thread_globals_get(kernel_thread_globals_);
-
       render_samples_full_pipeline(kernel_globals, work_tile, samples_num);
     });
   });
@@ -119,12 +182,21 @@ void PathTraceWorkCPU::render_samples_full_pipeline(KernelGlobals *kernel_global
   const bool has_shadow_catcher = device_scene_->data.integrator.has_shadow_catcher;
   const bool has_bake = device_scene_->data.bake.use;
 
-  IntegratorStateCPU integrator_states[2] = {};
+  const int num_pixels = work_tile.w * work_tile.h;
+
+  /* State of the main path of every pixel, followed by the state of its shadow catcher path which
+   * is split off from the main path by the kernels. */
+  vector<IntegratorStateCPU> integrator_states(num_pixels * 2);
+
+  /* Pixels for which the initialization kernel returned false, they need no more samples. */
+  vector<bool> pixel_done(num_pixels, false);
 
-  IntegratorStateCPU *state = &integrator_states[0];
-  IntegratorStateCPU *shadow_catcher_state = &integrator_states[1];
+  vector<IntegratorStateCPU *> closest_batch, shadow_batch;
+  vector<pair<uint64_t, IntegratorStateCPU *>> sort_keys;
+  closest_batch.reserve(integrator_states.size());
+  shadow_batch.reserve(integrator_states.size());
+  sort_keys.reserve(integrator_states.size());
 
-  KernelWorkTile sample_work_tile = work_tile;
   float *render_buffer = buffers_->buffer.data();
 
   for (int sample = 0; sample < samples_num; ++sample) {
@@ -132,26 +204,77 @@ void PathTraceWorkCPU::render_samples_full_pipeline(KernelGlobals *kernel_global
       break;
     }
 
-    if (has_bake) {
-      if (!kernels_.integrator_init_from_bake(
-              kernel_globals, state, &sample_work_tile, render_buffer)) {
-        break;
+    bool has_paths = false;
+
+    for (int i = 0; i < num_pixels; ++i) {
+      if (pixel_done[i]) {
+        continue;
       }
+
+      const int y = i / work_tile.w;
+      const int x = i - y * work_tile.w;
+
+      KernelWorkTile sample_work_tile = work_tile;
+      sample_work_tile.x = work_tile.x + x;
+      sample_work_tile.y = work_tile.y + y;
+      sample_work_tile.w = 1;
+      sample_work_tile.h = 1;
+      sample_work_tile.start_sample = work_tile.start_sample + sample;
+
+      IntegratorStateCPU *state = &integrator_states[i * 2];
+      const bool is_initialized =
+          has_bake ? kernels_.integrator_init_from_bake(
+                         kernel_globals, state, &sample_work_tile, render_buffer) :
+                     kernels_.integrator_init_from_camera(
+                         kernel_globals, state, &sample_work_tile, render_buffer);
+      if (!is_initialized) {
+        pixel_done[i] = true;
+        continue;
+      }
+
+      has_paths = true;
     }
-    else {
-      if (!kernels_.integrator_init_from_camera(
-              kernel_globals, state, &sample_work_tile, render_buffer)) {
+
+    if (!has_paths) {
+      break;
+    }
+
+    /* Run the shading kernels of all paths up to the point where they need a ray traced, then
+     * trace the gathered rays sorted for coherence. Shadow rays of a path are traced before its
+     * next closest hit ray, in the same order as the megakernel does. */
+    while (true) {
+      closest_batch.clear();
+      shadow_batch.clear();
+
+      for (int i = 0; i < num_pixels; ++i) {
+        for (int j = 0; j < (has_shadow_catcher ? 2 : 1); ++j) {
+          IntegratorStateCPU *state = &integrator_states[i * 2 + j];
+          if (!kernels_.integrator_megakernel_shade(kernel_globals, state, render_buffer)) {
+            continue;
+          }
+          if (state->shadow_path.queued_kernel) {
+            shadow_batch.push_back(state);
+          }
+          else {
+            closest_batch.push_back(state);
+          }
+        }
+      }
+
+      if (shadow_batch.empty() && closest_batch.empty()) {
         break;
       }
-    }
 
-    kernels_.integrator_megakernel(kernel_globals, state, render_buffer);
+      ray_batch_sort(shadow_batch, sort_keys, true);
+      for (IntegratorStateCPU *state : shadow_batch) {
+        kernels_.integrator_intersect_shadow(kernel_globals, state);
+      }
 
-    if (has_shadow_catcher) {
-      kernels_.integrator_megakernel(kernel_globals, shadow_catcher_state, render_buffer);
+      ray_batch_sort(closest_batch, sort_keys, false);
+      for (IntegratorStateCPU *state : closest_batch) {
+        kernels_.integrator_intersect_closest(kernel_globals, state);
+      }
     }
-
-    ++sample_work_tile.start_sample;
   }
 }
 
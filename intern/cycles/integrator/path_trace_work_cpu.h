@@ -48,7 +48,8 @@ class PathTraceWorkCPU : public PathTraceWork {
 
   virtual void render_samples(RenderStatistics &statistics,
                               int start_sample,
-                              int samples_num) override;
+                              int samples_num,
+                              int sample_offset) override;
 
   virtual void copy_to_gpu_display(GPUDisplay *gpu_display,
                                    PassMode pass_mode,
@@ -63,11 +64,17 @@ class PathTraceWorkCPU : public PathTraceWork {
   virtual void cryptomatte_postproces() override;
 
  protected:
-  /* Core path tracing routine. Renders given work time on the given queue. */
+  /* Core path tracing routine. Renders samples of all pixels of the given work tile together:
+   * shading kernels of all paths run until they need a ray traced, then the gathered shadow and
+   * closest hit rays are sorted by direction octant and origin and traced in that order. */
   void render_samples_full_pipeline(KernelGlobals *kernel_globals,
                                     const KernelWorkTile &work_tile,
                                     const int samples_num);
 
+  /* Size of the square block of pixels which is rendered by a single thread task, and which
+   * rays are batched together for tracing. */
+  static constexpr int kPixelBlockSize = 8;
+
   /* CPU kernels. */
   const CPUKernels &kernels_;
 
@@ -68,6 +68,11 @@ bool RenderScheduler::is_adaptive_sampling_used() const
   return adaptive_sampling_.use;
 }
 
+void RenderScheduler::set_path_guiding(const PathGuiding &path_guiding)
+{
+  path_guiding_ = path_guiding;
+}
+
 void RenderScheduler::set_start_sample(int start_sample)
 {
   start_sample_ = start_sample;
@@ -317,6 +322,7 @@ RenderWork RenderScheduler::get_render_work()
 
   render_work.path_trace.start_sample = get_start_sample_to_path_trace();
   render_work.path_trace.num_samples = get_num_samples_to_path_trace();
+  render_work.path_trace.sample_offset = get_start_sample();
 
   render_work.init_render_buffers = (render_work.path_trace.start_sample == get_start_sample());
 
@@ -831,6 +837,11 @@ int RenderScheduler::get_num_samples_to_path_trace() const
                                 min(num_samples_to_occupy, max_num_samples_to_render));
   }
 
+  /* Stop at the samples after which the path guiding distribution is rebuilt, so that the
+   * following samples benefit from the training as soon as possible. */
+  num_samples_to_render = path_guiding_.align_samples(path_trace_start_sample,
+                                                      num_samples_to_render);
+
   /* If adaptive sampling is not use, render as many samples per update as possible, keeping the
    * device fully occupied, without much overhead of display updates. */
   if (!adaptive_sampling_.use) {
@@ -841,7 +852,10 @@ int RenderScheduler::get_num_samples_to_path_trace() const
    * is to ensure that the final render is pixel-matched regardless of how many samples per second
    * compute device can do. */
 
-  return adaptive_sampling_.align_samples(path_trace_start_sample, num_samples_to_render);
+  /* Filtering points are relative to the first sample in the buffer, so that every range of samples
+   * of a frame rendered separately gets the same number of samples before it is filtered. */
+  return adaptive_sampling_.align_samples(path_trace_start_sample - start_sample_,
+                                          num_samples_to_render);
 }
 
 int RenderScheduler::get_num_samples_during_navigation(int resolution_divider) const
@@ -881,7 +895,7 @@ int RenderScheduler::get_num_samples_during_navigation(int resolution_divider) c
 
 bool RenderScheduler::work_need_adaptive_filter() const
 {
-  return adaptive_sampling_.need_filter(get_rendered_sample());
+  return adaptive_sampling_.need_filter(get_num_rendered_samples() - 1);
 }
 
 float RenderScheduler::work_adaptive_threshold() const
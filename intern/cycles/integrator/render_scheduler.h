@@ -17,6 +17,7 @@
 #pragma once
 
 #include "integrator/adaptive_sampling.h"
+#include "integrator/path_guiding.h"
 #include "integrator/denoiser.h" /* For DenoiseParams. */
 #include "render/buffers.h"
 #include "util/util_string.h"
@@ -39,6 +40,7 @@ class RenderWork {
   struct {
     int start_sample = 0;
     int num_samples = 0;
+    int sample_offset = 0;
   } path_trace;
 
   struct {
@@ -114,6 +116,8 @@ class RenderScheduler {
 
   bool is_adaptive_sampling_used() const;
 
+  void set_path_guiding(const PathGuiding &path_guiding);
+
   /* Start sample for path tracing.
    * The scheduler will schedule work using this sample as the first one. */
   void set_start_sample(int start_sample);
@@ -440,6 +444,8 @@ class RenderScheduler {
 
   AdaptiveSampling adaptive_sampling_;
 
+  PathGuiding path_guiding_;
+
   /* Progressively lower adaptive sampling threshold level, keeping the image at a uniform noise
    * level. */
   bool use_progressive_noise_floor_ = false;
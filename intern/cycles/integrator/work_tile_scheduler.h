@@ -38,7 +38,10 @@ class WorkTileScheduler {
   void set_max_num_path_states(int max_num_path_states);
 
   /* Scheduling will happen for pixels within a big tile denotes by its parameters. */
-  void reset(const BufferParams &buffer_params, int sample_start, int samples_num);
+  void reset(const BufferParams &buffer_params,
+             int sample_start,
+             int samples_num,
+             int sample_offset);
 
   /* Get work for a device.
    * Returns true if there is still work to be done and initialize the work tile to all
@@ -74,6 +77,9 @@ class WorkTileScheduler {
   int sample_start_ = 0;
   int samples_num_ = 0;
 
+  /* Index of the first sample rendered into the buffer. */
+  int sample_offset_ = 0;
+
   /* Tile size which be scheduled for rendering. */
   TileSize tile_size_;
 
@@ -76,6 +76,86 @@ ccl_device_forceinline int bvh_aligned_node_intersect(const KernelGlobals *kg,
 #endif
 }
 
+/* Compressed node stores the child bounds quantized to 8 bits relative to the
+ * node bounds, packed by BVH2::pack_compressed_node():
+ * - float4 0: visibility of both children and child node indices.
+ * - float4 1: xyz origin of the node, power-of-two scale exponents in w.
+ * - float4 2: per axis x, y, z the quantized bounds, child 0 lower in bits 0-7,
+ *   child 1 lower in bits 8-15, child 0 upper in bits 16-23, child 1 upper in bits 24-31. */
+ccl_device_forceinline int bvh_compressed_node_intersect(const KernelGlobals *kg,
+                                                         const float3 P,
+                                                         const float3 idir,
+                                                         const float t,
+                                                         const int node_addr,
+                                                         const uint visibility,
+                                                         float dist[2])
+{
+
+  /* fetch node data */
+#ifdef __VISIBILITY_FLAG__
+  float4 cnodes = kernel_tex_fetch(__bvh_nodes, node_addr + 0);
+#endif
+  float4 node0 = kernel_tex_fetch(__bvh_nodes, node_addr + 1);
+  float4 node1 = kernel_tex_fetch(__bvh_nodes, node_addr + 2);
+
+  /* decode bounds */
+  const uint exponents = __float_as_uint(node0.w);
+  const float scale_x = __uint_as_float((exponents & 0xff) << 23);
+  const float scale_y = __uint_as_float(((exponents >> 8) & 0xff) << 23);
+  const float scale_z = __uint_as_float(((exponents >> 16) & 0xff) << 23);
+
+  const uint qx = __float_as_uint(node1.x);
+  const uint qy = __float_as_uint(node1.y);
+  const uint qz = __float_as_uint(node1.z);
+
+  /* intersect ray against child nodes */
+  float c0lox = (node0.x + (float)(qx & 0xff) * scale_x - P.x) * idir.x;
+  float c0hix = (node0.x + (float)((qx >> 16) & 0xff) * scale_x - P.x) * idir.x;
+  float c0loy = (node0.y + (float)(qy & 0xff) * scale_y - P.y) * idir.y;
+  float c0hiy = (node0.y + (float)((qy >> 16) & 0xff) * scale_y - P.y) * idir.y;
+  float c0loz = (node0.z + (float)(qz & 0xff) * scale_z - P.z) * idir.z;
+  float c0hiz = (node0.z + (float)((qz >> 16) & 0xff) * scale_z - P.z) * idir.z;
+  float c0min = max4(0.0f, min(c0lox, c0hix), min(c0loy, c0hiy), min(c0loz, c0hiz));
+  float c0max = min4(t, max(c0lox, c0hix), max(c0loy, c0hiy), max(c0loz, c0hiz));
+
+  float c1lox = (node0.x + (float)((qx >> 8) & 0xff) * scale_x - P.x) * idir.x;
+  float c1hix = (node0.x + (float)(qx >> 24) * scale_x - P.x) * idir.x;
+  float c1loy = (node0.y + (float)((qy >> 8) & 0xff) * scale_y - P.y) * idir.y;
+  float c1hiy = (node0.y + (float)(qy >> 24) * scale_y - P.y) * idir.y;
+  float c1loz = (node0.z + (float)((qz >> 8) & 0xff) * scale_z - P.z) * idir.z;
+  float c1hiz = (node0.z + (float)(qz >> 24) * scale_z - P.z) * idir.z;
+  float c1min = max4(0.0f, min(c1lox, c1hix), min(c1loy, c1hiy), min(c1loz, c1hiz));
+  float c1max = min4(t, max(c1lox, c1hix), max(c1loy, c1hiy), max(c1loz, c1hiz));
+
+  dist[0] = c0min;
+  dist[1] = c1min;
+
+#ifdef __VISIBILITY_FLAG__
+  return (((c0max >= c0min) && (__float_as_uint(cnodes.x) & visibility)) ? 1 : 0) |
+         (((c1max >= c1min) && (__float_as_uint(cnodes.y) & visibility)) ? 2 : 0);
+#else
+  return ((c0max >= c0min) ? 1 : 0) | ((c1max >= c1min) ? 2 : 0);
+#endif
+}
+
+/* Intersect axis aligned node, which depending on the BVH settings is stored either with full
+ * precision or compressed bounds. */
+ccl_device_forceinline int bvh_aabb_node_intersect(const KernelGlobals *kg,
+                                                   const float3 P,
+                                                   const float3 idir,
+                                                   const float t,
+                                                   const int node_addr,
+                                                   const uint visibility,
+                                                   float dist[2])
+{
+  if (kernel_data.bvh.use_compressed_nodes) {
+    return bvh_compressed_node_intersect(kg, P, idir, t, node_addr, visibility, dist);
+  }
+  else {
+    return bvh_aligned_node_intersect(kg, P, idir, t, node_addr, visibility, dist);
+  }
+}
+
 ccl_device_forceinline bool bvh_unaligned_node_intersect_child(const KernelGlobals *kg,
                                                                const float3 P,
                                                                const float3 dir,
@@ -148,6 +228,6 @@ ccl_device_forceinline int bvh_node_intersect(const KernelGlobals *kg,
     return bvh_unaligned_node_intersect(kg, P, dir, idir, t, node_addr, visibility, dist);
   }
   else {
-    return bvh_aligned_node_intersect(kg, P, idir, t, node_addr, visibility, dist);
+    return bvh_aabb_node_intersect(kg, P, idir, t, node_addr, visibility, dist);
   }
 }
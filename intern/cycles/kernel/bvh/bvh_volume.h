@@ -20,7 +20,7 @@
 #if BVH_FEATURE(BVH_HAIR)
 #  define NODE_INTERSECT bvh_node_intersect
 #else
-#  define NODE_INTERSECT bvh_aligned_node_intersect
+#  define NODE_INTERSECT bvh_aabb_node_intersect
 #endif
 
 /* This is a template BVH traversal function for volumes, where
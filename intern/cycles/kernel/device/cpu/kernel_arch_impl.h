@@ -83,6 +83,13 @@ CCL_NAMESPACE_BEGIN
     KERNEL_INVOKE(name, kg, state, render_buffer); \
   }
 
+#define DEFINE_INTEGRATOR_SHADE_BATCH_KERNEL(name) \
+  bool KERNEL_FUNCTION_FULL_NAME(integrator_##name)( \
+      const KernelGlobals *kg, IntegratorStateCPU *state, ccl_global float *render_buffer) \
+  { \
+    return KERNEL_INVOKE(name, kg, state, render_buffer); \
+  }
+
 /* TODO: Either use something like get_work_pixel(), or simplify tile which is passed here, so
  * that it does not contain unused fields. */
 #define DEFINE_INTEGRATOR_INIT_KERNEL(name) \
@@ -107,6 +114,7 @@ DEFINE_INTEGRATOR_SHADE_KERNEL(shade_shadow)
 DEFINE_INTEGRATOR_SHADE_KERNEL(shade_surface)
 DEFINE_INTEGRATOR_SHADE_KERNEL(shade_volume)
 DEFINE_INTEGRATOR_SHADE_KERNEL(megakernel)
+DEFINE_INTEGRATOR_SHADE_BATCH_KERNEL(megakernel_shade)
 
 /* --------------------------------------------------------------------
  * Shader evaluation.
@@ -226,6 +234,7 @@ void KERNEL_FUNCTION_FULL_NAME(bake)(
 #undef KERNEL_INVOKE
 #undef DEFINE_INTEGRATOR_KERNEL
 #undef DEFINE_INTEGRATOR_SHADE_KERNEL
+#undef DEFINE_INTEGRATOR_SHADE_BATCH_KERNEL
 #undef DEFINE_INTEGRATOR_INIT_KERNEL
 
 #undef KERNEL_STUB
@@ -29,6 +29,49 @@ CCL_NAMESPACE_BEGIN
 
 #ifdef __VOLUME__
 
+/* Test if the position is in empty space of the voxel grids of a volume object. The bounding
+ * mesh only follows the grids at the granularity of leaf nodes, this skips shader evaluation for
+ * inactive voxels inside of them. */
+
+ccl_device_inline bool volume_occupancy_is_empty(const KernelGlobals *kg,
+                                                 const int object,
+                                                 const float3 P)
+{
+  const KernelVolumeOccupancy kvolume = kernel_tex_fetch(__object_volume_occupancy, object);
+  if (kvolume.offset == -1) {
+    return false;
+  }
+
+  const float3 co = transform_point(&kvolume.itfm, P);
+  if (!(co.x >= 0.0f && co.y >= 0.0f && co.z >= 0.0f &&
+        co.x < (float)(kvolume.res_x * VOLUME_OCCUPANCY_LEAF_DIM) &&
+        co.y < (float)(kvolume.res_y * VOLUME_OCCUPANCY_LEAF_DIM) &&
+        co.z < (float)(kvolume.res_z * VOLUME_OCCUPANCY_LEAF_DIM))) {
+    return true;
+  }
+
+  const int x = (int)co.x, y = (int)co.y, z = (int)co.z;
+  const int leaf_x = x / VOLUME_OCCUPANCY_LEAF_DIM;
+  const int leaf_y = y / VOLUME_OCCUPANCY_LEAF_DIM;
+  const int leaf_z = z / VOLUME_OCCUPANCY_LEAF_DIM;
+
+  const uint mask_offset = kernel_tex_fetch(
+      __volume_occupancy,
+      kvolume.offset + leaf_x + kvolume.res_x * (leaf_y + kvolume.res_y * leaf_z));
+  if (mask_offset == VOLUME_OCCUPANCY_EMPTY) {
+    return true;
+  }
+
+  /* Voxel order within the leaf node matches OpenVDB. */
+  const int bit = ((x % VOLUME_OCCUPANCY_LEAF_DIM) * VOLUME_OCCUPANCY_LEAF_DIM +
+                   (y % VOLUME_OCCUPANCY_LEAF_DIM)) *
+                      VOLUME_OCCUPANCY_LEAF_DIM +
+                  (z % VOLUME_OCCUPANCY_LEAF_DIM);
+  const uint word = kernel_tex_fetch(__volume_occupancy,
+                                     kvolume.offset + mask_offset + (bit >> 5));
+  return (word & (1u << (bit & 31))) == 0;
+}
+
 /* Return position normalized to 0..1 in mesh bounds */
 
 ccl_device_inline float3 volume_normalized_position(const KernelGlobals *kg,
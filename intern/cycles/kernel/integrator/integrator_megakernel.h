@@ -29,64 +29,92 @@
 
 CCL_NAMESPACE_BEGIN
 
+/* Kernel which is to be executed next for the state, shadow paths first. Zero when the path
+ * is terminated. */
+ccl_device_forceinline int integrator_megakernel_next_kernel(INTEGRATOR_STATE_CONST_ARGS)
+{
+  if (INTEGRATOR_STATE(shadow_path, queued_kernel)) {
+    return INTEGRATOR_STATE(shadow_path, queued_kernel);
+  }
+  return INTEGRATOR_STATE(path, queued_kernel);
+}
+
+ccl_device_forceinline void integrator_megakernel_execute(
+    INTEGRATOR_STATE_ARGS, const int kernel, ccl_global float *ccl_restrict render_buffer)
+{
+  switch (kernel) {
+    /* Shadow path kernels. */
+    case DEVICE_KERNEL_INTEGRATOR_INTERSECT_SHADOW:
+      integrator_intersect_shadow(INTEGRATOR_STATE_PASS);
+      break;
+    case DEVICE_KERNEL_INTEGRATOR_SHADE_SHADOW:
+      integrator_shade_shadow(INTEGRATOR_STATE_PASS, render_buffer);
+      break;
+    /* Regular path kernels. */
+    case DEVICE_KERNEL_INTEGRATOR_INTERSECT_CLOSEST:
+      integrator_intersect_closest(INTEGRATOR_STATE_PASS);
+      break;
+    case DEVICE_KERNEL_INTEGRATOR_SHADE_BACKGROUND:
+      integrator_shade_background(INTEGRATOR_STATE_PASS, render_buffer);
+      break;
+    case DEVICE_KERNEL_INTEGRATOR_SHADE_SURFACE:
+      integrator_shade_surface(INTEGRATOR_STATE_PASS, render_buffer);
+      break;
+    case DEVICE_KERNEL_INTEGRATOR_SHADE_VOLUME:
+      integrator_shade_volume(INTEGRATOR_STATE_PASS, render_buffer);
+      break;
+    case DEVICE_KERNEL_INTEGRATOR_SHADE_SURFACE_RAYTRACE:
+      integrator_shade_surface_raytrace(INTEGRATOR_STATE_PASS, render_buffer);
+      break;
+    case DEVICE_KERNEL_INTEGRATOR_SHADE_LIGHT:
+      integrator_shade_light(INTEGRATOR_STATE_PASS, render_buffer);
+      break;
+    case DEVICE_KERNEL_INTEGRATOR_INTERSECT_SUBSURFACE:
+      integrator_intersect_subsurface(INTEGRATOR_STATE_PASS);
+      break;
+    case DEVICE_KERNEL_INTEGRATOR_INTERSECT_VOLUME_STACK:
+      integrator_intersect_volume_stack(INTEGRATOR_STATE_PASS);
+      break;
+    default:
+      kernel_assert(0);
+      break;
+  }
+}
+
 ccl_device void integrator_megakernel(INTEGRATOR_STATE_ARGS,
                                       ccl_global float *ccl_restrict render_buffer)
 {
   /* Each kernel indicates the next kernel to execute, so here we simply
-   * have to check what that kernel is and execute it.
+   * have to check what that kernel is and execute it. Any shadow paths are
+   * handled first, before we potentially create more shadow paths.
    *
    * TODO: investigate if we can use device side enqueue for GPUs to avoid
    * having to compile this big kernel. */
   while (true) {
-    if (INTEGRATOR_STATE(shadow_path, queued_kernel)) {
-      /* First handle any shadow paths before we potentially create more shadow paths. */
-      switch (INTEGRATOR_STATE(shadow_path, queued_kernel)) {
-        case DEVICE_KERNEL_INTEGRATOR_INTERSECT_SHADOW:
-          integrator_intersect_shadow(INTEGRATOR_STATE_PASS);
-          break;
-        case DEVICE_KERNEL_INTEGRATOR_SHADE_SHADOW:
-          integrator_shade_shadow(INTEGRATOR_STATE_PASS, render_buffer);
-          break;
-        default:
-          kernel_assert(0);
-          break;
-      }
+    const int kernel = integrator_megakernel_next_kernel(INTEGRATOR_STATE_PASS);
+    if (kernel == 0) {
+      break;
     }
-    else if (INTEGRATOR_STATE(path, queued_kernel)) {
-      /* Then handle regular path kernels. */
-      switch (INTEGRATOR_STATE(path, queued_kernel)) {
-        case DEVICE_KERNEL_INTEGRATOR_INTERSECT_CLOSEST:
-          integrator_intersect_closest(INTEGRATOR_STATE_PASS);
-          break;
-        case DEVICE_KERNEL_INTEGRATOR_SHADE_BACKGROUND:
-          integrator_shade_background(INTEGRATOR_STATE_PASS, render_buffer);
-          break;
-        case DEVICE_KERNEL_INTEGRATOR_SHADE_SURFACE:
-          integrator_shade_surface(INTEGRATOR_STATE_PASS, render_buffer);
-          break;
-        case DEVICE_KERNEL_INTEGRATOR_SHADE_VOLUME:
-          integrator_shade_volume(INTEGRATOR_STATE_PASS, render_buffer);
-          break;
-        case DEVICE_KERNEL_INTEGRATOR_SHADE_SURFACE_RAYTRACE:
-          integrator_shade_surface_raytrace(INTEGRATOR_STATE_PASS, render_buffer);
-          break;
-        case DEVICE_KERNEL_INTEGRATOR_SHADE_LIGHT:
-          integrator_shade_light(INTEGRATOR_STATE_PASS, render_buffer);
-          break;
-        case DEVICE_KERNEL_INTEGRATOR_INTERSECT_SUBSURFACE:
-          integrator_intersect_subsurface(INTEGRATOR_STATE_PASS);
-          break;
-        case DEVICE_KERNEL_INTEGRATOR_INTERSECT_VOLUME_STACK:
-          integrator_intersect_volume_stack(INTEGRATOR_STATE_PASS);
-          break;
-        default:
-          kernel_assert(0);
-          break;
-      }
+    integrator_megakernel_execute(INTEGRATOR_STATE_PASS, kernel, render_buffer);
+  }
+}
+
+/* Same as the megakernel, but returns as soon as the path needs a closest hit or shadow ray
+ * intersection. This allows the caller to gather rays of multiple paths and trace them in a
+ * coherent order. Returns false when the path is terminated. */
+ccl_device bool integrator_megakernel_shade(INTEGRATOR_STATE_ARGS,
+                                            ccl_global float *ccl_restrict render_buffer)
+{
+  while (true) {
+    const int kernel = integrator_megakernel_next_kernel(INTEGRATOR_STATE_PASS);
+    if (kernel == 0) {
+      return false;
     }
-    else {
-      break;
+    if (kernel == DEVICE_KERNEL_INTEGRATOR_INTERSECT_CLOSEST ||
+        kernel == DEVICE_KERNEL_INTEGRATOR_INTERSECT_SHADOW) {
+      return true;
     }
+    integrator_megakernel_execute(INTEGRATOR_STATE_PASS, kernel, render_buffer);
   }
 }
 
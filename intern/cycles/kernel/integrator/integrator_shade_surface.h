@@ -99,6 +99,25 @@ ccl_device_forceinline void integrate_surface_emission(INTEGRATOR_STATE_CONST_AR
 }
 #endif /* __EMISSION__ */
 
+#ifdef __PATH_GUIDING__
+/* Cell of the guiding field to sample directions from, or GUIDING_CELL_NONE when guiding is not
+ * to be used at this shading point. */
+ccl_device_forceinline int integrate_surface_guiding_cell(INTEGRATOR_STATE_CONST_ARGS,
+                                                          const ShaderData *sd)
+{
+  if (!kernel_data.integrator.use_guiding || !guiding_shader_is_supported(sd)) {
+    return GUIDING_CELL_NONE;
+  }
+
+  const int cell = guiding_cell_index(kg, sd->P);
+  if (!guiding_cell_is_valid(kg, cell)) {
+    return GUIDING_CELL_NONE;
+  }
+
+  return cell;
+}
+#endif
+
 #ifdef __EMISSION__
 /* Path tracing: sample point on light and evaluate light shader, then
  * queue shadow ray to be traced. */
@@ -149,7 +168,17 @@ ccl_device_forceinline void integrate_surface_direct_light(INTEGRATOR_STATE_ARGS
   bsdf_eval_mul3(&bsdf_eval, light_eval / ls.pdf);
 
   if (ls.shader & SHADER_USE_MIS) {
+#  ifdef __PATH_GUIDING__
+    /* Directions are sampled from the mix of BSDF and guiding distribution at guided vertices,
+     * so weight against the same density as hits of lights by those directions get. */
+    const int guiding_cell = integrate_surface_guiding_cell(INTEGRATOR_STATE_PASS, sd);
+    const float mis_pdf = (guiding_cell != GUIDING_CELL_NONE) ?
+                              guiding_mis_pdf(kg, guiding_cell, ls.D, bsdf_pdf) :
+                              bsdf_pdf;
+    const float mis_weight = power_heuristic(ls.pdf, mis_pdf);
+#  else
     const float mis_weight = power_heuristic(ls.pdf, bsdf_pdf);
+#  endif
     bsdf_eval_mul(&bsdf_eval, mis_weight);
   }
 
@@ -200,11 +229,81 @@ ccl_device_forceinline void integrate_surface_direct_light(INTEGRATOR_STATE_ARGS
     INTEGRATOR_STATE_WRITE(shadow_path, unshadowed_throughput) = throughput;
   }
 
+#  ifdef __PATH_GUIDING__
+  INTEGRATOR_STATE_WRITE(shadow_path, guiding_cell) = INTEGRATOR_STATE(path, guiding_cell);
+  INTEGRATOR_STATE_WRITE(shadow_path, guiding_bin) = INTEGRATOR_STATE(path, guiding_bin);
+  INTEGRATOR_STATE_WRITE(shadow_path,
+                         guiding_throughput) = INTEGRATOR_STATE(path, guiding_throughput);
+#  endif
+
   /* Branch off shadow kernel. */
   INTEGRATOR_SHADOW_PATH_INIT(DEVICE_KERNEL_INTEGRATOR_INTERSECT_SHADOW);
 }
 #endif
 
+#ifdef __PATH_GUIDING__
+/* Path tracing: bounce off or through surface with a direction sampled from the guiding
+ * distribution, weighted against BSDF sampling using one-sample MIS. */
+ccl_device_forceinline int integrate_surface_guided_bounce(INTEGRATOR_STATE_ARGS,
+                                                           ShaderData *sd,
+                                                           const int guiding_cell,
+                                                           const float guiding_u,
+                                                           const float guiding_v)
+{
+  float guiding_pdf_value;
+  const float3 omega_in = guiding_sample(
+      kg, guiding_cell, guiding_u, guiding_v, &guiding_pdf_value);
+  const bool is_transmission = shader_bsdf_is_transmission(sd, omega_in);
+
+  BsdfEval bsdf_eval ccl_optional_struct_init;
+  const float bsdf_pdf = shader_bsdf_eval(kg, sd, omega_in, is_transmission, &bsdf_eval, 0);
+
+  if (bsdf_pdf == 0.0f || bsdf_eval_is_zero(&bsdf_eval)) {
+    return LABEL_NONE;
+  }
+
+  const float pdf = guiding_mis_pdf(kg, guiding_cell, omega_in, bsdf_pdf);
+
+  /* Closures which are not singular are either diffuse or glossy, classify the bounce by the
+   * component which contributes most. */
+  int label = (is_transmission) ? LABEL_TRANSMIT : LABEL_REFLECT;
+  label |= (reduce_add(bsdf_eval.diffuse) >= reduce_add(bsdf_eval.glossy)) ? LABEL_DIFFUSE :
+                                                                              LABEL_GLOSSY;
+
+  /* Setup ray. */
+  INTEGRATOR_STATE_WRITE(ray, P) = ray_offset(sd->P, (is_transmission) ? -sd->Ng : sd->Ng);
+  INTEGRATOR_STATE_WRITE(ray, D) = omega_in;
+  INTEGRATOR_STATE_WRITE(ray, t) = FLT_MAX;
+
+#  ifdef __RAY_DIFFERENTIALS__
+  INTEGRATOR_STATE_WRITE(ray, dP) = differential_make_compact(sd->dP);
+  INTEGRATOR_STATE_WRITE(ray, dD) = differential_zero_compact();
+#  endif
+
+  /* Update throughput. */
+  float3 throughput = INTEGRATOR_STATE(path, throughput);
+  throughput *= bsdf_eval_sum(&bsdf_eval) / pdf;
+  INTEGRATOR_STATE_WRITE(path, throughput) = throughput;
+
+  if (kernel_data.kernel_features & KERNEL_FEATURE_LIGHT_PASSES) {
+    if (INTEGRATOR_STATE(path, bounce) == 0) {
+      INTEGRATOR_STATE_WRITE(path,
+                             diffuse_glossy_ratio) = bsdf_eval_diffuse_glossy_ratio(&bsdf_eval);
+    }
+  }
+
+  /* Update path state */
+  INTEGRATOR_STATE_WRITE(path, mis_ray_pdf) = pdf;
+  INTEGRATOR_STATE_WRITE(path, mis_ray_t) = 0.0f;
+  INTEGRATOR_STATE_WRITE(path, min_ray_pdf) = fminf(pdf, INTEGRATOR_STATE(path, min_ray_pdf));
+
+  guiding_path_vertex(INTEGRATOR_STATE_PASS, sd->P, omega_in, throughput);
+
+  path_state_next(INTEGRATOR_STATE_PASS, label);
+  return label;
+}
+#endif
+
 /* Path tracing: bounce off or through surface with new direction. */
 ccl_device_forceinline int integrate_surface_bsdf_bssrdf_bounce(INTEGRATOR_STATE_ARGS,
                                                                 ShaderData *sd,
@@ -217,6 +316,18 @@ ccl_device_forceinline int integrate_surface_bsdf_bssrdf_bounce(INTEGRATOR_STATE
 
   float bsdf_u, bsdf_v;
   path_state_rng_2D(kg, rng_state, PRNG_BSDF_U, &bsdf_u, &bsdf_v);
+
+#ifdef __PATH_GUIDING__
+  /* Sample direction from the learned incident radiance distribution. */
+  const int guiding_cell = integrate_surface_guiding_cell(INTEGRATOR_STATE_PASS, sd);
+  const bool use_guiding = (guiding_cell != GUIDING_CELL_NONE);
+  if (use_guiding &&
+      path_state_rng_1D_hash(kg, rng_state, 0x6a1f0d3b) < GUIDING_SAMPLE_PROBABILITY) {
+    return integrate_surface_guided_bounce(
+        INTEGRATOR_STATE_PASS, sd, guiding_cell, bsdf_u, bsdf_v);
+  }
+#endif
+
   const ShaderClosure *sc = shader_bsdf_bssrdf_pick(sd, &bsdf_u);
 
 #ifdef __SUBSURFACE__
@@ -240,6 +351,13 @@ ccl_device_forceinline int integrate_surface_bsdf_bssrdf_bounce(INTEGRATOR_STATE
     return LABEL_NONE;
   }
 
+#ifdef __PATH_GUIDING__
+  if (use_guiding) {
+    /* One-sample MIS with the guiding distribution. */
+    bsdf_pdf = guiding_mis_pdf(kg, guiding_cell, normalize(bsdf_omega_in), bsdf_pdf);
+  }
+#endif
+
   /* Setup ray. Note that clipping works through transparent bounces. */
   INTEGRATOR_STATE_WRITE(ray, P) = ray_offset(sd->P, (label & LABEL_TRANSMIT) ? -sd->Ng : sd->Ng);
   INTEGRATOR_STATE_WRITE(ray, D) = normalize(bsdf_omega_in);
@@ -273,6 +391,10 @@ ccl_device_forceinline int integrate_surface_bsdf_bssrdf_bounce(INTEGRATOR_STATE
     INTEGRATOR_STATE_WRITE(path, mis_ray_t) = 0.0f;
     INTEGRATOR_STATE_WRITE(path, min_ray_pdf) = fminf(bsdf_pdf,
                                                       INTEGRATOR_STATE(path, min_ray_pdf));
+
+#ifdef __PATH_GUIDING__
+    guiding_path_vertex(INTEGRATOR_STATE_PASS, sd->P, INTEGRATOR_STATE(ray, D), throughput);
+#endif
   }
 
   path_state_next(INTEGRATOR_STATE_PASS, label);
@@ -793,6 +793,13 @@ ccl_device_forceinline void integrate_volume_direct_light(INTEGRATOR_STATE_ARGS,
     INTEGRATOR_STATE_WRITE(shadow_path, unshadowed_throughput) = throughput;
   }
 
+#    ifdef __PATH_GUIDING__
+  INTEGRATOR_STATE_WRITE(shadow_path, guiding_cell) = INTEGRATOR_STATE(path, guiding_cell);
+  INTEGRATOR_STATE_WRITE(shadow_path, guiding_bin) = INTEGRATOR_STATE(path, guiding_bin);
+  INTEGRATOR_STATE_WRITE(shadow_path,
+                         guiding_throughput) = INTEGRATOR_STATE(path, guiding_throughput);
+#    endif
+
   integrator_state_copy_volume_stack_to_shadow(INTEGRATOR_STATE_PASS);
 
   /* Branch off shadow kernel. */
@@ -856,6 +863,11 @@ ccl_device_forceinline bool integrate_volume_phase_scatter(INTEGRATOR_STATE_ARGS
   INTEGRATOR_STATE_WRITE(path, min_ray_pdf) = fminf(phase_pdf,
                                                     INTEGRATOR_STATE(path, min_ray_pdf));
 
+#  ifdef __PATH_GUIDING__
+  /* The guiding field only learns radiance arriving at surfaces. */
+  INTEGRATOR_STATE_WRITE(path, guiding_cell) = GUIDING_CELL_NONE;
+#  endif
+
   path_state_next(INTEGRATOR_STATE_PASS, label);
   return true;
 }
@@ -66,6 +66,11 @@ KERNEL_STRUCT_MEMBER(path, float3, denoising_feature_throughput, KERNEL_FEATURE_
 /* Shader sorting. */
 /* TODO: compress as uint16? or leave out entirely and recompute key in sorting code? */
 KERNEL_STRUCT_MEMBER(path, uint32_t, shader_sort_key, KERNEL_FEATURE_PATH_TRACING)
+/* Path guiding training: cell and direction bin of the last scattering vertex, and throughput
+ * of the path after scattering at it. */
+KERNEL_STRUCT_MEMBER(path, int, guiding_cell, KERNEL_FEATURE_PATH_GUIDING)
+KERNEL_STRUCT_MEMBER(path, int, guiding_bin, KERNEL_FEATURE_PATH_GUIDING)
+KERNEL_STRUCT_MEMBER(path, float3, guiding_throughput, KERNEL_FEATURE_PATH_GUIDING)
 KERNEL_STRUCT_END(path)
 
 /************************************** Ray ***********************************/
@@ -129,6 +134,10 @@ KERNEL_STRUCT_MEMBER(shadow_path, float3, unshadowed_throughput, KERNEL_FEATURE_
 KERNEL_STRUCT_MEMBER(shadow_path, float3, diffuse_glossy_ratio, KERNEL_FEATURE_LIGHT_PASSES)
 /* Number of intersections found by ray-tracing. */
 KERNEL_STRUCT_MEMBER(shadow_path, uint16_t, num_hits, KERNEL_FEATURE_PATH_TRACING)
+/* Path guiding training record copied from the main path. */
+KERNEL_STRUCT_MEMBER(shadow_path, int, guiding_cell, KERNEL_FEATURE_PATH_GUIDING)
+KERNEL_STRUCT_MEMBER(shadow_path, int, guiding_bin, KERNEL_FEATURE_PATH_GUIDING)
+KERNEL_STRUCT_MEMBER(shadow_path, float3, guiding_throughput, KERNEL_FEATURE_PATH_GUIDING)
 KERNEL_STRUCT_END(shadow_path)
 
 /********************************** Shadow Ray *******************************/
@@ -17,6 +17,7 @@
 #pragma once
 
 #include "kernel_adaptive_sampling.h"
+#include "kernel_guiding.h"
 #include "kernel_random.h"
 #include "kernel_shadow_catcher.h"
 #include "kernel_write_passes.h"
@@ -138,7 +139,8 @@ ccl_device_forceinline ccl_global float *kernel_accum_pixel_render_buffer(
 
 ccl_device_inline int kernel_accum_sample(INTEGRATOR_STATE_CONST_ARGS,
                                           ccl_global float *ccl_restrict render_buffer,
-                                          int sample)
+                                          int sample,
+                                          const int sample_offset)
 {
   if (kernel_data.film.pass_sample_count == PASS_UNUSED) {
     return sample;
@@ -147,7 +149,8 @@ ccl_device_inline int kernel_accum_sample(INTEGRATOR_STATE_CONST_ARGS,
   ccl_global float *buffer = kernel_accum_pixel_render_buffer(INTEGRATOR_STATE_PASS,
                                                               render_buffer);
 
-  return atomic_fetch_and_add_uint32((uint *)(buffer) + kernel_data.film.pass_sample_count, 1);
+  return atomic_fetch_and_add_uint32((uint *)(buffer) + kernel_data.film.pass_sample_count, 1) +
+         sample_offset;
 }
 
 ccl_device void kernel_accum_adaptive_buffer(INTEGRATOR_STATE_CONST_ARGS,
@@ -388,6 +391,10 @@ ccl_device_inline void kernel_accum_light(INTEGRATOR_STATE_CONST_ARGS,
   float3 contribution = INTEGRATOR_STATE(shadow_path, throughput);
   kernel_accum_clamp(kg, &contribution, INTEGRATOR_STATE(shadow_path, bounce));
 
+#ifdef __PATH_GUIDING__
+  guiding_record_shadow_path(INTEGRATOR_STATE_PASS, contribution);
+#endif
+
   ccl_global float *buffer = kernel_accum_pixel_render_buffer(INTEGRATOR_STATE_PASS,
                                                               render_buffer);
 
@@ -480,6 +487,10 @@ ccl_device_inline void kernel_accum_background(INTEGRATOR_STATE_CONST_ARGS,
   float3 contribution = INTEGRATOR_STATE(path, throughput) * L;
   kernel_accum_clamp(kg, &contribution, INTEGRATOR_STATE(path, bounce) - 1);
 
+#ifdef __PATH_GUIDING__
+  guiding_record_path(INTEGRATOR_STATE_PASS, contribution);
+#endif
+
   ccl_global float *buffer = kernel_accum_pixel_render_buffer(INTEGRATOR_STATE_PASS,
                                                               render_buffer);
 
@@ -503,6 +514,10 @@ ccl_device_inline void kernel_accum_emission(INTEGRATOR_STATE_CONST_ARGS,
   float3 contribution = throughput * L;
   kernel_accum_clamp(kg, &contribution, INTEGRATOR_STATE(path, bounce) - 1);
 
+#ifdef __PATH_GUIDING__
+  guiding_record_path(INTEGRATOR_STATE_PASS, contribution);
+#endif
+
   ccl_global float *buffer = kernel_accum_pixel_render_buffer(INTEGRATOR_STATE_PASS,
                                                               render_buffer);
 
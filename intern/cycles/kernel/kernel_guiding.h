@@ -0,0 +1,252 @@
+/*
+ * Copyright 2011-2021 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Path Guiding
+ *
+ * Incident radiance field which is learned online during the first samples of the render.
+ * The scene bounds are split into a regular grid of cells, and every cell stores a histogram of
+ * incident radiance over the sphere of directions.
+ *
+ * While training, the path remembers the cell and direction of its last scattering vertex, and
+ * every contribution accumulated to the film by the following segment of the path is divided
+ * by the throughput at that vertex and splatted to the training buffer. The host periodically
+ * turns the training buffer into a per-cell CDF, which is then used to sample directions at
+ * surface bounces, combined with BSDF sampling using one-sample MIS. */
+
+#pragma once
+
+CCL_NAMESPACE_BEGIN
+
+#ifdef __PATH_GUIDING__
+
+/* Probability of sampling the guiding distribution instead of the BSDF. */
+#  define GUIDING_SAMPLE_PROBABILITY 0.5f
+
+/* Spatial cell of the guiding grid the given position belongs to. */
+ccl_device_inline int guiding_cell_index(const KernelGlobals *kg, const float3 P)
+{
+  const int res_x = kernel_data.integrator.guiding_resolution_x;
+  const int res_y = kernel_data.integrator.guiding_resolution_y;
+  const int res_z = kernel_data.integrator.guiding_resolution_z;
+  const float inv_cell_size = kernel_data.integrator.guiding_inv_cell_size;
+
+  const int x = (int)clamp((P.x - kernel_data.integrator.guiding_bounds_min_x) * inv_cell_size,
+                           0.0f,
+                           (float)(res_x - 1));
+  const int y = (int)clamp((P.y - kernel_data.integrator.guiding_bounds_min_y) * inv_cell_size,
+                           0.0f,
+                           (float)(res_y - 1));
+  const int z = (int)clamp((P.z - kernel_data.integrator.guiding_bounds_min_z) * inv_cell_size,
+                           0.0f,
+                           (float)(res_z - 1));
+
+  return x + res_x * (y + res_y * z);
+}
+
+/* Equal-area cylindrical mapping between directions and histogram bins. */
+ccl_device_inline int guiding_direction_to_bin(const float3 D)
+{
+  const float u = D.z * 0.5f + 0.5f;
+  float phi = atan2f(D.y, D.x);
+  if (phi < 0.0f) {
+    phi += M_2PI_F;
+  }
+  const float v = phi * M_1_2PI_F;
+
+  const int iu = clamp(
+      (int)(u * GUIDING_DIRECTION_RESOLUTION), 0, GUIDING_DIRECTION_RESOLUTION - 1);
+  const int iv = clamp(
+      (int)(v * GUIDING_DIRECTION_RESOLUTION), 0, GUIDING_DIRECTION_RESOLUTION - 1);
+
+  return iu * GUIDING_DIRECTION_RESOLUTION + iv;
+}
+
+ccl_device_inline float3 guiding_bin_to_direction(const int bin,
+                                                  const float randu,
+                                                  const float randv)
+{
+  const int iu = bin / GUIDING_DIRECTION_RESOLUTION;
+  const int iv = bin - iu * GUIDING_DIRECTION_RESOLUTION;
+
+  const float z = (iu + randu) * (2.0f / GUIDING_DIRECTION_RESOLUTION) - 1.0f;
+  const float phi = (iv + randv) * (M_2PI_F / GUIDING_DIRECTION_RESOLUTION);
+  const float r = safe_sqrtf(1.0f - z * z);
+
+  return make_float3(r * cosf(phi), r * sinf(phi), z);
+}
+
+/* Convert probability of a bin to a solid angle density: all bins have the same area. */
+ccl_device_inline float guiding_bin_probability_to_pdf(const float probability)
+{
+  return probability * (GUIDING_DIRECTION_BINS * 0.25f * M_1_PI_F);
+}
+
+/* Cells which did not receive enough training samples have an empty distribution, and are not
+ * to be used for sampling. */
+ccl_device_inline bool guiding_cell_is_valid(const KernelGlobals *kg, const int cell)
+{
+  return kernel_tex_fetch(__guiding_distribution,
+                          cell * GUIDING_DIRECTION_BINS + GUIDING_DIRECTION_BINS - 1) > 0.0f;
+}
+
+ccl_device float guiding_pdf(const KernelGlobals *kg, const int cell, const float3 D)
+{
+  const int offset = cell * GUIDING_DIRECTION_BINS;
+  const int bin = guiding_direction_to_bin(D);
+
+  const float cdf_lo = (bin > 0) ? kernel_tex_fetch(__guiding_distribution, offset + bin - 1) :
+                                   0.0f;
+  const float cdf_hi = kernel_tex_fetch(__guiding_distribution, offset + bin);
+
+  return guiding_bin_probability_to_pdf(cdf_hi - cdf_lo);
+}
+
+/* Density of the one-sample MIS combination of guiding and BSDF sampling. Used both for the
+ * throughput of bounces and as BSDF pdf for MIS with light sampling, which need to match. */
+ccl_device_inline float guiding_mis_pdf(const KernelGlobals *kg,
+                                        const int cell,
+                                        const float3 D,
+                                        const float bsdf_pdf)
+{
+  return GUIDING_SAMPLE_PROBABILITY * guiding_pdf(kg, cell, D) +
+         (1.0f - GUIDING_SAMPLE_PROBABILITY) * bsdf_pdf;
+}
+
+ccl_device float3 guiding_sample(
+    const KernelGlobals *kg, const int cell, float randu, const float randv, float *pdf)
+{
+  const int offset = cell * GUIDING_DIRECTION_BINS;
+
+  /* Binary search for the bin. */
+  int first = 0;
+  int len = GUIDING_DIRECTION_BINS;
+
+  while (len > 0) {
+    const int half_len = len >> 1;
+    const int middle = first + half_len;
+
+    if (randu < kernel_tex_fetch(__guiding_distribution, offset + middle)) {
+      len = half_len;
+    }
+    else {
+      first = middle + 1;
+      len = len - half_len - 1;
+    }
+  }
+
+  const int bin = min(first, GUIDING_DIRECTION_BINS - 1);
+  const float cdf_lo = (bin > 0) ? kernel_tex_fetch(__guiding_distribution, offset + bin - 1) :
+                                   0.0f;
+  const float cdf_hi = kernel_tex_fetch(__guiding_distribution, offset + bin);
+  const float probability = cdf_hi - cdf_lo;
+
+  /* Rescale to reuse for the position within the bin, to preserve stratification. */
+  randu = (probability > 0.0f) ? clamp((randu - cdf_lo) / probability, 0.0f, 1.0f) : 0.5f;
+
+  *pdf = guiding_bin_probability_to_pdf(probability);
+  return guiding_bin_to_direction(bin, randu, randv);
+}
+
+/* Guiding is only used at vertices where all closures can be evaluated, so that both sampling
+ * strategies cover the same directions and their densities can be combined. */
+ccl_device_inline bool guiding_shader_is_supported(const ShaderData *sd)
+{
+  if (!(sd->flag & SD_BSDF_HAS_EVAL)) {
+    return false;
+  }
+
+  for (int i = 0; i < sd->num_closure; i++) {
+    const ShaderClosure *sc = &sd->closure[i];
+
+    if (CLOSURE_IS_BSSRDF(sc->type) ||
+        (CLOSURE_IS_BSDF(sc->type) &&
+         (CLOSURE_IS_BSDF_SINGULAR(sc->type) || CLOSURE_IS_BSDF_TRANSPARENT(sc->type)))) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/* Training. */
+
+ccl_device_inline void guiding_record(const KernelGlobals *kg,
+                                      const int cell,
+                                      const int bin,
+                                      const float3 contribution,
+                                      const float3 vertex_throughput)
+{
+  const float radiance = average(safe_divide_float3_float3(contribution, vertex_throughput));
+  if (!(radiance > 0.0f) || !isfinite_safe(radiance)) {
+    return;
+  }
+
+  ccl_global float *training = kernel_tex_array(__guiding_training) +
+                               cell * GUIDING_TRAINING_STRIDE;
+  atomic_add_and_fetch_float(training + bin, radiance);
+  atomic_add_and_fetch_float(training + GUIDING_DIRECTION_BINS, 1.0f);
+}
+
+ccl_device_inline void guiding_record_path(INTEGRATOR_STATE_CONST_ARGS, const float3 contribution)
+{
+  const int cell = INTEGRATOR_STATE(path, guiding_cell);
+  if (cell == GUIDING_CELL_NONE) {
+    return;
+  }
+
+  guiding_record(kg,
+                 cell,
+                 INTEGRATOR_STATE(path, guiding_bin),
+                 contribution,
+                 INTEGRATOR_STATE(path, guiding_throughput));
+}
+
+ccl_device_inline void guiding_record_shadow_path(INTEGRATOR_STATE_CONST_ARGS,
+                                                  const float3 contribution)
+{
+  const int cell = INTEGRATOR_STATE(shadow_path, guiding_cell);
+  if (cell == GUIDING_CELL_NONE) {
+    return;
+  }
+
+  guiding_record(kg,
+                 cell,
+                 INTEGRATOR_STATE(shadow_path, guiding_bin),
+                 contribution,
+                 INTEGRATOR_STATE(shadow_path, guiding_throughput));
+}
+
+/* Remember the scattering vertex, so that radiance arriving along the new ray is credited to
+ * it. Only done while the guiding field is being trained. */
+ccl_device_inline void guiding_path_vertex(INTEGRATOR_STATE_ARGS,
+                                           const float3 P,
+                                           const float3 D,
+                                           const float3 throughput)
+{
+  if (!kernel_data.integrator.use_guiding ||
+      INTEGRATOR_STATE(path, sample) >= kernel_data.integrator.guiding_training_samples) {
+    INTEGRATOR_STATE_WRITE(path, guiding_cell) = GUIDING_CELL_NONE;
+    return;
+  }
+
+  INTEGRATOR_STATE_WRITE(path, guiding_cell) = guiding_cell_index(kg, P);
+  INTEGRATOR_STATE_WRITE(path, guiding_bin) = guiding_direction_to_bin(D);
+  INTEGRATOR_STATE_WRITE(path, guiding_throughput) = throughput;
+}
+
+#endif /* __PATH_GUIDING__ */
+
+CCL_NAMESPACE_END
@@ -72,13 +72,33 @@ ccl_device_inline float cmj_randfloat_simple(uint i, uint p)
   return cmj_hash_simple(i, p) * (1.0f / (float)0xFFFFFFFF);
 }
 
+/* Blue noise dithering uses the same sample sequence for all pixels, with a Cranley-Patterson
+ * rotation from a tiled blue noise mask instead of a random one. The error of neighboring pixels
+ * is then negatively correlated at low sample counts, while each pixel still gets a stratified
+ * sequence. The mask is offset toroidally for every dimension, to decorrelate them. */
+ccl_device_inline float blue_noise_sample(const KernelGlobals *kg, uint rng_hash, uint dimension)
+{
+  const uint offset = cmj_hash_simple(dimension, kernel_data.integrator.seed);
+  const uint x = (rng_hash + offset) & (BLUE_NOISE_SIZE - 1);
+  const uint y = ((rng_hash >> BLUE_NOISE_SIZE_BITS) + (offset >> 16)) & (BLUE_NOISE_SIZE - 1);
+
+  return kernel_tex_fetch(__sample_blue_noise, y * BLUE_NOISE_SIZE + x);
+}
+
+/* Hash used to shuffle the sample sequence, which is shared by all pixels for blue noise. */
+ccl_device_inline uint pmj_shuffle_hash(const KernelGlobals *kg, uint rng_hash)
+{
+  return (kernel_data.integrator.use_blue_noise) ? kernel_data.integrator.seed : rng_hash;
+}
+
 ccl_device float pmj_sample_1D(const KernelGlobals *kg, uint sample, uint rng_hash, uint dimension)
 {
   /* Perform Owen shuffle of the sample number to reorder the samples. */
+  const uint shuffle_hash = pmj_shuffle_hash(kg, rng_hash);
 #ifdef _SIMPLE_HASH_
-  const uint rv = cmj_hash_simple(dimension, rng_hash);
+  const uint rv = cmj_hash_simple(dimension, shuffle_hash);
 #else /* Use a _REGULAR_HASH_. */
-  const uint rv = cmj_hash(dimension, rng_hash);
+  const uint rv = cmj_hash(dimension, shuffle_hash);
 #endif
 #ifdef _XOR_SHUFFLE_
 #  warning "Using XOR shuffle."
@@ -100,11 +120,17 @@ ccl_device float pmj_sample_1D(const KernelGlobals *kg, uint sample, uint rng_ha
 
 #ifndef _NO_CRANLEY_PATTERSON_ROTATION_
   /* Use Cranley-Patterson rotation to displace the sample pattern. */
+  float dx;
+  if (kernel_data.integrator.use_blue_noise) {
+    dx = blue_noise_sample(kg, rng_hash, d);
+  }
+  else {
 #  ifdef _SIMPLE_HASH_
-  float dx = cmj_randfloat_simple(d, rng_hash);
+    dx = cmj_randfloat_simple(d, rng_hash);
 #  else
-  float dx = cmj_randfloat(d, rng_hash);
+    dx = cmj_randfloat(d, rng_hash);
 #  endif
+  }
   /* Jitter sample locations and map back into [0 1]. */
   fx = fx + dx;
   fx = fx - floorf(fx);
@@ -119,10 +145,11 @@ ccl_device void pmj_sample_2D(
     const KernelGlobals *kg, uint sample, uint rng_hash, uint dimension, float *x, float *y)
 {
   /* Perform a shuffle on the sample number to reorder the samples. */
+  const uint shuffle_hash = pmj_shuffle_hash(kg, rng_hash);
 #ifdef _SIMPLE_HASH_
-  const uint rv = cmj_hash_simple(dimension, rng_hash);
+  const uint rv = cmj_hash_simple(dimension, shuffle_hash);
 #else /* Use a _REGULAR_HASH_. */
-  const uint rv = cmj_hash(dimension, rng_hash);
+  const uint rv = cmj_hash(dimension, shuffle_hash);
 #endif
 #ifdef _XOR_SHUFFLE_
 #  warning "Using XOR shuffle."
@@ -142,13 +169,20 @@ ccl_device void pmj_sample_2D(
 
 #ifndef _NO_CRANLEY_PATTERSON_ROTATION_
   /* Use Cranley-Patterson rotation to displace the sample pattern. */
+  float dx, dy;
+  if (kernel_data.integrator.use_blue_noise) {
+    dx = blue_noise_sample(kg, rng_hash, d);
+    dy = blue_noise_sample(kg, rng_hash, d + 1);
+  }
+  else {
 #  ifdef _SIMPLE_HASH_
-  float dx = cmj_randfloat_simple(d, rng_hash);
-  float dy = cmj_randfloat_simple(d + 1, rng_hash);
+    dx = cmj_randfloat_simple(d, rng_hash);
+    dy = cmj_randfloat_simple(d + 1, rng_hash);
 #  else
-  float dx = cmj_randfloat(d, rng_hash);
-  float dy = cmj_randfloat(d + 1, rng_hash);
+    dx = cmj_randfloat(d, rng_hash);
+    dy = cmj_randfloat(d + 1, rng_hash);
 #  endif
+  }
   /* Jitter sample locations and map back to the unit square [0 1]x[0 1]. */
   float sx = fx + dx;
   float sy = fy + dy;
@@ -78,6 +78,10 @@ ccl_device_inline void path_state_init_integrator(INTEGRATOR_STATE_ARGS,
     INTEGRATOR_STATE_WRITE(path, denoising_feature_throughput) = one_float3();
   }
 #endif
+
+#ifdef __PATH_GUIDING__
+  INTEGRATOR_STATE_WRITE(path, guiding_cell) = GUIDING_CELL_NONE;
+#endif
 }
 
 ccl_device_inline void path_state_next(INTEGRATOR_STATE_ARGS, int label)
@@ -78,8 +78,13 @@ ccl_device_forceinline float path_rng_1D(const KernelGlobals *kg,
   /* Hash rng with dimension to solve correlation issues.
    * See T38710, T50116.
    */
-  uint tmp_rng = cmj_hash_simple(dimension, rng_hash);
-  shift = tmp_rng * (1.0f / (float)0xFFFFFFFF);
+  if (kernel_data.integrator.use_blue_noise) {
+    shift = blue_noise_sample(kg, rng_hash, dimension);
+  }
+  else {
+    uint tmp_rng = cmj_hash_simple(dimension, rng_hash);
+    shift = tmp_rng * (1.0f / (float)0xFFFFFFFF);
+  }
 
   return r + shift - floorf(r + shift);
 #endif
@@ -142,7 +147,14 @@ ccl_device_inline uint path_rng_hash_init(const KernelGlobals *ccl_restrict kg,
                                           const int x,
                                           const int y)
 {
-  const uint rng_hash = hash_iqnt2d(x, y) ^ kernel_data.integrator.seed;
+  uint rng_hash = hash_iqnt2d(x, y) ^ kernel_data.integrator.seed;
+
+  if (kernel_data.integrator.use_blue_noise) {
+    /* Position of the pixel in the blue noise mask. */
+    rng_hash = (rng_hash & ~BLUE_NOISE_PIXEL_MASK) |
+               ((y & (BLUE_NOISE_SIZE - 1)) << BLUE_NOISE_SIZE_BITS) |
+               (x & (BLUE_NOISE_SIZE - 1));
+  }
 
 #ifdef __DEBUG_CORRELATION__
   srand48(rng_hash + sample);
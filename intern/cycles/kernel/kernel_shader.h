@@ -780,6 +780,11 @@ ccl_device_inline void shader_eval_volume(INTEGRATOR_STATE_CONST_ARGS,
       break;
     }
 
+    /* Skip empty voxels of volume objects, there is nothing to evaluate. */
+    if (entry.object != OBJECT_NONE && volume_occupancy_is_empty(kg, entry.object, sd->P)) {
+      continue;
+    }
+
     /* setup shaderdata from stack. it's mostly setup already in
      * shader_setup_from_volume, this switching should be quick */
     sd->object = entry.object;
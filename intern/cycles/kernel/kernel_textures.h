@@ -36,6 +36,8 @@ KERNEL_TEX(Transform, __object_motion_pass)
 KERNEL_TEX(DecomposedTransform, __object_motion)
 KERNEL_TEX(uint, __object_flag)
 KERNEL_TEX(float, __object_volume_step)
+KERNEL_TEX(KernelVolumeOccupancy, __object_volume_occupancy)
+KERNEL_TEX(uint, __volume_occupancy)
 
 /* cameras */
 KERNEL_TEX(DecomposedTransform, __camera_motion)
@@ -79,6 +81,7 @@ KERNEL_TEX(float, __lookup_table)
 
 /* sobol */
 KERNEL_TEX(float, __sample_pattern_lut)
+KERNEL_TEX(float, __sample_blue_noise)
 
 /* image textures */
 KERNEL_TEX(TextureInfo, __texture_info)
@@ -86,4 +89,8 @@ KERNEL_TEX(TextureInfo, __texture_info)
 /* ies lights */
 KERNEL_TEX(float, __ies)
 
+/* path guiding */
+KERNEL_TEX(float, __guiding_distribution)
+KERNEL_TEX(float, __guiding_training)
+
 #undef KERNEL_TEX
@@ -52,6 +52,15 @@ CCL_NAMESPACE_BEGIN
 
 #define VOLUME_BOUNDS_MAX 1024
 
+/* Path guiding: directional histogram of every spatial cell uses an equal-area
+ * cylindrical mapping of the sphere. The training record of a cell stores the
+ * radiance of every directional bin, followed by the number of recorded samples. */
+#define GUIDING_MAX_RESOLUTION 32
+#define GUIDING_DIRECTION_RESOLUTION 8
+#define GUIDING_DIRECTION_BINS (GUIDING_DIRECTION_RESOLUTION * GUIDING_DIRECTION_RESOLUTION)
+#define GUIDING_TRAINING_STRIDE (GUIDING_DIRECTION_BINS + 1)
+#define GUIDING_CELL_NONE (-1)
+
 #define BECKMANN_TABLE_SIZE 256
 
 #define SHADER_NONE (~0)
@@ -102,6 +111,7 @@ CCL_NAMESPACE_BEGIN
 #    define __OSL__
 #  endif
 #  define __VOLUME_RECORD_ALL__
+#  define __PATH_GUIDING__
 #endif /* __KERNEL_CPU__ */
 
 #ifdef __KERNEL_OPTIX__
@@ -143,6 +153,9 @@ CCL_NAMESPACE_BEGIN
 #  if !(__KERNEL_FEATURES & KERNEL_FEATURE_DENOISING)
 #    undef __DENOISING_FEATURES__
 #  endif
+#  if !(__KERNEL_FEATURES & KERNEL_FEATURE_PATH_GUIDING)
+#    undef __PATH_GUIDING__
+#  endif
 #endif
 
 #ifdef WITH_CYCLES_DEBUG_NAN
@@ -1162,8 +1175,19 @@ typedef struct KernelIntegrator {
 
   int has_shadow_catcher;
 
-  /* padding */
-  int pad1, pad2;
+  /* path guiding */
+  int use_guiding;
+  int guiding_training_samples;
+  int guiding_resolution_x;
+  int guiding_resolution_y;
+  int guiding_resolution_z;
+  float guiding_bounds_min_x;
+  float guiding_bounds_min_y;
+  float guiding_bounds_min_z;
+  float guiding_inv_cell_size;
+
+  /* blue noise */
+  int use_blue_noise;
 } KernelIntegrator;
 static_assert_align(KernelIntegrator, 16);
 
@@ -1189,6 +1213,8 @@ typedef struct KernelBVH {
   int bvh_layout;
   int use_bvh_steps;
   int curve_subdivisions;
+  int use_compressed_nodes;
+  int pad3, pad4, pad5;
 
   /* Custom BVH */
 #ifdef __KERNEL_OPTIX__
@@ -1271,6 +1297,24 @@ typedef struct KernelObject {
 } KernelObject;
 static_assert_align(KernelObject, 16);
 
+/* Voxel occupancy of volume objects, for skipping empty space inside the bounding mesh. */
+
+#define VOLUME_OCCUPANCY_LEAF_DIM 8
+#define VOLUME_OCCUPANCY_LEAF_WORDS 16
+#define VOLUME_OCCUPANCY_EMPTY 0xFFFFFFFF
+
+typedef struct KernelVolumeOccupancy {
+  /* World space to voxel index space, with the first voxel starting at the origin. */
+  Transform itfm;
+
+  /* Resolution in leaf nodes. */
+  int res_x, res_y, res_z;
+
+  /* Offset into the occupancy array, or -1 if the object has none. */
+  int offset;
+} KernelVolumeOccupancy;
+static_assert_align(KernelVolumeOccupancy, 16);
+
 typedef struct KernelSpotLight {
   float radius;
   float invarea;
@@ -1373,6 +1417,10 @@ typedef struct KernelWorkTile {
   uint start_sample;
   uint num_samples;
 
+  /* Index of the first sample rendered into the buffer, used when a frame is rendered in multiple
+   * ranges of samples which are accumulated afterwards. */
+  uint sample_offset;
+
   int offset;
   uint stride;
 
@@ -1398,6 +1446,12 @@ static_assert_align(KernelShaderEvalInput, 16);
 #define NUM_PMJ_SAMPLES ((NUM_PMJ_DIVISIONS) * (NUM_PMJ_DIVISIONS))
 #define NUM_PMJ_PATTERNS 1
 
+/* Size of the tileable blue noise mask, must be a power of two. The position of the pixel
+ * within the mask is stored in the lower bits of the path random number hash. */
+#define BLUE_NOISE_SIZE_BITS 6
+#define BLUE_NOISE_SIZE (1 << BLUE_NOISE_SIZE_BITS)
+#define BLUE_NOISE_PIXEL_MASK ((1 << (2 * BLUE_NOISE_SIZE_BITS)) - 1)
+
 /* Device kernels.
  *
  * Identifier for kernels that can be executed in device queues.
@@ -1524,6 +1578,9 @@ enum KernelFeatureFlag : unsigned int {
 
   /* Shadow render pass. */
   KERNEL_FEATURE_SHADOW_PASS = (1U << 22U),
+
+  /* Path guiding. */
+  KERNEL_FEATURE_PATH_GUIDING = (1U << 23U),
 };
 
 /* Shader node feature mask, to specialize shader evaluation for kernels. */
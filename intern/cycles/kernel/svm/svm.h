@@ -36,6 +36,15 @@
  * closure type, associated label, data and weight. Sampling from multiple
  * closures is supported through the mix closure node, the logic for that is
  * mostly taken care of in the SVM compiler.
+ *
+ * Shaders are interpreted on all devices, there is no per-shader compilation
+ * to native code. On the CPU this would need a host compiler and the kernel
+ * sources at render time, and loading of objects which match the ABI of the
+ * kernel of the used instruction set. The specialization which is known at
+ * build time is done with templates instead: svm_eval_nodes() is instantiated
+ * per shader type and node feature mask. Overhead of the interpreter is kept
+ * low by folding nodes in the SVM compiler, such as constant folding and the
+ * merging of mapping nodes into texture nodes.
  */
 
 #include "kernel/svm/svm_types.h"
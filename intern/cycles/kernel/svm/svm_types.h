@@ -455,6 +455,8 @@ typedef enum NodeImageProjection {
 typedef enum NodeImageFlags {
   NODE_IMAGE_COMPRESS_AS_SRGB = 1,
   NODE_IMAGE_ALPHA_UNASSOCIATE = 2,
+  /* Texture coordinate transform follows the node, see TextureMapping. */
+  NODE_IMAGE_MAPPING = 4,
 } NodeImageFlags;
 
 typedef enum NodeEnvironmentProjection {
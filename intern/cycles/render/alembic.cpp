@@ -26,6 +26,7 @@
 
 #include "util/util_foreach.h"
 #include "util/util_logging.h"
+#include "util/util_map.h"
 #include "util/util_progress.h"
 #include "util/util_transform.h"
 #include "util/util_vector.h"
@@ -40,7 +41,7 @@ CCL_NAMESPACE_BEGIN
 
 template<typename SchemaType>
 static vector<FaceSetShaderIndexPair> parse_face_sets_for_shader_assignment(
-    SchemaType &schema, const array<Node *> &used_shaders)
+    SchemaType &schema, const vector<ustring> &used_shader_names)
 {
   vector<FaceSetShaderIndexPair> result;
 
@@ -54,15 +55,15 @@ static vector<FaceSetShaderIndexPair> parse_face_sets_for_shader_assignment(
   for (const std::string &face_set_name : face_set_names) {
     int shader_index = 0;
 
-    for (Node *node : used_shaders) {
-      if (node->name == face_set_name) {
+    for (const ustring &shader_name : used_shader_names) {
+      if (shader_name == face_set_name) {
         break;
       }
 
       ++shader_index;
     }
 
-    if (shader_index >= used_shaders.size()) {
+    if (shader_index >= used_shader_names.size()) {
       /* use the first shader instead if none was found */
       shader_index = 0;
     }
@@ -105,6 +106,7 @@ void CachedData::clear()
   }
 
   attributes.clear();
+  is_animated = false;
 }
 
 CachedData::CachedAttribute &CachedData::add_attribute(const ustring &name,
@@ -450,8 +452,9 @@ bool AlembicObject::has_data_loaded() const
 }
 
 void AlembicObject::load_data_in_cache(CachedData &cached_data,
-                                       AlembicProcedural *proc,
+                                       const AlembicReadParams &read_params,
                                        IPolyMeshSchema &schema,
+                                       const AttributeRequestSet &requested_attributes,
                                        Progress &progress)
 {
   /* Only load data for the original Geometry. */
@@ -469,9 +472,10 @@ void AlembicObject::load_data_in_cache(CachedData &cached_data,
   data.face_indices = schema.getFaceIndicesProperty();
   data.normals = schema.getNormalsParam();
   data.num_samples = schema.getNumSamples();
-  data.shader_face_sets = parse_face_sets_for_shader_assignment(schema, get_used_shaders());
+  data.shader_face_sets = parse_face_sets_for_shader_assignment(schema,
+                                                                read_params.used_shader_names);
 
-  read_geometry_data(proc, cached_data, data, progress);
+  read_geometry_data(read_params, cached_data, data, progress);
 
   if (progress.get_cancel()) {
     return;
@@ -480,19 +484,19 @@ void AlembicObject::load_data_in_cache(CachedData &cached_data,
   /* Use the schema as the base compound property to also be able to look for top level properties.
    */
   read_attributes(
-      proc, cached_data, schema, schema.getUVsParam(), get_requested_attributes(), progress);
+      read_params, cached_data, schema, schema.getUVsParam(), requested_attributes, progress);
 
   if (progress.get_cancel()) {
     return;
   }
 
   cached_data.invalidate_last_loaded_time(true);
-  data_loaded = true;
 }
 
 void AlembicObject::load_data_in_cache(CachedData &cached_data,
-                                       AlembicProcedural *proc,
+                                       const AlembicReadParams &read_params,
                                        ISubDSchema &schema,
+                                       const AttributeRequestSet &requested_attributes,
                                        Progress &progress)
 {
   /* Only load data for the original Geometry. */
@@ -502,7 +506,7 @@ void AlembicObject::load_data_in_cache(CachedData &cached_data,
 
   cached_data.clear();
 
-  if (this->get_ignore_subdivision()) {
+  if (read_params.ignore_subdivision) {
     PolyMeshSchemaData data;
     data.topology_variance = schema.getTopologyVariance();
     data.time_sampling = schema.getTimeSampling();
@@ -511,9 +515,10 @@ void AlembicObject::load_data_in_cache(CachedData &cached_data,
     data.face_indices = schema.getFaceIndicesProperty();
     data.num_samples = schema.getNumSamples();
     data.velocities = schema.getVelocitiesProperty();
-    data.shader_face_sets = parse_face_sets_for_shader_assignment(schema, get_used_shaders());
+    data.shader_face_sets = parse_face_sets_for_shader_assignment(schema,
+                                                                  read_params.used_shader_names);
 
-    read_geometry_data(proc, cached_data, data, progress);
+    read_geometry_data(read_params, cached_data, data, progress);
 
     if (progress.get_cancel()) {
       return;
@@ -522,10 +527,9 @@ void AlembicObject::load_data_in_cache(CachedData &cached_data,
     /* Use the schema as the base compound property to also be able to look for top level
      * properties. */
     read_attributes(
-        proc, cached_data, schema, schema.getUVsParam(), get_requested_attributes(), progress);
+        read_params, cached_data, schema, schema.getUVsParam(), requested_attributes, progress);
 
     cached_data.invalidate_last_loaded_time(true);
-    data_loaded = true;
     return;
   }
 
@@ -547,9 +551,10 @@ void AlembicObject::load_data_in_cache(CachedData &cached_data,
   data.holes = schema.getHolesProperty();
   data.subdivision_scheme = schema.getSubdivisionSchemeProperty();
   data.velocities = schema.getVelocitiesProperty();
-  data.shader_face_sets = parse_face_sets_for_shader_assignment(schema, get_used_shaders());
+  data.shader_face_sets = parse_face_sets_for_shader_assignment(schema,
+                                                                read_params.used_shader_names);
 
-  read_geometry_data(proc, cached_data, data, progress);
+  read_geometry_data(read_params, cached_data, data, progress);
 
   if (progress.get_cancel()) {
     return;
@@ -558,15 +563,15 @@ void AlembicObject::load_data_in_cache(CachedData &cached_data,
   /* Use the schema as the base compound property to also be able to look for top level properties.
    */
   read_attributes(
-      proc, cached_data, schema, schema.getUVsParam(), get_requested_attributes(), progress);
+      read_params, cached_data, schema, schema.getUVsParam(), requested_attributes, progress);
 
   cached_data.invalidate_last_loaded_time(true);
-  data_loaded = true;
 }
 
 void AlembicObject::load_data_in_cache(CachedData &cached_data,
-                                       AlembicProcedural *proc,
+                                       const AlembicReadParams &read_params,
                                        const ICurvesSchema &schema,
+                                       const AttributeRequestSet &requested_attributes,
                                        Progress &progress)
 {
   /* Only load data for the original Geometry. */
@@ -588,10 +593,10 @@ void AlembicObject::load_data_in_cache(CachedData &cached_data,
   data.topology_variance = schema.getTopologyVariance();
   data.num_samples = schema.getNumSamples();
   data.num_vertices = schema.getNumVerticesProperty();
-  data.default_radius = proc->get_default_radius();
-  data.radius_scale = get_radius_scale();
+  data.default_radius = read_params.default_radius;
+  data.radius_scale = read_params.radius_scale;
 
-  read_geometry_data(proc, cached_data, data, progress);
+  read_geometry_data(read_params, cached_data, data, progress);
 
   if (progress.get_cancel()) {
     return;
@@ -600,10 +605,31 @@ void AlembicObject::load_data_in_cache(CachedData &cached_data,
   /* Use the schema as the base compound property to also be able to look for top level properties.
    */
   read_attributes(
-      proc, cached_data, schema, schema.getUVsParam(), get_requested_attributes(), progress);
+      read_params, cached_data, schema, schema.getUVsParam(), requested_attributes, progress);
 
   cached_data.invalidate_last_loaded_time(true);
-  data_loaded = true;
+}
+
+void AlembicObject::load_data_in_cache(CachedData &cached_data,
+                                       const AlembicReadParams &read_params,
+                                       const AttributeRequestSet &requested_attributes,
+                                       Progress &progress)
+{
+  if (schema_type == POLY_MESH) {
+    IPolyMesh polymesh(iobject, Alembic::Abc::kWrapExisting);
+    IPolyMeshSchema schema = polymesh.getSchema();
+    load_data_in_cache(cached_data, read_params, schema, requested_attributes, progress);
+  }
+  else if (schema_type == CURVES) {
+    ICurves curves(iobject, Alembic::Abc::kWrapExisting);
+    ICurvesSchema schema = curves.getSchema();
+    load_data_in_cache(cached_data, read_params, schema, requested_attributes, progress);
+  }
+  else if (schema_type == SUBD) {
+    ISubD subd_mesh(iobject, Alembic::Abc::kWrapExisting);
+    ISubDSchema schema = subd_mesh.getSchema();
+    load_data_in_cache(cached_data, read_params, schema, requested_attributes, progress);
+  }
 }
 
 void AlembicObject::setup_transform_cache(CachedData &cached_data, float scale)
@@ -669,6 +695,21 @@ AttributeRequestSet AlembicObject::get_requested_attributes()
   return requested_attributes;
 }
 
+AlembicReadParams AlembicObject::get_read_params(const AlembicProcedural *proc) const
+{
+  AlembicReadParams read_params;
+  read_params.frame_rate = static_cast<double>(proc->get_frame_rate());
+  read_params.default_radius = proc->get_default_radius();
+  read_params.radius_scale = get_radius_scale();
+  read_params.ignore_subdivision = get_ignore_subdivision();
+
+  for (const Node *node : get_used_shaders()) {
+    read_params.used_shader_names.push_back(node->name);
+  }
+
+  return read_params;
+}
+
 /* Update existing attributes and remove any attribute not in the cached_data, those attributes
  * were added by Cycles (e.g. face normals) */
 static void update_attributes(AttributeSet &attributes, CachedData &cached_data, double frame_time)
@@ -746,10 +787,18 @@ AlembicProcedural::AlembicProcedural() : Procedural(get_node_type())
 {
   objects_loaded = false;
   scene_ = nullptr;
+  generation = 0;
+  previous_frame = 0.0f;
+  frame_step = 1.0f;
+  prefetch_pool = make_unique<TaskPool>();
 }
 
 AlembicProcedural::~AlembicProcedural()
 {
+  /* Stop loading in the background before the objects and archive are freed. */
+  prefetch_progress.set_cancel("Cancel");
+  prefetch_pool->cancel();
+
   ccl::set<Geometry *> geometries_set;
   ccl::set<Object *> objects_set;
   ccl::set<AlembicObject *> abc_objects_set;
@@ -784,6 +833,9 @@ void AlembicProcedural::generate(Scene *scene, Progress &progress)
   assert(scene_ == nullptr || scene_ == scene);
   scene_ = scene;
 
+  /* The archive and the caches are not to be accessed while data is loaded in the background. */
+  prefetch_pool->wait_work();
+
   if (frame < start_frame || frame > end_frame) {
     clear_modified();
     return;
@@ -856,29 +908,29 @@ void AlembicProcedural::generate(Scene *scene, Progress &progress)
     }
   }
 
-  if (use_prefetch_is_modified()) {
-    if (!use_prefetch) {
-      for (Node *node : objects) {
-        AlembicObject *object = static_cast<AlembicObject *>(node);
+  if (use_prefetch_is_modified() || prefetch_cache_size_is_modified()) {
+    /* Reload the data for the new settings, with a larger memory limit streamed objects may fit
+     * in the cache again. */
+    for (Node *node : objects) {
+      AlembicObject *object = static_cast<AlembicObject *>(node);
+
+      if (!use_prefetch || object->use_streaming) {
         object->clear_cache();
+        object->data_loaded = false;
       }
-    }
-  }
 
-  if (prefetch_cache_size_is_modified()) {
-    /* Check whether the current memory usage fits in the new requested size,
-     * abort the render if it is any higher. */
-    size_t memory_used = 0ul;
-    for (Node *node : objects) {
-      AlembicObject *object = static_cast<AlembicObject *>(node);
-      memory_used += object->get_cached_data().memory_used();
+      object->use_streaming = !use_prefetch;
     }
+  }
 
-    if (memory_used > get_prefetch_cache_size_in_bytes()) {
-      progress.set_error("Error: Alembic Procedural memory limit reached");
-      return;
-    }
+  /* Step between the frames of consecutive generations, to predict which frame is rendered next.
+   */
+  if (generation > 0 && frame != previous_frame) {
+    frame_step = frame - previous_frame;
   }
+  previous_frame = frame;
+
+  generation++;
 
   build_caches(progress);
 
@@ -909,6 +961,20 @@ void AlembicProcedural::generate(Scene *scene, Progress &progress)
     object->clear_modified();
   }
 
+  if (use_prefetch) {
+    evict_caches();
+  }
+
+  cache_stats.memory_used = 0;
+  for (Node *node : objects) {
+    AlembicObject *object = static_cast<AlembicObject *>(node);
+    cache_stats.memory_used += object->memory_used();
+  }
+
+  VLOG(1) << "AlembicProcedural cache statistics:\n" << cache_stats.full_report();
+
+  prefetch_next_frame();
+
   clear_modified();
 }
 
@@ -1366,64 +1432,204 @@ void AlembicProcedural::build_caches(Progress &progress)
       return;
     }
 
-    if (object->schema_type == AlembicObject::POLY_MESH) {
-      if (!object->has_data_loaded()) {
-        IPolyMesh polymesh(object->iobject, Alembic::Abc::kWrapExisting);
-        IPolyMeshSchema schema = polymesh.getSchema();
-        object->load_data_in_cache(object->get_cached_data(), this, schema, progress);
-      }
-      else if (object->need_shader_update) {
-        IPolyMesh polymesh(object->iobject, Alembic::Abc::kWrapExisting);
-        IPolyMeshSchema schema = polymesh.getSchema();
-        read_attributes(this,
-                        object->get_cached_data(),
-                        schema,
-                        schema.getUVsParam(),
-                        object->get_requested_attributes(),
-                        progress);
-      }
+    if (!use_prefetch) {
+      object->use_streaming = true;
     }
-    else if (object->schema_type == AlembicObject::CURVES) {
-      if (!object->has_data_loaded() || default_radius_is_modified() ||
-          object->radius_scale_is_modified()) {
-        ICurves curves(object->iobject, Alembic::Abc::kWrapExisting);
-        ICurvesSchema schema = curves.getSchema();
-        object->load_data_in_cache(object->get_cached_data(), this, schema, progress);
+
+    object->last_used = generation;
+
+    CachedData &cached_data = object->get_cached_data();
+
+    bool need_load = !object->has_data_loaded();
+
+    if (object->schema_type == AlembicObject::CURVES &&
+        (default_radius_is_modified() || object->radius_scale_is_modified())) {
+      need_load = true;
+    }
+
+    if (object->use_streaming && cached_data.is_animated && cached_data.start_frame != frame) {
+      need_load = true;
+    }
+
+    if (object->instance_of) {
+      /* Only the transformations are cached for instances. */
+    }
+    else if (object->schema_type == AlembicObject::INVALID) {
+      continue;
+    }
+    else if (!need_load) {
+      cache_stats.hits++;
+
+      if (object->need_shader_update) {
+        if (object->schema_type == AlembicObject::POLY_MESH) {
+          IPolyMesh polymesh(object->iobject, Alembic::Abc::kWrapExisting);
+          IPolyMeshSchema schema = polymesh.getSchema();
+          read_attributes(object->get_read_params(this),
+                          cached_data,
+                          schema,
+                          schema.getUVsParam(),
+                          object->get_requested_attributes(),
+                          progress);
+        }
+        else if (object->schema_type == AlembicObject::SUBD) {
+          ISubD subd_mesh(object->iobject, Alembic::Abc::kWrapExisting);
+          ISubDSchema schema = subd_mesh.getSchema();
+          read_attributes(object->get_read_params(this),
+                          cached_data,
+                          schema,
+                          schema.getUVsParam(),
+                          object->get_requested_attributes(),
+                          progress);
+        }
       }
     }
-    else if (object->schema_type == AlembicObject::SUBD) {
-      if (!object->has_data_loaded()) {
-        ISubD subd_mesh(object->iobject, Alembic::Abc::kWrapExisting);
-        ISubDSchema schema = subd_mesh.getSchema();
-        object->load_data_in_cache(object->get_cached_data(), this, schema, progress);
+    else if (object->use_streaming && object->has_prefetched_data &&
+             object->prefetched_data_.start_frame == frame && !object->need_shader_update &&
+             !object->is_modified() && !frame_rate_is_modified() &&
+             !default_radius_is_modified()) {
+      /* Data was loaded in the background while rendering the previous frame, with the same
+       * settings. */
+      swap(cached_data, object->prefetched_data_);
+      object->clear_prefetched_data();
+      object->data_loaded = true;
+      cache_stats.prefetch_hits++;
+    }
+    else {
+      object->clear_prefetched_data();
+
+      cached_data.start_frame = (object->use_streaming) ? frame : start_frame;
+      cached_data.end_frame = (object->use_streaming) ? frame : end_frame;
+
+      object->load_data_in_cache(
+          cached_data, object->get_read_params(this), object->get_requested_attributes(), progress);
+      object->data_loaded = !progress.get_cancel();
+      cache_stats.misses++;
+    }
+
+    if (scale_is_modified() || cached_data.transforms.size() == 0) {
+      object->setup_transform_cache(cached_data, scale);
+    }
+
+    memory_used += object->memory_used();
+  }
+
+  VLOG(1) << "AlembicProcedural memory usage : " << string_human_readable_size(memory_used);
+}
+
+void AlembicProcedural::evict_caches()
+{
+  const size_t memory_limit = get_prefetch_cache_size_in_bytes();
+
+  size_t memory_used = 0;
+  for (Node *node : objects) {
+    AlembicObject *object = static_cast<AlembicObject *>(node);
+    memory_used += object->memory_used();
+  }
+
+  while (memory_used > memory_limit) {
+    /* All objects are used for every frame, so among the least recently used ones the largest
+     * is evicted first, to keep as many objects as possible in the cache. */
+    AlembicObject *evicted = nullptr;
+
+    for (Node *node : objects) {
+      AlembicObject *object = static_cast<AlembicObject *>(node);
+
+      /* Constant data takes the same memory when streamed. */
+      if (object->use_streaming || object->instance_of || !object->has_data_loaded() ||
+          object->get_cached_data().is_constant()) {
+        continue;
       }
-      else if (object->need_shader_update) {
-        ISubD subd_mesh(object->iobject, Alembic::Abc::kWrapExisting);
-        ISubDSchema schema = subd_mesh.getSchema();
-        read_attributes(this,
-                        object->get_cached_data(),
-                        schema,
-                        schema.getUVsParam(),
-                        object->get_requested_attributes(),
-                        progress);
+
+      if (evicted == nullptr || object->last_used < evicted->last_used ||
+          (object->last_used == evicted->last_used &&
+           object->memory_used() > evicted->memory_used())) {
+        evicted = object;
       }
     }
 
-    if (scale_is_modified() || object->get_cached_data().transforms.size() == 0) {
-      object->setup_transform_cache(object->get_cached_data(), scale);
+    if (evicted == nullptr) {
+      break;
+    }
+
+    VLOG(1) << "AlembicProcedural: streaming " << evicted->get_path() << ", "
+            << string_human_readable_size(evicted->memory_used()) << " did not fit in the cache";
+
+    /* The data for the current frame was already copied to the scene. */
+    memory_used -= evicted->memory_used();
+    evicted->clear_cache();
+    evicted->data_loaded = false;
+    evicted->use_streaming = true;
+
+    cache_stats.evictions++;
+  }
+}
+
+void AlembicProcedural::prefetch_next_frame()
+{
+  const float next_frame = frame + frame_step;
+
+  if (next_frame < start_frame || next_frame > end_frame) {
+    return;
+  }
+
+  /* Copy the settings and the requested attributes here, as the sockets and the shaders may be
+   * modified for the next frame while the data is being loaded. */
+  struct PrefetchObject {
+    AlembicObject *object;
+    AlembicReadParams read_params;
+    AttributeRequestSet requested_attributes;
+  };
+
+  vector<PrefetchObject> streamed_objects;
+
+  for (Node *node : objects) {
+    AlembicObject *object = static_cast<AlembicObject *>(node);
+
+    if (!object->use_streaming || object->instance_of ||
+        object->schema_type == AlembicObject::INVALID ||
+        !object->get_cached_data().is_animated) {
+      continue;
     }
 
-    memory_used += object->get_cached_data().memory_used();
+    streamed_objects.push_back(
+        {object, object->get_read_params(this), object->get_requested_attributes()});
+  }
+
+  if (streamed_objects.empty()) {
+    return;
+  }
+
+  /* Only the prefetched data of the objects is written, it is used by the main thread after
+   * waiting for the pool in generate(). */
+  prefetch_pool->push([this, next_frame, streamed_objects]() {
+    for (const PrefetchObject &item : streamed_objects) {
+      AlembicObject *object = item.object;
+      CachedData &prefetched_data = object->prefetched_data_;
 
-    if (use_prefetch) {
-      if (memory_used > get_prefetch_cache_size_in_bytes()) {
-        progress.set_error("Error: Alembic Procedural memory limit reached");
+      if (prefetch_progress.get_cancel()) {
         return;
       }
+
+      prefetched_data.start_frame = next_frame;
+      prefetched_data.end_frame = next_frame;
+
+      object->load_data_in_cache(
+          prefetched_data, item.read_params, item.requested_attributes, prefetch_progress);
+      object->has_prefetched_data = !prefetch_progress.get_cancel();
     }
-  }
+  });
+}
 
-  VLOG(1) << "AlembicProcedural memory usage : " << string_human_readable_size(memory_used);
+string AlembicCacheStats::full_report() const
+{
+  string result = "";
+  result += string_printf("  Memory used: %s\n", string_human_readable_size(memory_used).c_str());
+  result += string_printf("  Hits: %s\n", string_human_readable_number(hits).c_str());
+  result += string_printf("  Prefetch hits: %s\n",
+                          string_human_readable_number(prefetch_hits).c_str());
+  result += string_printf("  Misses: %s\n", string_human_readable_number(misses).c_str());
+  result += string_printf("  Evictions: %s\n", string_human_readable_number(evictions).c_str());
+  return result;
 }
 
 CCL_NAMESPACE_END
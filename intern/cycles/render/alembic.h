@@ -19,8 +19,12 @@
 #include "graph/node.h"
 #include "render/attribute.h"
 #include "render/procedural.h"
+#include "util/util_algorithm.h"
+#include "util/util_progress.h"
 #include "util/util_set.h"
+#include "util/util_task.h"
 #include "util/util_transform.h"
+#include "util/util_unique_ptr.h"
 #include "util/util_vector.h"
 
 #ifdef WITH_ALEMBIC
@@ -31,9 +35,9 @@
 CCL_NAMESPACE_BEGIN
 
 class AlembicProcedural;
+struct AlembicReadParams;
 class Geometry;
 class Object;
-class Progress;
 class Shader;
 
 using MatrixSampleMap = std::map<Alembic::Abc::chrono_t, Alembic::Abc::M44d>;
@@ -290,9 +294,23 @@ template<typename T> class DataStore {
  private:
   const TimeIndexPair &get_index_for_time(double time) const
   {
-    std::pair<size_t, Alembic::Abc::chrono_t> index_pair;
-    index_pair = time_sampling.getNearIndex(time, index_data_map.size());
-    return index_data_map[index_pair.first];
+    /* The entries are in chronological order, but do not necessarily start at the first sample of
+     * the time sampling when only some frames are loaded, so look up the nearest entry by time. */
+    auto it = std::lower_bound(
+        index_data_map.begin(),
+        index_data_map.end(),
+        time,
+        [](const TimeIndexPair &pair, double value) { return pair.time < value; });
+
+    if (it == index_data_map.end()) {
+      return index_data_map.back();
+    }
+
+    if (it != index_data_map.begin() && (time - (it - 1)->time) < (it->time - time)) {
+      --it;
+    }
+
+    return *it;
   }
 };
 
@@ -337,6 +355,14 @@ struct CachedData {
 
   vector<CachedAttribute> attributes{};
 
+  /* Range of frames to load the data for. This is set before loading, and is not reset when
+   * clearing the data. */
+  double start_frame = 0.0;
+  double end_frame = 0.0;
+
+  /* Whether any of the loaded properties has more than one sample in the archive. */
+  bool is_animated = false;
+
   void clear();
 
   CachedAttribute &add_attribute(const ustring &name,
@@ -393,18 +419,32 @@ class AlembicObject : public Node {
   Object *get_object();
 
   void load_data_in_cache(CachedData &cached_data,
-                          AlembicProcedural *proc,
+                          const AlembicReadParams &read_params,
                           Alembic::AbcGeom::IPolyMeshSchema &schema,
+                          const AttributeRequestSet &requested_attributes,
                           Progress &progress);
   void load_data_in_cache(CachedData &cached_data,
-                          AlembicProcedural *proc,
+                          const AlembicReadParams &read_params,
                           Alembic::AbcGeom::ISubDSchema &schema,
+                          const AttributeRequestSet &requested_attributes,
                           Progress &progress);
   void load_data_in_cache(CachedData &cached_data,
-                          AlembicProcedural *proc,
+                          const AlembicReadParams &read_params,
                           const Alembic::AbcGeom::ICurvesSchema &schema,
+                          const AttributeRequestSet &requested_attributes,
                           Progress &progress);
 
+  /* Load the data for the frame range set in the cached data, using the schema matching the type
+   * of the object. Only accesses the archive and the given settings, so that it can be used from a
+   * worker thread. */
+  void load_data_in_cache(CachedData &cached_data,
+                          const AlembicReadParams &read_params,
+                          const AttributeRequestSet &requested_attributes,
+                          Progress &progress);
+
+  /* Copy the settings of the procedural and of this object which are needed to load its data. */
+  AlembicReadParams get_read_params(const AlembicProcedural *proc) const;
+
   bool has_data_loaded() const;
 
   /* Enumeration used to speed up the discrimination of an IObject as IObject::matches() methods
@@ -434,12 +474,29 @@ class AlembicObject : public Node {
 
   bool is_constant() const
   {
+    /* The cache of streamed objects only holds a single frame. */
+    if (use_streaming) {
+      return !cached_data_.is_animated;
+    }
+
     return cached_data_.is_constant();
   }
 
   void clear_cache()
   {
     cached_data_.clear();
+    clear_prefetched_data();
+  }
+
+  void clear_prefetched_data()
+  {
+    prefetched_data_.clear();
+    has_prefetched_data = false;
+  }
+
+  size_t memory_used() const
+  {
+    return cached_data_.memory_used() + prefetched_data_.memory_used();
   }
 
   Object *object = nullptr;
@@ -448,11 +505,39 @@ class AlembicObject : public Node {
 
   CachedData cached_data_;
 
+  /* Only keep the data for the current frame in the cache instead of the data for the whole
+   * frame range of the procedural, for objects which do not fit in the memory limit. */
+  bool use_streaming = false;
+
+  /* Data for the next frame of streamed objects, loaded in the background while rendering. */
+  CachedData prefetched_data_;
+  bool has_prefetched_data = false;
+
+  /* Generation of the procedural in which the cache was last used, for eviction. */
+  uint64_t last_used = 0;
+
   void setup_transform_cache(CachedData &cached_data, float scale);
 
   AttributeRequestSet get_requested_attributes();
 };
 
+/* Statistics about the cache of an AlembicProcedural, accumulated over all generations. */
+struct AlembicCacheStats {
+  /* Memory used by the cached data of all objects at the end of the last generation. */
+  size_t memory_used = 0;
+
+  /* Number of times the data of an object for a frame was already in the cache, was loaded in the
+   * background ahead of time, or had to be read from the archive. */
+  uint64_t hits = 0;
+  uint64_t prefetch_hits = 0;
+  uint64_t misses = 0;
+
+  /* Number of objects which were switched to streaming to stay within the memory limit. */
+  uint64_t evictions = 0;
+
+  string full_report() const;
+};
+
 /* Procedural to render objects from a single Alembic archive.
  *
  * Every object desired to be rendered should be passed as an AlembicObject through the objects
@@ -461,12 +546,32 @@ class AlembicObject : public Node {
  * This procedural will load the data set for the entire animation in memory on the first frame,
  * and directly set the data for the new frames on the created Nodes if needed. This allows for
  * faster updates between frames as it avoids reseeking the data on disk.
+ *
+ * When the data does not fit in the memory limit, the objects which were least recently used,
+ * largest first, only keep the data of the current frame in memory. The data of the next frame
+ * for those objects is loaded in the background while the current frame renders.
  */
 class AlembicProcedural : public Procedural {
   Alembic::AbcGeom::IArchive archive;
   bool objects_loaded;
   Scene *scene_;
 
+  /* Counter of the generations, used to find the least recently used caches. */
+  uint64_t generation;
+
+  /* Frame of the previous generation, and the step from it to the current frame, to predict the
+   * frame whose data is to be prefetched. */
+  float previous_frame;
+  float frame_step;
+
+  AlembicCacheStats cache_stats;
+
+  /* Loading of data in the background. It has its own progress so that it can be canceled
+   * independently of the session. The pool is held by pointer since the destructor of a task
+   * group may throw, which is not allowed for the destructor of a procedural. */
+  unique_ptr<TaskPool> prefetch_pool;
+  Progress prefetch_progress;
+
  public:
   NODE_DECLARE
 
@@ -502,8 +607,8 @@ class AlembicProcedural : public Procedural {
   /* Cache controls */
   NODE_SOCKET_API(bool, use_prefetch)
 
-  /* Memory limit for the cache, if the data does not fit within this limit, rendering is aborted.
-   */
+  /* Memory limit for the cache in megabytes. Objects whose data does not fit within this limit
+   * are streamed one frame at a time. */
   NODE_SOCKET_API(int, prefetch_cache_size)
 
   AlembicProcedural();
@@ -526,6 +631,11 @@ class AlembicProcedural : public Procedural {
    * Returns a pointer to an existing or a newly created AlembicObject for the given path. */
   AlembicObject *get_or_create_object(const ustring &path);
 
+  const AlembicCacheStats &get_cache_stats() const
+  {
+    return cache_stats;
+  }
+
  private:
   /* Add an object to our list of objects, and tag the socket as modified. */
   void add_object(AlembicObject *object);
@@ -556,6 +666,12 @@ class AlembicProcedural : public Procedural {
 
   void build_caches(Progress &progress);
 
+  /* Switch objects to streaming until the cached data fits in the memory limit. */
+  void evict_caches();
+
+  /* Start loading the data of the next frame for streamed objects. */
+  void prefetch_next_frame();
+
   size_t get_prefetch_cache_size_in_bytes() const
   {
     /* prefetch_cache_size is in megabytes, so convert to bytes. */
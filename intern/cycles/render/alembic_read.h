@@ -21,11 +21,11 @@
 #  include <Alembic/AbcCoreFactory/All.h>
 #  include <Alembic/AbcGeom/All.h>
 
+#  include "util/util_param.h"
 #  include "util/util_vector.h"
 
 CCL_NAMESPACE_BEGIN
 
-class AlembicProcedural;
 class AttributeRequestSet;
 class Progress;
 struct CachedData;
@@ -37,6 +37,20 @@ struct FaceSetShaderIndexPair {
   int shader_index;
 };
 
+/* Settings of the procedural and of an object which are needed to read the data of the object.
+ * They are copied, so that the data can be read in the background while the sockets are modified
+ * for the next frame. */
+struct AlembicReadParams {
+  double frame_rate;
+
+  float default_radius;
+  float radius_scale;
+  bool ignore_subdivision;
+
+  /* Names of the shaders used by the object, to assign the face sets to shaders. */
+  vector<ustring> used_shader_names;
+};
+
 /* Data of an IPolyMeshSchema that we need to read. */
 struct PolyMeshSchemaData {
   Alembic::AbcGeom::TimeSamplingPtr time_sampling;
@@ -55,7 +69,7 @@ struct PolyMeshSchemaData {
   Alembic::AbcGeom::IV3fArrayProperty velocities;
 };
 
-void read_geometry_data(AlembicProcedural *proc,
+void read_geometry_data(const AlembicReadParams &read_params,
                         CachedData &cached_data,
                         const PolyMeshSchemaData &data,
                         Progress &progress);
@@ -87,7 +101,7 @@ struct SubDSchemaData {
   Alembic::AbcGeom::IV3fArrayProperty velocities;
 };
 
-void read_geometry_data(AlembicProcedural *proc,
+void read_geometry_data(const AlembicReadParams &read_params,
                         CachedData &cached_data,
                         const SubDSchemaData &data,
                         Progress &progress);
@@ -117,12 +131,12 @@ struct CurvesSchemaData {
   // TODO(@kevindietrich): type, basis, wrap
 };
 
-void read_geometry_data(AlembicProcedural *proc,
+void read_geometry_data(const AlembicReadParams &read_params,
                         CachedData &cached_data,
                         const CurvesSchemaData &data,
                         Progress &progress);
 
-void read_attributes(AlembicProcedural *proc,
+void read_attributes(const AlembicReadParams &read_params,
                      CachedData &cache,
                      const Alembic::AbcGeom::ICompoundProperty &arb_geom_params,
                      const Alembic::AbcGeom::IV2fGeomParam &default_uvs_param,
@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include <atomic>
 #include <stdlib.h>
 
 #include "device/device.h"
@@ -21,7 +22,9 @@
 
 #include "util/util_foreach.h"
 #include "util/util_hash.h"
+#include "util/util_logging.h"
 #include "util/util_math.h"
+#include "util/util_tbb.h"
 #include "util/util_time.h"
 #include "util/util_types.h"
 
@@ -358,4 +361,222 @@ void render_buffers_host_copy_denoised(RenderBuffers *dst,
   }
 }
 
+/* --------------------------------------------------------------------
+ * Accumulation.
+ */
+
+namespace {
+
+enum AccumulateOp {
+  ACCUMULATE_SUM,
+  ACCUMULATE_SUM_UINT,
+  ACCUMULATE_SUM_ADAPTIVE_AUX,
+  ACCUMULATE_ID_SLOTS,
+};
+
+struct AccumulatePass {
+  AccumulateOp op;
+  int offset;
+  int num_components;
+};
+
+}  // namespace
+
+/* Passes with the same name up to the trailing index form a single array of ID slots. */
+static string cryptomatte_pass_group_name(const ustring &name)
+{
+  const string &str = name.string();
+  size_t length = str.size();
+  while (length > 0 && isdigit(str[length - 1])) {
+    --length;
+  }
+  return str.substr(0, length);
+}
+
+static void accumulate_id_slots(float *dst, const float *src, const int num_slots)
+{
+  for (int src_slot = 0; src_slot < num_slots; ++src_slot) {
+    const float id = src[src_slot * 2 + 0];
+    const float weight = src[src_slot * 2 + 1];
+    if (id == ID_NONE) {
+      break;
+    }
+
+    /* Same logic as `kernel_write_id_slots()`: add to the slot of the ID, or claim an empty one.
+     * If no slot was found, add to the last. */
+    for (int slot = 0; slot < num_slots; ++slot) {
+      if (dst[slot * 2 + 0] == ID_NONE) {
+        dst[slot * 2 + 0] = id;
+        dst[slot * 2 + 1] = weight;
+        break;
+      }
+      else if (dst[slot * 2 + 0] == id || slot == num_slots - 1) {
+        dst[slot * 2 + 1] += weight;
+        break;
+      }
+    }
+  }
+
+  /* Keep the slots sorted by weight, same as the cryptomatte post-processing does. */
+  for (int slot = 1; slot < num_slots && dst[slot * 2] != ID_NONE; ++slot) {
+    for (int i = slot; i > 0 && dst[i * 2 + 1] > dst[(i - 1) * 2 + 1]; --i) {
+      std::swap(dst[i * 2 + 0], dst[(i - 1) * 2 + 0]);
+      std::swap(dst[i * 2 + 1], dst[(i - 1) * 2 + 1]);
+    }
+  }
+}
+
+bool render_buffers_host_accumulate(RenderBuffers *dst, const RenderBuffers *src)
+{
+  const BufferParams &params = dst->params;
+  const BufferParams &src_params = src->params;
+
+  if (params.width != src_params.width || params.height != src_params.height ||
+      params.pass_stride != src_params.pass_stride || params.passes != src_params.passes) {
+    LOG(ERROR) << "Render buffers to be accumulated have different layout.";
+    return false;
+  }
+
+  vector<AccumulatePass> accumulate_passes;
+
+  const int num_passes = params.passes.size();
+  for (int i = 0; i < num_passes; ++i) {
+    const BufferPass &pass = params.passes[i];
+    if (pass.offset == PASS_UNUSED || pass.mode == PassMode::DENOISED) {
+      continue;
+    }
+
+    AccumulatePass accumulate_pass;
+    accumulate_pass.op = ACCUMULATE_SUM;
+    accumulate_pass.offset = pass.offset;
+    accumulate_pass.num_components = pass.get_info().num_components;
+
+    switch (pass.type) {
+      case PASS_SAMPLE_COUNT:
+        accumulate_pass.op = ACCUMULATE_SUM_UINT;
+        break;
+      case PASS_ADAPTIVE_AUX_BUFFER:
+        accumulate_pass.op = ACCUMULATE_SUM_ADAPTIVE_AUX;
+        break;
+      case PASS_BAKE_PRIMITIVE:
+      case PASS_BAKE_DIFFERENTIAL:
+        /* Input of the baking, which is the same in both buffers. */
+        continue;
+      case PASS_CRYPTOMATTE: {
+        /* Merge all passes of the same cryptomatte type, as IDs are written to any of them. */
+        const string group_name = cryptomatte_pass_group_name(pass.name);
+        accumulate_pass.op = ACCUMULATE_ID_SLOTS;
+        while (i + 1 < num_passes && params.passes[i + 1].type == PASS_CRYPTOMATTE &&
+               params.passes[i + 1].offset != PASS_UNUSED &&
+               cryptomatte_pass_group_name(params.passes[i + 1].name) == group_name) {
+          accumulate_pass.num_components += params.passes[i + 1].get_info().num_components;
+          ++i;
+        }
+        break;
+      }
+      default:
+        /* Passes which are only written by the first sample, such as depth, are left at zero by
+         * all the other samples, so summing them is exact as well. */
+        break;
+    }
+
+    if (accumulate_pass.num_components != 0) {
+      accumulate_passes.push_back(accumulate_pass);
+    }
+  }
+
+  const int64_t pass_stride = params.pass_stride;
+  const int64_t num_pixels = (int64_t)params.width * params.height;
+
+  const float *src_buffer = src->buffer.data();
+  float *dst_buffer = dst->buffer.data();
+
+  parallel_for(int64_t(0), num_pixels, [&](int64_t pixel_index) {
+    const float *src_pixel = src_buffer + pixel_index * pass_stride;
+    float *dst_pixel = dst_buffer + pixel_index * pass_stride;
+
+    for (const AccumulatePass &accumulate_pass : accumulate_passes) {
+      const float *in = src_pixel + accumulate_pass.offset;
+      float *out = dst_pixel + accumulate_pass.offset;
+
+      switch (accumulate_pass.op) {
+        case ACCUMULATE_SUM:
+          for (int j = 0; j < accumulate_pass.num_components; ++j) {
+            out[j] += in[j];
+          }
+          break;
+        case ACCUMULATE_SUM_UINT:
+          out[0] = __uint_as_float(__float_as_uint(out[0]) + __float_as_uint(in[0]));
+          break;
+        case ACCUMULATE_SUM_ADAPTIVE_AUX:
+          out[0] += in[0];
+          out[1] += in[1];
+          out[2] += in[2];
+          /* Convergence is to be re-evaluated for the accumulated samples. */
+          out[3] = 0.0f;
+          break;
+        case ACCUMULATE_ID_SLOTS:
+          accumulate_id_slots(out, in, accumulate_pass.num_components / 2);
+          break;
+      }
+    }
+  });
+
+  dst->params.samples += src_params.samples;
+
+  return true;
+}
+
+int64_t render_buffers_host_num_unconverged_pixels(const RenderBuffers *buffers,
+                                                   const float threshold)
+{
+  const BufferParams &params = buffers->params;
+
+  const int combined_offset = params.get_pass_offset(PASS_COMBINED);
+  const int aux_offset = params.get_pass_offset(PASS_ADAPTIVE_AUX_BUFFER);
+  const int sample_count_offset = params.get_pass_offset(PASS_SAMPLE_COUNT);
+
+  DCHECK_NE(combined_offset, PASS_UNUSED);
+  DCHECK_NE(aux_offset, PASS_UNUSED);
+  DCHECK_NE(sample_count_offset, PASS_UNUSED);
+
+  const int64_t pass_stride = params.pass_stride;
+  const int64_t num_pixels = (int64_t)params.width * params.height;
+  const float *buffer = buffers->buffer.data();
+
+  /* Error estimate matches `kernel_adaptive_sampling_convergence_check()`. */
+  std::atomic<int64_t> num_unconverged = 0;
+
+  parallel_for(blocked_range<int64_t>(0, num_pixels), [&](const blocked_range<int64_t> &range) {
+    int64_t num_range_unconverged = 0;
+
+    for (int64_t pixel_index = range.begin(); pixel_index < range.end(); ++pixel_index) {
+      const float *pixel = buffer + pixel_index * pass_stride;
+      const float *I = pixel + combined_offset;
+      const float *A = pixel + aux_offset;
+
+      const uint sample = __float_as_uint(pixel[sample_count_offset]);
+      if (sample == 0) {
+        ++num_range_unconverged;
+        continue;
+      }
+      const float inv_sample = 1.0f / sample;
+
+      const float error_difference = (fabsf(I[0] - A[0]) + fabsf(I[1] - A[1]) +
+                                      fabsf(I[2] - A[2])) *
+                                     inv_sample;
+      const float error_normalize = sqrtf((I[0] + I[1] + I[2]) * inv_sample);
+      const float error = error_difference / (0.0001f + error_normalize);
+
+      if (!(error < threshold)) {
+        ++num_range_unconverged;
+      }
+    }
+
+    num_unconverged += num_range_unconverged;
+  });
+
+  return num_unconverged;
+}
+
 CCL_NAMESPACE_END
@@ -185,6 +185,25 @@ void render_buffers_host_copy_denoised(RenderBuffers *dst,
                                        const BufferParams &src_params,
                                        const size_t src_offset = 0);
 
+/* Accumulate samples of the source render buffers into the destination.
+ *
+ * Both buffers are expected to have the same parameters, and to contain disjoint ranges of samples
+ * of the same frame (rendered with different `SessionParams::sample_offset`). Passes are combined
+ * so that the result matches the buffers of a single render of all the samples: the number of
+ * samples is summed, as well as the sample count and the weights of the cryptomatte IDs.
+ * Denoised passes are not accumulated, and the accumulated result is to be denoised again.
+ *
+ * Returns false if the buffers are not compatible. */
+bool render_buffers_host_accumulate(RenderBuffers *dst, const RenderBuffers *src);
+
+/* Get number of pixels in the buffers whose noise is above the given adaptive sampling threshold.
+ * Uses the same error estimate as the adaptive sampling on the device, which allows to decide
+ * whether the accumulated buffers need more samples.
+ *
+ * The buffers are to contain the adaptive sampling passes. */
+int64_t render_buffers_host_num_unconverged_pixels(const RenderBuffers *buffers,
+                                                   const float threshold);
+
 CCL_NAMESPACE_END
 
 #endif /* __BUFFERS_H__ */
@@ -0,0 +1,797 @@
+/*
+ * Copyright 2011-2021 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "render/distributed.h"
+#include "render/buffers.h"
+
+#include "integrator/pass_accessor_cpu.h"
+
+#include "util/util_logging.h"
+#include "util/util_math.h"
+#include "util/util_time.h"
+
+#include <string.h>
+
+#ifndef _WIN32
+#  include <errno.h>
+#  include <arpa/inet.h>
+#  include <netdb.h>
+#  include <netinet/in.h>
+#  include <poll.h>
+#  include <sys/socket.h>
+#  include <sys/time.h>
+#  include <unistd.h>
+#endif
+
+CCL_NAMESPACE_BEGIN
+
+/* Identifies the protocol, and its version in the lowest byte. */
+static const uint32_t DISTRIBUTED_MAGIC = 0x43594402;
+
+/* Time the worker keeps retrying to connect to a coordinator which is not listening yet. */
+static const double DISTRIBUTED_CONNECT_TIMEOUT = 30.0;
+
+/* Time the coordinator waits for all workers to connect, and for a single worker to complete
+ * the handshake, so that missing workers or stalled connections are reported. */
+static const double DISTRIBUTED_ACCEPT_TIMEOUT = 300.0;
+static const double DISTRIBUTED_HANDSHAKE_TIMEOUT = 10.0;
+
+/* Size of the token in the handshake, including the null terminator. */
+static const int DISTRIBUTED_TOKEN_SIZE = 64;
+
+/* Limits for the values received from the other side, to reject corrupted or hostile messages
+ * before allocating memory for them. */
+static const int DISTRIBUTED_MAX_RESOLUTION = 65536;
+static const int DISTRIBUTED_MAX_PASSES = 1024;
+static const int DISTRIBUTED_MAX_PASS_STRIDE = 4096;
+static const int DISTRIBUTED_MAX_PASS_NAME_LENGTH = 1024;
+
+/* Messages. All of them are fixed size, the result is followed by the passes, each followed by
+ * its name, and then by the render buffer of the region. */
+
+struct DistributedHello {
+  uint32_t magic;
+  char token[DISTRIBUTED_TOKEN_SIZE];
+};
+
+struct DistributedRegion {
+  int32_t full_width, full_height;
+  int32_t x, y, width, height;
+  int32_t num_samples;
+};
+
+struct DistributedResult {
+  int32_t x, y, width, height;
+  int32_t samples;
+  int32_t num_passes;
+  int32_t pass_stride;
+  float exposure;
+  int32_t use_approximate_shadow_catcher;
+  int32_t use_transparent_background;
+};
+
+struct DistributedPass {
+  int32_t type;
+  int32_t mode;
+  int32_t include_albedo;
+  int32_t offset;
+  int32_t name_length;
+};
+
+static bool token_to_hello(const string &token, DistributedHello &hello)
+{
+  if (token.size() >= DISTRIBUTED_TOKEN_SIZE) {
+    return false;
+  }
+  memset(hello.token, 0, sizeof(hello.token));
+  memcpy(hello.token, token.data(), token.size());
+  return true;
+}
+
+/* Compare all bytes, so that the time taken does not tell how much of the token matched. */
+static bool hello_token_equals(const DistributedHello &a, const DistributedHello &b)
+{
+  int difference = 0;
+  for (int i = 0; i < DISTRIBUTED_TOKEN_SIZE; i++) {
+    difference |= a.token[i] ^ b.token[i];
+  }
+  return difference == 0;
+}
+
+static DistributedRegion region_from_assignment(const DistributedAssignment &assignment)
+{
+  DistributedRegion region;
+  region.full_width = assignment.full_width;
+  region.full_height = assignment.full_height;
+  region.x = assignment.x;
+  region.y = assignment.y;
+  region.width = assignment.width;
+  region.height = assignment.height;
+  region.num_samples = assignment.num_samples;
+  return region;
+}
+
+bool distributed_assignment_is_valid(const DistributedAssignment &assignment)
+{
+  return assignment.full_width > 0 && assignment.full_height > 0 &&
+         assignment.full_width <= DISTRIBUTED_MAX_RESOLUTION &&
+         assignment.full_height <= DISTRIBUTED_MAX_RESOLUTION && assignment.x >= 0 &&
+         assignment.y >= 0 && assignment.width > 0 && assignment.height > 0 &&
+         assignment.width <= assignment.full_width - assignment.x &&
+         assignment.height <= assignment.full_height - assignment.y &&
+         assignment.num_samples > 0;
+}
+
+vector<DistributedAssignment> distributed_split_frame(const int full_width,
+                                                      const int full_height,
+                                                      const int num_samples,
+                                                      const int num_workers)
+{
+  vector<DistributedAssignment> assignments;
+
+  const int num_regions = min(num_workers, full_height);
+  for (int i = 0; i < num_regions; i++) {
+    const int64_t begin = (int64_t)full_height * i / num_regions;
+    const int64_t end = (int64_t)full_height * (i + 1) / num_regions;
+
+    DistributedAssignment assignment;
+    assignment.full_width = full_width;
+    assignment.full_height = full_height;
+    assignment.x = 0;
+    assignment.y = (int)begin;
+    assignment.width = full_width;
+    assignment.height = (int)(end - begin);
+    assignment.num_samples = num_samples;
+
+    assignments.push_back(assignment);
+  }
+
+  return assignments;
+}
+
+/* --------------------------------------------------------------------
+ * Connection.
+ */
+
+DistributedConnection::DistributedConnection(int socket) : socket_(socket)
+{
+}
+
+DistributedConnection::~DistributedConnection()
+{
+  close();
+}
+
+DistributedConnection::DistributedConnection(DistributedConnection &&other) noexcept
+    : socket_(other.socket_), deadline_(other.deadline_), is_timed_out_(other.is_timed_out_)
+{
+  other.socket_ = -1;
+}
+
+DistributedConnection &DistributedConnection::operator=(DistributedConnection &&other) noexcept
+{
+  if (this != &other) {
+    close();
+    socket_ = other.socket_;
+    deadline_ = other.deadline_;
+    is_timed_out_ = other.is_timed_out_;
+    other.socket_ = -1;
+  }
+  return *this;
+}
+
+bool DistributedConnection::is_open() const
+{
+  return socket_ != -1;
+}
+
+void DistributedConnection::close()
+{
+#ifndef _WIN32
+  if (socket_ != -1) {
+    ::close(socket_);
+  }
+#endif
+  socket_ = -1;
+}
+
+void DistributedConnection::set_deadline(const double deadline)
+{
+#ifndef _WIN32
+  if (deadline == 0.0 && deadline_ != 0.0 && socket_ != -1) {
+    struct timeval no_timeout = {0, 0};
+    setsockopt(socket_, SOL_SOCKET, SO_RCVTIMEO, &no_timeout, sizeof(no_timeout));
+  }
+#endif
+  deadline_ = deadline;
+}
+
+bool DistributedConnection::is_timed_out() const
+{
+  return is_timed_out_;
+}
+
+bool DistributedConnection::send(const void *data, size_t size)
+{
+#ifndef _WIN32
+#  ifdef MSG_NOSIGNAL
+  const int flags = MSG_NOSIGNAL;
+#  else
+  const int flags = 0;
+#  endif
+
+  const char *ptr = static_cast<const char *>(data);
+  while (size > 0) {
+    const ssize_t num_sent = ::send(socket_, ptr, size, flags);
+    if (num_sent < 0 && errno == EINTR) {
+      continue;
+    }
+    if (num_sent <= 0) {
+      return false;
+    }
+    ptr += num_sent;
+    size -= num_sent;
+  }
+  return true;
+#else
+  (void)data;
+  (void)size;
+  return false;
+#endif
+}
+
+bool DistributedConnection::recv(void *data, size_t size)
+{
+#ifndef _WIN32
+  char *ptr = static_cast<char *>(data);
+  is_timed_out_ = false;
+  while (size > 0) {
+    if (deadline_ != 0.0) {
+      /* Bound every blocking call by the time left, a peer sending data slowly can not extend
+       * the deadline either. */
+      const double remaining = deadline_ - time_dt();
+      if (remaining <= 0.0) {
+        is_timed_out_ = true;
+        return false;
+      }
+      struct timeval timeout;
+      timeout.tv_sec = (time_t)remaining;
+      timeout.tv_usec = (suseconds_t)min((remaining - (double)timeout.tv_sec) * 1e6 + 1.0,
+                                         999999.0);
+      setsockopt(socket_, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    }
+
+    const ssize_t num_received = ::recv(socket_, ptr, size, 0);
+    if (num_received < 0 &&
+        (errno == EINTR || (deadline_ != 0.0 && (errno == EAGAIN || errno == EWOULDBLOCK)))) {
+      continue;
+    }
+    if (num_received <= 0) {
+      return false;
+    }
+    ptr += num_received;
+    size -= num_received;
+  }
+  return true;
+#else
+  (void)data;
+  (void)size;
+  return false;
+#endif
+}
+
+/* --------------------------------------------------------------------
+ * Coordinator.
+ */
+
+DistributedCoordinator::DistributedCoordinator()
+{
+}
+
+DistributedCoordinator::~DistributedCoordinator()
+{
+#ifndef _WIN32
+  if (socket_ != -1) {
+    ::close(socket_);
+  }
+#endif
+}
+
+bool DistributedCoordinator::listen(int port, const string &address, const string &token)
+{
+#ifndef _WIN32
+  DistributedHello hello;
+  if (!token_to_hello(token, hello)) {
+    return set_error(string_printf("Token is longer than %d characters",
+                                   DISTRIBUTED_TOKEN_SIZE - 1));
+  }
+  token_ = token;
+
+  struct in_addr bind_address;
+  if (inet_pton(AF_INET, address.c_str(), &bind_address) != 1) {
+    return set_error(string_printf("Invalid address to listen on: %s", address.c_str()));
+  }
+
+  /* Anyone who can connect gets to read the scene as rendered pixels and to inject pixels into
+   * the result, so only accept connections from the local host unless a token is used. */
+  const bool is_loopback = (ntohl(bind_address.s_addr) >> 24) == 127;
+  if (!is_loopback && token.empty()) {
+    return set_error(
+        string_printf("A token is required to listen for workers on %s", address.c_str()));
+  }
+
+  socket_ = ::socket(AF_INET, SOCK_STREAM, 0);
+  if (socket_ == -1) {
+    return set_error(string_printf("Error creating socket: %s", strerror(errno)));
+  }
+
+  const int reuse = 1;
+  setsockopt(socket_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+  struct sockaddr_in socket_address;
+  memset(&socket_address, 0, sizeof(socket_address));
+  socket_address.sin_family = AF_INET;
+  socket_address.sin_addr = bind_address;
+  socket_address.sin_port = htons(port);
+
+  if (::bind(socket_, (struct sockaddr *)&socket_address, sizeof(socket_address)) != 0) {
+    return set_error(string_printf("Error binding port %d: %s", port, strerror(errno)));
+  }
+
+  if (::listen(socket_, SOMAXCONN) != 0) {
+    return set_error(string_printf("Error listening on port %d: %s", port, strerror(errno)));
+  }
+
+  socklen_t address_len = sizeof(socket_address);
+  if (getsockname(socket_, (struct sockaddr *)&socket_address, &address_len) != 0) {
+    return set_error(string_printf("Error querying socket: %s", strerror(errno)));
+  }
+  port_ = ntohs(socket_address.sin_port);
+
+  VLOG(1) << "Distributed coordinator listening on " << address << ":" << port_;
+
+  return true;
+#else
+  (void)port;
+  (void)address;
+  (void)token;
+  return set_error("Distributed rendering is not supported on this platform");
+#endif
+}
+
+int DistributedCoordinator::get_port() const
+{
+  return port_;
+}
+
+void DistributedCoordinator::set_timeout(const double timeout)
+{
+  timeout_ = timeout;
+}
+
+bool DistributedCoordinator::render(const int full_width,
+                                    const int full_height,
+                                    const int num_samples,
+                                    const int num_workers,
+                                    RenderBuffers *buffers)
+{
+#ifndef _WIN32
+  const vector<DistributedAssignment> assignments = distributed_split_frame(
+      full_width, full_height, num_samples, num_workers);
+  if (assignments.size() != (size_t)num_workers) {
+    return set_error(string_printf(
+        "Can not split frame of %d rows between %d workers", full_height, num_workers));
+  }
+
+  DistributedHello expected_hello;
+  expected_hello.magic = DISTRIBUTED_MAGIC;
+  token_to_hello(token_, expected_hello);
+
+  const double start_time = time_dt();
+  const double deadline = (timeout_ > 0.0) ? start_time + timeout_ : 0.0;
+  const double accept_timeout = (timeout_ > 0.0) ? min(timeout_, DISTRIBUTED_ACCEPT_TIMEOUT) :
+                                                   DISTRIBUTED_ACCEPT_TIMEOUT;
+  const double accept_deadline = start_time + accept_timeout;
+
+  /* Hand out the work as soon as workers connect, so that they render while the others are still
+   * starting up. Anything else connecting to the port is dropped without giving up on the
+   * workers. */
+  vector<DistributedConnection> connections;
+  while (connections.size() < assignments.size()) {
+    const double remaining = accept_deadline - time_dt();
+    if (remaining <= 0.0) {
+      return set_error(string_printf("Only %d of %d workers connected within %.0f seconds",
+                                     (int)connections.size(),
+                                     num_workers,
+                                     accept_timeout));
+    }
+
+    struct pollfd listen_poll;
+    listen_poll.fd = socket_;
+    listen_poll.events = POLLIN;
+    listen_poll.revents = 0;
+    const int num_ready = ::poll(&listen_poll, 1, (int)(remaining * 1000.0) + 1);
+    if (num_ready == 0 || (num_ready < 0 && errno == EINTR)) {
+      continue;
+    }
+    if (num_ready < 0) {
+      return set_error(string_printf("Error waiting for workers: %s", strerror(errno)));
+    }
+
+    const int socket = ::accept(socket_, nullptr, nullptr);
+    if (socket == -1) {
+      if (errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      }
+      return set_error(string_printf("Error accepting worker: %s", strerror(errno)));
+    }
+
+    DistributedConnection connection(socket);
+    const double handshake_deadline = time_dt() + DISTRIBUTED_HANDSHAKE_TIMEOUT;
+    connection.set_deadline((deadline != 0.0) ? min(deadline, handshake_deadline) :
+                                                handshake_deadline);
+
+    DistributedHello hello;
+    if (!connection.recv(&hello, sizeof(hello))) {
+      LOG(WARNING) << "Dropped connection which did not complete the handshake";
+      continue;
+    }
+    if (hello.magic != DISTRIBUTED_MAGIC) {
+      LOG(WARNING) << "Dropped connection of an incompatible worker";
+      continue;
+    }
+    if (!hello_token_equals(hello, expected_hello)) {
+      LOG(WARNING) << "Dropped connection of a worker with a wrong token";
+      continue;
+    }
+
+    const DistributedAssignment &assignment = assignments[connections.size()];
+    const DistributedRegion region = region_from_assignment(assignment);
+    if (!connection.send(&region, sizeof(region))) {
+      LOG(WARNING) << "Dropped connection of a worker which did not accept its region";
+      continue;
+    }
+
+    VLOG(2) << "Assigned rows " << assignment.y << " to " << assignment.y + assignment.height
+            << " to worker " << connections.size();
+
+    connection.set_deadline(deadline);
+    connections.push_back(std::move(connection));
+  }
+
+  /* Workers only write to their connection from now on, so receiving results in order does not
+   * stall the ones finishing earlier for longer than the slowest worker takes. */
+  for (int i = 0; i < num_workers; i++) {
+    if (!receive_result(connections[i], assignments[i], i == 0, buffers)) {
+      return false;
+    }
+  }
+
+  buffers->copy_to_device();
+
+  return true;
+#else
+  (void)full_width;
+  (void)full_height;
+  (void)num_samples;
+  (void)num_workers;
+  (void)buffers;
+  return set_error("Distributed rendering is not supported on this platform");
+#endif
+}
+
+bool DistributedCoordinator::receive_result(DistributedConnection &connection,
+                                            const DistributedAssignment &assignment,
+                                            const bool is_first,
+                                            RenderBuffers *buffers)
+{
+  DistributedResult result;
+  if (!connection.recv(&result, sizeof(result))) {
+    return set_receive_error(connection, "result");
+  }
+
+  if (result.x != assignment.x || result.y != assignment.y ||
+      result.width != assignment.width || result.height != assignment.height) {
+    return set_error("Worker returned result for a different region");
+  }
+
+  if (result.num_passes <= 0 || result.num_passes > DISTRIBUTED_MAX_PASSES ||
+      result.pass_stride <= 0 || result.pass_stride > DISTRIBUTED_MAX_PASS_STRIDE) {
+    return set_error("Worker returned invalid passes");
+  }
+
+  BufferParams params;
+  params.width = assignment.full_width;
+  params.height = assignment.full_height;
+  params.full_x = 0;
+  params.full_y = 0;
+  params.full_width = assignment.full_width;
+  params.full_height = assignment.full_height;
+  params.samples = result.samples;
+  params.exposure = result.exposure;
+  params.use_approximate_shadow_catcher = result.use_approximate_shadow_catcher != 0;
+  params.use_transparent_background = result.use_transparent_background != 0;
+
+  for (int i = 0; i < result.num_passes; i++) {
+    DistributedPass pass_message;
+    if (!connection.recv(&pass_message, sizeof(pass_message))) {
+      return set_receive_error(connection, "passes");
+    }
+
+    if (pass_message.type < 0 || pass_message.type >= PASS_NUM || pass_message.mode < 0 ||
+        pass_message.mode > static_cast<int>(PassMode::DENOISED) ||
+        pass_message.offset >= result.pass_stride || pass_message.name_length < 0 ||
+        pass_message.name_length > DISTRIBUTED_MAX_PASS_NAME_LENGTH) {
+      return set_error("Worker returned invalid passes");
+    }
+
+    string name(pass_message.name_length, '\0');
+    if (pass_message.name_length && !connection.recv(&name[0], pass_message.name_length)) {
+      return set_receive_error(connection, "passes");
+    }
+
+    BufferPass pass;
+    pass.type = static_cast<PassType>(pass_message.type);
+    pass.mode = static_cast<PassMode>(pass_message.mode);
+    pass.name = ustring(name);
+    pass.include_albedo = pass_message.include_albedo != 0;
+    pass.offset = pass_message.offset;
+    params.passes.push_back(pass);
+  }
+
+  params.update_passes();
+  if (params.pass_stride != result.pass_stride) {
+    return set_error("Worker returned invalid passes");
+  }
+
+  /* All regions are to be rendered with the same passes and number of samples, otherwise they
+   * can not be combined into one frame. */
+  if (is_first) {
+    buffers->reset(params);
+    buffers->zero();
+  }
+  else if (params.passes != buffers->params.passes || params.samples != buffers->params.samples) {
+    return set_error("Workers rendered different passes or number of samples");
+  }
+
+  const int pass_stride = params.pass_stride;
+  const size_t row_size = (size_t)assignment.width * pass_stride;
+  for (int y = 0; y < assignment.height; y++) {
+    float *row = buffers->buffer.data() +
+                 ((size_t)(assignment.y + y) * assignment.full_width + assignment.x) *
+                     pass_stride;
+    if (!connection.recv(row, row_size * sizeof(float))) {
+      return set_receive_error(connection, "render buffers");
+    }
+  }
+
+  connection.close();
+
+  return true;
+}
+
+const string &DistributedCoordinator::get_error() const
+{
+  return error_;
+}
+
+bool DistributedCoordinator::set_error(const string &error)
+{
+  LOG(ERROR) << error;
+  error_ = error;
+  return false;
+}
+
+bool DistributedCoordinator::set_receive_error(const DistributedConnection &connection,
+                                               const char *what)
+{
+  if (connection.is_timed_out()) {
+    return set_error(
+        string_printf("Worker did not send its %s within %.0f seconds", what, timeout_));
+  }
+  return set_error(string_printf("Error receiving %s from worker", what));
+}
+
+/* --------------------------------------------------------------------
+ * Worker.
+ */
+
+bool DistributedWorker::connect(const string &host, int port, const string &token)
+{
+#ifndef _WIN32
+  DistributedHello hello;
+  hello.magic = DISTRIBUTED_MAGIC;
+  if (!token_to_hello(token, hello)) {
+    return set_error(string_printf("Token is longer than %d characters",
+                                   DISTRIBUTED_TOKEN_SIZE - 1));
+  }
+
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+
+  struct addrinfo *addresses = nullptr;
+  const string port_str = string_printf("%d", port);
+  const int status = getaddrinfo(host.c_str(), port_str.c_str(), &hints, &addresses);
+  if (status != 0) {
+    return set_error(
+        string_printf("Error resolving %s: %s", host.c_str(), gai_strerror(status)));
+  }
+
+  const double start_time = time_dt();
+  while (!connection_.is_open()) {
+    for (struct addrinfo *address = addresses; address; address = address->ai_next) {
+      const int socket = ::socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+      if (socket == -1) {
+        continue;
+      }
+      if (::connect(socket, address->ai_addr, address->ai_addrlen) == 0) {
+        connection_ = DistributedConnection(socket);
+        break;
+      }
+      ::close(socket);
+    }
+
+    if (!connection_.is_open()) {
+      if (time_dt() - start_time > DISTRIBUTED_CONNECT_TIMEOUT) {
+        break;
+      }
+      time_sleep(0.1);
+    }
+  }
+
+  freeaddrinfo(addresses);
+
+  if (!connection_.is_open()) {
+    return set_error(string_printf("Error connecting to %s:%d", host.c_str(), port));
+  }
+
+  if (!connection_.send(&hello, sizeof(hello))) {
+    return set_error("Error sending handshake to coordinator");
+  }
+
+  return true;
+#else
+  (void)host;
+  (void)port;
+  (void)token;
+  return set_error("Distributed rendering is not supported on this platform");
+#endif
+}
+
+bool DistributedWorker::receive_assignment(DistributedAssignment &assignment)
+{
+  DistributedRegion region;
+  if (!connection_.recv(&region, sizeof(region))) {
+    return set_error("Error receiving region from coordinator");
+  }
+
+  assignment.full_width = region.full_width;
+  assignment.full_height = region.full_height;
+  assignment.x = region.x;
+  assignment.y = region.y;
+  assignment.width = region.width;
+  assignment.height = region.height;
+  assignment.num_samples = region.num_samples;
+
+  if (!distributed_assignment_is_valid(assignment)) {
+    return set_error("Received invalid region from coordinator");
+  }
+
+  return true;
+}
+
+bool DistributedWorker::send_result(const DistributedAssignment &assignment,
+                                    const RenderBuffers *buffers)
+{
+  const BufferParams &params = buffers->params;
+  if (params.width != assignment.width || params.height != assignment.height) {
+    return set_error("Render buffers do not match the assigned region");
+  }
+
+  DistributedResult result;
+  result.x = assignment.x;
+  result.y = assignment.y;
+  result.width = assignment.width;
+  result.height = assignment.height;
+  result.samples = params.samples;
+  result.num_passes = params.passes.size();
+  result.pass_stride = params.pass_stride;
+  result.exposure = params.exposure;
+  result.use_approximate_shadow_catcher = params.use_approximate_shadow_catcher;
+  result.use_transparent_background = params.use_transparent_background;
+
+  if (!connection_.send(&result, sizeof(result))) {
+    return set_error("Error sending result to coordinator");
+  }
+
+  for (const BufferPass &pass : params.passes) {
+    DistributedPass pass_message;
+    pass_message.type = pass.type;
+    pass_message.mode = static_cast<int>(pass.mode);
+    pass_message.include_albedo = pass.include_albedo;
+    pass_message.offset = pass.offset;
+    pass_message.name_length = pass.name.size();
+
+    if (!connection_.send(&pass_message, sizeof(pass_message)) ||
+        !connection_.send(pass.name.c_str(), pass.name.size())) {
+      return set_error("Error sending result to coordinator");
+    }
+  }
+
+  const size_t size = (size_t)assignment.width * assignment.height * params.pass_stride *
+                      sizeof(float);
+  if (!connection_.send(buffers->buffer.data(), size)) {
+    return set_error("Error sending result to coordinator");
+  }
+
+  connection_.close();
+
+  return true;
+}
+
+const string &DistributedWorker::get_error() const
+{
+  return error_;
+}
+
+bool DistributedWorker::set_error(const string &error)
+{
+  LOG(ERROR) << error;
+  error_ = error;
+  return false;
+}
+
+/* --------------------------------------------------------------------
+ * Result.
+ */
+
+bool distributed_get_render_pixels(const RenderBuffers *buffers,
+                                   const string &pass_name,
+                                   const int num_components,
+                                   float *pixels)
+{
+  const BufferParams &buffer_params = buffers->params;
+
+  const BufferPass *pass = buffer_params.find_pass(pass_name);
+  if (pass == nullptr) {
+    return false;
+  }
+
+  /* Merged buffers are not denoised. */
+  if (pass->mode == PassMode::DENOISED) {
+    pass = buffer_params.find_pass(pass->type);
+    if (pass == nullptr) {
+      return false;
+    }
+  }
+
+  pass = buffer_params.get_actual_display_pass(pass);
+
+  PassAccessor::PassAccessInfo pass_access_info(*pass);
+  pass_access_info.use_approximate_shadow_catcher = buffer_params.use_approximate_shadow_catcher;
+  pass_access_info.use_approximate_shadow_catcher_background =
+      pass_access_info.use_approximate_shadow_catcher && !buffer_params.use_transparent_background;
+
+  const PassAccessorCPU pass_accessor(
+      pass_access_info, buffer_params.exposure, buffer_params.samples);
+  const PassAccessor::Destination destination(pixels, num_components);
+
+  return pass_accessor.get_render_tile_pixels(buffers, destination);
+}
+
+CCL_NAMESPACE_END
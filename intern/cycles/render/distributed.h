@@ -0,0 +1,164 @@
+/*
+ * Copyright 2011-2021 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "util/util_string.h"
+#include "util/util_vector.h"
+
+CCL_NAMESPACE_BEGIN
+
+class RenderBuffers;
+
+/* Distributed rendering of a single frame.
+ *
+ * The coordinator listens on a TCP port, and every worker process which connects to it gets a
+ * region of the frame assigned. The worker renders its region and sends the render buffers with
+ * all passes back, where they are merged into render buffers of the full frame.
+ *
+ * The coordinator only listens on the loopback interface unless a token is given, which workers
+ * then need to present. The token is sent as plain text, so it only protects against accidental
+ * connections on a trusted network.
+ *
+ * Messages are sent in the native byte order, so all processes are to run on hosts of the same
+ * architecture. */
+
+/* Region of the full frame rendered by a single worker. */
+class DistributedAssignment {
+ public:
+  int full_width = 0;
+  int full_height = 0;
+
+  int x = 0;
+  int y = 0;
+  int width = 0;
+  int height = 0;
+
+  int num_samples = 0;
+};
+
+/* Check that the region lies within the full frame and that all sizes are sensible, so that it
+ * can be used for buffers allocation. */
+bool distributed_assignment_is_valid(const DistributedAssignment &assignment);
+
+/* Split frame of the given resolution into bands of rows, one per worker. If there are more
+ * workers than rows fewer regions are returned. */
+vector<DistributedAssignment> distributed_split_frame(int full_width,
+                                                      int full_height,
+                                                      int num_samples,
+                                                      int num_workers);
+
+/* Blocking stream connection between the coordinator and a worker. */
+class DistributedConnection {
+ public:
+  DistributedConnection() = default;
+  explicit DistributedConnection(int socket);
+  ~DistributedConnection();
+
+  DistributedConnection(const DistributedConnection &other) = delete;
+  DistributedConnection &operator=(const DistributedConnection &other) = delete;
+
+  DistributedConnection(DistributedConnection &&other) noexcept;
+  DistributedConnection &operator=(DistributedConnection &&other) noexcept;
+
+  bool is_open() const;
+  void close();
+
+  /* Make receiving fail once the given time_dt() passed, zero never times out. */
+  void set_deadline(double deadline);
+  /* Whether the last receive failed because the deadline passed. */
+  bool is_timed_out() const;
+
+  /* Send or receive exactly the given number of bytes. */
+  bool send(const void *data, size_t size);
+  bool recv(void *data, size_t size);
+
+ protected:
+  int socket_ = -1;
+  double deadline_ = 0.0;
+  bool is_timed_out_ = false;
+};
+
+class DistributedCoordinator {
+ public:
+  DistributedCoordinator();
+  ~DistributedCoordinator();
+
+  /* Start listening for workers on the given IPv4 address. Port 0 picks any free port, use
+   * get_port() to query it. Listening on an address other than loopback requires a token. */
+  bool listen(int port, const string &address = "127.0.0.1", const string &token = "");
+  int get_port() const;
+
+  /* Time in seconds render() may take in total, zero waits for the results forever. Workers
+   * always need to connect within a limited time. */
+  void set_timeout(double timeout);
+
+  /* Accept the given number of workers, assign each of them a region of the frame and merge the
+   * results into the full-frame buffers, which are reset to the passes rendered by the workers.
+   * Connections which fail the handshake are dropped. Blocks until all regions have been
+   * received, fails when workers are missing after the timeout. */
+  bool render(int full_width,
+              int full_height,
+              int num_samples,
+              int num_workers,
+              RenderBuffers *buffers);
+
+  const string &get_error() const;
+
+ protected:
+  bool receive_result(DistributedConnection &connection,
+                      const DistributedAssignment &assignment,
+                      bool is_first,
+                      RenderBuffers *buffers);
+
+  bool set_error(const string &error);
+  bool set_receive_error(const DistributedConnection &connection, const char *what);
+
+  int socket_ = -1;
+  int port_ = 0;
+  string token_;
+  double timeout_ = 0.0;
+  string error_;
+};
+
+class DistributedWorker {
+ public:
+  /* Connect to the coordinator, retrying for a while in case it did not start listening yet. */
+  bool connect(const string &host, int port, const string &token = "");
+
+  /* Receive the region to render. Fails for regions which are not valid. */
+  bool receive_assignment(DistributedAssignment &assignment);
+
+  /* Send the render buffers of the assigned region, with all their passes. */
+  bool send_result(const DistributedAssignment &assignment, const RenderBuffers *buffers);
+
+  const string &get_error() const;
+
+ protected:
+  bool set_error(const string &error);
+
+  DistributedConnection connection_;
+  string error_;
+};
+
+/* Get pixels of the named pass from the merged render buffers, in the same way as
+ * Session::get_render_tile_pixels() does for the buffers of a session. */
+bool distributed_get_render_pixels(const RenderBuffers *buffers,
+                                   const string &pass_name,
+                                   int num_components,
+                                   float *pixels);
+
+CCL_NAMESPACE_END
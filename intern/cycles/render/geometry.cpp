@@ -39,8 +39,11 @@
 
 #include "util/util_foreach.h"
 #include "util/util_logging.h"
+#include "util/util_map.h"
 #include "util/util_progress.h"
+#include "util/util_string.h"
 #include "util/util_task.h"
+#include "util/util_tbb.h"
 
 CCL_NAMESPACE_BEGIN
 
@@ -244,6 +247,7 @@ void Geometry::compute_bvh(
       bparams.bvh_layout = bvh_layout;
       bparams.use_unaligned_nodes = dscene->data.bvh.have_curves &&
                                     params->use_bvh_unaligned_nodes;
+      bparams.use_compressed_nodes = params->use_bvh_compressed_nodes;
       bparams.num_motion_triangle_steps = params->num_bvh_time_steps;
       bparams.num_motion_curve_steps = params->num_bvh_time_steps;
       bparams.bvh_type = params->bvh_type;
@@ -275,6 +279,233 @@ bool Geometry::has_voxel_attributes() const
   return false;
 }
 
+/* Deduplication */
+
+namespace {
+
+/* 64-bit FNV-1a over 32-bit words. */
+class ContentHash {
+ public:
+  void add_words(const uint32_t *words, const size_t num_words)
+  {
+    for (size_t i = 0; i < num_words; i++) {
+      value = (value ^ words[i]) * 0x100000001b3ULL;
+    }
+  }
+
+  void add_bytes(const void *data, const size_t size)
+  {
+    const size_t num_words = size / sizeof(uint32_t);
+    add_words((const uint32_t *)data, num_words);
+
+    for (size_t i = num_words * sizeof(uint32_t); i < size; i++) {
+      value = (value ^ ((const uint8_t *)data)[i]) * 0x100000001b3ULL;
+    }
+  }
+
+  /* The 4th component of float3 is padding and can contain any value. */
+  void add_float3s(const float3 *data, const size_t num_elements)
+  {
+    for (size_t i = 0; i < num_elements; i++) {
+      add_words((const uint32_t *)&data[i], 3);
+    }
+  }
+
+  template<typename T> void add_array(const array<T> &a)
+  {
+    add_bytes(a.data(), a.size() * sizeof(T));
+  }
+
+  uint64_t value = 0xcbf29ce484222325ULL;
+};
+
+template<typename T> const T &socket_value(const Node *node, const SocketType &socket)
+{
+  return *(const T *)(((const char *)node) + socket.struct_offset);
+}
+
+bool attribute_is_float3(const Attribute &attr)
+{
+  return attr.element != ATTR_ELEMENT_VOXEL && attr.element != ATTR_ELEMENT_CORNER_BYTE &&
+         attr.data_sizeof() == sizeof(float3);
+}
+
+uint64_t attribute_hash(const Attribute &attr)
+{
+  ContentHash hash;
+  hash.add_bytes(&attr.name, sizeof(attr.name));
+  hash.add_bytes(&attr.std, sizeof(attr.std));
+  hash.add_bytes(&attr.element, sizeof(attr.element));
+  hash.add_bytes(&attr.type, sizeof(attr.type));
+
+  if (attribute_is_float3(attr)) {
+    hash.add_float3s(attr.data_float3(), attr.buffer.size() / sizeof(float3));
+  }
+  else {
+    hash.add_bytes(attr.buffer.data(), attr.buffer.size());
+  }
+
+  return hash.value;
+}
+
+/* Compare the components of float3 values, ignoring the padding the same way as the hash. */
+bool float3s_equal(const float3 *a, const float3 *b, const size_t num_elements)
+{
+  for (size_t i = 0; i < num_elements; i++) {
+    if (memcmp(&a[i], &b[i], sizeof(float) * 3) != 0) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool attribute_equals(const Attribute &a, const Attribute &b)
+{
+  if (a.std != b.std || a.element != b.element || a.type != b.type || a.flags != b.flags ||
+      a.buffer.size() != b.buffer.size()) {
+    return false;
+  }
+
+  if (attribute_is_float3(a)) {
+    return float3s_equal(a.data_float3(), b.data_float3(), a.buffer.size() / sizeof(float3));
+  }
+
+  return a.buffer.empty() || memcmp(a.buffer.data(), b.buffer.data(), a.buffer.size()) == 0;
+}
+
+}  // namespace
+
+bool Geometry::can_deduplicate() const
+{
+  if (!(is_mesh() || is_hair()) || transform_applied) {
+    return false;
+  }
+
+  /* Displacement and subdivision are evaluated for a single object, which might give different
+   * results for the objects which would share the geometry. */
+  if (has_true_displacement()) {
+    return false;
+  }
+
+  if (is_mesh() &&
+      static_cast<const Mesh *>(this)->get_subdivision_type() != Mesh::SUBDIVISION_NONE) {
+    return false;
+  }
+
+  return true;
+}
+
+uint64_t Geometry::content_hash() const
+{
+  ContentHash hash;
+  hash.add_bytes(&type, sizeof(type));
+
+  foreach (const SocketType &socket, type->inputs) {
+    switch (socket.type) {
+      case SocketType::COLOR:
+      case SocketType::VECTOR:
+      case SocketType::POINT:
+      case SocketType::NORMAL:
+        hash.add_float3s(&socket_value<float3>(this, socket), 1);
+        break;
+      case SocketType::BOOLEAN_ARRAY:
+        hash.add_array(socket_value<array<bool>>(this, socket));
+        break;
+      case SocketType::FLOAT_ARRAY:
+        hash.add_array(socket_value<array<float>>(this, socket));
+        break;
+      case SocketType::INT_ARRAY:
+        hash.add_array(socket_value<array<int>>(this, socket));
+        break;
+      case SocketType::COLOR_ARRAY:
+      case SocketType::VECTOR_ARRAY:
+      case SocketType::POINT_ARRAY:
+      case SocketType::NORMAL_ARRAY: {
+        const array<float3> &a = socket_value<array<float3>>(this, socket);
+        hash.add_float3s(a.data(), a.size());
+        break;
+      }
+      case SocketType::POINT2_ARRAY:
+        hash.add_array(socket_value<array<float2>>(this, socket));
+        break;
+      case SocketType::STRING_ARRAY:
+        hash.add_array(socket_value<array<ustring>>(this, socket));
+        break;
+      case SocketType::TRANSFORM_ARRAY:
+        hash.add_array(socket_value<array<Transform>>(this, socket));
+        break;
+      case SocketType::NODE_ARRAY:
+        hash.add_array(socket_value<array<Node *>>(this, socket));
+        break;
+      case SocketType::CLOSURE:
+      case SocketType::UNDEFINED:
+        break;
+      default:
+        hash.add_bytes(((const char *)this) + socket.struct_offset, socket.size());
+        break;
+    }
+  }
+
+  /* Combine attributes independent of their order. */
+  uint64_t attributes_hash = 0;
+  foreach (const Attribute &attr, attributes.attributes) {
+    attributes_hash += attribute_hash(attr);
+  }
+
+  return hash.value ^ attributes_hash;
+}
+
+bool Geometry::content_equals(const Geometry &other) const
+{
+  if (type != other.type) {
+    return false;
+  }
+
+  foreach (const SocketType &socket, type->inputs) {
+    switch (socket.type) {
+      case SocketType::COLOR:
+      case SocketType::VECTOR:
+      case SocketType::POINT:
+      case SocketType::NORMAL:
+        if (!float3s_equal(
+                &socket_value<float3>(this, socket), &socket_value<float3>(&other, socket), 1)) {
+          return false;
+        }
+        break;
+      case SocketType::COLOR_ARRAY:
+      case SocketType::VECTOR_ARRAY:
+      case SocketType::POINT_ARRAY:
+      case SocketType::NORMAL_ARRAY: {
+        const array<float3> &a = socket_value<array<float3>>(this, socket);
+        const array<float3> &b = socket_value<array<float3>>(&other, socket);
+        if (a.size() != b.size() || !float3s_equal(a.data(), b.data(), a.size())) {
+          return false;
+        }
+        break;
+      }
+      default:
+        if (!equals_value(other, socket)) {
+          return false;
+        }
+        break;
+    }
+  }
+
+  if (attributes.attributes.size() != other.attributes.attributes.size()) {
+    return false;
+  }
+
+  foreach (const Attribute &attr, attributes.attributes) {
+    const Attribute *other_attr = other.attributes.find(attr.name);
+    if (other_attr == nullptr || !attribute_equals(attr, *other_attr)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
 void Geometry::tag_update(Scene *scene, bool rebuild)
 {
   if (rebuild) {
@@ -309,6 +540,8 @@ GeometryManager::GeometryManager()
 {
   update_flags = UPDATE_ALL;
   need_flags_update = true;
+  num_deduplicated_geometry = 0;
+  deduplicated_geometry_size = 0;
 }
 
 GeometryManager::~GeometryManager()
@@ -1246,6 +1479,7 @@ void GeometryManager::device_update_bvh(Device *device,
   bparams.use_spatial_split = scene->params.use_bvh_spatial_split;
   bparams.use_unaligned_nodes = dscene->data.bvh.have_curves &&
                                 scene->params.use_bvh_unaligned_nodes;
+  bparams.use_compressed_nodes = scene->params.use_bvh_compressed_nodes;
   bparams.num_motion_triangle_steps = scene->params.num_bvh_time_steps;
   bparams.num_motion_curve_steps = scene->params.num_bvh_time_steps;
   bparams.bvh_type = scene->params.bvh_type;
@@ -1282,6 +1516,11 @@ void GeometryManager::device_update_bvh(Device *device,
   PackedBVH pack;
   if (has_bvh2_layout) {
     pack = std::move(static_cast<BVH2 *>(bvh)->pack);
+
+    VLOG(1) << "BVH2 memory: inner nodes "
+            << string_human_readable_size(pack.nodes.size() * sizeof(int4)) << ", leaf nodes "
+            << string_human_readable_size(pack.leaf_nodes.size() * sizeof(int4))
+            << (bparams.use_compressed_nodes ? " (compressed)." : ".");
   }
   else {
     progress.set_status("Updating Scene BVH", "Packing BVH primitives");
@@ -1405,6 +1644,8 @@ void GeometryManager::device_update_bvh(Device *device,
   }
 
   dscene->data.bvh.root = pack.root_index;
+  dscene->data.bvh.use_compressed_nodes = (bparams.bvh_layout == BVH_LAYOUT_BVH2 &&
+                                           bparams.use_compressed_nodes);
   dscene->data.bvh.use_bvh_steps = (scene->params.num_bvh_time_steps != 0);
   dscene->data.bvh.curve_subdivisions = scene->params.curve_subdivisions();
   /* The scene handle is set in 'CPUDevice::const_copy_to' and 'OptiXDevice::const_copy_to' */
@@ -2170,12 +2411,93 @@ bool GeometryManager::need_update() const
   return update_flags != UPDATE_NONE;
 }
 
+set<Geometry *> GeometryManager::deduplicate(Scene *scene, const set<Geometry *> &geometry)
+{
+  scoped_callback_timer timer([scene](double time) {
+    if (scene->update_stats) {
+      scene->update_stats->geometry.times.add_entry({"deduplicate", time});
+    }
+  });
+
+  /* Follow the scene order, so that the same geometry is kept between runs. */
+  vector<Geometry *> candidates;
+  foreach (Geometry *geom, scene->geometry) {
+    if (geometry.find(geom) != geometry.end() && geom->can_deduplicate()) {
+      candidates.push_back(geom);
+    }
+  }
+
+  vector<uint64_t> hashes(candidates.size());
+  parallel_for(size_t(0), candidates.size(), [&](size_t i) {
+    hashes[i] = candidates[i]->content_hash();
+  });
+
+  unordered_map<uint64_t, vector<Geometry *>> unique_geometry;
+  map<Geometry *, Geometry *> duplicate_of;
+
+  for (size_t i = 0; i < candidates.size(); i++) {
+    Geometry *geom = candidates[i];
+    vector<Geometry *> &same_hash = unique_geometry[hashes[i]];
+
+    Geometry *original = nullptr;
+    foreach (Geometry *other, same_hash) {
+      if (geom->content_equals(*other)) {
+        original = other;
+        break;
+      }
+    }
+
+    if (original) {
+      duplicate_of[geom] = original;
+    }
+    else {
+      same_hash.push_back(geom);
+    }
+  }
+
+  num_deduplicated_geometry = 0;
+  deduplicated_geometry_size = 0;
+
+  if (duplicate_of.empty()) {
+    return set<Geometry *>();
+  }
+
+  foreach (Object *object, scene->objects) {
+    map<Geometry *, Geometry *>::const_iterator it = duplicate_of.find(object->get_geometry());
+    if (it != duplicate_of.end()) {
+      object->set_geometry(it->second);
+    }
+  }
+
+  set<Geometry *> duplicates;
+  for (const auto &it : duplicate_of) {
+    Geometry *geom = it.first;
+
+    size_t size = geom->get_total_size_in_bytes();
+    foreach (const Attribute &attr, geom->attributes.attributes) {
+      size += attr.buffer.size();
+    }
+
+    num_deduplicated_geometry++;
+    deduplicated_geometry_size += size;
+    duplicates.insert(geom);
+  }
+
+  VLOG(1) << "Deduplicated " << num_deduplicated_geometry << " geometries, saving "
+          << string_human_readable_size(deduplicated_geometry_size) << ".";
+
+  return duplicates;
+}
+
 void GeometryManager::collect_statistics(const Scene *scene, RenderStats *stats)
 {
   foreach (Geometry *geometry, scene->geometry) {
     stats->mesh.geometry.add_entry(
         NamedSizeEntry(string(geometry->name.c_str()), geometry->get_total_size_in_bytes()));
   }
+
+  stats->mesh.num_deduplicated = num_deduplicated_geometry;
+  stats->mesh.deduplicated_size = deduplicated_geometry_size;
 }
 
 CCL_NAMESPACE_END
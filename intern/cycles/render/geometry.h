@@ -167,6 +167,15 @@ class Geometry : public Node {
   bool has_motion_blur() const;
   bool has_voxel_attributes() const;
 
+  /* Deduplication
+   *
+   * Geometry with identical data and attributes coming from different sources can be shared
+   * between objects through instancing. The hash is only used to find candidates, which are then
+   * compared exactly. */
+  bool can_deduplicate() const;
+  uint64_t content_hash() const;
+  bool content_equals(const Geometry &other) const;
+
   bool is_mesh() const
   {
     return geometry_type == MESH;
@@ -237,9 +246,18 @@ class GeometryManager {
 
   bool need_update() const;
 
+  /* Find geometry with identical content, make objects use a single copy of it and return the
+   * duplicates which are no longer used by any object. Only the given geometry is considered,
+   * the caller owns it and is responsible for deleting the returned duplicates. */
+  set<Geometry *> deduplicate(Scene *scene, const set<Geometry *> &geometry);
+
   /* Statistics */
   void collect_statistics(const Scene *scene, RenderStats *stats);
 
+  /* Number of duplicates found by the last deduplicate() call and the memory they used. */
+  int num_deduplicated_geometry;
+  size_t deduplicated_geometry_size;
+
  protected:
   bool displace(Device *device, DeviceScene *dscene, Scene *scene, Mesh *mesh, Progress &progress);
 
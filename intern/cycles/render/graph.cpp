@@ -676,6 +676,73 @@ void ShaderGraph::deduplicate_nodes()
   }
 }
 
+/* Fold mapping nodes with constant settings into the texture mapping of the texture nodes they
+ * are connected to. The texture mapping uses a transform computed once at compile time, while
+ * the mapping node builds it from Euler angles for every evaluation. Mapping nodes which are
+ * left without links are removed by the clean pass. */
+void ShaderGraph::fold_mapping_nodes()
+{
+  int num_folded = 0;
+
+  foreach (ShaderNode *node, nodes) {
+    if (node->type != MappingNode::get_node_type()) {
+      continue;
+    }
+
+    MappingNode *mapping = static_cast<MappingNode *>(node);
+    ShaderInput *vector_in = mapping->input("Vector");
+    ShaderOutput *vector_out = mapping->output("Vector");
+
+    if (!vector_in->link || mapping->input("Location")->link ||
+        mapping->input("Rotation")->link || mapping->input("Scale")->link) {
+      continue;
+    }
+
+    const float3 scale = mapping->get_scale();
+    TextureMapping::Type type;
+
+    if (mapping->get_mapping_type() == NODE_MAPPING_TYPE_POINT) {
+      type = TextureMapping::POINT;
+    }
+    else if (mapping->get_mapping_type() == NODE_MAPPING_TYPE_TEXTURE) {
+      /* The texture mapping clamps small scales to keep the matrix invertible, where the mapping
+       * node divides safely, only fold when both give the same result. */
+      if (fabsf(scale.x) < 1e-5f || fabsf(scale.y) < 1e-5f || fabsf(scale.z) < 1e-5f) {
+        continue;
+      }
+      type = TextureMapping::TEXTURE;
+    }
+    else {
+      continue;
+    }
+
+    /* Copy because disconnect modifies this list. */
+    vector<ShaderInput *> links(vector_out->links);
+
+    foreach (ShaderInput *to, links) {
+      TextureMapping *tex_mapping = to->parent->get_texture_mapping();
+
+      if (tex_mapping == NULL || to->name() != "Vector" || !tex_mapping->skip()) {
+        continue;
+      }
+
+      tex_mapping->type = type;
+      tex_mapping->translation = mapping->get_location();
+      tex_mapping->rotation = mapping->get_rotation();
+      tex_mapping->scale = scale;
+
+      disconnect(to);
+      connect(vector_in->link, to);
+
+      num_folded++;
+    }
+  }
+
+  if (num_folded > 0) {
+    VLOG(1) << "Folded " << num_folded << " mapping nodes into texture nodes.";
+  }
+}
+
 /* Check whether volume output has meaningful nodes, otherwise
  * disconnect the output.
  */
@@ -784,6 +851,7 @@ void ShaderGraph::clean(Scene *scene)
   constant_fold(scene);
   simplify_settings(scene);
   deduplicate_nodes();
+  fold_mapping_nodes();
   verify_volume_output();
 
   /* we do two things here: find cycles and break them, and remove unused
@@ -43,6 +43,7 @@ class OSLCompiler;
 class OutputNode;
 class ConstantFolder;
 class MD5Hash;
+class TextureMapping;
 
 /* Bump
  *
@@ -188,6 +189,13 @@ class ShaderNode : public Node {
    */
   virtual void simplify_settings(Scene * /*scene*/){};
 
+  /* Transform applied to the texture coordinate by the node itself, so that a preceding mapping
+   * node with constant settings can be folded into it. */
+  virtual TextureMapping *get_texture_mapping()
+  {
+    return NULL;
+  }
+
   virtual bool has_surface_emission()
   {
     return false;
@@ -377,6 +385,7 @@ class ShaderGraph : public NodeOwner {
   void constant_fold(Scene *scene);
   void simplify_settings(Scene *scene);
   void deduplicate_nodes();
+  void fold_mapping_nodes();
   void verify_volume_output();
 };
 
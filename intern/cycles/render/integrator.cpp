@@ -32,6 +32,7 @@
 #include "util/util_foreach.h"
 #include "util/util_hash.h"
 #include "util/util_logging.h"
+#include "util/util_string.h"
 #include "util/util_task.h"
 #include "util/util_time.h"
 
@@ -80,6 +81,10 @@ NODE_DEFINE(Integrator)
   sampling_pattern_enum.insert("sobol", SAMPLING_PATTERN_SOBOL);
   sampling_pattern_enum.insert("pmj", SAMPLING_PATTERN_PMJ);
   SOCKET_ENUM(sampling_pattern, "Sampling Pattern", sampling_pattern_enum, SAMPLING_PATTERN_SOBOL);
+  SOCKET_BOOLEAN(use_blue_noise, "Use Blue Noise", false);
+
+  SOCKET_BOOLEAN(use_guiding, "Use Path Guiding", false);
+  SOCKET_INT(guiding_training_samples, "Path Guiding Training Samples", 128);
 
   static NodeEnum denoiser_type_enum;
   denoiser_type_enum.insert("optix", DENOISER_OPTIX);
@@ -100,6 +105,7 @@ NODE_DEFINE(Integrator)
   SOCKET_BOOLEAN(use_denoise_pass_normal, "Use Normal Pass for Denoiser", true);
   SOCKET_ENUM(
       denoiser_prefilter, "Denoiser Type", denoiser_prefilter_enum, DENOISER_PREFILTER_ACCURATE);
+  SOCKET_INT(denoiser_memory_limit, "Denoiser Memory Limit", 0);
 
   return type;
 }
@@ -190,6 +196,7 @@ void Integrator::device_update(Device *device, DeviceScene *dscene, Scene *scene
                                            sample_clamp_indirect * 3.0f;
 
   kintegrator->sampling_pattern = new_sampling_pattern;
+  kintegrator->use_blue_noise = use_blue_noise;
 
   if (light_sampling_threshold > 0.0f) {
     kintegrator->light_inv_rr_threshold = 1.0f / light_sampling_threshold;
@@ -230,15 +237,82 @@ void Integrator::device_update(Device *device, DeviceScene *dscene, Scene *scene
     }
   }
 
+  /* The blue noise mask does not depend on any settings, so it is only generated once. */
+  if (use_blue_noise && dscene->sample_blue_noise.size() == 0) {
+    float *values = dscene->sample_blue_noise.alloc(BLUE_NOISE_SIZE * BLUE_NOISE_SIZE);
+    blue_noise_generate(values, BLUE_NOISE_SIZE, 0);
+    dscene->sample_blue_noise.copy_to_device();
+  }
+
   kintegrator->has_shadow_catcher = scene->has_shadow_catcher();
 
+  /* Path guiding is only implemented for the CPU kernels. */
+  kintegrator->use_guiding = (get_kernel_features(scene) & KERNEL_FEATURE_PATH_GUIDING) != 0;
+  kintegrator->guiding_training_samples = guiding_training_samples;
+
+  if (kintegrator->use_guiding) {
+    device_update_guiding(dscene, scene);
+  }
+
   dscene->sample_pattern_lut.clear_modified();
+  dscene->sample_blue_noise.clear_modified();
   clear_modified();
 }
 
+void Integrator::device_update_guiding(DeviceScene *dscene, Scene *scene)
+{
+  KernelIntegrator *kintegrator = &dscene->data.integrator;
+
+  BoundBox bounds = BoundBox::empty;
+  foreach (Object *object, scene->objects) {
+    if (object->bounds.valid()) {
+      bounds.grow(object->bounds);
+    }
+  }
+
+  if (!bounds.valid()) {
+    kintegrator->use_guiding = false;
+    return;
+  }
+
+  /* Cubic cells, with the longest side of the scene bounds split into the maximum number of
+   * cells. */
+  const float3 size = bounds.size();
+  const float cell_size = max(max3(size) / GUIDING_MAX_RESOLUTION, 1e-4f);
+  const int resolution_x = clamp((int)ceilf(size.x / cell_size), 1, GUIDING_MAX_RESOLUTION);
+  const int resolution_y = clamp((int)ceilf(size.y / cell_size), 1, GUIDING_MAX_RESOLUTION);
+  const int resolution_z = clamp((int)ceilf(size.z / cell_size), 1, GUIDING_MAX_RESOLUTION);
+  const int num_cells = resolution_x * resolution_y * resolution_z;
+
+  kintegrator->guiding_resolution_x = resolution_x;
+  kintegrator->guiding_resolution_y = resolution_y;
+  kintegrator->guiding_resolution_z = resolution_z;
+  kintegrator->guiding_bounds_min_x = bounds.min.x;
+  kintegrator->guiding_bounds_min_y = bounds.min.y;
+  kintegrator->guiding_bounds_min_z = bounds.min.z;
+  kintegrator->guiding_inv_cell_size = 1.0f / cell_size;
+
+  /* Both distribution and training data start empty, they are filled in during rendering. */
+  float *distribution = dscene->guiding_distribution.alloc(num_cells * GUIDING_DIRECTION_BINS);
+  memset(distribution, 0, dscene->guiding_distribution.memory_size());
+  dscene->guiding_distribution.copy_to_device();
+
+  float *training = dscene->guiding_training.alloc(num_cells * GUIDING_TRAINING_STRIDE);
+  memset(training, 0, dscene->guiding_training.memory_size());
+  dscene->guiding_training.copy_to_device();
+
+  VLOG(1) << "Path guiding grid resolution " << resolution_x << "x" << resolution_y << "x"
+          << resolution_z << ", "
+          << string_human_readable_size(dscene->guiding_distribution.memory_size() +
+                                        dscene->guiding_training.memory_size());
+}
+
 void Integrator::device_free(Device *, DeviceScene *dscene, bool force_free)
 {
   dscene->sample_pattern_lut.free_if_need_realloc(force_free);
+  dscene->sample_blue_noise.free_if_need_realloc(force_free);
+  dscene->guiding_distribution.free();
+  dscene->guiding_training.free();
 }
 
 void Integrator::tag_update(Scene *scene, uint32_t flag)
@@ -268,6 +342,15 @@ void Integrator::tag_update(Scene *scene, uint32_t flag)
   }
 }
 
+uint Integrator::get_kernel_features(const Scene *scene) const
+{
+  if (use_guiding && scene->device->info.type == DEVICE_CPU) {
+    return KERNEL_FEATURE_PATH_GUIDING;
+  }
+
+  return 0;
+}
+
 AdaptiveSampling Integrator::get_adaptive_sampling() const
 {
   AdaptiveSampling adaptive_sampling;
@@ -311,6 +394,16 @@ AdaptiveSampling Integrator::get_adaptive_sampling() const
   return adaptive_sampling;
 }
 
+PathGuiding Integrator::get_path_guiding() const
+{
+  PathGuiding path_guiding;
+
+  path_guiding.use = use_guiding;
+  path_guiding.training_samples = max(guiding_training_samples, 1);
+
+  return path_guiding;
+}
+
 DenoiseParams Integrator::get_denoise_params() const
 {
   DenoiseParams denoise_params;
@@ -326,6 +419,8 @@ DenoiseParams Integrator::get_denoise_params() const
 
   denoise_params.prefilter = denoiser_prefilter;
 
+  denoise_params.memory_limit = denoiser_memory_limit;
+
   return denoise_params;
 }
 
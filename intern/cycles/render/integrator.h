@@ -22,6 +22,7 @@
 #include "device/device_denoise.h" /* For the parameters and type enum. */
 #include "graph/node.h"
 #include "integrator/adaptive_sampling.h"
+#include "integrator/path_guiding.h"
 
 CCL_NAMESPACE_BEGIN
 
@@ -75,6 +76,10 @@ class Integrator : public Node {
   NODE_SOCKET_API(float, adaptive_threshold)
 
   NODE_SOCKET_API(SamplingPattern, sampling_pattern)
+  NODE_SOCKET_API(bool, use_blue_noise)
+
+  NODE_SOCKET_API(bool, use_guiding)
+  NODE_SOCKET_API(int, guiding_training_samples)
 
   NODE_SOCKET_API(bool, use_denoise);
   NODE_SOCKET_API(DenoiserType, denoiser_type);
@@ -82,6 +87,7 @@ class Integrator : public Node {
   NODE_SOCKET_API(bool, use_denoise_pass_albedo);
   NODE_SOCKET_API(bool, use_denoise_pass_normal);
   NODE_SOCKET_API(DenoiserPrefilter, denoiser_prefilter);
+  NODE_SOCKET_API(int, denoiser_memory_limit);
 
   enum : uint32_t {
     AO_PASS_MODIFIED = (1 << 0),
@@ -101,8 +107,14 @@ class Integrator : public Node {
 
   void tag_update(Scene *scene, uint32_t flag);
 
+  uint get_kernel_features(const Scene *scene) const;
+
   AdaptiveSampling get_adaptive_sampling() const;
+  PathGuiding get_path_guiding() const;
   DenoiseParams get_denoise_params() const;
+
+ protected:
+  void device_update_guiding(DeviceScene *dscene, Scene *scene);
 };
 
 CCL_NAMESPACE_END
@@ -25,6 +25,7 @@
 
 #include "render/jitter.h"
 
+#include <algorithm>
 #include <math.h>
 #include <vector>
 
@@ -278,4 +279,123 @@ void progressive_multi_jitter_02_generate_2D(float2 points[], int size, int rng_
   shuffle(points, size, rng_seed);
 }
 
+/* Blue noise mask using the void-and-cluster method from "The void-and-cluster method for dither
+ * array generation" by Robert Ulichney. Distances are toroidal so the mask can be tiled. */
+class BlueNoiseGenerator {
+ public:
+  static void generate(float values[], int size, int rng_seed)
+  {
+    BlueNoiseGenerator g(size);
+    const int num = size * size;
+
+    /* Initial binary pattern of randomly placed points, relaxed by moving the point of the
+     * tightest cluster into the largest void until it is the same point. */
+    const int num_initial = std::max(num / 10, 1);
+    for (int i = 0; g.num_points < num_initial; i++) {
+      const int index = (int)(cmj_randfloat(i, rng_seed) * num) % num;
+      if (!g.pattern[index]) {
+        g.toggle(index);
+      }
+    }
+
+    for (int i = 0; i < num; i++) {
+      const int cluster = g.tightest_cluster();
+      g.toggle(cluster);
+      const int largest_void = g.largest_void();
+      g.toggle(largest_void);
+      if (largest_void == cluster) {
+        break;
+      }
+    }
+
+    std::vector<int> rank(num);
+
+    /* Rank the initial points by removing the tightest cluster. */
+    BlueNoiseGenerator initial = g;
+    for (int r = g.num_points - 1; r >= 0; r--) {
+      const int cluster = g.tightest_cluster();
+      g.toggle(cluster);
+      rank[cluster] = r;
+    }
+
+    /* Rank the remaining points by filling the largest void. */
+    g = initial;
+    for (int r = g.num_points; r < num; r++) {
+      const int largest_void = g.largest_void();
+      g.toggle(largest_void);
+      rank[largest_void] = r;
+    }
+
+    for (int i = 0; i < num; i++) {
+      values[i] = (rank[i] + 0.5f) / num;
+    }
+  }
+
+ protected:
+  BlueNoiseGenerator(int size)
+      : size(size), num_points(0), filter(size * size), energy(size * size, 0.0f),
+        pattern(size * size, false)
+  {
+    const float sigma = 1.5f;
+    for (int y = 0; y < size; y++) {
+      for (int x = 0; x < size; x++) {
+        const int dx = std::min(x, size - x);
+        const int dy = std::min(y, size - y);
+        filter[y * size + x] = expf(-(dx * dx + dy * dy) / (2.0f * sigma * sigma));
+      }
+    }
+  }
+
+  /* Add or remove a point, and update the filtered energy of the pattern. */
+  void toggle(int index)
+  {
+    pattern[index] = !pattern[index];
+    num_points += (pattern[index]) ? 1 : -1;
+
+    const float sign = (pattern[index]) ? 1.0f : -1.0f;
+    const int px = index % size;
+    const int py = index / size;
+    for (int y = 0; y < size; y++) {
+      const int dy = (y - py + size) % size;
+      for (int x = 0; x < size; x++) {
+        const int dx = (x - px + size) % size;
+        energy[y * size + x] += sign * filter[dy * size + dx];
+      }
+    }
+  }
+
+  int tightest_cluster() const
+  {
+    int best = -1;
+    for (int i = 0; i < size * size; i++) {
+      if (pattern[i] && (best == -1 || energy[i] > energy[best])) {
+        best = i;
+      }
+    }
+    return best;
+  }
+
+  int largest_void() const
+  {
+    int best = -1;
+    for (int i = 0; i < size * size; i++) {
+      if (!pattern[i] && (best == -1 || energy[i] < energy[best])) {
+        best = i;
+      }
+    }
+    return best;
+  }
+
+  int size;
+  int num_points;
+  std::vector<float> filter;
+  std::vector<float> energy;
+  std::vector<bool> pattern;
+};
+
+void blue_noise_generate(float values[], int size, int rng_seed)
+{
+  BlueNoiseGenerator::generate(values, size, rng_seed);
+}
+
 CCL_NAMESPACE_END
@@ -24,6 +24,9 @@ CCL_NAMESPACE_BEGIN
 void progressive_multi_jitter_generate_2D(float2 points[], int size, int rng_seed);
 void progressive_multi_jitter_02_generate_2D(float2 points[], int size, int rng_seed);
 
+/* Tileable blue noise mask of size x size values in [0, 1], each value occurring once. */
+void blue_noise_generate(float values[], int size, int rng_seed);
+
 CCL_NAMESPACE_END
 
 #endif /* __JITTER_H__ */
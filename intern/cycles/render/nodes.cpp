@@ -377,12 +377,21 @@ void ImageTextureNode::compile(SVMCompiler &compiler)
   const bool compress_as_srgb = metadata.compress_as_srgb;
   const ustring known_colorspace = metadata.colorspace;
 
-  int vector_offset = tex_mapping.compile_begin(compiler, vector_in);
+  /* A plain transform of the texture coordinate is applied by the image texture node itself,
+   * which avoids a separate texture mapping node and the stack round-trip between them. */
+  const bool inline_mapping = projection != NODE_IMAGE_PROJ_BOX && !tex_mapping.skip() &&
+                              !tex_mapping.use_minmax && tex_mapping.type != TextureMapping::NORMAL;
+
+  int vector_offset = (inline_mapping) ? compiler.stack_assign(vector_in) :
+                                         tex_mapping.compile_begin(compiler, vector_in);
   uint flags = 0;
 
   if (compress_as_srgb) {
     flags |= NODE_IMAGE_COMPRESS_AS_SRGB;
   }
+  if (inline_mapping) {
+    flags |= NODE_IMAGE_MAPPING;
+  }
   if (!alpha_out->links.empty()) {
     const bool unassociate_alpha = !(ColorSpaceManager::colorspace_is_data(colorspace) ||
                                      alpha_type == IMAGE_ALPHA_CHANNEL_PACKED ||
@@ -411,6 +420,13 @@ void ImageTextureNode::compile(SVMCompiler &compiler)
                                              flags),
                       projection);
 
+    if (inline_mapping) {
+      Transform tfm = tex_mapping.compute_transform();
+      compiler.add_node(tfm.x);
+      compiler.add_node(tfm.y);
+      compiler.add_node(tfm.z);
+    }
+
     if (num_nodes > 0) {
       for (int i = 0; i < num_nodes; i++) {
         int4 node;
@@ -439,7 +455,9 @@ void ImageTextureNode::compile(SVMCompiler &compiler)
                       __float_as_int(projection_blend));
   }
 
-  tex_mapping.compile_end(compiler, vector_in, vector_offset);
+  if (!inline_mapping) {
+    tex_mapping.compile_end(compiler, vector_in, vector_offset);
+  }
 }
 
 void ImageTextureNode::compile(OSLCompiler &compiler)
@@ -69,6 +69,10 @@ class TextureNode : public ShaderNode {
   explicit TextureNode(const NodeType *node_type) : ShaderNode(node_type)
   {
   }
+  TextureMapping *get_texture_mapping()
+  {
+    return &tex_mapping;
+  }
   TextureMapping tex_mapping;
   NODE_SOCKET_API_STRUCT_MEMBER(float3, tex_mapping, translation)
   NODE_SOCKET_API_STRUCT_MEMBER(float3, tex_mapping, rotation)
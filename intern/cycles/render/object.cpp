@@ -33,6 +33,7 @@
 #include "util/util_murmurhash.h"
 #include "util/util_progress.h"
 #include "util/util_set.h"
+#include "util/util_string.h"
 #include "util/util_task.h"
 #include "util/util_vector.h"
 
@@ -779,6 +780,84 @@ void ObjectManager::device_update_flags(
 
   dscene->object_flag.clear_modified();
   dscene->object_volume_step.clear_modified();
+
+  device_update_volume_occupancy(dscene, scene);
+}
+
+void ObjectManager::device_update_volume_occupancy(DeviceScene *dscene, Scene *scene)
+{
+  const bool motion_blur = scene->need_motion() == Scene::MOTION_BLUR;
+  KernelVolumeOccupancy *kvolumes = dscene->object_volume_occupancy.alloc(scene->objects.size());
+
+  /* Occupancy is shared between instances of the same volume. */
+  map<Volume *, int> volume_offsets;
+  vector<uint> occupancy;
+
+  foreach (Object *object, scene->objects) {
+    KernelVolumeOccupancy &kvolume = kvolumes[object->index];
+    kvolume.itfm = transform_identity();
+    kvolume.res_x = kvolume.res_y = kvolume.res_z = 0;
+    kvolume.offset = -1;
+
+    if (object->geometry->geometry_type != Geometry::VOLUME) {
+      continue;
+    }
+
+    Volume *volume = static_cast<Volume *>(object->geometry);
+    if (volume->occupancy.empty()) {
+      continue;
+    }
+
+    /* The grids only match the shape of the volume when it does not move. */
+    if (motion_blur &&
+        (object->use_motion() || volume->attributes.find(ATTR_STD_VOLUME_VELOCITY))) {
+      continue;
+    }
+
+    /* Shaders which do not depend on the grids may fill the empty voxels. */
+    bool shaders_use_grids = true;
+    foreach (Node *node, volume->get_used_shaders()) {
+      Shader *shader = static_cast<Shader *>(node);
+      if (shader->has_volume && !shader->has_volume_attribute_dependency) {
+        shaders_use_grids = false;
+      }
+    }
+
+    if (!shaders_use_grids) {
+      continue;
+    }
+
+    map<Volume *, int>::iterator it = volume_offsets.find(volume);
+    if (it == volume_offsets.end()) {
+      it = volume_offsets.insert(std::make_pair(volume, (int)occupancy.size())).first;
+      occupancy.insert(occupancy.end(), volume->occupancy.begin(), volume->occupancy.end());
+    }
+
+    kvolume.itfm = volume->occupancy_tfm * transform_inverse(object->get_tfm());
+    kvolume.res_x = volume->occupancy_resolution.x;
+    kvolume.res_y = volume->occupancy_resolution.y;
+    kvolume.res_z = volume->occupancy_resolution.z;
+    kvolume.offset = it->second;
+  }
+
+  /* Always have at least one element, so the array is valid on the device. */
+  if (occupancy.empty()) {
+    occupancy.push_back(VOLUME_OCCUPANCY_EMPTY);
+  }
+
+  uint *docc = dscene->volume_occupancy.alloc(occupancy.size());
+  memcpy(docc, occupancy.data(), occupancy.size() * sizeof(uint));
+
+  dscene->object_volume_occupancy.copy_to_device();
+  dscene->volume_occupancy.copy_to_device();
+
+  dscene->object_volume_occupancy.clear_modified();
+  dscene->volume_occupancy.clear_modified();
+
+  if (!volume_offsets.empty()) {
+    VLOG(1) << "Volume occupancy for " << volume_offsets.size() << " volumes, "
+            << string_human_readable_size(occupancy.size() * sizeof(uint));
+  }
 }
 
 void ObjectManager::device_update_mesh_offsets(Device *, DeviceScene *dscene, Scene *scene)
@@ -833,6 +912,8 @@ void ObjectManager::device_free(Device *, DeviceScene *dscene, bool force_free)
   dscene->object_motion.free_if_need_realloc(force_free);
   dscene->object_flag.free_if_need_realloc(force_free);
   dscene->object_volume_step.free_if_need_realloc(force_free);
+  dscene->object_volume_occupancy.free_if_need_realloc(force_free);
+  dscene->volume_occupancy.free_if_need_realloc(force_free);
 }
 
 void ObjectManager::apply_static_transforms(DeviceScene *dscene, Scene *scene, Progress &progress)
@@ -179,6 +179,7 @@ class ObjectManager {
   bool device_update_object_transform_pop_work(UpdateObjectTransformState *state,
                                                int *start_index,
                                                int *num_objects);
+  void device_update_volume_occupancy(DeviceScene *dscene, Scene *scene);
 };
 
 CCL_NAMESPACE_END
@@ -69,6 +69,8 @@ DeviceScene::DeviceScene(Device *device)
       object_motion(device, "__object_motion", MEM_GLOBAL),
       object_flag(device, "__object_flag", MEM_GLOBAL),
       object_volume_step(device, "__object_volume_step", MEM_GLOBAL),
+      object_volume_occupancy(device, "__object_volume_occupancy", MEM_GLOBAL),
+      volume_occupancy(device, "__volume_occupancy", MEM_GLOBAL),
       camera_motion(device, "__camera_motion", MEM_GLOBAL),
       attributes_map(device, "__attributes_map", MEM_GLOBAL),
       attributes_float(device, "__attributes_float", MEM_GLOBAL),
@@ -84,7 +86,10 @@ DeviceScene::DeviceScene(Device *device)
       shaders(device, "__shaders", MEM_GLOBAL),
       lookup_table(device, "__lookup_table", MEM_GLOBAL),
       sample_pattern_lut(device, "__sample_pattern_lut", MEM_GLOBAL),
-      ies_lights(device, "__ies", MEM_GLOBAL)
+      sample_blue_noise(device, "__sample_blue_noise", MEM_GLOBAL),
+      ies_lights(device, "__ies", MEM_GLOBAL),
+      guiding_distribution(device, "__guiding_distribution", MEM_GLOBAL),
+      guiding_training(device, "__guiding_training", MEM_GLOBAL)
 {
   memset((void *)&data, 0, sizeof(data));
 }
@@ -520,6 +525,7 @@ void Scene::update_kernel_features()
   }
 
   kernel_features |= film->get_kernel_features(this);
+  kernel_features |= integrator->get_kernel_features(this);
 
   dscene.data.kernel_features = kernel_features;
 
@@ -575,6 +581,8 @@ static void log_kernel_features(const uint features)
           << string_from_bool(features & KERNEL_FEATURE_PATCH_EVALUATION) << "\n";
   VLOG(2) << "Use Shadow Catcher " << string_from_bool(features & KERNEL_FEATURE_SHADOW_CATCHER)
           << "\n";
+  VLOG(2) << "Use Path Guiding " << string_from_bool(features & KERNEL_FEATURE_PATH_GUIDING)
+          << "\n";
 }
 
 bool Scene::load_kernels(Progress &progress, bool lock_scene)
@@ -100,6 +100,8 @@ class DeviceScene {
   device_vector<DecomposedTransform> object_motion;
   device_vector<uint> object_flag;
   device_vector<float> object_volume_step;
+  device_vector<KernelVolumeOccupancy> object_volume_occupancy;
+  device_vector<uint> volume_occupancy;
 
   /* cameras */
   device_vector<DecomposedTransform> camera_motion;
@@ -129,10 +131,15 @@ class DeviceScene {
 
   /* integrator */
   device_vector<float> sample_pattern_lut;
+  device_vector<float> sample_blue_noise;
 
   /* ies lights */
   device_vector<float> ies_lights;
 
+  /* path guiding */
+  device_vector<float> guiding_distribution;
+  device_vector<float> guiding_training;
+
   KernelData data;
 
   DeviceScene(Device *device);
@@ -154,6 +161,7 @@ class SceneParams {
   BVHType bvh_type;
   bool use_bvh_spatial_split;
   bool use_bvh_unaligned_nodes;
+  bool use_bvh_compressed_nodes;
   int num_bvh_time_steps;
   int hair_subdivisions;
   CurveShapeType hair_shape;
@@ -168,6 +176,7 @@ class SceneParams {
     bvh_type = BVH_TYPE_DYNAMIC;
     use_bvh_spatial_split = false;
     use_bvh_unaligned_nodes = true;
+    use_bvh_compressed_nodes = false;
     num_bvh_time_steps = 0;
     hair_subdivisions = 3;
     hair_shape = CURVE_RIBBON;
@@ -181,6 +190,7 @@ class SceneParams {
              bvh_type == params.bvh_type &&
              use_bvh_spatial_split == params.use_bvh_spatial_split &&
              use_bvh_unaligned_nodes == params.use_bvh_unaligned_nodes &&
+             use_bvh_compressed_nodes == params.use_bvh_compressed_nodes &&
              num_bvh_time_steps == params.num_bvh_time_steps &&
              hair_subdivisions == params.hair_subdivisions && hair_shape == params.hair_shape &&
              texture_limit == params.texture_limit);
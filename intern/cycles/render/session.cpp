@@ -37,6 +37,7 @@
 #include "util/util_foreach.h"
 #include "util/util_function.h"
 #include "util/util_logging.h"
+#include "util/util_mapped_malloc.h"
 #include "util/util_math.h"
 #include "util/util_task.h"
 #include "util/util_time.h"
@@ -58,6 +59,9 @@ Session::Session(const SessionParams &params_, const SceneParams &scene_params)
 
   device = Device::create(params.device, stats, profiler);
 
+  page_ins_at_start_ = util_mapped_memory_page_ins();
+  stall_time_at_start_ = util_mapped_memory_stall_time();
+
   scene = new Scene(scene_params, device);
 
   /* Configure path tracer. */
@@ -291,6 +295,13 @@ RenderWork Session::run_update_for_next_iteration()
     path_trace_->set_adaptive_sampling(adaptive_sampling);
   }
 
+  /* Update path guiding. */
+  {
+    const PathGuiding path_guiding = scene->integrator->get_path_guiding();
+    path_trace_->set_path_guiding(path_guiding);
+  }
+
+  render_scheduler_.set_start_sample(params.sample_offset);
   render_scheduler_.set_num_samples(params.samples);
   render_scheduler_.set_time_limit(params.time_limit);
 
@@ -421,6 +432,9 @@ void Session::do_delayed_reset()
   tile_manager_.reset_scheduling(buffer_params_, get_effective_tile_size());
   render_scheduler_.reset(buffer_params_, params.samples);
 
+  /* Scene might have changed, start learning path guiding from scratch. */
+  path_trace_->reset_path_guiding();
+
   /* Passes. */
   /* When multiple tiles are used SAMPLE_COUNT pass is used to keep track of possible partial
    * tile results. It is safe to use generic update function here which checks for changes since
@@ -631,6 +645,12 @@ void Session::device_free()
 void Session::collect_statistics(RenderStats *render_stats)
 {
   scene->collect_statistics(render_stats);
+
+  render_stats->mapped_memory.mapped_size = stats.mem_mapped;
+  render_stats->mapped_memory.page_ins = util_mapped_memory_page_ins() - page_ins_at_start_;
+  render_stats->mapped_memory.stall_time = util_mapped_memory_stall_time() -
+                                           stall_time_at_start_;
+
   if (params.use_profiling && (params.device.type == DEVICE_CPU)) {
     render_stats->collect_profiling(scene, profiler);
   }
@@ -672,6 +692,11 @@ bool Session::copy_render_tile_from_device()
   return path_trace_->copy_render_tile_from_device();
 }
 
+void Session::copy_render_tile_to_buffers(RenderBuffers *buffers)
+{
+  path_trace_->copy_render_tile_to_buffers(buffers);
+}
+
 bool Session::get_render_tile_pixels(const string &pass_name, int num_components, float *pixels)
 {
   /* NOTE: The code relies on a fact that session is fully update and no scene/buffer modification
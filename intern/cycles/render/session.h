@@ -53,6 +53,10 @@ class SessionParams {
 
   bool experimental;
   int samples;
+
+  /* Index of the first sample to render. Allows to split rendering of a frame into ranges of
+   * samples rendered by separate sessions, whose render buffers are accumulated afterwards. */
+  int sample_offset;
   int pixel_size;
   int threads;
 
@@ -76,6 +80,7 @@ class SessionParams {
 
     experimental = false;
     samples = 1024;
+    sample_offset = 0;
     pixel_size = 1;
     threads = 0;
     time_limit = 0.0;
@@ -170,6 +175,10 @@ class Session {
 
   bool copy_render_tile_from_device();
 
+  /* Copy render buffers of the current tile, so that they can be accumulated with the buffers of
+   * other sessions rendering different ranges of samples of the same frame. */
+  void copy_render_tile_to_buffers(RenderBuffers *buffers);
+
   bool get_render_tile_pixels(const string &pass_name, int num_components, float *pixels);
   bool set_render_tile_pixels(const string &pass_name, int num_components, const float *pixels);
 
@@ -244,6 +253,11 @@ class Session {
    * Is a single full-frame path tracer for interactive viewport rendering.
    * A path tracer for the current big-tile for an offline rendering. */
   unique_ptr<PathTrace> path_trace_;
+
+  /* Number of pages read from disk and time stalled on reading them by the process when the
+   * session was created, used to report page-ins of memory mapped scene data. */
+  uint64_t page_ins_at_start_ = 0;
+  double stall_time_at_start_ = 0.0;
 };
 
 CCL_NAMESPACE_END
@@ -226,7 +226,7 @@ string NamedSampleCountStats::full_report(int indent_level)
 
 /* Mesh statistics. */
 
-MeshStats::MeshStats()
+MeshStats::MeshStats() : num_deduplicated(0), deduplicated_size(0)
 {
 }
 
@@ -235,6 +235,13 @@ string MeshStats::full_report(int indent_level)
   const string indent(indent_level * kIndentNumSpaces, ' ');
   string result = "";
   result += indent + "Geometry:\n" + geometry.full_report(indent_level + 1);
+  if (num_deduplicated) {
+    result += indent + "Deduplicated:\n";
+    result += indent + string(kIndentNumSpaces, ' ') +
+              string_printf("%d geometries, %s saved\n",
+                            num_deduplicated,
+                            string_human_readable_size(deduplicated_size).c_str());
+  }
   return result;
 }
 
@@ -252,6 +259,22 @@ string ImageStats::full_report(int indent_level)
   return result;
 }
 
+/* Mapped memory statistics. */
+
+MappedMemoryStats::MappedMemoryStats() : mapped_size(0), page_ins(0), stall_time(0.0)
+{
+}
+
+string MappedMemoryStats::full_report(int indent_level)
+{
+  const string indent(indent_level * kIndentNumSpaces, ' ');
+  string result = "";
+  result += indent + "Mapped size: " + string_human_readable_size(mapped_size) + "\n";
+  result += indent + "Page-ins: " + string_human_readable_number(page_ins) + "\n";
+  result += indent + "Page-in stall time: " + string_printf("%.2fs", stall_time) + "\n";
+  return result;
+}
+
 /* Overall statistics. */
 
 RenderStats::RenderStats()
@@ -315,6 +338,9 @@ string RenderStats::full_report()
   string result = "";
   result += "Mesh statistics:\n" + mesh.full_report(1);
   result += "Image statistics:\n" + image.full_report(1);
+  if (mapped_memory.mapped_size) {
+    result += "Mapped memory statistics:\n" + mapped_memory.full_report(1);
+  }
   if (has_profiling) {
     result += "Kernel statistics:\n" + kernel.full_report(1);
     result += "Shader statistics:\n" + shaders.full_report(1);
@@ -160,6 +160,11 @@ class MeshStats {
    * memory like BVH.
    */
   NamedSizeStats geometry;
+
+  /* Geometry which was shared with other geometry of identical content, and the memory this
+   * saved. */
+  int num_deduplicated;
+  size_t deduplicated_size;
 };
 
 /* Statistics about images held in memory. */
@@ -173,6 +178,27 @@ class ImageStats {
   NamedSizeStats textures;
 };
 
+/* Statistics about host memory which is backed by file mappings and paged in on demand. */
+class MappedMemoryStats {
+ public:
+  MappedMemoryStats();
+
+  /* Generate full human-readable report. */
+  string full_report(int indent_level = 0);
+
+  /* Size of the memory which is currently backed by file mappings. */
+  size_t mapped_size;
+
+  /* Number of pages read from disk since the session started.
+   * Counted for the whole process, so it also includes page-ins which are not caused by the
+   * mapped scene data. */
+  uint64_t page_ins;
+
+  /* Time in seconds spent waiting for pages to be read from disk since the session started.
+   * Only available on Linux with delay accounting enabled, zero otherwise. */
+  double stall_time;
+};
+
 /* Render process statistics. */
 class RenderStats {
  public:
@@ -188,6 +214,7 @@ class RenderStats {
 
   MeshStats mesh;
   ImageStats image;
+  MappedMemoryStats mapped_memory;
   NamedNestedSampleStats kernel;
   NamedSampleCountStats shaders;
   NamedSampleCountStats objects;
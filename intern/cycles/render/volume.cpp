@@ -30,6 +30,7 @@
 #include "util/util_logging.h"
 #include "util/util_openvdb.h"
 #include "util/util_progress.h"
+#include "util/util_string.h"
 #include "util/util_types.h"
 
 CCL_NAMESPACE_BEGIN
@@ -50,11 +51,17 @@ Volume::Volume() : Mesh(get_node_type(), Geometry::VOLUME)
   clipping = 0.001f;
   step_size = 0.0f;
   object_space = false;
+  occupancy_tfm = transform_identity();
+  occupancy_resolution = make_int3(0, 0, 0);
 }
 
 void Volume::clear(bool preserve_shaders)
 {
   Mesh::clear(preserve_shaders, true);
+
+  occupancy_tfm = transform_identity();
+  occupancy_resolution = make_int3(0, 0, 0);
+  occupancy.clear();
 }
 
 struct QuadData {
@@ -181,6 +188,8 @@ class VolumeMeshBuilder {
                              vector<int> &tris,
                              vector<float3> &face_normals);
 
+  bool create_occupancy(Transform &tfm, int3 &resolution, vector<uint> &occupancy);
+
   bool empty_grid() const;
 
 #ifdef WITH_OPENVDB
@@ -424,6 +433,86 @@ void VolumeMeshBuilder::convert_quads_to_tris(const vector<QuadData> &quads,
   }
 }
 
+/* Store the voxel masks of the leaf nodes of the padded topology, so that the kernel can skip
+ * empty voxels inside of active leaf nodes. Must be called after create_mesh(), which ensures the
+ * tree only contains leaf nodes. */
+bool VolumeMeshBuilder::create_occupancy(Transform &tfm, int3 &resolution, vector<uint> &occupancy)
+{
+#ifdef WITH_OPENVDB
+  /* Limit memory usage of the leaf node table. */
+  static const size_t max_table_size = (1 << 24);
+  static const int LEAF_DIM = openvdb::MaskGrid::TreeType::LeafNodeType::DIM;
+  static_assert(LEAF_DIM == VOLUME_OCCUPANCY_LEAF_DIM, "Unexpected OpenVDB leaf size");
+  static_assert(openvdb::MaskGrid::TreeType::LeafNodeType::SIZE ==
+                    VOLUME_OCCUPANCY_LEAF_WORDS * 32,
+                "Unexpected OpenVDB leaf size");
+
+  if (!topology_grid->transform().isLinear()) {
+    return false;
+  }
+
+  const openvdb::MaskGrid::TreeType &tree = topology_grid->tree();
+  openvdb::CoordBBox leaf_bbox;
+  if (!tree.evalLeafBoundingBox(leaf_bbox)) {
+    return false;
+  }
+
+  /* The bounding box is aligned to leaf nodes. */
+  const openvdb::Coord leaf_min = leaf_bbox.min();
+  resolution = make_int3(leaf_bbox.dim().x() / LEAF_DIM,
+                         leaf_bbox.dim().y() / LEAF_DIM,
+                         leaf_bbox.dim().z() / LEAF_DIM);
+
+  const size_t table_size = (size_t)resolution.x * resolution.y * resolution.z;
+  if (table_size > max_table_size) {
+    return false;
+  }
+
+  occupancy.clear();
+  occupancy.resize(table_size, VOLUME_OCCUPANCY_EMPTY);
+  occupancy.reserve(table_size + tree.leafCount() * VOLUME_OCCUPANCY_LEAF_WORDS);
+
+  for (auto iter = tree.cbeginLeaf(); iter; ++iter) {
+    const openvdb::Coord origin = iter->origin() - leaf_min;
+    const size_t index = (origin.x() / LEAF_DIM) +
+                         resolution.x * ((origin.y() / LEAF_DIM) +
+                                         (size_t)resolution.y * (origin.z() / LEAF_DIM));
+
+    const size_t mask_offset = occupancy.size();
+    occupancy[index] = (uint)mask_offset;
+    occupancy.resize(mask_offset + VOLUME_OCCUPANCY_LEAF_WORDS, 0);
+
+    for (auto voxel = iter->cbeginValueOn(); voxel; ++voxel) {
+      const openvdb::Index bit = voxel.pos();
+      occupancy[mask_offset + (bit >> 5)] |= (1u << (bit & 31));
+    }
+  }
+
+  /* Index to object space, as done for image textures. Voxel centers are at integer coordinates
+   * in OpenVDB, offset by half a voxel so that truncation gives the voxel index. */
+  openvdb::math::Mat4f grid_matrix =
+      topology_grid->transform().baseMap()->getAffineMap()->getMat4();
+  Transform index_to_object;
+  for (int col = 0; col < 4; col++) {
+    for (int row = 0; row < 3; row++) {
+      index_to_object[row][col] = (float)grid_matrix[col][row];
+    }
+  }
+
+  tfm = transform_translate(make_float3(0.5f - leaf_min.x(),
+                                        0.5f - leaf_min.y(),
+                                        0.5f - leaf_min.z())) *
+        transform_inverse(index_to_object);
+
+  return true;
+#else
+  (void)tfm;
+  (void)resolution;
+  (void)occupancy;
+  return false;
+#endif
+}
+
 bool VolumeMeshBuilder::empty_grid() const
 {
 #ifdef WITH_OPENVDB
@@ -624,12 +713,19 @@ void GeometryManager::create_volume_mesh(Volume *volume, Progress &progress)
     fN[i] = face_normals[i];
   }
 
+  if (!builder.create_occupancy(
+          volume->occupancy_tfm, volume->occupancy_resolution, volume->occupancy)) {
+    volume->occupancy.clear();
+  }
+
   /* Print stats. */
   VLOG(1) << "Memory usage volume mesh: "
           << ((vertices.size() + face_normals.size()) * sizeof(float3) +
               indices.size() * sizeof(int)) /
                  (1024.0 * 1024.0)
           << "Mb.";
+  VLOG(1) << "Memory usage volume occupancy: "
+          << string_human_readable_size(volume->occupancy.size() * sizeof(uint));
 }
 
 CCL_NAMESPACE_END
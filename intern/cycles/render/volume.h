@@ -32,6 +32,15 @@ class Volume : public Mesh {
   NODE_SOCKET_API(float, step_size)
   NODE_SOCKET_API(bool, object_space)
 
+  /* Voxel occupancy of the grids, used to skip shader evaluation in the empty space inside the
+   * bounding mesh. Computed along with the mesh, and empty if not available.
+   *
+   * The resolution is in leaf nodes of 8x8x8 voxels. For each leaf node there is an offset to its
+   * voxel mask of 16 words, or VOLUME_OCCUPANCY_EMPTY. The masks follow the leaf node table. */
+  Transform occupancy_tfm;
+  int3 occupancy_resolution;
+  vector<uint> occupancy;
+
   virtual void clear(bool preserve_shaders = false) override;
 };
 
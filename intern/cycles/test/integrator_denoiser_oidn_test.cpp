@@ -0,0 +1,142 @@
+/*
+ * Copyright 2011-2021 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "testing/testing.h"
+
+#include "device/device.h"
+#include "integrator/denoiser_oidn.h"
+#include "render/buffers.h"
+#include "util/util_hash.h"
+#include "util/util_openimagedenoise.h"
+#include "util/util_profiling.h"
+#include "util/util_stats.h"
+
+CCL_NAMESPACE_BEGIN
+
+#ifdef WITH_OPENIMAGEDENOISE
+
+static constexpr int kNumSamples = 4;
+
+static void add_pass(BufferParams &params, PassType type, PassMode mode)
+{
+  BufferPass pass;
+  pass.type = type;
+  pass.mode = mode;
+  pass.offset = params.passes.empty() ? 0 :
+                                        params.passes.back().offset +
+                                            params.passes.back().get_info().num_components;
+  params.passes.push_back(pass);
+}
+
+/* Frame with smooth gradients and edges, with per-pixel noise on top. */
+static void create_noisy_frame(RenderBuffers &buffers, const int width, const int height)
+{
+  BufferParams params;
+  params.width = width;
+  params.height = height;
+  params.full_width = width;
+  params.full_height = height;
+  params.samples = kNumSamples;
+
+  add_pass(params, PASS_COMBINED, PassMode::NOISY);
+  add_pass(params, PASS_COMBINED, PassMode::DENOISED);
+
+  params.update_passes();
+  buffers.reset(params);
+  buffers.zero();
+
+  const int offset = params.get_pass_offset(PASS_COMBINED);
+
+  float *buffer = buffers.buffer.data();
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      float *pixel = buffer + ((int64_t)y * width + x) * params.pass_stride + offset;
+
+      const float base = (((x / 64) + (y / 48)) % 2) ? 0.8f : 0.2f;
+      const float gradient = (float)x / width;
+      for (int c = 0; c < 3; c++) {
+        const float noise = hash_uint3_to_float(x, y, c) - 0.5f;
+        pixel[c] = (base + 0.5f * gradient * c + noise * 0.5f) * kNumSamples;
+      }
+      pixel[3] = kNumSamples;
+    }
+  }
+}
+
+static void denoise_frame(Device *device, RenderBuffers &buffers, const int memory_limit)
+{
+  DenoiseParams params;
+  params.use = true;
+  params.type = DENOISER_OPENIMAGEDENOISE;
+  params.use_pass_albedo = false;
+  params.use_pass_normal = false;
+  params.prefilter = DENOISER_PREFILTER_NONE;
+  params.memory_limit = memory_limit;
+
+  OIDNDenoiser denoiser(device, params);
+  EXPECT_TRUE(denoiser.denoise_buffer(buffers.params, &buffers, kNumSamples, true));
+}
+
+/* Denoising in tiles with a memory limit gives the same result as denoising the full frame at
+ * once, up to differences from the order of floating point operations. */
+TEST(OIDNDenoiser, tiled_matches_full_frame)
+{
+  if (!openimagedenoise_supported()) {
+    GTEST_SKIP();
+  }
+
+  Stats stats;
+  Profiler profiler;
+  vector<DeviceInfo> devices = Device::available_devices(DEVICE_MASK_CPU);
+  ASSERT_FALSE(devices.empty());
+  unique_ptr<Device> device(Device::create(devices.front(), stats, profiler));
+
+  /* Denoising the frame at once is estimated to need about 450 MB, the limit results in tiles of
+   * 169 pixels plus the overlap. */
+  const int width = 512;
+  const int height = 384;
+  const int memory_limit = 400;
+
+  RenderBuffers full_buffers(device.get());
+  create_noisy_frame(full_buffers, width, height);
+  denoise_frame(device.get(), full_buffers, 0);
+
+  RenderBuffers tiled_buffers(device.get());
+  create_noisy_frame(tiled_buffers, width, height);
+  denoise_frame(device.get(), tiled_buffers, memory_limit);
+
+  const BufferParams &params = full_buffers.params;
+  const int offset = params.get_pass_offset(PASS_COMBINED, PassMode::DENOISED);
+  ASSERT_NE(offset, PASS_UNUSED);
+
+  const float *full = full_buffers.buffer.data();
+  const float *tiled = tiled_buffers.buffer.data();
+
+  float max_difference = 0.0f;
+  for (int64_t i = 0; i < (int64_t)width * height; i++) {
+    for (int c = 0; c < 3; c++) {
+      const float full_value = full[i * params.pass_stride + offset + c];
+      const float tiled_value = tiled[i * params.pass_stride + offset + c];
+      max_difference = max(max_difference, fabsf(full_value - tiled_value));
+    }
+  }
+
+  EXPECT_LT(max_difference, 1e-2f);
+}
+
+#endif
+
+CCL_NAMESPACE_END
@@ -0,0 +1,206 @@
+/*
+ * Copyright 2011-2021 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "testing/testing.h"
+
+#include "integrator/path_guiding.h"
+
+#include "kernel/device/cpu/compat.h"
+#include "kernel/device/cpu/globals.h"
+
+#include "util/util_atomic.h"
+
+#include "kernel/integrator/integrator_state.h"
+
+#include "kernel/kernel_guiding.h"
+#include "kernel/kernel_types.h"
+
+#include "util/util_vector.h"
+
+#include <random>
+
+CCL_NAMESPACE_BEGIN
+
+TEST(PathGuiding, need_update)
+{
+  PathGuiding path_guiding;
+  path_guiding.use = true;
+  path_guiding.training_samples = 48;
+
+  EXPECT_FALSE(path_guiding.need_update(0));
+  EXPECT_FALSE(path_guiding.need_update(1));
+  EXPECT_TRUE(path_guiding.need_update(3));
+  EXPECT_FALSE(path_guiding.need_update(4));
+  EXPECT_TRUE(path_guiding.need_update(7));
+  EXPECT_TRUE(path_guiding.need_update(15));
+  EXPECT_TRUE(path_guiding.need_update(31));
+  EXPECT_TRUE(path_guiding.need_update(47));
+  EXPECT_FALSE(path_guiding.need_update(63));
+
+  path_guiding.use = false;
+  EXPECT_FALSE(path_guiding.need_update(3));
+}
+
+TEST(PathGuiding, align_samples)
+{
+  PathGuiding path_guiding;
+  path_guiding.use = true;
+  path_guiding.training_samples = 48;
+
+  EXPECT_EQ(path_guiding.align_samples(0, 1), 1);
+  EXPECT_EQ(path_guiding.align_samples(0, 16), 4);
+  EXPECT_EQ(path_guiding.align_samples(1, 16), 3);
+  EXPECT_EQ(path_guiding.align_samples(4, 16), 4);
+  EXPECT_EQ(path_guiding.align_samples(8, 4), 4);
+  EXPECT_EQ(path_guiding.align_samples(32, 64), 16);
+
+  /* No more updates once the training is over. */
+  EXPECT_EQ(path_guiding.align_samples(48, 64), 64);
+
+  for (int sample = 0; sample < 48; ++sample) {
+    for (int num_samples = 48; num_samples < 64; ++num_samples) {
+      const int num_samples_aligned = path_guiding.align_samples(sample, num_samples);
+      EXPECT_TRUE(path_guiding.need_update(sample + num_samples_aligned - 1));
+    }
+  }
+}
+
+TEST(PathGuiding, update_distribution)
+{
+  vector<float> training(GUIDING_TRAINING_STRIDE * 2, 0.0f);
+  vector<float> distribution(GUIDING_DIRECTION_BINS * 2, -1.0f);
+
+  /* First cell has enough samples, all radiance arriving from a single bin. */
+  training[5] = 10.0f;
+  training[GUIDING_DIRECTION_BINS] = 100.0f;
+
+  /* Second cell did not receive enough samples. */
+  training[GUIDING_TRAINING_STRIDE + 5] = 10.0f;
+  training[GUIDING_TRAINING_STRIDE + GUIDING_DIRECTION_BINS] = 1.0f;
+
+  PathGuiding::update_distribution(training.data(), distribution.data(), 2);
+
+  float prev_cdf = 0.0f;
+  for (int bin = 0; bin < GUIDING_DIRECTION_BINS; bin++) {
+    EXPECT_GT(distribution[bin], prev_cdf);
+    prev_cdf = distribution[bin];
+  }
+  EXPECT_EQ(distribution[GUIDING_DIRECTION_BINS - 1], 1.0f);
+  EXPECT_GT(distribution[5] - distribution[4], 0.5f);
+
+  for (int bin = 0; bin < GUIDING_DIRECTION_BINS; bin++) {
+    EXPECT_EQ(distribution[GUIDING_DIRECTION_BINS + bin], 0.0f);
+  }
+}
+
+/* Incident radiance for the sampling test: a bright region of one histogram bin above a dim
+ * environment. */
+static float test_radiance(const float3 D)
+{
+  float phi = atan2f(D.y, D.x);
+  if (phi < 0.0f) {
+    phi += M_2PI_F;
+  }
+  return (D.z >= 0.5f && D.z < 0.75f && phi >= M_PI_4_F && phi < M_PI_2_F) ? 1000.0f : 0.01f;
+}
+
+/* Estimate the light reflected by a diffuse surface with normal along Z with BSDF sampling only
+ * and with one-sample MIS of BSDF and guiding sampling, as the integrator does, and compare the
+ * noise of both. */
+TEST(PathGuiding, guided_sampling_convergence)
+{
+  /* Reflected radiance with the cosine weighted integral of test_radiance() over the
+   * hemisphere, computed analytically using equal-area coordinates. */
+  const double bright_integral = (0.75 * 0.75 - 0.5 * 0.5) * 0.5 * M_PI_4 / M_PI;
+  const double reference = 1000.0 * bright_integral + 0.01 * (1.0 - bright_integral);
+
+  std::mt19937 rng(1234);
+  std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+
+  /* Train a single cell with directions sampled uniformly over the sphere. */
+  vector<float> training(GUIDING_TRAINING_STRIDE, 0.0f);
+  for (int i = 0; i < 100000; i++) {
+    const float z = 1.0f - 2.0f * uniform(rng);
+    const float r = safe_sqrtf(1.0f - z * z);
+    const float phi = M_2PI_F * uniform(rng);
+    const float3 D = make_float3(r * cosf(phi), r * sinf(phi), z);
+    training[guiding_direction_to_bin(D)] += test_radiance(D);
+    training[GUIDING_DIRECTION_BINS] += 1.0f;
+  }
+
+  vector<float> distribution(GUIDING_DIRECTION_BINS);
+  PathGuiding::update_distribution(training.data(), distribution.data(), 1);
+
+  KernelGlobals kernel_globals = {};
+  kernel_globals.__guiding_distribution.data = distribution.data();
+  kernel_globals.__guiding_distribution.width = distribution.size();
+  const KernelGlobals *kg = &kernel_globals;
+
+  const int num_estimates = 256;
+  const int num_samples = 64;
+
+  double sum[2] = {0.0, 0.0};
+  double sum_sq[2] = {0.0, 0.0};
+
+  for (int estimate = 0; estimate < num_estimates; estimate++) {
+    for (int guided = 0; guided < 2; guided++) {
+      double value = 0.0;
+      for (int sample = 0; sample < num_samples; sample++) {
+        const float u = uniform(rng);
+        const float v = uniform(rng);
+
+        float3 D;
+        if (guided && uniform(rng) < GUIDING_SAMPLE_PROBABILITY) {
+          float guiding_pdf_value;
+          D = guiding_sample(kg, 0, u, v, &guiding_pdf_value);
+        }
+        else {
+          const float z = sqrtf(u);
+          const float r = safe_sqrtf(1.0f - z * z);
+          const float phi = M_2PI_F * v;
+          D = make_float3(r * cosf(phi), r * sinf(phi), z);
+        }
+
+        if (D.z <= 0.0f) {
+          continue;
+        }
+
+        const float bsdf_pdf = D.z * M_1_PI_F;
+        const float pdf = (guided) ? guiding_mis_pdf(kg, 0, D, bsdf_pdf) : bsdf_pdf;
+        value += test_radiance(D) * D.z * M_1_PI_F / pdf;
+      }
+      value /= num_samples;
+
+      sum[guided] += value;
+      sum_sq[guided] += value * value;
+    }
+  }
+
+  double variance[2];
+  for (int guided = 0; guided < 2; guided++) {
+    const double mean = sum[guided] / num_estimates;
+    variance[guided] = sum_sq[guided] / num_estimates - mean * mean;
+
+    /* Both estimators converge to the same result. */
+    const double standard_error = sqrt(variance[guided] / num_estimates);
+    EXPECT_NEAR(mean, reference, 4.0 * standard_error);
+  }
+
+  /* Guiding learned the bright region, so it is found much more often. */
+  EXPECT_LT(variance[1], variance[0] * 0.25);
+}
+
+CCL_NAMESPACE_END
@@ -17,6 +17,8 @@
 #include "testing/testing.h"
 
 #include "integrator/render_scheduler.h"
+#include "render/session.h"
+#include "render/tile.h"
 
 CCL_NAMESPACE_BEGIN
 
@@ -34,4 +36,50 @@ TEST(IntegratorRenderScheduler, calculate_resolution_for_divider)
   EXPECT_EQ(calculate_resolution_for_divider(1920, 1080, 4), 360);
 }
 
+TEST(IntegratorRenderScheduler, sample_offset)
+{
+  SessionParams session_params;
+  session_params.background = true;
+
+  TileManager tile_manager;
+  RenderScheduler scheduler(tile_manager, session_params);
+
+  AdaptiveSampling adaptive_sampling;
+  adaptive_sampling.use = true;
+  adaptive_sampling.min_samples = 3;
+  adaptive_sampling.adaptive_step = 4;
+  scheduler.set_adaptive_sampling(adaptive_sampling);
+
+  BufferParams buffer_params;
+  buffer_params.width = buffer_params.full_width = 64;
+  buffer_params.height = buffer_params.full_height = 64;
+
+  scheduler.set_start_sample(101);
+  scheduler.reset(buffer_params, 32);
+
+  /* Samples are scheduled from the offset, and adaptive filtering happens at the same points
+   * relative to the first sample in the buffer as for a render without an offset. */
+  int num_rendered_samples = 0;
+  vector<int> num_samples_at_filter;
+  while (RenderWork render_work = scheduler.get_render_work()) {
+    if (render_work.path_trace.num_samples == 0) {
+      continue;
+    }
+
+    EXPECT_EQ(render_work.path_trace.start_sample, 101 + num_rendered_samples);
+    EXPECT_EQ(render_work.path_trace.sample_offset, 101);
+    EXPECT_EQ(render_work.init_render_buffers, num_rendered_samples == 0);
+
+    num_rendered_samples += render_work.path_trace.num_samples;
+    if (render_work.adaptive_sampling.filter) {
+      num_samples_at_filter.push_back(num_rendered_samples);
+    }
+
+    scheduler.report_path_trace_time(render_work, 0.01, false);
+  }
+
+  EXPECT_EQ(num_rendered_samples, 32);
+  EXPECT_EQ(num_samples_at_filter, vector<int>({8, 12, 16, 20, 24, 28, 32}));
+}
+
 CCL_NAMESPACE_END
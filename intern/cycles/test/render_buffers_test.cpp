@@ -0,0 +1,136 @@
+/*
+ * Copyright 2011-2021 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "testing/testing.h"
+
+#include "device/device.h"
+#include "render/buffers.h"
+#include "util/util_profiling.h"
+#include "util/util_stats.h"
+
+CCL_NAMESPACE_BEGIN
+
+static void add_pass(BufferParams &params, PassType type)
+{
+  BufferPass pass;
+  pass.type = type;
+  pass.offset = params.passes.empty() ? 0 :
+                                        params.passes.back().offset +
+                                            params.passes.back().get_info().num_components;
+  params.passes.push_back(pass);
+}
+
+static BufferParams make_params(const int samples)
+{
+  BufferParams params;
+  params.width = 2;
+  params.height = 2;
+  params.full_width = 2;
+  params.full_height = 2;
+  params.samples = samples;
+
+  add_pass(params, PASS_COMBINED);
+  add_pass(params, PASS_SAMPLE_COUNT);
+  add_pass(params, PASS_ADAPTIVE_AUX_BUFFER);
+
+  params.update_passes();
+
+  return params;
+}
+
+/* Fill every pass of every pixel with values derived from the pixel index and the given seed. */
+static void fill_buffers(RenderBuffers &buffers, const float seed, const uint sample_count)
+{
+  const BufferParams &params = buffers.params;
+  const int combined = params.get_pass_offset(PASS_COMBINED);
+  const int sample_count_offset = params.get_pass_offset(PASS_SAMPLE_COUNT);
+  const int aux = params.get_pass_offset(PASS_ADAPTIVE_AUX_BUFFER);
+
+  float *buffer = buffers.buffer.data();
+  for (int i = 0; i < params.width * params.height; i++) {
+    float *pixel = buffer + i * params.pass_stride;
+    for (int j = 0; j < 4; j++) {
+      pixel[combined + j] = seed + i + j * 0.25f;
+      pixel[aux + j] = seed * 2.0f + i + j;
+    }
+    pixel[sample_count_offset] = __uint_as_float(sample_count + i);
+  }
+}
+
+TEST(render_buffers_host_accumulate, sums_passes)
+{
+  Stats stats;
+  Profiler profiler;
+  unique_ptr<Device> device(Device::create(Device::dummy_device(), stats, profiler));
+
+  RenderBuffers dst(device.get());
+  RenderBuffers src(device.get());
+  dst.reset(make_params(4));
+  src.reset(make_params(12));
+
+  fill_buffers(dst, 1.0f, 4);
+  fill_buffers(src, 3.0f, 12);
+
+  ASSERT_TRUE(render_buffers_host_accumulate(&dst, &src));
+
+  const BufferParams &params = dst.params;
+  EXPECT_EQ(params.samples, 16);
+
+  const int combined = params.get_pass_offset(PASS_COMBINED);
+  const int sample_count_offset = params.get_pass_offset(PASS_SAMPLE_COUNT);
+  const int aux = params.get_pass_offset(PASS_ADAPTIVE_AUX_BUFFER);
+
+  const float *buffer = dst.buffer.data();
+  for (int i = 0; i < params.width * params.height; i++) {
+    const float *pixel = buffer + i * params.pass_stride;
+    for (int j = 0; j < 4; j++) {
+      EXPECT_FLOAT_EQ(pixel[combined + j], 4.0f + 2 * i + j * 0.5f);
+    }
+
+    /* Sample count is stored as an unsigned integer, so it is to be summed as one. */
+    EXPECT_EQ(__float_as_uint(pixel[sample_count_offset]), 16 + 2 * i);
+
+    /* Convergence flag is reset, so that the accumulated samples are checked again. */
+    for (int j = 0; j < 3; j++) {
+      EXPECT_FLOAT_EQ(pixel[aux + j], 8.0f + 2 * i + 2 * j);
+    }
+    EXPECT_EQ(pixel[aux + 3], 0.0f);
+  }
+}
+
+TEST(render_buffers_host_accumulate, different_layout)
+{
+  Stats stats;
+  Profiler profiler;
+  unique_ptr<Device> device(Device::create(Device::dummy_device(), stats, profiler));
+
+  BufferParams params = make_params(1);
+  RenderBuffers dst(device.get());
+  dst.reset(params);
+
+  params.width = 1;
+  params.update_passes();
+  RenderBuffers src(device.get());
+  src.reset(params);
+
+  dst.zero();
+  src.zero();
+
+  EXPECT_FALSE(render_buffers_host_accumulate(&dst, &src));
+  EXPECT_EQ(dst.params.samples, 1);
+}
+
+CCL_NAMESPACE_END
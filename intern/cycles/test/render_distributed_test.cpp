@@ -0,0 +1,331 @@
+/*
+ * Copyright 2011-2021 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "testing/testing.h"
+
+#include "device/device.h"
+
+#include "render/buffers.h"
+#include "render/camera.h"
+#include "render/distributed.h"
+#include "render/graph.h"
+#include "render/mesh.h"
+#include "render/nodes.h"
+#include "render/object.h"
+#include "render/pass.h"
+#include "render/scene.h"
+#include "render/session.h"
+#include "render/shader.h"
+
+#include "util/util_function.h"
+#include "util/util_profiling.h"
+#include "util/util_stats.h"
+#include "util/util_thread.h"
+#include "util/util_time.h"
+#include "util/util_unique_ptr.h"
+
+CCL_NAMESPACE_BEGIN
+
+TEST(distributed_split_frame, covers_frame)
+{
+  const vector<DistributedAssignment> assignments = distributed_split_frame(64, 37, 16, 4);
+  ASSERT_EQ(assignments.size(), 4);
+
+  int y = 0;
+  for (const DistributedAssignment &assignment : assignments) {
+    EXPECT_EQ(assignment.full_width, 64);
+    EXPECT_EQ(assignment.full_height, 37);
+    EXPECT_EQ(assignment.x, 0);
+    EXPECT_EQ(assignment.width, 64);
+    EXPECT_EQ(assignment.y, y);
+    EXPECT_GE(assignment.height, 9);
+    EXPECT_EQ(assignment.num_samples, 16);
+    EXPECT_TRUE(distributed_assignment_is_valid(assignment));
+    y += assignment.height;
+  }
+  EXPECT_EQ(y, 37);
+}
+
+TEST(distributed_split_frame, more_workers_than_rows)
+{
+  const vector<DistributedAssignment> assignments = distributed_split_frame(8, 3, 1, 4);
+  ASSERT_EQ(assignments.size(), 3);
+  for (const DistributedAssignment &assignment : assignments) {
+    EXPECT_EQ(assignment.height, 1);
+  }
+}
+
+TEST(distributed_assignment_is_valid, out_of_range)
+{
+  const DistributedAssignment valid = distributed_split_frame(64, 32, 16, 2)[1];
+  EXPECT_TRUE(distributed_assignment_is_valid(valid));
+
+  DistributedAssignment assignment = valid;
+  assignment.y = 17;
+  EXPECT_FALSE(distributed_assignment_is_valid(assignment));
+
+  assignment = valid;
+  assignment.x = -1;
+  EXPECT_FALSE(distributed_assignment_is_valid(assignment));
+
+  assignment = valid;
+  assignment.width = 65;
+  EXPECT_FALSE(distributed_assignment_is_valid(assignment));
+
+  assignment = valid;
+  assignment.height = 0;
+  EXPECT_FALSE(distributed_assignment_is_valid(assignment));
+
+  assignment = valid;
+  assignment.x = 0x7fffffff;
+  EXPECT_FALSE(distributed_assignment_is_valid(assignment));
+
+  assignment = valid;
+  assignment.full_width = -64;
+  EXPECT_FALSE(distributed_assignment_is_valid(assignment));
+
+  assignment = valid;
+  assignment.num_samples = 0;
+  EXPECT_FALSE(distributed_assignment_is_valid(assignment));
+}
+
+#ifndef _WIN32
+TEST(DistributedCoordinator, listen_requires_token)
+{
+  DistributedCoordinator coordinator;
+  EXPECT_FALSE(coordinator.listen(0, "0.0.0.0"));
+
+  DistributedCoordinator coordinator_with_token;
+  EXPECT_TRUE(coordinator_with_token.listen(0, "0.0.0.0", "secret"));
+}
+
+static unique_ptr<Device> test_device_create(Stats &stats, Profiler &profiler)
+{
+  return unique_ptr<Device>(
+      Device::create(Device::available_devices(DEVICE_MASK_CPU).front(), stats, profiler));
+}
+
+TEST(DistributedCoordinator, drop_wrong_token)
+{
+  DistributedCoordinator coordinator;
+  ASSERT_TRUE(coordinator.listen(0, "127.0.0.1", "secret"));
+  coordinator.set_timeout(2.0);
+  const int port = coordinator.get_port();
+
+  thread worker_thread([port]() {
+    DistributedWorker worker;
+    DistributedAssignment assignment;
+    if (worker.connect("127.0.0.1", port, "wrong")) {
+      EXPECT_FALSE(worker.receive_assignment(assignment));
+    }
+  });
+
+  Stats stats;
+  Profiler profiler;
+  unique_ptr<Device> device = test_device_create(stats, profiler);
+  RenderBuffers buffers(device.get());
+
+  /* The worker is dropped, so it is missing once the time is up. */
+  EXPECT_FALSE(coordinator.render(8, 8, 1, 1, &buffers));
+  EXPECT_EQ(coordinator.get_error(), "Only 0 of 1 workers connected within 2 seconds");
+
+  worker_thread.join();
+}
+
+TEST(DistributedCoordinator, missing_result_times_out)
+{
+  DistributedCoordinator coordinator;
+  ASSERT_TRUE(coordinator.listen(0));
+  coordinator.set_timeout(1.0);
+  const int port = coordinator.get_port();
+
+  /* Worker which takes the region, but never sends a result. */
+  thread worker_thread([port]() {
+    DistributedWorker worker;
+    DistributedAssignment assignment;
+    if (worker.connect("127.0.0.1", port) && worker.receive_assignment(assignment)) {
+      time_sleep(2.0);
+    }
+  });
+
+  Stats stats;
+  Profiler profiler;
+  unique_ptr<Device> device = test_device_create(stats, profiler);
+  RenderBuffers buffers(device.get());
+
+  EXPECT_FALSE(coordinator.render(8, 8, 1, 1, &buffers));
+  EXPECT_EQ(coordinator.get_error(), "Worker did not send its result within 1 seconds");
+
+  worker_thread.join();
+}
+
+/* Scene with a diffuse plane lit by the background, covering part of the frame. */
+static void test_scene_create(Scene *scene, const int width, const int height)
+{
+  Camera *camera = scene->camera;
+  camera->set_full_width(width);
+  camera->set_full_height(height);
+  camera->compute_auto_viewplane();
+
+  ShaderGraph *graph = new ShaderGraph();
+  BackgroundNode *background = graph->create_node<BackgroundNode>();
+  background->set_color(make_float3(0.8f, 0.9f, 1.0f));
+  background->set_strength(1.0f);
+  graph->add(background);
+  graph->connect(background->output("Background"), graph->output()->input("Surface"));
+  scene->default_background->set_graph(graph);
+  scene->default_background->tag_update(scene);
+
+  Mesh *mesh = scene->create_node<Mesh>();
+  array<Node *> used_shaders;
+  used_shaders.push_back_slow(scene->default_surface);
+  mesh->set_used_shaders(used_shaders);
+
+  array<float3> verts;
+  verts.push_back_slow(make_float3(-1.0f, -1.5f, 3.0f));
+  verts.push_back_slow(make_float3(1.5f, -1.0f, 4.0f));
+  verts.push_back_slow(make_float3(1.0f, 1.0f, 3.0f));
+  verts.push_back_slow(make_float3(-1.0f, 1.0f, 2.5f));
+  mesh->set_verts(verts);
+  mesh->reserve_mesh(4, 2);
+  mesh->add_triangle(0, 1, 2, 0, false);
+  mesh->add_triangle(0, 2, 3, 0, false);
+
+  Object *object = scene->create_node<Object>();
+  object->set_geometry(mesh);
+  object->set_tfm(transform_identity());
+
+  for (Pass *pass : scene->passes) {
+    if (pass->get_type() == PASS_COMBINED && pass->get_name().empty()) {
+      pass->set_name(ustring("combined"));
+    }
+  }
+}
+
+static SessionParams test_session_params(const int num_samples)
+{
+  SessionParams session_params;
+  session_params.device = Device::available_devices(DEVICE_MASK_CPU).front();
+  session_params.background = true;
+  session_params.samples = num_samples;
+  session_params.use_auto_tile = false;
+  return session_params;
+}
+
+/* Render the region of the full frame, the result is to be read from the session by the
+ * callback. */
+static void test_render(const DistributedAssignment &region,
+                        const function<void(Session &session)> &write_render_tile_cb)
+{
+  const SessionParams session_params = test_session_params(region.num_samples);
+  Session session(session_params, SceneParams());
+  test_scene_create(session.scene, region.full_width, region.full_height);
+
+  session.write_render_tile_cb = [&]() { write_render_tile_cb(session); };
+
+  BufferParams buffer_params;
+  buffer_params.full_x = region.x;
+  buffer_params.full_y = region.y;
+  buffer_params.width = region.width;
+  buffer_params.height = region.height;
+  buffer_params.full_width = region.full_width;
+  buffer_params.full_height = region.full_height;
+
+  session.reset(session_params, buffer_params);
+  session.start();
+  session.wait();
+}
+
+TEST(DistributedCoordinator, matches_single_process_render)
+{
+  const int full_width = 32, full_height = 24, num_samples = 4, num_workers = 3;
+
+  /* Reference render of the whole frame in this process. */
+  DistributedAssignment full_frame;
+  full_frame.full_width = full_width;
+  full_frame.full_height = full_height;
+  full_frame.width = full_width;
+  full_frame.height = full_height;
+  full_frame.num_samples = num_samples;
+
+  vector<float> reference_pixels(full_width * full_height * 4);
+  test_render(full_frame, [&](Session &session) {
+    EXPECT_TRUE(session.get_render_tile_pixels("combined", 4, reference_pixels.data()));
+  });
+  /* Same frame rendered by workers, each with its own session. */
+  DistributedCoordinator coordinator;
+  ASSERT_TRUE(coordinator.listen(0));
+  const int port = coordinator.get_port();
+
+  /* Connection from something else than a worker, which is dropped. */
+  thread *stray_connection = new thread([port]() {
+    DistributedWorker worker;
+    DistributedAssignment assignment;
+    if (worker.connect("127.0.0.1", port, "not a worker")) {
+      EXPECT_FALSE(worker.receive_assignment(assignment));
+    }
+  });
+
+  vector<thread *> workers;
+  for (int i = 0; i < num_workers; i++) {
+    workers.push_back(new thread([port, stray_connection, i]() {
+      /* Only connect after the stray connection was dropped. */
+      if (i == 0) {
+        stray_connection->join();
+      }
+
+      DistributedWorker worker;
+      DistributedAssignment assignment;
+      if (!worker.connect("127.0.0.1", port) || !worker.receive_assignment(assignment)) {
+        return;
+      }
+
+      test_render(assignment, [&](Session &session) {
+        RenderBuffers buffers(session.device);
+        session.copy_render_tile_to_buffers(&buffers);
+        worker.send_result(assignment, &buffers);
+      });
+    }));
+  }
+
+  Stats stats;
+  Profiler profiler;
+  unique_ptr<Device> device = test_device_create(stats, profiler);
+  RenderBuffers buffers(device.get());
+
+  const bool success = coordinator.render(
+      full_width, full_height, num_samples, num_workers, &buffers);
+
+  for (thread *worker : workers) {
+    worker->join();
+    delete worker;
+  }
+  delete stray_connection;
+
+  ASSERT_TRUE(success) << coordinator.get_error();
+  EXPECT_EQ(buffers.params.samples, num_samples);
+
+  vector<float> pixels(full_width * full_height * 4);
+  ASSERT_TRUE(distributed_get_render_pixels(&buffers, "combined", 4, pixels.data()));
+
+  /* Paths of a pixel do not depend on the region it is rendered in. */
+  for (int i = 0; i < pixels.size(); i++) {
+    EXPECT_FLOAT_EQ(pixels[i], reference_pixels[i]) << "pixel " << i / 4;
+  }
+}
+#endif
+
+CCL_NAMESPACE_END
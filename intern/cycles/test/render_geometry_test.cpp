@@ -0,0 +1,97 @@
+/*
+ * Copyright 2011-2021 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "testing/testing.h"
+
+#include "render/mesh.h"
+
+CCL_NAMESPACE_BEGIN
+
+/* Two triangles forming a quad, with a UV attribute. */
+static void create_quad(Mesh &mesh, const float offset = 0.0f)
+{
+  mesh.reserve_mesh(4, 2);
+  mesh.add_vertex(make_float3(0.0f, 0.0f, offset));
+  mesh.add_vertex(make_float3(1.0f, 0.0f, offset));
+  mesh.add_vertex(make_float3(1.0f, 1.0f, offset));
+  mesh.add_vertex(make_float3(0.0f, 1.0f, offset));
+  mesh.add_triangle(0, 1, 2, 0, true);
+  mesh.add_triangle(0, 2, 3, 0, true);
+
+  Attribute *attr = mesh.attributes.add(ustring("uv"), TypeFloat2, ATTR_ELEMENT_CORNER);
+  float2 *uv = attr->data_float2();
+  for (int i = 0; i < 6; i++) {
+    uv[i] = make_float2(i * 0.1f, 1.0f - i * 0.1f);
+  }
+}
+
+TEST(Geometry, identical_content)
+{
+  Mesh a, b;
+  create_quad(a);
+  create_quad(b);
+
+  EXPECT_TRUE(a.can_deduplicate());
+  EXPECT_TRUE(a.content_equals(b));
+  EXPECT_EQ(a.content_hash(), b.content_hash());
+}
+
+TEST(Geometry, float3_padding_is_ignored)
+{
+  Mesh a, b;
+  create_quad(a);
+  create_quad(b);
+
+  ((float *)&b.get_verts()[0])[3] = 42.0f;
+
+  EXPECT_TRUE(a.content_equals(b));
+  EXPECT_EQ(a.content_hash(), b.content_hash());
+}
+
+TEST(Geometry, different_vertices)
+{
+  Mesh a, b;
+  create_quad(a);
+  create_quad(b, 1.0f);
+
+  EXPECT_FALSE(a.content_equals(b));
+  EXPECT_NE(a.content_hash(), b.content_hash());
+}
+
+TEST(Geometry, different_attributes)
+{
+  Mesh a, b;
+  create_quad(a);
+  create_quad(b);
+
+  b.attributes.find(ustring("uv"))->data_float2()[3].x = 0.5f;
+  EXPECT_FALSE(a.content_equals(b));
+
+  b.attributes.remove(ustring("uv"));
+  EXPECT_FALSE(a.content_equals(b));
+  EXPECT_FALSE(b.content_equals(a));
+}
+
+TEST(Geometry, applied_transform_is_not_deduplicated)
+{
+  Mesh mesh;
+  create_quad(mesh);
+
+  mesh.transform_applied = true;
+  EXPECT_FALSE(mesh.can_deduplicate());
+}
+
+CCL_NAMESPACE_END
@@ -1536,4 +1536,58 @@ TEST_F(RenderGraph, constant_fold_convert_color_float_color)
   graph.finalize(scene);
 }
 
+/*
+ * Tests:
+ *  - Folding of mapping node with constant settings into the texture mapping.
+ */
+TEST_F(RenderGraph, fold_mapping_texture)
+{
+  EXPECT_ANY_MESSAGE(log);
+  CORRECT_INFO_MESSAGE(log, "Folded 1 mapping nodes into texture nodes.");
+
+  builder.add_node(ShaderNodeBuilder<GeometryNode>(graph, "Geometry"))
+      .add_node(ShaderNodeBuilder<MappingNode>(graph, "Mapping")
+                    .set_param("mapping_type", NODE_MAPPING_TYPE_POINT)
+                    .set("Location", make_float3(1.0f, 2.0f, 3.0f))
+                    .set("Scale", make_float3(2.0f, 2.0f, 2.0f)))
+      .add_node(ShaderNodeBuilder<NoiseTextureNode>(graph, "Noise"))
+      .add_connection("Geometry::Position", "Mapping::Vector")
+      .add_connection("Mapping::Vector", "Noise::Vector")
+      .output_color("Noise::Color");
+
+  graph.finalize(scene);
+
+  /* Output, geometry, noise and emission. */
+  EXPECT_EQ(graph.nodes.size(), 4);
+
+  TextureNode *noise = static_cast<TextureNode *>(builder.find_node("Noise"));
+  EXPECT_EQ(noise->tex_mapping.type, TextureMapping::POINT);
+  EXPECT_EQ(noise->tex_mapping.translation, make_float3(1.0f, 2.0f, 3.0f));
+  EXPECT_EQ(noise->tex_mapping.scale, make_float3(2.0f, 2.0f, 2.0f));
+}
+
+/*
+ * Tests:
+ *  - NOT folding of mapping node with linked settings.
+ */
+TEST_F(RenderGraph, fold_mapping_texture_linked)
+{
+  EXPECT_ANY_MESSAGE(log);
+  INVALID_INFO_MESSAGE(log, "Folded ");
+
+  builder.add_attribute("Attribute")
+      .add_node(ShaderNodeBuilder<GeometryNode>(graph, "Geometry"))
+      .add_node(ShaderNodeBuilder<MappingNode>(graph, "Mapping")
+                    .set_param("mapping_type", NODE_MAPPING_TYPE_POINT))
+      .add_node(ShaderNodeBuilder<NoiseTextureNode>(graph, "Noise"))
+      .add_connection("Geometry::Position", "Mapping::Vector")
+      .add_connection("Attribute::Vector", "Mapping::Location")
+      .add_connection("Mapping::Vector", "Noise::Vector")
+      .output_color("Noise::Color");
+
+  graph.finalize(scene);
+
+  EXPECT_EQ(graph.nodes.size(), 6);
+}
+
 CCL_NAMESPACE_END
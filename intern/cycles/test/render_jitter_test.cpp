@@ -0,0 +1,86 @@
+/*
+ * Copyright 2011-2021 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "testing/testing.h"
+
+#include <random>
+
+#include "render/jitter.h"
+#include "util/util_math.h"
+#include "util/util_vector.h"
+
+CCL_NAMESPACE_BEGIN
+
+static const int size = 64;
+
+TEST(blue_noise_generate, values_are_unique)
+{
+  vector<float> values(size * size);
+  blue_noise_generate(values.data(), size, 0);
+
+  vector<bool> used(size * size, false);
+  for (const float value : values) {
+    const int rank = (int)(value * (size * size));
+    ASSERT_GE(rank, 0);
+    ASSERT_LT(rank, size * size);
+    EXPECT_FALSE(used[rank]);
+    used[rank] = true;
+  }
+}
+
+/* Estimate a step function with a single sample per pixel, and compare the error after a box
+ * filter, which approximates how visible the noise is. */
+static float filtered_error(const vector<float> &values, const int filter_size)
+{
+  double error_sum = 0.0;
+  int num_blocks = 0;
+
+  for (int by = 0; by < size; by += filter_size) {
+    for (int bx = 0; bx < size; bx += filter_size) {
+      double error = 0.0;
+      for (int y = by; y < by + filter_size; y++) {
+        for (int x = bx; x < bx + filter_size; x++) {
+          error += ((values[y * size + x] < 0.5f) ? 1.0 : 0.0) - 0.5;
+        }
+      }
+      error /= filter_size * filter_size;
+      error_sum += error * error;
+      num_blocks++;
+    }
+  }
+
+  return (float)sqrt(error_sum / num_blocks);
+}
+
+TEST(blue_noise_generate, filtered_error)
+{
+  vector<float> blue_noise(size * size);
+  blue_noise_generate(blue_noise.data(), size, 0);
+
+  std::mt19937 rng(0);
+  std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+  vector<float> white_noise(size * size);
+  for (int i = 0; i < size * size; i++) {
+    white_noise[i] = distribution(rng);
+  }
+
+  for (int filter_size = 2; filter_size <= 8; filter_size *= 2) {
+    EXPECT_LT(filtered_error(blue_noise, filter_size),
+              0.7f * filtered_error(white_noise, filter_size));
+  }
+}
+
+CCL_NAMESPACE_END
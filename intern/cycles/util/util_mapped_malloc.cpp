@@ -0,0 +1,170 @@
+/*
+ * Copyright 2011-2021 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "util/util_mapped_malloc.h"
+#include "util/util_logging.h"
+#include "util/util_path.h"
+
+#ifdef _WIN32
+#  include "util/util_windows.h"
+#else
+#  include <fcntl.h>
+#  include <stdio.h>
+#  include <stdlib.h>
+#  include <sys/mman.h>
+#  include <sys/resource.h>
+#  include <unistd.h>
+#endif
+
+CCL_NAMESPACE_BEGIN
+
+void *util_mapped_malloc(size_t size, const string &directory)
+{
+#ifdef _WIN32
+  wchar_t filepath[MAX_PATH];
+  if (GetTempFileNameW(string_to_wstring(directory).c_str(), L"cyc", 0, filepath) == 0) {
+    LOG(ERROR) << "Error creating memory mapped file in " << directory;
+    return NULL;
+  }
+
+  /* The file is only accessed through the mapping, and deleted by the system once the file handle
+   * is closed and the view is unmapped, even if the process crashes. */
+  HANDLE file = CreateFileW(filepath,
+                            GENERIC_READ | GENERIC_WRITE,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                            NULL,
+                            CREATE_ALWAYS,
+                            FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE,
+                            NULL);
+  if (file == INVALID_HANDLE_VALUE) {
+    LOG(ERROR) << "Error opening memory mapped file in " << directory;
+    DeleteFileW(filepath);
+    return NULL;
+  }
+
+  const uint64_t size64 = size;
+  HANDLE mapping = CreateFileMappingW(
+      file, NULL, PAGE_READWRITE, (DWORD)(size64 >> 32), (DWORD)(size64 & 0xffffffff), NULL);
+  CloseHandle(file);
+
+  if (mapping == NULL) {
+    LOG(ERROR) << "Error resizing memory mapped file to " << string_human_readable_size(size);
+    return NULL;
+  }
+
+  void *ptr = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+  CloseHandle(mapping);
+
+  if (ptr == NULL) {
+    LOG(ERROR) << "Error mapping " << string_human_readable_size(size) << " of memory";
+    return NULL;
+  }
+
+  return ptr;
+#else
+  string filepath = path_join(directory, "cycles_mapped_XXXXXX");
+  const int fd = mkstemp(&filepath[0]);
+  if (fd == -1) {
+    LOG(ERROR) << "Error creating memory mapped file in " << directory;
+    return NULL;
+  }
+
+  /* The file is only accessed through the mapping, so remove it from the file system right away.
+   * Its storage is released once the mapping is gone, even if the process crashes. */
+  unlink(filepath.c_str());
+
+  if (ftruncate(fd, size) != 0) {
+    LOG(ERROR) << "Error resizing memory mapped file to " << string_human_readable_size(size);
+    close(fd);
+    return NULL;
+  }
+
+  void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+
+  if (ptr == MAP_FAILED) {
+    LOG(ERROR) << "Error mapping " << string_human_readable_size(size) << " of memory";
+    return NULL;
+  }
+
+  return ptr;
+#endif
+}
+
+void util_mapped_free(void *ptr, size_t size)
+{
+#ifdef _WIN32
+  (void)size;
+  if (ptr != NULL) {
+    UnmapViewOfFile(ptr);
+  }
+#else
+  if (ptr != NULL) {
+    munmap(ptr, size);
+  }
+#endif
+}
+
+uint64_t util_mapped_memory_page_ins()
+{
+#ifdef _WIN32
+  return 0;
+#else
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+  return usage.ru_majflt;
+#endif
+}
+
+double util_mapped_memory_stall_time()
+{
+#ifdef __linux__
+  /* Time the process waited for block I/O, which includes waiting for pages of mapped files to be
+   * read. Field 42 of the process status, only counted when the kernel has delay accounting
+   * enabled (delayacct boot option or kernel.task_delayacct sysctl). */
+  FILE *file = fopen("/proc/self/stat", "r");
+  if (file == NULL) {
+    return 0.0;
+  }
+
+  char buffer[1024];
+  const size_t len = fread(buffer, 1, sizeof(buffer) - 1, file);
+  fclose(file);
+  buffer[len] = '\0';
+
+  /* Skip process ID and the executable name, which may contain spaces. */
+  const char *fields = strrchr(buffer, ')');
+  if (fields == NULL) {
+    return 0.0;
+  }
+
+  /* Fields after the name start with the third field, the process state. */
+  vector<string> tokens;
+  string_split(tokens, fields + 1, " ");
+  const size_t blkio_ticks_index = 42 - 3;
+  if (tokens.size() <= blkio_ticks_index) {
+    return 0.0;
+  }
+
+  return (double)strtoull(tokens[blkio_ticks_index].c_str(), NULL, 10) / sysconf(_SC_CLK_TCK);
+#else
+  return 0.0;
+#endif
+}
+
+CCL_NAMESPACE_END
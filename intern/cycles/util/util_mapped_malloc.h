@@ -0,0 +1,44 @@
+/*
+ * Copyright 2011-2021 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __UTIL_MAPPED_MALLOC_H__
+#define __UTIL_MAPPED_MALLOC_H__
+
+#include "util/util_string.h"
+#include "util/util_types.h"
+
+CCL_NAMESPACE_BEGIN
+
+/* Allocate block of size bytes backed by an anonymous file in the given directory.
+ *
+ * Pages of such memory are written back to the file and read in again on demand by the operating
+ * system, so the memory does not need to stay resident. The returned pointer is page aligned.
+ * Returns NULL if the file or the mapping could not be created. */
+void *util_mapped_malloc(size_t size, const string &directory);
+
+/* Free memory allocated by util_mapped_malloc. The size must match the allocated one. */
+void util_mapped_free(void *ptr, size_t size);
+
+/* Number of pages read from disk by the current process (major page faults) since it started. */
+uint64_t util_mapped_memory_page_ins();
+
+/* Time in seconds the process was stalled waiting for pages to be read from disk. Zero when the
+ * platform does not provide this. */
+double util_mapped_memory_stall_time();
+
+CCL_NAMESPACE_END
+
+#endif /* __UTIL_MAPPED_MALLOC_H__ */
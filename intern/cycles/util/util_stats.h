@@ -26,7 +26,7 @@ class Stats {
  public:
   enum static_init_t { static_init = 0 };
 
-  Stats() : mem_used(0), mem_peak(0)
+  Stats() : mem_used(0), mem_peak(0), mem_mapped(0)
   {
   }
   explicit Stats(static_init_t)
@@ -45,8 +45,22 @@ class Stats {
     atomic_sub_and_fetch_z(&mem_used, size);
   }
 
+  /* Memory which is backed by a file mapping and is paged in on demand. Such memory is also
+   * accounted in the regular usage. */
+  void mem_mapped_alloc(size_t size)
+  {
+    atomic_add_and_fetch_z(&mem_mapped, size);
+  }
+
+  void mem_mapped_free(size_t size)
+  {
+    assert(mem_mapped >= size);
+    atomic_sub_and_fetch_z(&mem_mapped, size);
+  }
+
   size_t mem_used;
   size_t mem_peak;
+  size_t mem_mapped;
 };
 
 CCL_NAMESPACE_END
@@ -54,6 +54,9 @@ enum {
   IDTYPE_FLAGS_APPEND_IS_REUSABLE = 1 << 3,
   /** Indicates that the given IDType does not have animation data. */
   IDTYPE_FLAGS_NO_ANIMDATA = 1 << 4,
+  /** Indicates that #IDTypeInfo.blend_write of the given IDType only modifies the temporary copy
+   * of the ID and data owned by that ID, so that different IDs can be written in parallel. */
+  IDTYPE_FLAGS_BLEND_WRITE_THREADSAFE = 1 << 5,
 };
 
 typedef struct IDCacheKey {
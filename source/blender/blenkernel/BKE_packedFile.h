@@ -117,6 +117,10 @@ enum ePF_FileCompare BKE_packedfile_compare_to_file(const char *ref_file_name,
                                                     struct PackedFile *pf);
 
 /* read */
+/* Read the data of a packed file which was left in the .blend file when loading it, must be
+ * called before accessing #PackedFile.data. Returns false if the data could not be read, the
+ * data is zero-filled then. */
+bool BKE_packedfile_ensure_data(struct PackedFile *pf);
 int BKE_packedfile_seek(struct PackedFile *pf, int offset, int whence);
 void BKE_packedfile_rewind(struct PackedFile *pf);
 int BKE_packedfile_read(struct PackedFile *pf, void *data, int size);
@@ -217,6 +217,61 @@ bool BKE_appdir_folder_documents(char *dir)
   return true;
 }
 
+/**
+ * Get the user's cache directory, i.e.
+ * - Linux: `$XDG_CACHE_HOME/blender/`, defaulting to `$HOME/.cache/blender/`.
+ * - Windows: `%LOCALAPPDATA%\Blender Foundation\Blender\Cache\`.
+ * - macOS: `$HOME/Library/Caches/Blender/`.
+ *
+ * Falls back to the temporary directory when the platform location can't be found.
+ *
+ * \returns True if the path is set, the directory is not created.
+ */
+bool BKE_appdir_folder_caches(char *r_path, const size_t path_len)
+{
+  r_path[0] = '\0';
+
+#ifdef WIN32
+  const char *caches_root_path = BLI_getenv("LOCALAPPDATA");
+  if (caches_root_path && caches_root_path[0]) {
+    BLI_path_join(r_path,
+                  path_len,
+                  caches_root_path,
+                  "Blender Foundation",
+                  "Blender",
+                  "Cache",
+                  SEP_STR,
+                  NULL);
+    return true;
+  }
+#elif defined(__APPLE__)
+  const char *home_path = BKE_appdir_folder_home();
+  if (home_path && home_path[0]) {
+    BLI_path_join(r_path, path_len, home_path, "Library", "Caches", "Blender", SEP_STR, NULL);
+    return true;
+  }
+#else
+  const char *caches_root_path = BLI_getenv("XDG_CACHE_HOME");
+  if (caches_root_path && caches_root_path[0]) {
+    BLI_path_join(r_path, path_len, caches_root_path, "blender", SEP_STR, NULL);
+    return true;
+  }
+  const char *home_path = BKE_appdir_folder_home();
+  if (home_path && home_path[0]) {
+    BLI_path_join(r_path, path_len, home_path, ".cache", "blender", SEP_STR, NULL);
+    return true;
+  }
+#endif
+
+  const char *temp_path = BKE_tempdir_base();
+  if (temp_path && temp_path[0]) {
+    BLI_path_join(r_path, path_len, temp_path, "blender_cache", SEP_STR, NULL);
+    return true;
+  }
+
+  return false;
+}
+
 /**
  * Gets a good default directory for fonts.
  */
@@ -34,6 +34,8 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "CLG_log.h"
+
 #include "MEM_guardedalloc.h"
 
 #include "DNA_scene_types.h"
@@ -56,6 +58,8 @@
 
 #include "DEG_depsgraph.h"
 
+static CLG_LogRef LOG = {"bke.blender_undo"};
+
 /* -------------------------------------------------------------------- */
 /** \name Global Undo
  * \{ */
@@ -144,6 +148,13 @@ MemFileUndoData *BKE_memfile_undo_encode(Main *bmain, MemFileUndoData *mfu_prev)
     }
     /* success = */ /* UNUSED */ BLO_write_file_mem(bmain, prevfile, &mfu->memfile, fileflags);
     mfu->undo_size = mfu->memfile.size;
+
+    CLOG_INFO(&LOG,
+              1,
+              "memfile step: %zu KB new, %zu KB unchanged, %zu KB shared by content",
+              mfu->memfile.size / 1024,
+              mfu->memfile.size_identical / 1024,
+              mfu->memfile.size_deduplicated / 1024);
   }
 
   bmain->is_memfile_undo_written = true;
@@ -181,7 +181,7 @@ IDTypeInfo IDType_ID_HA = {
     .name = "Hair",
     .name_plural = "hairs",
     .translation_context = BLT_I18NCONTEXT_ID_HAIR,
-    .flags = IDTYPE_FLAGS_APPEND_IS_REUSABLE,
+    .flags = IDTYPE_FLAGS_APPEND_IS_REUSABLE | IDTYPE_FLAGS_BLEND_WRITE_THREADSAFE,
 
     .init_data = hair_init_data,
     .copy_data = hair_copy_data,
@@ -4562,6 +4562,7 @@ static ImBuf *load_image_single(Image *ima,
 
     imapf = BLI_findlink(&ima->packedfiles, view_id);
     if (imapf->packedfile) {
+      BKE_packedfile_ensure_data(imapf->packedfile);
       ibuf = IMB_ibImageFromMemory((unsigned char *)imapf->packedfile->data,
                                    imapf->packedfile->size,
                                    flag,
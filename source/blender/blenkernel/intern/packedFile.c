@@ -33,6 +33,8 @@
 #include "MEM_guardedalloc.h"
 #include <string.h>
 
+#include "atomic_ops.h"
+
 #include "DNA_ID.h"
 #include "DNA_image_types.h"
 #include "DNA_packedFile_types.h"
@@ -41,6 +43,7 @@
 #include "DNA_volume_types.h"
 
 #include "BLI_blenlib.h"
+#include "BLI_threads.h"
 #include "BLI_utildefines.h"
 
 #include "BKE_font.h"
@@ -55,6 +58,35 @@
 #include "IMB_imbuf_types.h"
 
 #include "BLO_read_write.h"
+#include "BLO_readfile.h"
+
+/* Deferred data may be needed by multiple threads at once, e.g. when rendering. */
+static ThreadMutex packedfile_deferred_mutex = BLI_MUTEX_INITIALIZER;
+
+bool BKE_packedfile_ensure_data(PackedFile *pf)
+{
+  bool success = true;
+
+  /* Once loaded the data stays, only take the lock while it may still be deferred. */
+  if (pf->deferred) {
+    BLI_mutex_lock(&packedfile_deferred_mutex);
+    if (pf->deferred) {
+      struct BlendDeferredData *deferred = pf->deferred;
+      pf->data = BLO_deferred_data_read(deferred);
+      if (pf->data == NULL) {
+        /* The whole code assumes packed files always have data. */
+        pf->data = MEM_callocN(pf->size, __func__);
+        success = false;
+      }
+      /* Publish the data before other threads can see the packed file as loaded. */
+      atomic_cas_ptr((void **)&pf->deferred, deferred, NULL);
+      BLO_deferred_data_free(deferred);
+    }
+    BLI_mutex_unlock(&packedfile_deferred_mutex);
+  }
+
+  return success;
+}
 
 int BKE_packedfile_seek(PackedFile *pf, int offset, int whence)
 {
@@ -96,6 +128,8 @@ void BKE_packedfile_rewind(PackedFile *pf)
 int BKE_packedfile_read(PackedFile *pf, void *data, int size)
 {
   if ((pf != NULL) && (size >= 0) && (data != NULL)) {
+    BKE_packedfile_ensure_data(pf);
+
     if (size + pf->seek > pf->size) {
       size = pf->size - pf->seek;
     }
@@ -155,9 +189,12 @@ int BKE_packedfile_count_all(Main *bmain)
 void BKE_packedfile_free(PackedFile *pf)
 {
   if (pf) {
-    BLI_assert(pf->data != NULL);
+    BLI_assert(pf->data != NULL || pf->deferred != NULL);
 
     MEM_SAFE_FREE(pf->data);
+    if (pf->deferred) {
+      BLO_deferred_data_free(pf->deferred);
+    }
     MEM_freeN(pf);
   }
   else {
@@ -168,12 +205,26 @@ void BKE_packedfile_free(PackedFile *pf)
 PackedFile *BKE_packedfile_duplicate(const PackedFile *pf_src)
 {
   BLI_assert(pf_src != NULL);
-  BLI_assert(pf_src->data != NULL);
+  BLI_assert(pf_src->data != NULL || pf_src->deferred != NULL);
 
-  PackedFile *pf_dst;
+  PackedFile *pf_dst = NULL;
 
-  pf_dst = MEM_dupallocN(pf_src);
-  pf_dst->data = MEM_dupallocN(pf_src->data);
+  if (pf_src->deferred) {
+    /* Another thread may be loading the deferred data of the source at the same time. */
+    BLI_mutex_lock(&packedfile_deferred_mutex);
+    if (pf_src->deferred) {
+      /* Keep the copy deferred as well, it reads its own data when needed. */
+      pf_dst = MEM_dupallocN(pf_src);
+      pf_dst->data = NULL;
+      pf_dst->deferred = BLO_deferred_data_duplicate(pf_src->deferred);
+    }
+    BLI_mutex_unlock(&packedfile_deferred_mutex);
+  }
+
+  if (pf_dst == NULL) {
+    pf_dst = MEM_dupallocN(pf_src);
+    pf_dst->data = MEM_dupallocN(pf_src->data);
+  }
 
   return pf_dst;
 }
@@ -333,6 +384,8 @@ int BKE_packedfile_write_to_file(ReportList *reports,
   /* make sure the path to the file exists... */
   BLI_make_existing_file(name);
 
+  BKE_packedfile_ensure_data(pf);
+
   file = BLI_open(name, O_BINARY + O_WRONLY + O_CREAT + O_TRUNC, 0666);
   if (file == -1) {
     BKE_reportf(reports, RPT_ERROR, "Error creating file '%s'", name);
@@ -409,6 +462,7 @@ enum ePF_FileCompare BKE_packedfile_compare_to_file(const char *ref_file_name,
     else {
       ret_val = PF_CMP_EQUAL;
 
+      BKE_packedfile_ensure_data(pf);
       for (int i = 0; i < pf->size; i += sizeof(buf)) {
         int len = pf->size - i;
         if (len > sizeof(buf)) {
@@ -535,7 +589,8 @@ static void unpack_generate_paths(const char *name,
     if (id_type == ID_IM) {
       ImagePackedFile *imapf = ((Image *)id)->packedfiles.last;
       if (imapf != NULL && imapf->packedfile != NULL) {
-        const PackedFile *pf = imapf->packedfile;
+        PackedFile *pf = imapf->packedfile;
+        BKE_packedfile_ensure_data(pf);
         enum eImbFileType ftype = IMB_ispic_type_from_memory((const uchar *)pf->data, pf->size);
         if (ftype != IMB_FTYPE_NONE) {
           const int imtype = BKE_image_ftype_to_imtype(ftype, NULL);
@@ -881,7 +936,12 @@ void BKE_packedfile_blend_write(BlendWriter *writer, PackedFile *pf)
   if (pf == NULL) {
     return;
   }
-  BLO_write_struct(writer, PackedFile, pf);
+  BKE_packedfile_ensure_data(pf);
+
+  /* Clear runtime data. */
+  PackedFile pf_tmp = *pf;
+  pf_tmp.deferred = NULL;
+  BLO_write_struct_at_address(writer, PackedFile, pf, &pf_tmp);
   BLO_write_raw(writer, pf->size, pf->data);
 }
 
@@ -893,6 +953,14 @@ void BKE_packedfile_blend_read(BlendDataReader *reader, PackedFile **pf_p)
     return;
   }
 
+  /* Large data may still be in the file, it's read when first needed. Always assigned, so the
+   * runtime pointer stored in older files is never used. */
+  pf->deferred = BLO_read_get_deferred_data(reader, pf->data);
+  if (pf->deferred) {
+    pf->data = NULL;
+    return;
+  }
+
   BLO_read_packed_address(reader, &pf->data);
   if (pf->data == NULL) {
     /* We cannot allow a PackedFile with a NULL data field,
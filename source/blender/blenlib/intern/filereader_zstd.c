@@ -28,9 +28,33 @@
 #include "BLI_endian_switch.h"
 #include "BLI_filereader.h"
 #include "BLI_math_base.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
 
 #include "MEM_guardedalloc.h"
 
+/* Maximum number of frames which are decompressed ahead of the reading position. */
+#define ZSTD_READ_AHEAD_MAX_FRAMES 16
+
+typedef enum eZstdReadAheadState {
+  ZSTD_READ_AHEAD_NONE = 0,
+  /** Compressed data is read, waiting for a thread to decompress it. */
+  ZSTD_READ_AHEAD_QUEUED,
+  ZSTD_READ_AHEAD_RUNNING,
+  /** Decompression finished, uncompressed data is NULL when it failed. */
+  ZSTD_READ_AHEAD_DONE,
+} eZstdReadAheadState;
+
+typedef struct ZstdReadAheadFrame {
+  int frame;
+  eZstdReadAheadState state;
+
+  char *compressed_data;
+  size_t compressed_size;
+  char *uncompressed_data;
+  size_t uncompressed_size;
+} ZstdReadAheadFrame;
+
 typedef struct {
   FileReader reader;
 
@@ -48,6 +72,20 @@ typedef struct {
     char *cached_content;
     int cached_frame;
   } seek;
+
+  /* When frames are accessed sequentially, the following frames are decompressed on worker
+   * threads while the current one is being parsed. */
+  struct {
+    TaskPool *pool;
+    /** Protects the state of the frames, which are used as ring buffer indexed by frame. */
+    ThreadMutex mutex;
+    ThreadCondition condition;
+
+    ZstdReadAheadFrame *frames;
+    int num_frames;
+    /** Next frame to be scheduled for decompression. */
+    int next_frame;
+  } read_ahead;
 } ZstdReader;
 
 static bool zstd_read_u32(FileReader *base, uint32_t *val)
@@ -170,6 +208,193 @@ static int zstd_frame_from_pos(ZstdReader *zstd, size_t pos)
   return low;
 }
 
+/* Read the compressed data of a frame from the underlying file. */
+static char *zstd_read_compressed_frame(ZstdReader *zstd, int frame, size_t *r_compressed_size)
+{
+  size_t compressed_size = zstd->seek.compressed_ofs[frame + 1] - zstd->seek.compressed_ofs[frame];
+
+  char *compressed_data = MEM_mallocN(compressed_size, __func__);
+  if (zstd->base->seek(zstd->base, zstd->seek.compressed_ofs[frame], SEEK_SET) < 0 ||
+      zstd->base->read(zstd->base, compressed_data, compressed_size) < compressed_size) {
+    MEM_freeN(compressed_data);
+    return NULL;
+  }
+
+  *r_compressed_size = compressed_size;
+  return compressed_data;
+}
+
+/* -------------------------------------------------------------------- */
+/** \name Read-Ahead
+ *
+ * Reading the underlying file stays on the reading thread, only decompression is done by worker
+ * threads. A frame which is needed before a worker started on it is decompressed by the reading
+ * thread itself, so it never waits for a task which did not start yet.
+ * \{ */
+
+static void zstd_read_ahead_decompress(ZstdReadAheadFrame *slot)
+{
+  char *uncompressed_data = MEM_mallocN(slot->uncompressed_size, __func__);
+  size_t res = ZSTD_decompress(uncompressed_data,
+                               slot->uncompressed_size,
+                               slot->compressed_data,
+                               slot->compressed_size);
+  MEM_SAFE_FREE(slot->compressed_data);
+  if (ZSTD_isError(res) || res < slot->uncompressed_size) {
+    MEM_SAFE_FREE(uncompressed_data);
+  }
+
+  slot->uncompressed_data = uncompressed_data;
+}
+
+/* Decompress the frame of the slot unless another thread already started on it.
+ * Must be called with the mutex locked. */
+static void zstd_read_ahead_run_locked(ZstdReader *zstd, ZstdReadAheadFrame *slot)
+{
+  if (slot->state != ZSTD_READ_AHEAD_QUEUED) {
+    return;
+  }
+
+  slot->state = ZSTD_READ_AHEAD_RUNNING;
+  BLI_mutex_unlock(&zstd->read_ahead.mutex);
+
+  zstd_read_ahead_decompress(slot);
+
+  BLI_mutex_lock(&zstd->read_ahead.mutex);
+  slot->state = ZSTD_READ_AHEAD_DONE;
+  BLI_condition_notify_all(&zstd->read_ahead.condition);
+}
+
+static void zstd_read_ahead_task(TaskPool *__restrict pool, void *taskdata)
+{
+  ZstdReader *zstd = BLI_task_pool_user_data(pool);
+  ZstdReadAheadFrame *slot = taskdata;
+
+  BLI_mutex_lock(&zstd->read_ahead.mutex);
+  zstd_read_ahead_run_locked(zstd, slot);
+  BLI_mutex_unlock(&zstd->read_ahead.mutex);
+}
+
+/* Make the slot available for another frame. Must be called with the mutex locked. */
+static void zstd_read_ahead_release_locked(ZstdReader *zstd, ZstdReadAheadFrame *slot)
+{
+  while (slot->state == ZSTD_READ_AHEAD_RUNNING) {
+    BLI_condition_wait(&zstd->read_ahead.condition, &zstd->read_ahead.mutex);
+  }
+
+  MEM_SAFE_FREE(slot->compressed_data);
+  MEM_SAFE_FREE(slot->uncompressed_data);
+  slot->state = ZSTD_READ_AHEAD_NONE;
+  slot->frame = -1;
+}
+
+static void zstd_read_ahead_schedule(ZstdReader *zstd, int frame)
+{
+  ZstdReadAheadFrame *slot = &zstd->read_ahead.frames[frame % zstd->read_ahead.num_frames];
+
+  size_t compressed_size;
+  char *compressed_data = zstd_read_compressed_frame(zstd, frame, &compressed_size);
+
+  BLI_mutex_lock(&zstd->read_ahead.mutex);
+  zstd_read_ahead_release_locked(zstd, slot);
+  if (compressed_data == NULL) {
+    /* Leave error handling to the reading thread, when it gets to this frame. */
+    BLI_mutex_unlock(&zstd->read_ahead.mutex);
+    return;
+  }
+
+  slot->frame = frame;
+  slot->compressed_data = compressed_data;
+  slot->compressed_size = compressed_size;
+  slot->uncompressed_size = zstd->seek.uncompressed_ofs[frame + 1] -
+                            zstd->seek.uncompressed_ofs[frame];
+  slot->state = ZSTD_READ_AHEAD_QUEUED;
+  BLI_mutex_unlock(&zstd->read_ahead.mutex);
+
+  BLI_task_pool_push(zstd->read_ahead.pool, zstd_read_ahead_task, slot, false, NULL);
+}
+
+/* Schedule decompression of the frames following the given one. */
+static void zstd_read_ahead_update(ZstdReader *zstd, int frame)
+{
+  if (zstd->read_ahead.pool == NULL) {
+    const int num_threads = BLI_system_thread_count();
+    if (num_threads < 2 || zstd->seek.num_frames < 2) {
+      return;
+    }
+
+    zstd->read_ahead.num_frames = min_ii(num_threads, ZSTD_READ_AHEAD_MAX_FRAMES);
+    zstd->read_ahead.frames = MEM_calloc_arrayN(
+        zstd->read_ahead.num_frames, sizeof(ZstdReadAheadFrame), __func__);
+    for (int i = 0; i < zstd->read_ahead.num_frames; i++) {
+      zstd->read_ahead.frames[i].frame = -1;
+    }
+    BLI_mutex_init(&zstd->read_ahead.mutex);
+    BLI_condition_init(&zstd->read_ahead.condition);
+    zstd->read_ahead.pool = BLI_task_pool_create(zstd, TASK_PRIORITY_HIGH);
+  }
+
+  const int last_frame = min_ii(frame + zstd->read_ahead.num_frames,
+                                zstd->seek.num_frames - 1);
+  if (zstd->read_ahead.next_frame <= frame || zstd->read_ahead.next_frame > last_frame + 1) {
+    /* Reading continues sequentially from a different position than before. */
+    zstd->read_ahead.next_frame = frame + 1;
+  }
+
+  for (; zstd->read_ahead.next_frame <= last_frame; zstd->read_ahead.next_frame++) {
+    zstd_read_ahead_schedule(zstd, zstd->read_ahead.next_frame);
+  }
+}
+
+/* Take the uncompressed data of the frame if it was scheduled, waiting for it if needed.
+ * Returns NULL if the frame was not scheduled or decompression failed. */
+static char *zstd_read_ahead_take(ZstdReader *zstd, int frame)
+{
+  if (zstd->read_ahead.pool == NULL) {
+    return NULL;
+  }
+
+  ZstdReadAheadFrame *slot = &zstd->read_ahead.frames[frame % zstd->read_ahead.num_frames];
+
+  BLI_mutex_lock(&zstd->read_ahead.mutex);
+  char *uncompressed_data = NULL;
+  if (slot->frame == frame) {
+    zstd_read_ahead_run_locked(zstd, slot);
+    while (slot->state == ZSTD_READ_AHEAD_RUNNING) {
+      BLI_condition_wait(&zstd->read_ahead.condition, &zstd->read_ahead.mutex);
+    }
+
+    uncompressed_data = slot->uncompressed_data;
+    slot->uncompressed_data = NULL;
+    zstd_read_ahead_release_locked(zstd, slot);
+  }
+  BLI_mutex_unlock(&zstd->read_ahead.mutex);
+
+  return uncompressed_data;
+}
+
+static void zstd_read_ahead_free(ZstdReader *zstd)
+{
+  if (zstd->read_ahead.pool == NULL) {
+    return;
+  }
+
+  /* Discard tasks which did not start yet and wait for the running ones. */
+  BLI_task_pool_cancel(zstd->read_ahead.pool);
+  BLI_task_pool_free(zstd->read_ahead.pool);
+
+  for (int i = 0; i < zstd->read_ahead.num_frames; i++) {
+    MEM_SAFE_FREE(zstd->read_ahead.frames[i].compressed_data);
+    MEM_SAFE_FREE(zstd->read_ahead.frames[i].uncompressed_data);
+  }
+  MEM_freeN(zstd->read_ahead.frames);
+
+  BLI_mutex_end(&zstd->read_ahead.mutex);
+  BLI_condition_end(&zstd->read_ahead.condition);
+}
+
+/** \} */
+
 /* Ensure that the currently loaded frame is the correct one. */
 static const char *zstd_ensure_cache(ZstdReader *zstd, int frame)
 {
@@ -178,32 +403,42 @@ static const char *zstd_ensure_cache(ZstdReader *zstd, int frame)
     return zstd->seek.cached_content;
   }
 
+  /* Start reading ahead once the file is being read sequentially. */
+  const bool is_sequential = (frame > 0 && frame == zstd->seek.cached_frame + 1);
+
   /* Cached frame doesn't match, so discard it and cache the wanted one instead. */
   MEM_SAFE_FREE(zstd->seek.cached_content);
+  zstd->seek.cached_frame = -1;
 
-  size_t compressed_size = zstd->seek.compressed_ofs[frame + 1] - zstd->seek.compressed_ofs[frame];
-  size_t uncompressed_size = zstd->seek.uncompressed_ofs[frame + 1] -
-                             zstd->seek.uncompressed_ofs[frame];
+  char *uncompressed_data = zstd_read_ahead_take(zstd, frame);
+  const bool is_read_ahead = (uncompressed_data != NULL);
+  if (uncompressed_data == NULL) {
+    size_t compressed_size;
+    char *compressed_data = zstd_read_compressed_frame(zstd, frame, &compressed_size);
+    if (compressed_data == NULL) {
+      return NULL;
+    }
 
-  char *uncompressed_data = MEM_mallocN(uncompressed_size, __func__);
-  char *compressed_data = MEM_mallocN(compressed_size, __func__);
-  if (zstd->base->seek(zstd->base, zstd->seek.compressed_ofs[frame], SEEK_SET) < 0 ||
-      zstd->base->read(zstd->base, compressed_data, compressed_size) < compressed_size) {
-    MEM_freeN(compressed_data);
-    MEM_freeN(uncompressed_data);
-    return NULL;
-  }
+    size_t uncompressed_size = zstd->seek.uncompressed_ofs[frame + 1] -
+                               zstd->seek.uncompressed_ofs[frame];
+    uncompressed_data = MEM_mallocN(uncompressed_size, __func__);
 
-  size_t res = ZSTD_decompressDCtx(
-      zstd->ctx, uncompressed_data, uncompressed_size, compressed_data, compressed_size);
-  MEM_freeN(compressed_data);
-  if (ZSTD_isError(res) || res < uncompressed_size) {
-    MEM_freeN(uncompressed_data);
-    return NULL;
+    size_t res = ZSTD_decompressDCtx(
+        zstd->ctx, uncompressed_data, uncompressed_size, compressed_data, compressed_size);
+    MEM_freeN(compressed_data);
+    if (ZSTD_isError(res) || res < uncompressed_size) {
+      MEM_freeN(uncompressed_data);
+      return NULL;
+    }
   }
 
   zstd->seek.cached_frame = frame;
   zstd->seek.cached_content = uncompressed_data;
+
+  if (is_sequential || is_read_ahead) {
+    zstd_read_ahead_update(zstd, frame);
+  }
+
   return uncompressed_data;
 }
 
@@ -295,6 +530,7 @@ static void zstd_close(FileReader *reader)
 
   ZSTD_freeDCtx(zstd->ctx);
   if (zstd->reader.seek) {
+    zstd_read_ahead_free(zstd);
     MEM_freeN(zstd->seek.uncompressed_ofs);
     MEM_freeN(zstd->seek.compressed_ofs);
     MEM_freeN(zstd->seek.cached_content);
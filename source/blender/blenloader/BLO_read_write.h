@@ -54,6 +54,7 @@ typedef struct BlendExpander BlendExpander;
 typedef struct BlendLibReader BlendLibReader;
 typedef struct BlendWriter BlendWriter;
 
+struct BlendDeferredData;
 struct BlendFileReadReport;
 struct Main;
 struct ReportList;
@@ -200,6 +201,12 @@ void *BLO_read_get_new_packed_address(BlendDataReader *reader, const void *old_a
 #define BLO_read_packed_address(reader, ptr_p) \
   *((void **)ptr_p) = BLO_read_get_new_packed_address((reader), *(ptr_p))
 
+/* Returns the location of data which was left in the file because of
+ * #BLO_READ_DEFER_PACKED_DATA, or NULL when the data was read normally. The caller takes
+ * ownership, see #BLO_deferred_data_read. */
+struct BlendDeferredData *BLO_read_get_deferred_data(BlendDataReader *reader,
+                                                     const void *old_address);
+
 typedef void (*BlendReadListFn)(BlendDataReader *reader, void *data);
 void BLO_read_list_cb(BlendDataReader *reader, struct ListBase *list, BlendReadListFn callback);
 void BLO_read_list(BlendDataReader *reader, struct ListBase *list);
@@ -82,7 +82,7 @@ typedef struct BlendFileData {
 } BlendFileData;
 
 struct BlendFileReadParams {
-  uint skip_flags : 3; /* #eBLOReadSkip */
+  uint skip_flags : 4; /* #eBLOReadSkip */
   uint is_startup : 1;
 
   /** Whether we are reading the memfile for an undo or a redo. */
@@ -100,6 +100,11 @@ typedef struct BlendFileReadReport {
     double lib_overrides;
     double lib_overrides_resync;
     double lib_overrides_recursive_resync;
+    /* Main file only: indexing all blocks and decoding their data in parallel, reading the
+     * decoded data into IDs and versioning. */
+    double decode_blocks;
+    double read_data;
+    double versioning;
   } duration;
 
   /* Count information. */
@@ -121,6 +126,10 @@ typedef struct BlendFileReadReport {
     int proxies_to_lib_overrides_success;
     /* Number of proxies that failed to convert to library overrides. */
     int proxies_to_lib_overrides_failures;
+
+    /* Number of blocks in the main file, and how many of those were decoded in parallel. */
+    int read_blocks;
+    int decoded_blocks;
   } count;
 
   /* Number of libraries which had overrides that needed to be resynced, and a single linked list
@@ -137,6 +146,11 @@ typedef enum eBLOReadSkip {
   BLO_READ_SKIP_DATA = (1 << 1),
   /** Do not attempt to re-use IDs from old bmain for unchanged ones in case of undo. */
   BLO_READ_SKIP_UNDO_OLD_MAIN = (1 << 2),
+  /**
+   * Leave the data of large packed files in the file until it is first accessed, see
+   * #BKE_packedfile_ensure_data. Only has an effect for uncompressed files.
+   */
+  BLO_READ_DEFER_PACKED_DATA = (1 << 3),
 } eBLOReadSkip;
 #define BLO_READ_SKIP_ALL (BLO_READ_SKIP_USERDEF | BLO_READ_SKIP_DATA)
 
@@ -157,6 +171,22 @@ void BLO_blendfiledata_free(BlendFileData *bfd);
 
 /** \} */
 
+/* -------------------------------------------------------------------- */
+/** \name BLO Deferred Data API
+ *
+ * Location of a data block which was left in the file while reading it, so it can be read later.
+ * \{ */
+
+struct BlendDeferredData;
+
+/* Read the data from the file, returns NULL when the file can't be read or was modified since
+ * it was opened. */
+void *BLO_deferred_data_read(const struct BlendDeferredData *deferred);
+struct BlendDeferredData *BLO_deferred_data_duplicate(const struct BlendDeferredData *deferred);
+void BLO_deferred_data_free(struct BlendDeferredData *deferred);
+
+/** \} */
+
 /* -------------------------------------------------------------------- */
 /** \name BLO Blend File Handle API
  * \{ */
@@ -26,6 +26,10 @@
 
 #include "BLI_filereader.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 struct GHash;
 struct Scene;
 
@@ -34,8 +38,13 @@ typedef struct {
   const char *buf;
   /** Size in bytes. */
   size_t size;
-  /** When true, this chunk doesn't own the memory, it's shared with a previous #MemFileChunk */
+  /** When true, this chunk is identical to the matching one (same position) in the previous
+   * step, and shares its memory. Used by undo code to detect unchanged IDs. */
   bool is_identical;
+  /** When true, this chunk doesn't own the memory, it's shared with a previous #MemFileChunk.
+   * Always set for identical chunks, but also for chunks which only have the same content as some
+   * other chunk of the previous step. */
+  bool is_shared;
   /** When true, this chunk is also identical to the one in the next step (used by undo code to
    * detect unchanged IDs).
    * Defined when writing the next step (i.e. last undo step has those always false). */
@@ -43,11 +52,21 @@ typedef struct {
   /** Session UUID of the ID being currently written (MAIN_ID_SESSION_UUID_UNSET when not writing
    * ID-related data). Used to find matching chunks in previous memundo step. */
   uint id_session_uuid;
+  /** Hash of the chunk content, used to find chunks with identical content in the next step. */
+  uint hash;
+  /** Unique for every newly written chunk, and passed on to chunks sharing its memory in later
+   * steps. Chunks with the same id have the same content. */
+  uint64_t content_id;
 } MemFileChunk;
 
 typedef struct MemFile {
   ListBase chunks;
+  /** Size of the memory owned by this memfile (i.e. not shared with previous steps). */
   size_t size;
+  /** Size of the memory shared with the previous step, for chunks that are identical at the same
+   * position, and for chunks that were found elsewhere in the previous step by their content. */
+  size_t size_identical;
+  size_t size_deduplicated;
 } MemFile;
 
 typedef struct MemFileWriteData {
@@ -59,6 +78,8 @@ typedef struct MemFileWriteData {
 
   /** Maps an ID session uuid to its first reference MemFileChunk, if existing. */
   struct GHash *id_session_uuid_mapping;
+  /** Set of all reference MemFileChunk, looked up by their content. */
+  struct GHash *chunk_by_content;
 } MemFileWriteData;
 
 typedef struct MemFileUndoData {
@@ -97,4 +118,20 @@ extern struct Main *BLO_memfile_main_get(struct MemFile *memfile,
                                          struct Scene **r_scene);
 extern bool BLO_memfile_write_file(struct MemFile *memfile, const char *filename);
 
+/* Incremental writing of memfiles to the same file, see #BLO_memfile_write_file_incremental. */
+typedef struct MemFileIncrementalWrite MemFileIncrementalWrite;
+
+MemFileIncrementalWrite *BLO_memfile_incremental_new(void);
+void BLO_memfile_incremental_free(MemFileIncrementalWrite *incremental);
+bool BLO_memfile_write_file_incremental(MemFileIncrementalWrite *incremental,
+                                        struct MemFile *memfile,
+                                        const char *filename);
+void BLO_memfile_incremental_discard(const char *filename);
+bool BLO_memfile_incremental_exists(const char *filename);
+bool BLO_memfile_incremental_recover(const char *filename, const char *filepath_dst);
+
 FileReader *BLO_memfile_new_filereader(MemFile *memfile, int undo_direction);
+
+#ifdef __cplusplus
+}
+#endif
@@ -61,22 +61,30 @@
 
 #include "MEM_guardedalloc.h"
 
+#include "atomic_ops.h"
+
 #include "BLI_blenlib.h"
 #include "BLI_endian_defines.h"
 #include "BLI_endian_switch.h"
 #include "BLI_ghash.h"
+#include "BLI_hash_mm2a.h"
 #include "BLI_linklist.h"
 #include "BLI_math.h"
 #include "BLI_memarena.h"
 #include "BLI_mempool.h"
+#include "BLI_system.h"
+#include "BLI_task.h"
 #include "BLI_threads.h"
 
+#include BLI_SYSTEM_PID_H
+
 #include "PIL_time.h"
 
 #include "BLT_translation.h"
 
 #include "BKE_anim_data.h"
 #include "BKE_animsys.h"
+#include "BKE_appdir.h"
 #include "BKE_asset.h"
 #include "BKE_collection.h"
 #include "BKE_global.h" /* for G */
@@ -196,6 +204,8 @@ static void *read_struct(FileData *fd, BHead *bh, const char *blockname);
 static BHead *find_bhead_from_code_name(FileData *fd, const short idcode, const char *name);
 static BHead *find_bhead_from_idname(FileData *fd, const char *idname);
 static bool library_link_idcode_needs_tag_check(const short idcode, const int flag);
+static const char *dataname(short id_code);
+static void read_file_decode_end(FileData *fd);
 
 typedef struct BHeadN {
   struct BHeadN *next, *prev;
@@ -206,6 +216,8 @@ typedef struct BHeadN {
   bool has_data;
 #endif
   bool is_memchunk_identical;
+  /** Data decoded ahead of time by #read_file_decode_blocks, owned until taken by #read_struct. */
+  void *decoded_data;
   struct BHead bhead;
 } BHeadN;
 
@@ -272,11 +284,20 @@ typedef struct OldNewMap {
 #define MAP_CAPACITY(onm) (1ll << ((onm)->capacity_exp + 1))
 #define SLOT_MASK(onm) (MAP_CAPACITY(onm) - 1)
 #define DEFAULT_SIZE_EXP 6
+/* Maximum size kept when clearing the map, bigger maps are shrunk to the default size. */
+#define MAX_KEEP_SIZE_EXP 16
 #define PERTURB_SHIFT 5
 
+/* Same as #BLI_ghashutil_ptrhash, inlined since this is called for every pointer that is read. */
+BLI_INLINE uint32_t oldnewmap_hash(const void *ptr)
+{
+  const size_t y = (size_t)ptr;
+  return (uint32_t)(y >> 4) | ((uint32_t)y << (sizeof(uint32_t[8]) - 4));
+}
+
 /* based on the probing algorithm used in Python dicts. */
 #define ITER_SLOTS(onm, KEY, SLOT_NAME, INDEX_NAME) \
-  uint32_t hash = BLI_ghashutil_ptrhash(KEY); \
+  uint32_t hash = oldnewmap_hash(KEY); \
   uint32_t mask = SLOT_MASK(onm); \
   uint perturb = hash; \
   int SLOT_NAME = mask & hash; \
@@ -419,8 +440,29 @@ static void oldnewmap_clear(OldNewMap *onm)
     }
   }
 
-  onm->capacity_exp = DEFAULT_SIZE_EXP;
-  oldnewmap_clear_map(onm);
+  /* Keep the capacity for the next ID, which likely needs a similar amount of entries, so that
+   * the map does not have to grow again for every ID. */
+  if (onm->capacity_exp > MAX_KEEP_SIZE_EXP) {
+    onm->capacity_exp = DEFAULT_SIZE_EXP;
+    onm->entries = MEM_reallocN(onm->entries, sizeof(*onm->entries) * ENTRIES_CAPACITY(onm));
+    onm->map = MEM_reallocN(onm->map, sizeof(*onm->map) * MAP_CAPACITY(onm));
+    oldnewmap_clear_map(onm);
+  }
+  else if (onm->nentries < MAP_CAPACITY(onm) / 64) {
+    /* Only few slots are used (e.g. a small ID after a big one), reset just those. Other entries
+     * can be in the probe sequence of an entry, so do not stop at empty slots. */
+    for (int i = 0; i < onm->nentries; i++) {
+      ITER_SLOTS (onm, onm->entries[i].oldp, slot, index) {
+        if (index == i) {
+          onm->map[slot] = -1;
+          break;
+        }
+      }
+    }
+  }
+  else {
+    oldnewmap_clear_map(onm);
+  }
   onm->nentries = 0;
 }
 
@@ -435,6 +477,7 @@ static void oldnewmap_free(OldNewMap *onm)
 #undef MAP_CAPACITY
 #undef SLOT_MASK
 #undef DEFAULT_SIZE_EXP
+#undef MAX_KEEP_SIZE_EXP
 #undef PERTURB_SHIFT
 #undef ITER_SLOTS
 
@@ -763,6 +806,44 @@ static void bh8_from_bh4(BHead *bhead, BHead4 *bhead4)
   }
 }
 
+/**
+ * Convert a block header as stored in the file (#BHead4 or #BHead8, depending on
+ * #FD_FLAGS_FILE_POINTSIZE_IS_4) to the #BHead of this platform.
+ */
+static void bhead_from_file_bhead(const FileData *fd, void *bhead_file, BHead *r_bhead)
+{
+  if (fd->flags & FD_FLAGS_FILE_POINTSIZE_IS_4) {
+    BHead4 *bhead4 = bhead_file;
+    if (fd->flags & FD_FLAGS_SWITCH_ENDIAN) {
+      switch_endian_bh4(bhead4);
+    }
+
+    if (fd->flags & FD_FLAGS_POINTSIZE_DIFFERS) {
+      bh8_from_bh4(r_bhead, bhead4);
+    }
+    else {
+      /* MIN2 is only to quiet '-Warray-bounds' compiler warning. */
+      BLI_assert(sizeof(*r_bhead) == sizeof(*bhead4));
+      memcpy(r_bhead, bhead4, MIN2(sizeof(*r_bhead), sizeof(*bhead4)));
+    }
+  }
+  else {
+    BHead8 *bhead8 = bhead_file;
+    if (fd->flags & FD_FLAGS_SWITCH_ENDIAN) {
+      switch_endian_bh8(bhead8);
+    }
+
+    if (fd->flags & FD_FLAGS_POINTSIZE_DIFFERS) {
+      bh4_from_bh8(r_bhead, bhead8, (fd->flags & FD_FLAGS_SWITCH_ENDIAN) != 0);
+    }
+    else {
+      /* MIN2 is only to quiet '-Warray-bounds' compiler warning. */
+      BLI_assert(sizeof(*r_bhead) == sizeof(*bhead8));
+      memcpy(r_bhead, bhead8, MIN2(sizeof(*r_bhead), sizeof(*bhead8)));
+    }
+  }
+}
+
 static BHeadN *get_bhead(FileData *fd)
 {
   BHeadN *new_bhead = NULL;
@@ -788,18 +869,7 @@ static BHeadN *get_bhead(FileData *fd)
         readsize = fd->file->read(fd->file, &bhead4, sizeof(bhead4));
 
         if (readsize == sizeof(bhead4) || bhead4.code == ENDB) {
-          if (fd->flags & FD_FLAGS_SWITCH_ENDIAN) {
-            switch_endian_bh4(&bhead4);
-          }
-
-          if (fd->flags & FD_FLAGS_POINTSIZE_DIFFERS) {
-            bh8_from_bh4(&bhead, &bhead4);
-          }
-          else {
-            /* MIN2 is only to quiet '-Warray-bounds' compiler warning. */
-            BLI_assert(sizeof(bhead) == sizeof(bhead4));
-            memcpy(&bhead, &bhead4, MIN2(sizeof(bhead), sizeof(bhead4)));
-          }
+          bhead_from_file_bhead(fd, &bhead4, &bhead);
         }
         else {
           fd->is_eof = true;
@@ -811,18 +881,7 @@ static BHeadN *get_bhead(FileData *fd)
         readsize = fd->file->read(fd->file, &bhead8, sizeof(bhead8));
 
         if (readsize == sizeof(bhead8) || bhead8.code == ENDB) {
-          if (fd->flags & FD_FLAGS_SWITCH_ENDIAN) {
-            switch_endian_bh8(&bhead8);
-          }
-
-          if (fd->flags & FD_FLAGS_POINTSIZE_DIFFERS) {
-            bh4_from_bh8(&bhead, &bhead8, (fd->flags & FD_FLAGS_SWITCH_ENDIAN) != 0);
-          }
-          else {
-            /* MIN2 is only to quiet '-Warray-bounds' compiler warning. */
-            BLI_assert(sizeof(bhead) == sizeof(bhead8));
-            memcpy(&bhead, &bhead8, MIN2(sizeof(bhead), sizeof(bhead8)));
-          }
+          bhead_from_file_bhead(fd, &bhead8, &bhead);
         }
         else {
           fd->is_eof = true;
@@ -850,6 +909,7 @@ static BHeadN *get_bhead(FileData *fd)
           new_bhead->file_offset = fd->file->offset;
           new_bhead->has_data = false;
           new_bhead->is_memchunk_identical = false;
+          new_bhead->decoded_data = NULL;
           new_bhead->bhead = bhead;
           off64_t seek_new = fd->file->seek(fd->file, bhead.len, SEEK_CUR);
           if (seek_new == -1) {
@@ -873,6 +933,7 @@ static BHeadN *get_bhead(FileData *fd)
           new_bhead->has_data = true;
 #endif
           new_bhead->is_memchunk_identical = false;
+          new_bhead->decoded_data = NULL;
           new_bhead->bhead = bhead;
 
           readsize = fd->file->read(fd->file, new_bhead + 1, (size_t)bhead.len);
@@ -990,6 +1051,7 @@ static BHead *blo_bhead_read_full(FileData *fd, BHead *thisblock)
   new_bhead_data->file_offset = new_bhead->file_offset;
   new_bhead_data->has_data = true;
   new_bhead_data->is_memchunk_identical = false;
+  new_bhead_data->decoded_data = NULL;
   if (!blo_bhead_read_data(fd, thisblock, new_bhead_data + 1)) {
     MEM_freeN(new_bhead_data);
     return NULL;
@@ -1149,6 +1211,248 @@ static int *read_file_thumbnail(FileData *fd)
 
 /** \} */
 
+/* -------------------------------------------------------------------- */
+/** \name Block Index Cache
+ *
+ * Opening a file walks over all of its block headers to find the DNA, for large libraries that
+ * are only partially read when linking this is a significant part of the time spent.
+ *
+ * The headers of libraries are stored in the user cache directory, keyed by the file size and
+ * modification time. When an index is found only the non #DATA blocks are read from the file,
+ * #DATA blocks are read on demand as usual. The modification time has a resolution of seconds,
+ * so the headers of the blocks that are read are compared with the ones in the file as well.
+ * \{ */
+
+#define BLOCK_INDEX_MAGIC "BLENDIDX"
+#define BLOCK_INDEX_VERSION 1
+/** Don't write index files for small files, walking over their blocks is fast enough. */
+#define BLOCK_INDEX_MIN_BLOCKS 4096
+
+typedef struct BlockIndexHeader {
+  char magic[8];
+  int version;
+  /** Records store headers converted for this platform, which depends on the pointer size. */
+  int bhead_size;
+  int64_t file_size;
+  int64_t file_mtime;
+  int64_t blocks_num;
+  char filepath[FILE_MAX];
+} BlockIndexHeader;
+
+typedef struct BlockIndexRecord {
+  /** Offset of the block data in the file. */
+  int64_t file_offset;
+  BHead bhead;
+} BlockIndexRecord;
+
+static bool read_file_block_index_filepath(const FileData *fd, char r_filepath[FILE_MAX])
+{
+  char caches_dir[FILE_MAX];
+  if (!BKE_appdir_folder_caches(caches_dir, sizeof(caches_dir))) {
+    return false;
+  }
+
+  char filename[16];
+  const uint hash = BLI_hash_mm2(
+      (const uchar *)fd->deferred.filepath, strlen(fd->deferred.filepath), 0);
+  BLI_snprintf(filename, sizeof(filename), "%08x.index", hash);
+  BLI_path_join(r_filepath, FILE_MAX, caches_dir, "blend_block_index", filename, NULL);
+  return true;
+}
+
+static int64_t read_file_bhead_file_size(const FileData *fd)
+{
+  return (fd->flags & FD_FLAGS_FILE_POINTSIZE_IS_4) ? sizeof(BHead4) : sizeof(BHead8);
+}
+
+static bool read_file_block_index_use(const FileData *fd)
+{
+  /* Offsets only match the file for uncompressed files. */
+  return (fd->flags & FD_FLAGS_USE_BLOCK_INDEX) && fd->deferred.filepath[0] != '\0' &&
+         fd->file->seek != NULL;
+}
+
+/**
+ * Fill #FileData.bhead_list from the index of the file, reading the data of non #DATA blocks.
+ *
+ * \return false when there is no valid index, leaving the file to be read from the start.
+ */
+static bool read_file_block_index_load(FileData *fd)
+{
+  char index_filepath[FILE_MAX];
+  if (!read_file_block_index_filepath(fd, index_filepath)) {
+    return false;
+  }
+
+  FILE *file = BLI_fopen(index_filepath, "rb");
+  if (file == NULL) {
+    return false;
+  }
+
+  BlockIndexHeader header;
+  BlockIndexRecord *records = NULL;
+  bool ok = (fread(&header, sizeof(header), 1, file) == 1) &&
+            (memcmp(header.magic, BLOCK_INDEX_MAGIC, sizeof(header.magic)) == 0) &&
+            (header.version == BLOCK_INDEX_VERSION) && (header.bhead_size == sizeof(BHead)) &&
+            (header.file_size == fd->deferred.file_size) &&
+            (header.file_mtime == fd->deferred.file_mtime) && (header.blocks_num > 0) &&
+            (header.blocks_num < header.file_size) &&
+            (strncmp(header.filepath, fd->deferred.filepath, sizeof(header.filepath)) == 0);
+  if (ok) {
+    records = MEM_malloc_arrayN((size_t)header.blocks_num, sizeof(*records), __func__);
+    ok = fread(records, sizeof(*records), (size_t)header.blocks_num, file) ==
+         (size_t)header.blocks_num;
+  }
+  fclose(file);
+
+  const off64_t offset_backup = fd->file->offset;
+  const int64_t bhead_file_size = read_file_bhead_file_size(fd);
+  int64_t file_offset_next = SIZEOFBLENDERHEADER;
+  for (int64_t i = 0; ok && i < header.blocks_num; i++) {
+    const BlockIndexRecord *record = &records[i];
+    const BHead *bhead = &record->bhead;
+
+    /* Don't trust the index further than needed to avoid reading outside of the file.
+     * Blocks directly follow each other. */
+    if (bhead->len < 0 || record->file_offset != file_offset_next + bhead_file_size ||
+        record->file_offset + bhead->len > header.file_size) {
+      ok = false;
+      break;
+    }
+    file_offset_next = record->file_offset + bhead->len;
+
+    BHeadN *new_bhead;
+    if (BHEAD_USE_READ_ON_DEMAND(bhead)) {
+      new_bhead = MEM_mallocN(sizeof(BHeadN), "new_bhead");
+      new_bhead->file_offset = (off64_t)record->file_offset;
+      new_bhead->has_data = false;
+    }
+    else {
+      /* The file may have been replaced within the resolution of its modification time, check
+       * that the header matches the one in the file. Since blocks directly follow each other
+       * this also catches changes to the size of the #DATA blocks in between. */
+      BHead8 bhead_file = {0}; /* Large enough for #BHead4 too. */
+      BHead bhead_test = {0};
+      if (fd->file->seek(fd->file, (off64_t)(record->file_offset - bhead_file_size), SEEK_SET) ==
+              -1 ||
+          fd->file->read(fd->file, &bhead_file, (size_t)bhead_file_size) != bhead_file_size) {
+        ok = false;
+        break;
+      }
+      bhead_from_file_bhead(fd, &bhead_file, &bhead_test);
+      if (bhead_test.code != bhead->code || bhead_test.len != bhead->len ||
+          bhead_test.old != bhead->old || bhead_test.SDNAnr != bhead->SDNAnr ||
+          bhead_test.nr != bhead->nr) {
+        ok = false;
+        break;
+      }
+
+      new_bhead = MEM_mallocN(sizeof(BHeadN) + (size_t)bhead->len, "new_bhead");
+      new_bhead->file_offset = 0; /* don't seek. */
+      new_bhead->has_data = true;
+      if (fd->file->read(fd->file, new_bhead + 1, (size_t)bhead->len) != bhead->len) {
+        MEM_freeN(new_bhead);
+        ok = false;
+        break;
+      }
+    }
+    new_bhead->next = new_bhead->prev = NULL;
+    new_bhead->is_memchunk_identical = false;
+    new_bhead->decoded_data = NULL;
+    new_bhead->bhead = *bhead;
+    BLI_addtail(&fd->bhead_list, new_bhead);
+  }
+
+  MEM_SAFE_FREE(records);
+
+  if (!ok) {
+    BLI_freelistN(&fd->bhead_list);
+    fd->file->seek(fd->file, offset_backup, SEEK_SET);
+    return false;
+  }
+
+  /* All blocks are known, nothing is left to read sequentially. */
+  fd->is_eof = true;
+  return true;
+}
+
+static void read_file_block_index_write(FileData *fd)
+{
+  /* Complete the list of blocks, reading the DNA stops before the end of the file. */
+  BHead *bhead = fd->bhead_list.last ? &((BHeadN *)fd->bhead_list.last)->bhead : NULL;
+  while (bhead != NULL) {
+    bhead = blo_bhead_next(fd, bhead);
+  }
+
+  const int64_t blocks_num = BLI_listbase_count(&fd->bhead_list);
+  if (blocks_num < BLOCK_INDEX_MIN_BLOCKS) {
+    return;
+  }
+
+  char index_filepath[FILE_MAX];
+  if (!read_file_block_index_filepath(fd, index_filepath)) {
+    return;
+  }
+
+  BlockIndexHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, BLOCK_INDEX_MAGIC, sizeof(header.magic));
+  header.version = BLOCK_INDEX_VERSION;
+  header.bhead_size = sizeof(BHead);
+  header.file_size = fd->deferred.file_size;
+  header.file_mtime = fd->deferred.file_mtime;
+  header.blocks_num = blocks_num;
+  BLI_strncpy(header.filepath, fd->deferred.filepath, sizeof(header.filepath));
+
+  BlockIndexRecord *records = MEM_malloc_arrayN((size_t)blocks_num, sizeof(*records), __func__);
+  const int64_t bhead_file_size = read_file_bhead_file_size(fd);
+  int64_t file_offset = SIZEOFBLENDERHEADER;
+  int64_t i = 0;
+  LISTBASE_FOREACH (BHeadN *, bheadn, &fd->bhead_list) {
+    file_offset += bhead_file_size;
+    BLI_assert(bheadn->has_data || bheadn->file_offset == file_offset);
+    records[i].file_offset = file_offset;
+    records[i].bhead = bheadn->bhead;
+    file_offset += bheadn->bhead.len;
+    i++;
+  }
+
+  char index_dir[FILE_MAX];
+  BLI_split_dir_part(index_filepath, index_dir, sizeof(index_dir));
+  BLI_dir_create_recursive(index_dir);
+
+  /* Write to a temporary file first, so other instances never read a partial index. The name is
+   * unique to this process and call, so instances writing the same index don't mix their data. */
+  static uint32_t tmp_counter = 0;
+  char tmp_filepath[FILE_MAX + 32];
+  BLI_snprintf(tmp_filepath,
+               sizeof(tmp_filepath),
+               "%s@%d_%u",
+               index_filepath,
+               abs(getpid()),
+               atomic_add_and_fetch_uint32(&tmp_counter, 1));
+
+  FILE *file = BLI_fopen(tmp_filepath, "wb");
+  bool ok = false;
+  if (file != NULL) {
+    ok = (fwrite(&header, sizeof(header), 1, file) == 1) &&
+         (fwrite(records, sizeof(*records), (size_t)blocks_num, file) == (size_t)blocks_num);
+    ok = (fclose(file) == 0) && ok;
+    if (!ok || BLI_rename(tmp_filepath, index_filepath) != 0) {
+      BLI_delete(tmp_filepath, false, false);
+      ok = false;
+    }
+  }
+
+  if (!ok) {
+    CLOG_INFO(&LOG, 2, "Unable to write block index '%s'", index_filepath);
+  }
+
+  MEM_freeN(records);
+}
+
+/** \} */
+
 static FileData *filedata_new(BlendFileReadReport *reports)
 {
   BLI_assert(reports != NULL);
@@ -1171,6 +1475,9 @@ static FileData *blo_decode_and_check(FileData *fd, ReportList *reports)
   decode_blender_header(fd);
 
   if (fd->flags & FD_FLAGS_FILE_OK) {
+    const bool use_block_index = read_file_block_index_use(fd);
+    const bool has_block_index = use_block_index && read_file_block_index_load(fd);
+
     const char *error_message = NULL;
     if (read_file_dna(fd, &error_message) == false) {
       BKE_reportf(
@@ -1178,6 +1485,9 @@ static FileData *blo_decode_and_check(FileData *fd, ReportList *reports)
       blo_filedata_free(fd);
       fd = NULL;
     }
+    else if (use_block_index && !has_block_index) {
+      read_file_block_index_write(fd);
+    }
   }
   else {
     BKE_reportf(
@@ -1218,7 +1528,12 @@ static FileData *blo_filedata_from_file_descriptor(const char *filepath,
   rawfile->seek(rawfile, 0, SEEK_SET);
 
   /* Check if we have a regular file. */
-  if (memcmp(header, "BLENDER", sizeof(header)) == 0) {
+  const bool is_uncompressed = memcmp(header, "BLENDER", sizeof(header)) == 0;
+  BLI_stat_t st;
+  /* Offsets in uncompressed files match the file on disk, so data can be read from it later.
+   * Stat the file now, since closing `rawfile` below also closes `filedes`. */
+  const bool can_defer = is_uncompressed && BLI_fstat(filedes, &st) == 0;
+  if (is_uncompressed) {
     /* Try opening the file with memory-mapped IO. */
     file = BLI_filereader_new_mmap(filedes);
     if (file == NULL) {
@@ -1252,6 +1567,12 @@ static FileData *blo_filedata_from_file_descriptor(const char *filepath,
   FileData *fd = filedata_new(reports);
   fd->file = file;
 
+  if (can_defer) {
+    BLI_strncpy(fd->deferred.filepath, filepath, sizeof(fd->deferred.filepath));
+    fd->deferred.file_size = (int64_t)st.st_size;
+    fd->deferred.file_mtime = (int64_t)st.st_mtime;
+  }
+
   return fd;
 }
 
@@ -1284,6 +1605,23 @@ FileData *blo_filedata_from_file(const char *filepath, BlendFileReadReport *repo
   return NULL;
 }
 
+/**
+ * Same as blo_filedata_from_file(), for files which are only partially read (linking from
+ * libraries, listing data-blocks). Uses the block index cache when possible,
+ * see #read_file_block_index_load.
+ */
+FileData *blo_filedata_from_file_for_link(const char *filepath, BlendFileReadReport *reports)
+{
+  FileData *fd = blo_filedata_from_file_open(filepath, reports);
+  if (fd != NULL) {
+    BLI_strncpy(fd->relabase, filepath, sizeof(fd->relabase));
+    fd->flags |= FD_FLAGS_USE_BLOCK_INDEX;
+
+    return blo_decode_and_check(fd, reports->reports);
+  }
+  return NULL;
+}
+
 /**
  * Same as blo_filedata_from_file(), but does not reads DNA data, only header.
  * Use it for light access (e.g. thumbnail reading).
@@ -1353,6 +1691,9 @@ void blo_filedata_free(FileData *fd)
   if (fd) {
     fd->file->close(fd->file);
 
+    /* Reading may stop early on errors. */
+    read_file_decode_end(fd);
+
     /* Free all BHeadN data blocks */
 #ifndef NDEBUG
     BLI_freelistN(&fd->bhead_list);
@@ -1402,6 +1743,10 @@ void blo_filedata_free(FileData *fd)
     }
 #endif
 
+    if (fd->deferred.bheads) {
+      BLI_ghash_free(fd->deferred.bheads, NULL, NULL);
+    }
+
     MEM_freeN(fd);
   }
 }
@@ -1541,14 +1886,18 @@ BlendThumbnail *BLO_thumbnail_from_file(const char *filepath)
  * \{ */
 
 /* Only direct data-blocks. */
+static void read_deferred_data_into_datamap(FileData *fd, const void *adr);
+
 static void *newdataadr(FileData *fd, const void *adr)
 {
+  read_deferred_data_into_datamap(fd, adr);
   return oldnewmap_lookup_and_inc(fd->datamap, adr, true);
 }
 
 /* Only direct data-blocks. */
 static void *newdataadr_no_us(FileData *fd, const void *adr)
 {
+  read_deferred_data_into_datamap(fd, adr);
   return oldnewmap_lookup_and_inc(fd->datamap, adr, false);
 }
 
@@ -1565,7 +1914,7 @@ static void *newpackedadr(FileData *fd, const void *adr)
     return oldnewmap_lookup_and_inc(fd->packedmap, adr, true);
   }
 
-  return oldnewmap_lookup_and_inc(fd->datamap, adr, true);
+  return newdataadr(fd, adr);
 }
 
 /* only lib data */
@@ -1892,12 +2241,12 @@ void blo_cache_storage_end(FileData *fd)
 /** \name DNA Struct Loading
  * \{ */
 
-static void switch_endian_structs(const struct SDNA *filesdna, BHead *bhead)
+static void switch_endian_structs_data(const struct SDNA *filesdna,
+                                       const BHead *bhead,
+                                       char *data)
 {
   int blocksize, nblocks;
-  char *data;
 
-  data = (char *)(bhead + 1);
   blocksize = filesdna->types_size[filesdna->structs[bhead->SDNAnr]->type];
 
   nblocks = bhead->nr;
@@ -1908,10 +2257,23 @@ static void switch_endian_structs(const struct SDNA *filesdna, BHead *bhead)
   }
 }
 
+static void switch_endian_structs(const struct SDNA *filesdna, BHead *bhead)
+{
+  switch_endian_structs_data(filesdna, bhead, (char *)(bhead + 1));
+}
+
 static void *read_struct(FileData *fd, BHead *bh, const char *blockname)
 {
   void *temp = NULL;
 
+  /* Use data which was already decoded in parallel. */
+  BHeadN *bheadn = BHEADN_FROM_BHEAD(bh);
+  if (bheadn->decoded_data) {
+    temp = bheadn->decoded_data;
+    bheadn->decoded_data = NULL;
+    return temp;
+  }
+
   if (bh->len) {
 #ifdef USE_BHEAD_READ_ON_DEMAND
     BHead *bh_orig = bh;
@@ -1985,6 +2347,8 @@ static const void *peek_struct_undo(FileData *fd, BHead *bhead)
   return (bhead->len) ? (const void *)(bhead + 1) : NULL;
 }
 
+/** \} */
+
 static void link_glob_list(FileData *fd, ListBase *lb) /* for glob data */
 {
   Link *ln, *prev;
@@ -2016,6 +2380,241 @@ static void link_glob_list(FileData *fd, ListBase *lb) /* for glob data */
 
 /** \} */
 
+/* -------------------------------------------------------------------- */
+/** \name Parallel Block Decoding
+ *
+ * Endian switching and DNA reconstruction of a block do not depend on other blocks. So when a
+ * whole file is read, all blocks are indexed first and their data is decoded on multiple threads,
+ * one window of blocks ahead of the serial read at a time. Linking the decoded data into the main
+ * database and versioning remain serial, #read_struct then only picks up the decoded data.
+ * \{ */
+
+/* Amount of block data decoded ahead of the serial read. Bounds the memory used by decoded data
+ * which is not read into IDs yet, and by the raw data of blocks which are otherwise read on
+ * demand. */
+#define DECODE_WINDOW_SIZE (64 * 1024 * 1024)
+
+typedef struct BlockDecodeTask {
+  BHeadN *bheadn;
+  /** Raw data of the block, either stored after the #BHeadN or in the window buffer. */
+  char *data;
+  const char *allocname;
+} BlockDecodeTask;
+
+typedef struct BlockDecodeData {
+  FileData *fd;
+  BlockDecodeTask *tasks;
+} BlockDecodeData;
+
+/* Thread-safe part of #read_struct, for block data which is already in memory. */
+static void *read_struct_decode(FileData *fd, const BHead *bh, char *data, const char *blockname)
+{
+  if (bh->SDNAnr && (fd->flags & FD_FLAGS_SWITCH_ENDIAN)) {
+    switch_endian_structs_data(fd->filesdna, bh, data);
+  }
+
+  if (fd->compflags[bh->SDNAnr] == SDNA_CMP_NOT_EQUAL) {
+    return DNA_struct_reconstruct(fd->reconstruct_info, bh->SDNAnr, bh->nr, data);
+  }
+
+  void *temp = MEM_mallocN(bh->len, blockname);
+  memcpy(temp, data, bh->len);
+  return temp;
+}
+
+static void read_file_decode_block_cb(void *__restrict userdata,
+                                      const int index,
+                                      const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  BlockDecodeData *data = userdata;
+  BlockDecodeTask *task = &data->tasks[index];
+
+  task->bheadn->decoded_data = read_struct_decode(
+      data->fd, &task->bheadn->bhead, task->data, task->allocname);
+}
+
+/* Whether the block is worth decoding ahead of time. Blocks which are read on demand and need no
+ * conversion are read directly into their final memory by #read_struct. */
+static bool read_file_block_needs_decode(FileData *fd, const BHeadN *bheadn)
+{
+  const BHead *bh = &bheadn->bhead;
+
+  if (bh->len == 0 || fd->compflags[bh->SDNAnr] == SDNA_CMP_REMOVED) {
+    return false;
+  }
+
+#ifdef USE_BHEAD_READ_ON_DEMAND
+  if (!bheadn->has_data) {
+    return (fd->compflags[bh->SDNAnr] == SDNA_CMP_NOT_EQUAL) ||
+           (bh->SDNAnr && (fd->flags & FD_FLAGS_SWITCH_ENDIAN));
+  }
+#endif
+
+  return true;
+}
+
+/**
+ * Allocation name for the decoded data of the block, NULL when it is not decoded ahead. Only the
+ * ID blocks and their data are decoded, other blocks are small and have their own reading logic.
+ *
+ * \param id_allocname: Allocation name for the data of the ID the block belongs to, updated when
+ * passing the blocks in order.
+ */
+static const char *read_file_block_decode_allocname(FileData *fd,
+                                                    const BHeadN *bheadn,
+                                                    const char **id_allocname)
+{
+  const BHead *bh = &bheadn->bhead;
+
+  if (blo_bhead_is_id(bh)) {
+    *id_allocname = dataname(bh->code);
+  }
+  else if (bh->code != DATA) {
+    *id_allocname = NULL;
+  }
+
+  if (*id_allocname == NULL || !read_file_block_needs_decode(fd, bheadn)) {
+    return NULL;
+  }
+  return blo_bhead_is_id(bh) ? "lib block" : *id_allocname;
+}
+
+/* Free decoded data of the current window which the serial read skipped. */
+static void read_file_decode_window_free(FileData *fd)
+{
+  for (BHeadN *bheadn = fd->decode.first; bheadn && bheadn != fd->decode.next;
+       bheadn = bheadn->next) {
+    MEM_SAFE_FREE(bheadn->decoded_data);
+  }
+  fd->decode.first = NULL;
+}
+
+/* Decode the blocks from #FileData.decode.next on. The window only ends before an ID or another
+ * non-data block, so all data of an ID is decoded together. */
+static void read_file_decode_window(FileData *fd)
+{
+  const double time_start = PIL_check_seconds_timer();
+
+  read_file_decode_window_free(fd);
+
+  BHeadN *first = fd->decode.next;
+  BHeadN *next = NULL;
+  size_t window_size = 0;
+  size_t read_size = 0;
+  const char *id_allocname = NULL;
+
+  for (BHeadN *bheadn = first; bheadn && bheadn->bhead.code != ENDB; bheadn = bheadn->next) {
+    if (bheadn != first && bheadn->bhead.code != DATA && window_size >= DECODE_WINDOW_SIZE) {
+      next = bheadn;
+      break;
+    }
+    if (read_file_block_decode_allocname(fd, bheadn, &id_allocname) == NULL) {
+      continue;
+    }
+    window_size += (size_t)bheadn->bhead.len;
+#ifdef USE_BHEAD_READ_ON_DEMAND
+    if (!bheadn->has_data) {
+      read_size += (size_t)bheadn->bhead.len;
+    }
+#endif
+  }
+
+  fd->decode.first = first;
+  fd->decode.next = next;
+
+  if (read_size > fd->decode.buffer_size) {
+    /* Only an ID with more data than the window size needs a larger buffer. */
+    MEM_SAFE_FREE(fd->decode.buffer);
+    fd->decode.buffer_size = MAX2(DECODE_WINDOW_SIZE, read_size);
+    fd->decode.buffer = MEM_mallocN(fd->decode.buffer_size, __func__);
+  }
+
+  BlockDecodeTask *tasks = fd->decode.tasks;
+  int tasks_len = 0;
+  size_t buffer_offset = 0;
+  id_allocname = NULL;
+
+  for (BHeadN *bheadn = first; bheadn && bheadn != next && bheadn->bhead.code != ENDB;
+       bheadn = bheadn->next) {
+    const char *allocname = read_file_block_decode_allocname(fd, bheadn, &id_allocname);
+    if (allocname == NULL) {
+      continue;
+    }
+
+    BlockDecodeTask *task = &tasks[tasks_len];
+    task->bheadn = bheadn;
+    task->allocname = allocname;
+    task->data = (char *)(bheadn + 1);
+
+#ifdef USE_BHEAD_READ_ON_DEMAND
+    if (!bheadn->has_data) {
+      task->data = fd->decode.buffer + buffer_offset;
+      if (!blo_bhead_read_data(fd, &bheadn->bhead, task->data)) {
+        /* Leave the error handling to #read_struct. */
+        continue;
+      }
+      buffer_offset += (size_t)bheadn->bhead.len;
+    }
+#endif
+
+    tasks_len++;
+  }
+
+  BlockDecodeData data = {fd, tasks};
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.min_iter_per_thread = 16;
+
+  BLI_task_parallel_range(0, tasks_len, &data, read_file_decode_block_cb, &settings);
+
+  fd->reports->duration.decode_blocks += PIL_check_seconds_timer() - time_start;
+  fd->reports->count.decoded_blocks += tasks_len;
+}
+
+static void read_file_decode_begin(FileData *fd)
+{
+  const double time_start = PIL_check_seconds_timer();
+
+  /* Index all blocks. The data of blocks which are read on demand stays in the file. */
+  int blocks_len = 0;
+  for (BHead *bhead = blo_bhead_first(fd); bhead && bhead->code != ENDB;
+       bhead = blo_bhead_next(fd, bhead)) {
+    blocks_len++;
+  }
+
+  fd->reports->count.read_blocks = blocks_len;
+  fd->reports->duration.decode_blocks = PIL_check_seconds_timer() - time_start;
+
+  fd->decode.tasks = MEM_malloc_arrayN(MAX2(blocks_len, 1), sizeof(*fd->decode.tasks), __func__);
+  fd->decode.first = NULL;
+  fd->decode.next = fd->bhead_list.first;
+}
+
+/* Keep the data of the blocks from \a bhead on decoded, called as the serial read passes them. */
+static void read_file_decode_ahead(FileData *fd, BHead *bhead)
+{
+  if (fd->decode.tasks && fd->decode.next == BHEADN_FROM_BHEAD(bhead)) {
+    read_file_decode_window(fd);
+  }
+}
+
+static void read_file_decode_end(FileData *fd)
+{
+  if (fd->decode.tasks == NULL) {
+    return;
+  }
+
+  fd->decode.next = NULL;
+  read_file_decode_window_free(fd);
+
+  MEM_SAFE_FREE(fd->decode.buffer);
+  fd->decode.buffer_size = 0;
+  MEM_SAFE_FREE(fd->decode.tasks);
+}
+
+/** \} */
+
 /* -------------------------------------------------------------------- */
 /** \name Read ID
  * \{ */
@@ -3101,9 +3700,134 @@ static bool direct_link_id(FileData *fd, Main *main, const int tag, ID *id, ID *
   return success;
 }
 
+/* -------------------------------------------------------------------- */
+/** \name Deferred Data
+ *
+ * With #BLO_READ_DEFER_PACKED_DATA, large raw data blocks of IDs which can contain packed files
+ * are not read. Their location in the file is handed to the packed file instead, which reads
+ * the data on first access. Data which turns out to be referenced by anything else is read as
+ * usual as soon as its address is looked up.
+ * \{ */
+
+/* Only data larger than this is deferred, smaller packed files are not worth the overhead. */
+#define DEFERRED_DATA_MIN_SIZE (1 << 16)
+
+typedef struct BlendDeferredData {
+  char filepath[FILE_MAX];
+  off64_t offset;
+  size_t size;
+  /** State of the file when it was opened, to detect modifications. */
+  int64_t file_size;
+  int64_t file_mtime;
+} BlendDeferredData;
+
+static bool read_data_can_defer(FileData *fd, const short idcode, BHead *bhead)
+{
+#ifdef USE_BHEAD_READ_ON_DEMAND
+  if ((fd->skip_flags & BLO_READ_DEFER_PACKED_DATA) == 0 || fd->deferred.filepath[0] == '\0') {
+    return false;
+  }
+  /* Packed files are written as raw data. */
+  if (!ELEM(idcode, ID_IM, ID_SO, ID_VF, ID_VO) || bhead->SDNAnr != 0 ||
+      bhead->len < DEFERRED_DATA_MIN_SIZE) {
+    return false;
+  }
+  /* The data must still be in the file. */
+  const BHeadN *new_bhead = BHEADN_FROM_BHEAD(bhead);
+  return !new_bhead->has_data && new_bhead->decoded_data == NULL;
+#else
+  UNUSED_VARS(fd, idcode, bhead);
+  return false;
+#endif
+}
+
+/* Read deferred data when its address is looked up like regular data. */
+static void read_deferred_data_into_datamap(FileData *fd, const void *adr)
+{
+  if (fd->deferred.bheads == NULL || adr == NULL) {
+    return;
+  }
+
+  BHead *bhead = BLI_ghash_popkey(fd->deferred.bheads, adr, NULL);
+  if (bhead == NULL) {
+    return;
+  }
+
+  void *data = read_struct(fd, bhead, "deferred data");
+  if (data) {
+    oldnewmap_insert(fd->datamap, bhead->old, data, 0);
+  }
+}
+
+BlendDeferredData *BLO_read_get_deferred_data(BlendDataReader *reader, const void *old_address)
+{
+  FileData *fd = reader->fd;
+  if (fd->deferred.bheads == NULL || old_address == NULL) {
+    return NULL;
+  }
+
+  BHead *bhead = BLI_ghash_popkey(fd->deferred.bheads, old_address, NULL);
+  if (bhead == NULL) {
+    return NULL;
+  }
+
+  BlendDeferredData *deferred = MEM_mallocN(sizeof(*deferred), __func__);
+  BLI_strncpy(deferred->filepath, fd->deferred.filepath, sizeof(deferred->filepath));
+#ifdef USE_BHEAD_READ_ON_DEMAND
+  deferred->offset = BHEADN_FROM_BHEAD(bhead)->file_offset;
+#endif
+  deferred->size = (size_t)bhead->len;
+  deferred->file_size = fd->deferred.file_size;
+  deferred->file_mtime = fd->deferred.file_mtime;
+
+  return deferred;
+}
+
+void *BLO_deferred_data_read(const BlendDeferredData *deferred)
+{
+  const int file = BLI_open(deferred->filepath, O_BINARY | O_RDONLY, 0);
+  if (file == -1) {
+    return NULL;
+  }
+
+  void *data = NULL;
+
+  /* Offsets are meaningless once the file was overwritten, e.g. by saving it again. */
+  BLI_stat_t st;
+  if (BLI_fstat(file, &st) == 0 && (int64_t)st.st_size == deferred->file_size &&
+      (int64_t)st.st_mtime == deferred->file_mtime &&
+      BLI_lseek(file, deferred->offset, SEEK_SET) == deferred->offset) {
+    data = MEM_mallocN(deferred->size, "deferred data");
+    if (read(file, data, deferred->size) != (ssize_t)deferred->size) {
+      MEM_SAFE_FREE(data);
+    }
+  }
+
+  close(file);
+
+  if (data == NULL) {
+    CLOG_ERROR(&LOG, "Failed to read deferred data from '%s'", deferred->filepath);
+  }
+
+  return data;
+}
+
+BlendDeferredData *BLO_deferred_data_duplicate(const BlendDeferredData *deferred)
+{
+  return MEM_dupallocN(deferred);
+}
+
+void BLO_deferred_data_free(BlendDeferredData *deferred)
+{
+  MEM_freeN(deferred);
+}
+
+/** \} */
+
 /* Read all data associated with a datablock into datamap. */
 static BHead *read_data_into_datamap(FileData *fd, BHead *bhead, const char *allocname)
 {
+  const short idcode = bhead->code;
   bhead = blo_bhead_next(fd, bhead);
 
   while (bhead && bhead->code == DATA) {
@@ -3123,6 +3847,15 @@ static BHead *read_data_into_datamap(FileData *fd, BHead *bhead, const char *all
     }
 #endif
 
+    if (read_data_can_defer(fd, idcode, bhead)) {
+      if (fd->deferred.bheads == NULL) {
+        fd->deferred.bheads = BLI_ghash_ptr_new(__func__);
+      }
+      BLI_ghash_insert(fd->deferred.bheads, (void *)bhead->old, bhead);
+      bhead = blo_bhead_next(fd, bhead);
+      continue;
+    }
+
     void *data = read_struct(fd, bhead, allocname);
     if (data) {
       oldnewmap_insert(fd->datamap, bhead->old, data, 0);
@@ -3486,6 +4219,9 @@ static BHead *read_libblock(FileData *fd,
   bhead = read_data_into_datamap(fd, bhead, allocname);
   const bool success = direct_link_id(fd, main, id_tag, id, id_old);
   oldnewmap_clear(fd->datamap);
+  if (fd->deferred.bheads) {
+    BLI_ghash_clear(fd->deferred.bheads, NULL, NULL);
+  }
 
   if (!success) {
     /* XXX This is probably working OK currently given the very limited scope of that flag.
@@ -3931,7 +4667,17 @@ BlendFileData *blo_read_file_internal(FileData *fd, const char *filepath)
     }
   }
 
+  /* Decoding data in parallel is only worth it when reading all of it from an actual file. */
+  const bool use_decode_blocks = (fd->flags & FD_FLAGS_IS_MEMFILE) == 0 &&
+                                 (fd->skip_flags & BLO_READ_SKIP_DATA) == 0;
+  if (use_decode_blocks) {
+    fd->reports->duration.read_data = PIL_check_seconds_timer();
+    read_file_decode_begin(fd);
+  }
+
   while (bhead) {
+    read_file_decode_ahead(fd, bhead);
+
     switch (bhead->code) {
       case DATA:
       case DNA1:
@@ -3982,10 +4728,21 @@ BlendFileData *blo_read_file_internal(FileData *fd, const char *filepath)
     }
   }
 
+  read_file_decode_end(fd);
+
   /* do before read_libraries, but skip undo case */
   if ((fd->flags & FD_FLAGS_IS_MEMFILE) == 0) {
     if ((fd->skip_flags & BLO_READ_SKIP_DATA) == 0) {
+      fd->reports->duration.versioning = PIL_check_seconds_timer();
+      /* Decoding happens while reading the data, only count it once. */
+      fd->reports->duration.read_data = fd->reports->duration.versioning -
+                                        fd->reports->duration.read_data -
+                                        fd->reports->duration.decode_blocks;
+
       do_versions(fd, NULL, bfd->main);
+
+      fd->reports->duration.versioning = PIL_check_seconds_timer() -
+                                         fd->reports->duration.versioning;
     }
 
     if ((fd->skip_flags & BLO_READ_SKIP_USERDEF) == 0) {
@@ -4013,6 +4770,7 @@ BlendFileData *blo_read_file_internal(FileData *fd, const char *filepath)
        * from groups to collections... We could optimize out that first call when we are reading a
        * current version file, but again this is really not a bottle neck currently.
        * So not worth it. */
+      const double time_versioning = PIL_check_seconds_timer();
       BKE_main_id_refcount_recompute(bfd->main, false);
 
       /* Yep, second splitting... but this is a very cheap operation, so no big deal. */
@@ -4023,6 +4781,8 @@ BlendFileData *blo_read_file_internal(FileData *fd, const char *filepath)
       }
       blo_join_main(&mainlist);
 
+      fd->reports->duration.versioning += PIL_check_seconds_timer() - time_versioning;
+
       /* And we have to compute those user-reference-counts again, as `do_versions_after_linking()`
        * does not always properly handle user counts, and/or that function does not take into
        * account old, deprecated data. */
@@ -5279,7 +6039,7 @@ static FileData *read_library_file_data(FileData *basefd,
                      mainptr->curlib->filepath_abs,
                      mainptr->curlib->filepath,
                      library_parent_filepath(mainptr->curlib));
-    fd = blo_filedata_from_file(mainptr->curlib->filepath_abs, basefd->reports);
+    fd = blo_filedata_from_file_for_link(mainptr->curlib->filepath_abs, basefd->reports);
   }
 
   if (fd) {
@@ -5290,6 +6050,7 @@ static FileData *read_library_file_data(FileData *basefd,
     fd->mainlist = mainlist;
 
     fd->reports = basefd->reports;
+    fd->skip_flags |= basefd->skip_flags & BLO_READ_DEFER_PACKED_DATA;
 
     if (fd->libmap) {
       oldnewmap_free(fd->libmap);
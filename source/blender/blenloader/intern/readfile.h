@@ -53,6 +53,8 @@ enum eFileDataFlag {
   FD_FLAGS_IS_MEMFILE = 1 << 4,
   /* XXX Unused in practice (checked once but never set). */
   FD_FLAGS_NOT_MY_LIBMAP = 1 << 5,
+  /** Read and write the block index cache, for files which are only partially read. */
+  FD_FLAGS_USE_BLOCK_INDEX = 1 << 6,
 };
 
 /* Disallow since it's 32bit on ms-windows. */
@@ -108,6 +110,29 @@ typedef struct FileData {
   struct OldNewMap *packedmap;
   struct BLOCacheStorage *cache_storage;
 
+  /** Data left in the file because of #BLO_READ_DEFER_PACKED_DATA. */
+  struct {
+    /** Maps the old address of data of the ID being read to its #BHead. */
+    struct GHash *bheads;
+    /** Uncompressed file on disk the data can be read from later, empty otherwise. */
+    char filepath[FILE_MAX];
+    /** State of the file when it was opened, to detect modifications. */
+    int64_t file_size;
+    int64_t file_mtime;
+  } deferred;
+
+  /** Blocks decoded in parallel ahead of the serial read of a whole file. */
+  struct {
+    /** Tasks of the current window, allocated for all blocks of the file. */
+    struct BlockDecodeTask *tasks;
+    /** Raw data of the window for blocks which are otherwise read on demand. */
+    char *buffer;
+    size_t buffer_size;
+    /** First block of the window, and the first block after it or NULL at the end. */
+    struct BHeadN *first;
+    struct BHeadN *next;
+  } decode;
+
   struct BHeadSort *bheadmap;
   int tot_bheadmap;
 
@@ -132,6 +157,8 @@ void blo_split_main(ListBase *mainlist, struct Main *main);
 BlendFileData *blo_read_file_internal(FileData *fd, const char *filepath);
 
 FileData *blo_filedata_from_file(const char *filepath, struct BlendFileReadReport *reports);
+FileData *blo_filedata_from_file_for_link(const char *filepath,
+                                          struct BlendFileReadReport *reports);
 FileData *blo_filedata_from_memory(const void *mem,
                                    int memsize,
                                    struct BlendFileReadReport *reports);
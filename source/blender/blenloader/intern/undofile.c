@@ -38,10 +38,14 @@
 
 #include "MEM_guardedalloc.h"
 
+#include "atomic_ops.h"
+
 #include "DNA_listBase.h"
 
 #include "BLI_blenlib.h"
+#include "BLI_endian_defines.h"
 #include "BLI_ghash.h"
+#include "BLI_hash_mm2a.h"
 
 #include "BLO_readfile.h"
 #include "BLO_undofile.h"
@@ -55,18 +59,23 @@
 
 /* **************** support for memory-write, for undo buffers *************** */
 
+/** Last #MemFileChunk.content_id, shared by all memfiles so ids never repeat. */
+static uint64_t memfile_chunk_content_id_last = 0;
+
 /* not memfile itself */
 void BLO_memfile_free(MemFile *memfile)
 {
   MemFileChunk *chunk;
 
   while ((chunk = BLI_pophead(&memfile->chunks))) {
-    if (chunk->is_identical == false) {
+    if (chunk->is_shared == false) {
       MEM_freeN((void *)chunk->buf);
     }
     MEM_freeN(chunk);
   }
   memfile->size = 0;
+  memfile->size_identical = 0;
+  memfile->size_deduplicated = 0;
 }
 
 /* to keep list of memfiles consistent, 'first' is always first in list */
@@ -78,22 +87,26 @@ void BLO_memfile_merge(MemFile *first, MemFile *second)
   GHash *buffer_to_second_memchunk = BLI_ghash_new(
       BLI_ghashutil_ptrhash, BLI_ghashutil_ptrcmp, __func__);
 
-  /* First, detect all memchunks in second memfile that are not owned by it. */
+  /* First, detect all memchunks in second memfile that are not owned by it. Several of them may
+   * share the same buffer, ownership is only transferred to the first one. */
   for (MemFileChunk *sc = second->chunks.first; sc != NULL; sc = sc->next) {
-    if (sc->is_identical) {
-      BLI_ghash_insert(buffer_to_second_memchunk, (void *)sc->buf, sc);
+    if (sc->is_shared) {
+      void **entry;
+      if (!BLI_ghash_ensure_p(buffer_to_second_memchunk, (void *)sc->buf, &entry)) {
+        *entry = sc;
+      }
     }
   }
 
   /* Now, check all chunks from first memfile (the one we are removing), and if a memchunk owned by
    * it is also used by the second memfile, transfer the ownership. */
   for (MemFileChunk *fc = first->chunks.first; fc != NULL; fc = fc->next) {
-    if (!fc->is_identical) {
+    if (!fc->is_shared) {
       MemFileChunk *sc = BLI_ghash_lookup(buffer_to_second_memchunk, fc->buf);
       if (sc != NULL) {
-        BLI_assert(sc->is_identical);
-        sc->is_identical = false;
-        fc->is_identical = true;
+        BLI_assert(sc->is_shared);
+        sc->is_shared = false;
+        fc->is_shared = true;
       }
       /* Note that if the second memfile does not use that chunk, we assume that the first one
        * fully owns it without sharing it with any other memfile, and hence it should be freed with
@@ -114,6 +127,25 @@ void BLO_memfile_clear_future(MemFile *memfile)
   }
 }
 
+static uint memfile_chunk_content_hash(const char *buf, size_t size)
+{
+  return BLI_hash_mm2((const unsigned char *)buf, size, 0);
+}
+
+static uint memfile_chunk_ghash_hash(const void *key)
+{
+  const MemFileChunk *chunk = key;
+  return chunk->hash;
+}
+
+static bool memfile_chunk_ghash_cmp(const void *a, const void *b)
+{
+  const MemFileChunk *chunk_a = a;
+  const MemFileChunk *chunk_b = b;
+  return (chunk_a->hash != chunk_b->hash || chunk_a->size != chunk_b->size ||
+          memcmp(chunk_a->buf, chunk_b->buf, chunk_a->size) != 0);
+}
+
 void BLO_memfile_write_init(MemFileWriteData *mem_data,
                             MemFile *written_memfile,
                             MemFile *reference_memfile)
@@ -145,6 +177,21 @@ void BLO_memfile_write_init(MemFileWriteData *mem_data,
         }
       }
     }
+
+    /* Index all chunks of the previous step by their content, so that data which did not change
+     * but moved to another position (e.g. when IDs are added, removed or re-ordered) can still
+     * share memory with it. Of several identical chunks only the first one is kept. */
+    mem_data->chunk_by_content = BLI_ghash_new_ex(memfile_chunk_ghash_hash,
+                                                  memfile_chunk_ghash_cmp,
+                                                  __func__,
+                                                  (uint)BLI_listbase_count(
+                                                      &reference_memfile->chunks));
+    LISTBASE_FOREACH (MemFileChunk *, mem_chunk, &reference_memfile->chunks) {
+      void **entry;
+      if (!BLI_ghash_ensure_p(mem_data->chunk_by_content, mem_chunk, &entry)) {
+        *entry = mem_chunk;
+      }
+    }
   }
 }
 
@@ -153,6 +200,9 @@ void BLO_memfile_write_finalize(MemFileWriteData *mem_data)
   if (mem_data->id_session_uuid_mapping != NULL) {
     BLI_ghash_free(mem_data->id_session_uuid_mapping, NULL, NULL);
   }
+  if (mem_data->chunk_by_content != NULL) {
+    BLI_ghash_free(mem_data->chunk_by_content, NULL, NULL);
+  }
 }
 
 void BLO_memfile_chunk_add(MemFileWriteData *mem_data, const char *buf, size_t size)
@@ -164,6 +214,7 @@ void BLO_memfile_chunk_add(MemFileWriteData *mem_data, const char *buf, size_t s
   curchunk->size = size;
   curchunk->buf = NULL;
   curchunk->is_identical = false;
+  curchunk->is_shared = false;
   /* This is unsafe in the sense that an app handler or other code that does not
    * perform an undo push may make changes after the last undo push that
    * will then not be undo. Though it's not entirely clear that is wrong behavior. */
@@ -177,18 +228,41 @@ void BLO_memfile_chunk_add(MemFileWriteData *mem_data, const char *buf, size_t s
     if (compchunk->size == curchunk->size) {
       if (memcmp(compchunk->buf, buf, size) == 0) {
         curchunk->buf = compchunk->buf;
+        curchunk->hash = compchunk->hash;
+        curchunk->content_id = compchunk->content_id;
         curchunk->is_identical = true;
+        curchunk->is_shared = true;
         compchunk->is_identical_future = true;
+        memfile->size_identical += size;
       }
     }
     *compchunk_step = compchunk->next;
   }
 
+  if (curchunk->buf == NULL) {
+    curchunk->hash = memfile_chunk_content_hash(buf, size);
+  }
+
+  /* Same content somewhere else in the previous step. The memory is shared, but the chunk is not
+   * considered identical, since it may belong to another ID (or to none) in the previous step.
+   * Content is always compared in full, never only by its hash. */
+  if (curchunk->buf == NULL && mem_data->chunk_by_content != NULL) {
+    const MemFileChunk key = {.buf = buf, .size = size, .hash = curchunk->hash};
+    const MemFileChunk *refchunk = BLI_ghash_lookup(mem_data->chunk_by_content, &key);
+    if (refchunk != NULL) {
+      curchunk->buf = refchunk->buf;
+      curchunk->content_id = refchunk->content_id;
+      curchunk->is_shared = true;
+      memfile->size_deduplicated += size;
+    }
+  }
+
   /* not equal... */
   if (curchunk->buf == NULL) {
     char *buf_new = MEM_mallocN(size, "Chunk buffer");
     memcpy(buf_new, buf, size);
     curchunk->buf = buf_new;
+    curchunk->content_id = atomic_add_and_fetch_uint64(&memfile_chunk_content_id_last, 1);
     memfile->size += size;
   }
 }
@@ -217,22 +291,16 @@ struct Main *BLO_memfile_main_get(struct MemFile *memfile,
 }
 
 /**
- * Saves .blend using undo buffer.
+ * Open a file for writing memfile data to it.
  *
- * \return success.
+ * \note This is currently used for autosave and 'quit.blend',
+ * where _not_ following symlinks is OK,
+ * however if this is ever executed explicitly by the user,
+ * we may want to allow writing to symlinks.
  */
-bool BLO_memfile_write_file(struct MemFile *memfile, const char *filename)
+static int memfile_file_open_write(const char *filename)
 {
-  MemFileChunk *chunk;
-  int file, oflags;
-
-  /* NOTE: This is currently used for autosave and 'quit.blend',
-   * where _not_ following symlinks is OK,
-   * however if this is ever executed explicitly by the user,
-   * we may want to allow writing to symlinks.
-   */
-
-  oflags = O_BINARY | O_WRONLY | O_CREAT | O_TRUNC;
+  int oflags = O_BINARY | O_WRONLY | O_CREAT | O_TRUNC;
 #ifdef O_NOFOLLOW
   /* use O_NOFOLLOW to avoid writing to a symlink - use 'O_EXCL' (CVE-2008-1103) */
   oflags |= O_NOFOLLOW;
@@ -242,7 +310,18 @@ bool BLO_memfile_write_file(struct MemFile *memfile, const char *filename)
 #    warning "Symbolic links will be followed on undo save, possibly causing CVE-2008-1103"
 #  endif
 #endif
-  file = BLI_open(filename, oflags, 0666);
+  return BLI_open(filename, oflags, 0666);
+}
+
+/**
+ * Saves .blend using undo buffer.
+ *
+ * \return success.
+ */
+bool BLO_memfile_write_file(struct MemFile *memfile, const char *filename)
+{
+  MemFileChunk *chunk;
+  const int file = memfile_file_open_write(filename);
 
   if (file == -1) {
     fprintf(stderr,
@@ -275,6 +354,381 @@ bool BLO_memfile_write_file(struct MemFile *memfile, const char *filename)
   return true;
 }
 
+/* -------------------------------------------------------------------- */
+/** \name Incremental File Writing
+ *
+ * Writing memfiles to the same file over and over again (as done for auto-save) mostly writes
+ * the same data. Instead a full base file is written once, and following writes only store a
+ * delta file next to it. The delta contains the chunks that are not in the base file, and
+ * references into the base file for all other chunks.
+ *
+ * Chunks are matched by their #MemFileChunk.content_id, so no content has to be compared or
+ * hashed. The delta is always relative to the base file, so only the last one is kept (it is
+ * replaced atomically). Once the delta gets too big, a new base file is written.
+ *
+ * The base file stays a regular .blend file, #BLO_memfile_incremental_recover merges a pending
+ * delta with it into a new file, the base file and the delta are never modified by it.
+ * \{ */
+
+#define DELTA_FILE_SUFFIX ".delta"
+#define DELTA_FILE_MAGIC "BLENDDLT"
+#define DELTA_FILE_VERSION 2
+#define DELTA_FILE_POINTER_SIZE ((sizeof(void *) == 8) ? '-' : '_')
+#define DELTA_FILE_ENDIAN ((ENDIAN_ORDER == B_ENDIAN) ? 'V' : 'v')
+
+/** Size of the buffer used to copy data from the base file when recovering. */
+#define DELTA_COPY_BUFFER_SIZE (1 << 20)
+
+typedef struct MemFileDeltaHeader {
+  char magic[8];
+  /** Same markers as the .blend file header, the delta is stored in native byte order. */
+  char pointer_size;
+  char endian;
+  char _pad[2];
+  int32_t version;
+  /** Used to detect that the base file changed since the delta was written. */
+  int64_t base_size;
+  int64_t base_mtime;
+  /** Size of the file after merging the delta. */
+  int64_t result_size;
+  int64_t records_len;
+} MemFileDeltaHeader;
+
+typedef struct MemFileDeltaRecord {
+  /** Offset in the base file, or -1 when the data directly follows this record. */
+  int64_t base_offset;
+  int64_t size;
+} MemFileDeltaRecord;
+
+typedef struct MemFileBaseChunk {
+  uint64_t content_id;
+  size_t offset;
+} MemFileBaseChunk;
+
+struct MemFileIncrementalWrite {
+  char filepath[FILE_MAX];
+  int64_t base_size;
+  int64_t base_mtime;
+
+  /** Chunks of the base file, sorted by content id. */
+  MemFileBaseChunk *base_chunks;
+  int base_chunks_len;
+};
+
+static void memfile_delta_filepath(const char *filename, char *r_delta_filepath)
+{
+  BLI_snprintf(r_delta_filepath, FILE_MAX, "%s" DELTA_FILE_SUFFIX, filename);
+}
+
+static int memfile_base_chunk_cmp(const void *a, const void *b)
+{
+  const uint64_t id_a = ((const MemFileBaseChunk *)a)->content_id;
+  const uint64_t id_b = ((const MemFileBaseChunk *)b)->content_id;
+  return (id_a < id_b) ? -1 : (id_a > id_b) ? 1 : 0;
+}
+
+static const MemFileBaseChunk *memfile_base_chunk_find(const MemFileIncrementalWrite *incremental,
+                                                       const MemFileChunk *chunk)
+{
+  const MemFileBaseChunk key = {.content_id = chunk->content_id};
+  return bsearch(&key,
+                 incremental->base_chunks,
+                 (size_t)incremental->base_chunks_len,
+                 sizeof(MemFileBaseChunk),
+                 memfile_base_chunk_cmp);
+}
+
+static bool memfile_file_stat(const char *filename, int64_t *r_size, int64_t *r_mtime)
+{
+  BLI_stat_t st;
+  if (BLI_stat(filename, &st) == -1) {
+    return false;
+  }
+  *r_size = (int64_t)st.st_size;
+  *r_mtime = (int64_t)st.st_mtime;
+  return true;
+}
+
+static bool memfile_write_base(MemFileIncrementalWrite *incremental,
+                               MemFile *memfile,
+                               const char *filename)
+{
+  /* Remove the delta first, it must never be applied to another base file. */
+  BLO_memfile_incremental_discard(filename);
+
+  MEM_SAFE_FREE(incremental->base_chunks);
+  incremental->base_chunks_len = 0;
+  incremental->filepath[0] = '\0';
+
+  if (!BLO_memfile_write_file(memfile, filename) ||
+      !memfile_file_stat(filename, &incremental->base_size, &incremental->base_mtime)) {
+    return false;
+  }
+
+  incremental->base_chunks = MEM_malloc_arrayN(
+      (size_t)BLI_listbase_count(&memfile->chunks), sizeof(MemFileBaseChunk), __func__);
+  size_t offset = 0;
+  LISTBASE_FOREACH (MemFileChunk *, chunk, &memfile->chunks) {
+    MemFileBaseChunk *base_chunk = &incremental->base_chunks[incremental->base_chunks_len++];
+    base_chunk->content_id = chunk->content_id;
+    base_chunk->offset = offset;
+    offset += chunk->size;
+  }
+  qsort(incremental->base_chunks,
+        (size_t)incremental->base_chunks_len,
+        sizeof(MemFileBaseChunk),
+        memfile_base_chunk_cmp);
+
+  BLI_strncpy(incremental->filepath, filename, sizeof(incremental->filepath));
+  return true;
+}
+
+static bool memfile_write_delta(const MemFileIncrementalWrite *incremental,
+                                MemFile *memfile,
+                                const char *filename)
+{
+  char delta_filepath[FILE_MAX], tmp_filepath[FILE_MAX];
+  memfile_delta_filepath(filename, delta_filepath);
+  BLI_snprintf(tmp_filepath, sizeof(tmp_filepath), "%s@", delta_filepath);
+
+  const int file = memfile_file_open_write(tmp_filepath);
+  if (file == -1) {
+    fprintf(stderr,
+            "Unable to save '%s': %s\n",
+            tmp_filepath,
+            errno ? strerror(errno) : "Unknown error opening file");
+    return false;
+  }
+
+  MemFileDeltaHeader header = {.pointer_size = DELTA_FILE_POINTER_SIZE,
+                               .endian = DELTA_FILE_ENDIAN,
+                               .version = DELTA_FILE_VERSION,
+                               .base_size = incremental->base_size,
+                               .base_mtime = incremental->base_mtime};
+  memcpy(header.magic, DELTA_FILE_MAGIC, sizeof(header.magic));
+
+  /* Header is written again once the number of records is known. */
+  bool ok = write(file, &header, sizeof(header)) == sizeof(header);
+
+  MemFileDeltaRecord record = {.base_offset = -1, .size = 0};
+  for (MemFileChunk *chunk = memfile->chunks.first; chunk && ok; chunk = chunk->next) {
+    const MemFileBaseChunk *base_chunk = memfile_base_chunk_find(incremental, chunk);
+    header.result_size += (int64_t)chunk->size;
+
+    if (base_chunk != NULL) {
+      /* Merge references to consecutive data in the base file. */
+      if (record.size != 0 && record.base_offset != -1 &&
+          record.base_offset + record.size == (int64_t)base_chunk->offset) {
+        record.size += (int64_t)chunk->size;
+        continue;
+      }
+      if (record.size != 0) {
+        ok = write(file, &record, sizeof(record)) == sizeof(record);
+        header.records_len++;
+      }
+      record.base_offset = (int64_t)base_chunk->offset;
+      record.size = (int64_t)chunk->size;
+    }
+    else {
+      if (record.size != 0) {
+        ok = write(file, &record, sizeof(record)) == sizeof(record);
+        header.records_len++;
+      }
+      record.base_offset = -1;
+      record.size = (int64_t)chunk->size;
+      ok = ok && write(file, &record, sizeof(record)) == sizeof(record) &&
+           (size_t)write(file, chunk->buf, chunk->size) == chunk->size;
+      header.records_len++;
+      record.size = 0;
+    }
+  }
+  if (ok && record.size != 0) {
+    ok = write(file, &record, sizeof(record)) == sizeof(record);
+    header.records_len++;
+  }
+
+  ok = ok && BLI_lseek(file, 0, SEEK_SET) == 0 &&
+       write(file, &header, sizeof(header)) == sizeof(header);
+
+  close(file);
+
+  if (!ok) {
+    fprintf(stderr,
+            "Unable to save '%s': %s\n",
+            tmp_filepath,
+            errno ? strerror(errno) : "Unknown error writing file");
+    BLI_delete(tmp_filepath, false, false);
+    return false;
+  }
+
+  if (BLI_rename(tmp_filepath, delta_filepath) != 0) {
+    fprintf(stderr, "Unable to rename '%s' to '%s'\n", tmp_filepath, delta_filepath);
+    return false;
+  }
+
+  return true;
+}
+
+MemFileIncrementalWrite *BLO_memfile_incremental_new(void)
+{
+  return MEM_callocN(sizeof(MemFileIncrementalWrite), __func__);
+}
+
+void BLO_memfile_incremental_free(MemFileIncrementalWrite *incremental)
+{
+  MEM_SAFE_FREE(incremental->base_chunks);
+  MEM_freeN(incremental);
+}
+
+/**
+ * Saves the memfile to a file, only writing the chunks that changed since the base file was
+ * written by a previous call with the same \a incremental data.
+ *
+ * \return success.
+ */
+bool BLO_memfile_write_file_incremental(MemFileIncrementalWrite *incremental,
+                                        MemFile *memfile,
+                                        const char *filename)
+{
+  int64_t base_size, base_mtime;
+  if (incremental->base_chunks == NULL || !STREQ(incremental->filepath, filename) ||
+      !memfile_file_stat(filename, &base_size, &base_mtime) ||
+      base_size != incremental->base_size || base_mtime != incremental->base_mtime) {
+    return memfile_write_base(incremental, memfile, filename);
+  }
+
+  /* Write a new base file once the delta would contain more than half of the data, reading the
+   * delta back is not worth it anymore at that point. */
+  size_t new_size = 0;
+  LISTBASE_FOREACH (MemFileChunk *, chunk, &memfile->chunks) {
+    if (memfile_base_chunk_find(incremental, chunk) == NULL) {
+      new_size += chunk->size;
+    }
+  }
+  if (new_size > (size_t)incremental->base_size / 2) {
+    return memfile_write_base(incremental, memfile, filename);
+  }
+
+  return memfile_write_delta(incremental, memfile, filename);
+}
+
+/**
+ * Remove a pending delta of the given file, needed when the file is written in another way.
+ */
+void BLO_memfile_incremental_discard(const char *filename)
+{
+  char delta_filepath[FILE_MAX];
+  memfile_delta_filepath(filename, delta_filepath);
+  if (BLI_exists(delta_filepath)) {
+    BLI_delete(delta_filepath, false, false);
+  }
+}
+
+static bool memfile_delta_copy(int file_src, int file_dst, int64_t size, char *buffer)
+{
+  while (size > 0) {
+    const size_t len = (size_t)MIN2(size, (int64_t)DELTA_COPY_BUFFER_SIZE);
+    if ((size_t)read(file_src, buffer, len) != len || (size_t)write(file_dst, buffer, len) != len) {
+      return false;
+    }
+    size -= (int64_t)len;
+  }
+  return true;
+}
+
+/**
+ * \return true when the file has a delta written by #BLO_memfile_write_file_incremental.
+ */
+bool BLO_memfile_incremental_exists(const char *filename)
+{
+  char delta_filepath[FILE_MAX];
+  memfile_delta_filepath(filename, delta_filepath);
+  return BLI_exists(delta_filepath) != 0;
+}
+
+/**
+ * Merge the delta written by #BLO_memfile_write_file_incremental with its base file, writing the
+ * result to \a filepath_dst as a regular .blend file. Neither the base file nor the delta are
+ * modified, a delta that doesn't match the base file is left as it is.
+ *
+ * \return success.
+ */
+bool BLO_memfile_incremental_recover(const char *filename, const char *filepath_dst)
+{
+  char delta_filepath[FILE_MAX], tmp_filepath[FILE_MAX];
+  memfile_delta_filepath(filename, delta_filepath);
+  BLI_snprintf(tmp_filepath, sizeof(tmp_filepath), "%s@", filepath_dst);
+
+  const int file_delta = BLI_open(delta_filepath, O_BINARY | O_RDONLY, 0);
+  if (file_delta == -1) {
+    return false;
+  }
+
+  MemFileDeltaHeader header;
+  int64_t base_size, base_mtime;
+  if (read(file_delta, &header, sizeof(header)) != sizeof(header) ||
+      memcmp(header.magic, DELTA_FILE_MAGIC, sizeof(header.magic)) != 0 ||
+      header.pointer_size != DELTA_FILE_POINTER_SIZE || header.endian != DELTA_FILE_ENDIAN ||
+      header.version != DELTA_FILE_VERSION ||
+      !memfile_file_stat(filename, &base_size, &base_mtime) || base_size != header.base_size ||
+      base_mtime != header.base_mtime) {
+    /* Written on another platform, or the base file was written again after the delta. */
+    fprintf(stderr, "Ignoring outdated or invalid '%s'\n", delta_filepath);
+    close(file_delta);
+    return false;
+  }
+
+  const int file_base = BLI_open(filename, O_BINARY | O_RDONLY, 0);
+  const int file_dst = memfile_file_open_write(tmp_filepath);
+  bool ok = file_base != -1 && file_dst != -1;
+
+  char *buffer = MEM_mallocN(DELTA_COPY_BUFFER_SIZE, __func__);
+  int64_t result_size = 0;
+  for (int64_t i = 0; i < header.records_len && ok; i++) {
+    MemFileDeltaRecord record;
+    ok = read(file_delta, &record, sizeof(record)) == sizeof(record) && record.size >= 0;
+    if (!ok) {
+      break;
+    }
+    if (record.base_offset == -1) {
+      ok = memfile_delta_copy(file_delta, file_dst, record.size, buffer);
+    }
+    else {
+      ok = record.base_offset >= 0 && record.base_offset + record.size <= base_size &&
+           BLI_lseek(file_base, record.base_offset, SEEK_SET) == record.base_offset &&
+           memfile_delta_copy(file_base, file_dst, record.size, buffer);
+    }
+    result_size += record.size;
+  }
+  MEM_freeN(buffer);
+  ok = ok && result_size == header.result_size;
+
+  close(file_delta);
+  if (file_base != -1) {
+    close(file_base);
+  }
+  if (file_dst != -1) {
+    close(file_dst);
+  }
+
+  if (!ok || BLI_rename(tmp_filepath, filepath_dst) != 0) {
+    fprintf(stderr, "Unable to apply '%s' to '%s'\n", delta_filepath, filepath_dst);
+    BLI_delete(tmp_filepath, false, false);
+    return false;
+  }
+
+  return true;
+}
+
+#undef DELTA_FILE_SUFFIX
+#undef DELTA_FILE_MAGIC
+#undef DELTA_FILE_VERSION
+#undef DELTA_FILE_POINTER_SIZE
+#undef DELTA_FILE_ENDIAN
+#undef DELTA_COPY_BUFFER_SIZE
+
+/** \} */
+
 static ssize_t undo_read(FileReader *reader, void *buffer, size_t size)
 {
   UndoReader *undo = (UndoReader *)reader;
@@ -105,9 +105,12 @@
 #include "BLI_linklist.h"
 #include "BLI_math_base.h"
 #include "BLI_mempool.h"
+#include "BLI_task.h"
 #include "BLI_threads.h"
 #include "MEM_guardedalloc.h" /* MEM_freeN */
 
+#include "atomic_ops.h"
+
 #include "BKE_blender_version.h"
 #include "BKE_bpath.h"
 #include "BKE_global.h" /* for G */
@@ -144,6 +147,13 @@
 #define MEM_BUFFER_SIZE (MEM_SIZE_OPTIMAL(1 << 17)) /* 128kb */
 #define MEM_CHUNK_SIZE (MEM_SIZE_OPTIMAL(1 << 15))  /* ~32kb */
 
+/* Limits of the content defined chunks large blocks are split into for undo,
+ * see #mywrite_chunk_len_content_defined. */
+#define MEM_CHUNK_SIZE_MIN (MEM_CHUNK_SIZE / 4)
+#define MEM_CHUNK_SIZE_MAX (MEM_CHUNK_SIZE * 4)
+/* Number of hash bits which must be zero at a boundary, giving the average chunk size. */
+#define MEM_CHUNK_BOUNDARY_BITS 15
+
 #define ZSTD_BUFFER_SIZE (1 << 21) /* 2mb */
 #define ZSTD_CHUNK_SIZE (1 << 20)  /* 1mb */
 
@@ -406,6 +416,32 @@ static void ww_handle_init(eWriteWrapType ww_type, WriteWrap *r_ww)
 /** \name Write Data Type & Functions
  * \{ */
 
+/** Captures stop growing at this size, the rest of the ID is then written directly. */
+#define WRITE_CAPTURE_SIZE_MAX (16 << 20) /* 16mb */
+/** Limit of the total size of all captures held in memory at once. */
+#define WRITE_CAPTURE_TOTAL_SIZE_MAX (128 << 20) /* 128mb */
+
+/**
+ * Output of a #WriteData that is not written out directly, but kept to be written later, in
+ * order with the rest of the file (used to write IDs in parallel).
+ */
+typedef struct WriteCapture {
+  /** All written bytes, one after the other. */
+  uchar *buf;
+  size_t buf_len;
+  size_t buf_max;
+  /** Size of all captures existing at the same time, shared between threads. */
+  size_t *total_len;
+  /** Set once the limits were exceeded, the captured data only covers the start of the ID then,
+   * see #write_id_batch_flush. */
+  bool is_overflow;
+
+  /** Size of every #mywrite call, so that it can be replayed exactly. */
+  size_t *writes;
+  uint writes_len;
+  uint writes_max;
+} WriteCapture;
+
 typedef struct {
   const struct SDNA *sdna;
 
@@ -429,11 +465,18 @@ typedef struct {
   /** Set on unlikely case of an error (ignores further file writing). */
   bool error;
 
+  /** Number of upcoming #mywrite calls to ignore, because their data was already written from a
+   * #WriteCapture. */
+  uint skip_writes_len;
+
   /** #MemFile writing (used for undo). */
   MemFileWriteData mem;
   /** When true, write to #WriteData.current, could also call 'is_undo'. */
   bool use_memfile;
 
+  /** When set, all writes are stored there instead of being written out. */
+  WriteCapture *capture;
+
   /**
    * Wrap writing, so we can use zstd or
    * other compression types later, see: G_FILE_COMPRESS
@@ -503,6 +546,42 @@ static void writedata_free(WriteData *wd)
   MEM_freeN(wd);
 }
 
+static void write_capture_free(WriteCapture *capture)
+{
+  MEM_SAFE_FREE(capture->buf);
+  MEM_SAFE_FREE(capture->writes);
+  memset(capture, 0, sizeof(*capture));
+}
+
+static void write_capture_append(WriteCapture *capture, const void *adr, size_t len)
+{
+  if (capture->is_overflow) {
+    return;
+  }
+
+  const size_t total_len = atomic_add_and_fetch_z(capture->total_len, len);
+  if (capture->buf_len + len > WRITE_CAPTURE_SIZE_MAX ||
+      total_len > WRITE_CAPTURE_TOTAL_SIZE_MAX) {
+    /* Keep what was captured so far, it is written out before the rest of the ID. */
+    atomic_sub_and_fetch_z(capture->total_len, len);
+    capture->is_overflow = true;
+    return;
+  }
+
+  if (capture->buf_len + len > capture->buf_max) {
+    capture->buf_max = max_zz(capture->buf_max * 2, max_zz(capture->buf_len + len, 1 << 14));
+    capture->buf = MEM_reallocN(capture->buf, capture->buf_max);
+  }
+  if (capture->writes_len == capture->writes_max) {
+    capture->writes_max = max_ii((int)capture->writes_max * 2, 256);
+    capture->writes = MEM_reallocN(capture->writes, sizeof(size_t) * capture->writes_max);
+  }
+
+  memcpy(capture->buf + capture->buf_len, adr, len);
+  capture->buf_len += len;
+  capture->writes[capture->writes_len++] = len;
+}
+
 /** \} */
 
 /* -------------------------------------------------------------------- */
@@ -521,6 +600,31 @@ static void mywrite_flush(WriteData *wd)
   }
 }
 
+/**
+ * Length of the next chunk of a large block written to an undo memfile.
+ *
+ * Boundaries are defined by the content, using a gear rolling hash of the last 32 bytes, instead
+ * of being at fixed offsets. Inserting or removing data in a large array then only changes the
+ * chunks around the modification, the following ones can still be found by their content in the
+ * previous undo step (see #BLO_memfile_chunk_add).
+ */
+static size_t mywrite_chunk_len_content_defined(const uchar *adr, size_t len)
+{
+  if (len <= MEM_CHUNK_SIZE_MAX) {
+    return len;
+  }
+
+  /* Only the last 32 bytes affect the hash, no need to look at the ones before. */
+  uint hash = 0;
+  for (size_t i = MEM_CHUNK_SIZE_MIN - 32; i < MEM_CHUNK_SIZE_MAX; i++) {
+    hash = (hash << 1) + (adr[i] + 1u) * 0x9E3779B1u;
+    if (i >= MEM_CHUNK_SIZE_MIN && (hash >> (32 - MEM_CHUNK_BOUNDARY_BITS)) == 0) {
+      return i + 1;
+    }
+  }
+  return MEM_CHUNK_SIZE_MAX;
+}
+
 /**
  * Low level WRITE(2) wrapper that buffers data
  * \param adr: Pointer to new chunk of data
@@ -537,6 +641,16 @@ static void mywrite(WriteData *wd, const void *adr, size_t len)
     return;
   }
 
+  if (wd->capture != NULL) {
+    write_capture_append(wd->capture, adr, len);
+    return;
+  }
+
+  if (wd->skip_writes_len != 0) {
+    wd->skip_writes_len--;
+    return;
+  }
+
 #ifdef USE_WRITE_DATA_LEN
   wd->write_len += len;
 #endif
@@ -554,7 +668,8 @@ static void mywrite(WriteData *wd, const void *adr, size_t len)
       }
 
       do {
-        size_t writelen = MIN2(len, wd->buffer.chunk_size);
+        size_t writelen = wd->use_memfile ? mywrite_chunk_len_content_defined(adr, len) :
+                                            MIN2(len, wd->buffer.chunk_size);
         writedata_do_write(wd, adr, writelen);
         adr = (const char *)adr + writelen;
         len -= writelen;
@@ -575,6 +690,19 @@ static void mywrite(WriteData *wd, const void *adr, size_t len)
   }
 }
 
+/**
+ * Write out the captured data, using the same calls to #mywrite as the ones that were captured,
+ * so that buffering (and hence the output) is the same as when writing directly.
+ */
+static void mywrite_capture(WriteData *wd, const WriteCapture *capture)
+{
+  const uchar *adr = capture->buf;
+  for (uint i = 0; i < capture->writes_len; i++) {
+    mywrite(wd, adr, capture->writes[i]);
+    adr += capture->writes[i];
+  }
+}
+
 /**
  * BeGiN initializer for mywrite
  * \param ww: File write wrapper.
@@ -1082,6 +1210,189 @@ static void write_thumb(WriteData *wd, const BlendThumbnail *thumb)
 
 /** \} */
 
+/* -------------------------------------------------------------------- */
+/** \name Parallel ID Writing
+ *
+ * IDs of a list are serialized in batches on worker threads, each one into its own
+ * #WriteCapture. These are then written out in order from the main thread, so the file is
+ * exactly the same as when writing all IDs one after the other.
+ *
+ * Only ID types with #IDTYPE_FLAGS_BLEND_WRITE_THREADSAFE are written on worker threads, others
+ * are written directly from the main thread. When an ID has more data than the capture limits,
+ * the main thread writes out the partial capture and serializes the ID again to write the rest,
+ * skipping the already captured writes.
+ * \{ */
+
+#define ID_BUFFER_STATIC_SIZE 8192
+
+/**
+ * Record the changes that happened up to this undo push in recalc_up_to_undo_push, and clear
+ * recalc_after_undo_push again to start accumulating for the next undo push.
+ *
+ * Done once before writing the ID, since #write_id may run more than once for the same ID.
+ */
+static void write_id_undo_recalc_store(ID *id)
+{
+  id->recalc_up_to_undo_push = id->recalc_after_undo_push;
+  id->recalc_after_undo_push = 0;
+
+  bNodeTree *nodetree = ntreeFromID(id);
+  if (nodetree != NULL) {
+    nodetree->id.recalc_up_to_undo_push = nodetree->id.recalc_after_undo_push;
+    nodetree->id.recalc_after_undo_push = 0;
+  }
+  if (GS(id->name) == ID_SCE) {
+    Scene *scene = (Scene *)id;
+    if (scene->master_collection != NULL) {
+      scene->master_collection->id.recalc_up_to_undo_push =
+          scene->master_collection->id.recalc_after_undo_push;
+      scene->master_collection->id.recalc_after_undo_push = 0;
+    }
+  }
+}
+
+/**
+ * Write a single ID and all of its data, from a temporary copy of the ID struct.
+ *
+ * Only touches the given ID, so this can run in parallel for different IDs.
+ */
+static void write_id(WriteData *wd, ID *id)
+{
+  const IDTypeInfo *id_type = BKE_idtype_get_info_from_id(id);
+
+  char id_buffer_static[ID_BUFFER_STATIC_SIZE];
+  void *id_buffer = id_buffer_static;
+  const size_t idtype_struct_size = id_type->struct_size;
+  if (idtype_struct_size > ID_BUFFER_STATIC_SIZE) {
+    BLI_assert(0);
+    id_buffer = MEM_mallocN(idtype_struct_size, __func__);
+  }
+
+  memcpy(id_buffer, id, idtype_struct_size);
+
+  /* Clear runtime data to reduce false detection of changed data in undo/redo context. */
+  ((ID *)id_buffer)->tag = 0;
+  ((ID *)id_buffer)->us = 0;
+  ((ID *)id_buffer)->icon_id = 0;
+  /* Those listbase data change every time we add/remove an ID, and also often when
+   * renaming one (due to re-sorting). This avoids generating a lot of false 'is changed'
+   * detections between undo steps. */
+  ((ID *)id_buffer)->prev = NULL;
+  ((ID *)id_buffer)->next = NULL;
+  /* Those runtime pointers should never be set during writing stage, but just in case clear
+   * them too. */
+  ((ID *)id_buffer)->orig_id = NULL;
+  ((ID *)id_buffer)->newid = NULL;
+  /* Even though in theory we could be able to preserve this python instance across undo even
+   * when we need to re-read the ID into its original address, this is currently cleared in
+   * #direct_link_id_common in `readfile.c` anyway, */
+  ((ID *)id_buffer)->py_instance = NULL;
+
+  if (id_type->blend_write != NULL) {
+    BlendWriter writer = {wd};
+    id_type->blend_write(&writer, (ID *)id_buffer, id);
+  }
+
+  if (id_buffer != id_buffer_static) {
+    MEM_freeN(id_buffer);
+  }
+}
+
+/** Number of IDs serialized at once for each thread, limits memory used by captured data. */
+#define WRITE_ID_BATCH_SIZE_PER_THREAD 4
+
+typedef struct WriteIDBatch {
+  const WriteData *wd;
+  /** When false, all IDs are written directly in #write_id_batch_flush. */
+  bool use_capture;
+  ID **ids;
+  /** IDs which are written directly in #write_id_batch_flush instead. */
+  bool *is_serial;
+  WriteCapture *captures;
+  /** Size of all captures of the batch, see #WRITE_CAPTURE_TOTAL_SIZE_MAX. */
+  size_t captures_len;
+} WriteIDBatch;
+
+static void write_id_batch_cb(void *__restrict userdata,
+                              const int index,
+                              const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  WriteIDBatch *batch = userdata;
+  if (batch->is_serial[index]) {
+    return;
+  }
+
+  WriteCapture *capture = &batch->captures[index];
+  capture->total_len = &batch->captures_len;
+
+  WriteData wd = {
+      .sdna = batch->wd->sdna,
+      .use_memfile = batch->wd->use_memfile,
+      .capture = capture,
+  };
+  write_id(&wd, batch->ids[index]);
+}
+
+static void write_id_batch_flush(WriteData *wd,
+                                 WriteIDBatch *batch,
+                                 const int batch_len,
+                                 Main *bmain,
+                                 OverrideLibraryStorage *override_storage)
+{
+  if (wd->use_memfile) {
+    for (int i = 0; i < batch_len; i++) {
+      write_id_undo_recalc_store(batch->ids[i]);
+    }
+  }
+
+  batch->captures_len = 0;
+
+  if (batch->use_capture) {
+    TaskParallelSettings settings;
+    BLI_parallel_range_settings_defaults(&settings);
+    settings.min_iter_per_thread = 1;
+    BLI_task_parallel_range(0, batch_len, batch, write_id_batch_cb, &settings);
+  }
+
+  for (int i = 0; i < batch_len; i++) {
+    ID *id = batch->ids[i];
+    WriteCapture *capture = &batch->captures[i];
+
+    mywrite_id_begin(wd, id);
+
+    if (batch->is_serial[i]) {
+      const bool do_override = !ELEM(override_storage, NULL, bmain) &&
+                               ID_IS_OVERRIDE_LIBRARY_REAL(id);
+      if (do_override) {
+        BKE_lib_override_library_operations_store_start(bmain, override_storage, id);
+      }
+      write_id(wd, id);
+      if (do_override) {
+        BKE_lib_override_library_operations_store_end(override_storage, id);
+      }
+    }
+    else if (!batch->use_capture) {
+      write_id(wd, id);
+    }
+    else if (capture->is_overflow) {
+      /* The ID was too large to be kept in memory, only write the data after the capture. */
+      mywrite_capture(wd, capture);
+      wd->skip_writes_len = capture->writes_len;
+      write_id(wd, id);
+      BLI_assert(wd->skip_writes_len == 0 || wd->error);
+      wd->skip_writes_len = 0;
+    }
+    else {
+      mywrite_capture(wd, capture);
+    }
+    write_capture_free(capture);
+
+    mywrite_id_end(wd, id);
+  }
+}
+
+/** \} */
+
 /* -------------------------------------------------------------------- */
 /** \name File Writing (Private)
  * \{ */
@@ -1125,7 +1436,17 @@ static bool write_file_handle(Main *mainvar,
                                                  NULL :
                                                  BKE_lib_override_library_operations_store_init();
 
-#define ID_BUFFER_STATIC_SIZE 8192
+  const int num_threads = BLI_system_thread_count();
+  const int batch_size = num_threads * WRITE_ID_BATCH_SIZE_PER_THREAD;
+  WriteIDBatch batch = {
+      .wd = wd,
+      /* With a single thread capturing only adds overhead. */
+      .use_capture = num_threads > 1,
+      .ids = MEM_malloc_arrayN((size_t)batch_size, sizeof(ID *), __func__),
+      .is_serial = MEM_malloc_arrayN((size_t)batch_size, sizeof(bool), __func__),
+      .captures = MEM_calloc_arrayN((size_t)batch_size, sizeof(WriteCapture), __func__),
+  };
+
   /* This outer loop allows to save first data-blocks from real mainvar,
    * then the temp ones from override process,
    * if needed, without duplicating whole code. */
@@ -1140,14 +1461,7 @@ static bool write_file_handle(Main *mainvar,
         continue; /* Libraries are handled separately below. */
       }
 
-      char id_buffer_static[ID_BUFFER_STATIC_SIZE];
-      void *id_buffer = id_buffer_static;
-      const size_t idtype_struct_size = BKE_idtype_get_info_from_id(id)->struct_size;
-      if (idtype_struct_size > ID_BUFFER_STATIC_SIZE) {
-        BLI_assert(0);
-        id_buffer = MEM_mallocN(idtype_struct_size, __func__);
-      }
-
+      int batch_len = 0;
       for (; id; id = id->next) {
         /* We should never attempt to write non-regular IDs
          * (i.e. all kind of temp/runtime ones). */
@@ -1162,77 +1476,30 @@ static bool write_file_handle(Main *mainvar,
           continue;
         }
 
-        const bool do_override = !ELEM(override_storage, NULL, bmain) &&
-                                 ID_IS_OVERRIDE_LIBRARY_REAL(id);
-
-        if (do_override) {
-          BKE_lib_override_library_operations_store_start(bmain, override_storage, id);
+        batch.ids[batch_len] = id;
+        /* Overrides modify the ID (and the override storage) while writing it. */
+        batch.is_serial[batch_len] = (BKE_idtype_get_info_from_id(id)->flags &
+                                      IDTYPE_FLAGS_BLEND_WRITE_THREADSAFE) == 0 ||
+                                     (!ELEM(override_storage, NULL, bmain) &&
+                                      ID_IS_OVERRIDE_LIBRARY_REAL(id));
+        if (++batch_len == batch_size) {
+          write_id_batch_flush(wd, &batch, batch_len, bmain, override_storage);
+          batch_len = 0;
         }
-
-        if (wd->use_memfile) {
-          /* Record the changes that happened up to this undo push in
-           * recalc_up_to_undo_push, and clear recalc_after_undo_push again
-           * to start accumulating for the next undo push. */
-          id->recalc_up_to_undo_push = id->recalc_after_undo_push;
-          id->recalc_after_undo_push = 0;
-
-          bNodeTree *nodetree = ntreeFromID(id);
-          if (nodetree != NULL) {
-            nodetree->id.recalc_up_to_undo_push = nodetree->id.recalc_after_undo_push;
-            nodetree->id.recalc_after_undo_push = 0;
-          }
-          if (GS(id->name) == ID_SCE) {
-            Scene *scene = (Scene *)id;
-            if (scene->master_collection != NULL) {
-              scene->master_collection->id.recalc_up_to_undo_push =
-                  scene->master_collection->id.recalc_after_undo_push;
-              scene->master_collection->id.recalc_after_undo_push = 0;
-            }
-          }
-        }
-
-        mywrite_id_begin(wd, id);
-
-        memcpy(id_buffer, id, idtype_struct_size);
-
-        /* Clear runtime data to reduce false detection of changed data in undo/redo context. */
-        ((ID *)id_buffer)->tag = 0;
-        ((ID *)id_buffer)->us = 0;
-        ((ID *)id_buffer)->icon_id = 0;
-        /* Those listbase data change every time we add/remove an ID, and also often when
-         * renaming one (due to re-sorting). This avoids generating a lot of false 'is changed'
-         * detections between undo steps. */
-        ((ID *)id_buffer)->prev = NULL;
-        ((ID *)id_buffer)->next = NULL;
-        /* Those runtime pointers should never be set during writing stage, but just in case clear
-         * them too. */
-        ((ID *)id_buffer)->orig_id = NULL;
-        ((ID *)id_buffer)->newid = NULL;
-        /* Even though in theory we could be able to preserve this python instance across undo even
-         * when we need to re-read the ID into its original address, this is currently cleared in
-         * #direct_link_id_common in `readfile.c` anyway, */
-        ((ID *)id_buffer)->py_instance = NULL;
-
-        const IDTypeInfo *id_type = BKE_idtype_get_info_from_id(id);
-        if (id_type->blend_write != NULL) {
-          id_type->blend_write(&writer, (ID *)id_buffer, id);
-        }
-
-        if (do_override) {
-          BKE_lib_override_library_operations_store_end(override_storage, id);
-        }
-
-        mywrite_id_end(wd, id);
       }
 
-      if (id_buffer != id_buffer_static) {
-        MEM_SAFE_FREE(id_buffer);
+      if (batch_len != 0) {
+        write_id_batch_flush(wd, &batch, batch_len, bmain, override_storage);
       }
 
       mywrite_flush(wd);
     }
   } while ((bmain != override_storage) && (bmain = override_storage));
 
+  MEM_freeN(batch.ids);
+  MEM_freeN(batch.is_serial);
+  MEM_freeN(batch.captures);
+
   if (override_storage) {
     BKE_lib_override_library_operations_store_finalize(override_storage);
     override_storage = NULL;
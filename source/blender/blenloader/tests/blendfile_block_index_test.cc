@@ -0,0 +1,199 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The Original Code is Copyright (C) 2021 by Blender Foundation.
+ */
+#include "blendfile_loading_base_test.h"
+
+#include <cstdio>
+#include <set>
+#include <string>
+
+#ifdef WIN32
+#  include <sys/utime.h>
+#else
+#  include <utime.h>
+#endif
+
+#include "MEM_guardedalloc.h"
+
+#include "BKE_appdir.h"
+#include "BKE_lib_id.h"
+#include "BKE_main.h"
+
+#include "BLI_fileops.h"
+#include "BLI_hash_mm2a.h"
+#include "BLI_linklist.h"
+#include "BLI_path_util.h"
+#include "BLI_string.h"
+
+#include "BLO_readfile.h"
+#include "BLO_writefile.h"
+
+#include "DNA_ID.h"
+
+/* Enough blocks for an index to be written, see #BLOCK_INDEX_MIN_BLOCKS. */
+static constexpr int meshes_num = 4200;
+
+class BlendfileBlockIndexTest : public BlendfileLoadingBaseTest {
+ protected:
+  char filepath[FILE_MAX];
+  char index_filepath[FILE_MAX];
+  std::string caches_env;
+  bool has_caches_env = false;
+
+  void SetUp() override
+  {
+    BlendfileLoadingBaseTest::SetUp();
+    BKE_tempdir_init("");
+
+    /* Keep the index out of the cache directory of the user (where supported). */
+    const char *env = BLI_getenv("XDG_CACHE_HOME");
+    has_caches_env = env != nullptr;
+    caches_env = env ? env : "";
+    char caches_dir[FILE_MAX];
+    BLI_path_join(caches_dir, sizeof(caches_dir), BKE_tempdir_session(), "cache", nullptr);
+    BLI_setenv("XDG_CACHE_HOME", caches_dir);
+
+    BLI_path_join(filepath,
+                  sizeof(filepath),
+                  BKE_tempdir_session(),
+                  "blendfile_block_index_test.blend",
+                  nullptr);
+
+    /* Same location as #read_file_block_index_filepath. */
+    ASSERT_TRUE(BKE_appdir_folder_caches(caches_dir, sizeof(caches_dir)));
+    char filename[16];
+    BLI_snprintf(filename,
+                 sizeof(filename),
+                 "%08x.index",
+                 BLI_hash_mm2((const unsigned char *)filepath, strlen(filepath), 0));
+    BLI_path_join(
+        index_filepath, sizeof(index_filepath), caches_dir, "blend_block_index", filename, nullptr);
+  }
+
+  void TearDown() override
+  {
+    BLI_delete(index_filepath, false, false);
+    BLI_delete(filepath, false, false);
+    BLI_setenv("XDG_CACHE_HOME", has_caches_env ? caches_env.c_str() : nullptr);
+    BlendfileLoadingBaseTest::TearDown();
+  }
+
+  /* Write a library with the given number of meshes, their names start with the prefix. */
+  void write_library(const char *prefix, const int num)
+  {
+    Main *bmain = BKE_main_new();
+    for (int i = 0; i < num; i++) {
+      char name[MAX_ID_NAME - 2];
+      BLI_snprintf(name, sizeof(name), "%s%04d", prefix, i);
+      BKE_id_new(bmain, ID_ME, name);
+    }
+
+    BlendFileWriteParams params = {BLO_WRITE_PATH_REMAP_NONE};
+    EXPECT_TRUE(BLO_write_file(bmain, filepath, 0, &params, nullptr));
+    BKE_main_free(bmain);
+  }
+
+  /* Names of the meshes as listed when linking. */
+  std::set<std::string> read_mesh_names()
+  {
+    BlendFileReadReport bf_reports = {nullptr};
+    BlendHandle *bh = BLO_blendhandle_from_file(filepath, &bf_reports);
+    if (bh == nullptr) {
+      ADD_FAILURE() << "Unable to open '" << filepath << "'";
+      return {};
+    }
+
+    int names_num = 0;
+    LinkNode *names = BLO_blendhandle_get_datablock_names(bh, ID_ME, false, &names_num);
+    std::set<std::string> result;
+    for (LinkNode *link = names; link; link = link->next) {
+      result.insert(static_cast<const char *>(link->link));
+    }
+    EXPECT_EQ(result.size(), (size_t)names_num);
+    BLI_linklist_freeN(names);
+    BLO_blendhandle_close(bh);
+    return result;
+  }
+
+  static std::set<std::string> expected_names(const char *prefix, const int num)
+  {
+    std::set<std::string> result;
+    for (int i = 0; i < num; i++) {
+      char name[MAX_ID_NAME - 2];
+      BLI_snprintf(name, sizeof(name), "%s%04d", prefix, i);
+      result.insert(name);
+    }
+    return result;
+  }
+
+  /* Write the library and read it twice, so that the second read uses the index. */
+  void write_library_with_index()
+  {
+    write_library("mesh", meshes_num);
+    EXPECT_FALSE(BLI_exists(index_filepath));
+    EXPECT_EQ(read_mesh_names(), expected_names("mesh", meshes_num));
+    ASSERT_TRUE(BLI_exists(index_filepath));
+    EXPECT_EQ(read_mesh_names(), expected_names("mesh", meshes_num));
+  }
+};
+
+TEST_F(BlendfileBlockIndexTest, StaleIndexFallsBack)
+{
+  write_library_with_index();
+
+  BLI_stat_t st;
+  ASSERT_EQ(BLI_stat(filepath, &st), 0);
+  const size_t file_size = BLI_file_size(filepath);
+
+  /* Replace the library by one with other blocks, which can't be told apart from the indexed
+   * file by its size and modification time. Data after the end of the file is ignored. */
+  write_library("part", meshes_num - 100);
+  const size_t new_file_size = BLI_file_size(filepath);
+  ASSERT_LT(new_file_size, file_size);
+  FILE *file = BLI_fopen(filepath, "ab");
+  ASSERT_NE(file, nullptr);
+  for (size_t i = new_file_size; i < file_size; i++) {
+    fputc(0, file);
+  }
+  fclose(file);
+  struct utimbuf times = {st.st_mtime, st.st_mtime};
+  ASSERT_EQ(utime(filepath, &times), 0);
+
+  EXPECT_EQ(read_mesh_names(), expected_names("part", meshes_num - 100));
+}
+
+TEST_F(BlendfileBlockIndexTest, CorruptIndexFallsBack)
+{
+  write_library_with_index();
+
+  /* Damage the records at the end of the index. */
+  size_t index_size = 0;
+  char *index_data = static_cast<char *>(
+      BLI_file_read_binary_as_mem(index_filepath, 0, &index_size));
+  ASSERT_NE(index_data, nullptr);
+  ASSERT_GT(index_size, 256u);
+  for (size_t i = index_size - 256; i < index_size; i++) {
+    index_data[i] ^= 0x5a;
+  }
+  FILE *file = BLI_fopen(index_filepath, "wb");
+  ASSERT_NE(file, nullptr);
+  EXPECT_EQ(fwrite(index_data, 1, index_size, file), index_size);
+  fclose(file);
+  MEM_freeN(index_data);
+
+  EXPECT_EQ(read_mesh_names(), expected_names("mesh", meshes_num));
+}
@@ -0,0 +1,192 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The Original Code is Copyright (C) 2021 by Blender Foundation.
+ */
+#include "blendfile_loading_base_test.h"
+
+#include <cstring>
+
+#include "MEM_guardedalloc.h"
+
+#include "BKE_appdir.h"
+#include "BKE_lib_id.h"
+#include "BKE_main.h"
+#include "BKE_packedFile.h"
+
+#include "BLI_fileops.h"
+#include "BLI_listbase.h"
+#include "BLI_path_util.h"
+
+#include "BLO_readfile.h"
+#include "BLO_writefile.h"
+
+#include "DNA_image_types.h"
+#include "DNA_packedFile_types.h"
+
+/* Large enough to be left in the file by #BLO_READ_DEFER_PACKED_DATA. */
+static constexpr int packed_data_size = 1 << 20;
+
+class BlendfileDeferredDataTest : public BlendfileLoadingBaseTest {
+ protected:
+  char filepath[FILE_MAX];
+
+  void SetUp() override
+  {
+    BlendfileLoadingBaseTest::SetUp();
+    BKE_tempdir_init("");
+    BLI_path_join(filepath,
+                  sizeof(filepath),
+                  BKE_tempdir_session(),
+                  "blendfile_deferred_data_test.blend",
+                  nullptr);
+  }
+
+  void TearDown() override
+  {
+    BLI_delete(filepath, false, false);
+    BlendfileLoadingBaseTest::TearDown();
+  }
+
+  static unsigned char expected_byte(const int i)
+  {
+    return (unsigned char)((i * 7) ^ (i >> 8));
+  }
+
+  /* Write a file with an image that has a large packed file. */
+  void write_packed_image()
+  {
+    Main *bmain = BKE_main_new();
+
+    unsigned char *data = static_cast<unsigned char *>(MEM_mallocN(packed_data_size, __func__));
+    for (int i = 0; i < packed_data_size; i++) {
+      data[i] = expected_byte(i);
+    }
+
+    Image *ima = static_cast<Image *>(BKE_id_new(bmain, ID_IM, "packed"));
+    ImagePackedFile *imapf = static_cast<ImagePackedFile *>(
+        MEM_callocN(sizeof(ImagePackedFile), __func__));
+    imapf->packedfile = BKE_packedfile_new_from_memory(data, packed_data_size);
+    BLI_addtail(&ima->packedfiles, imapf);
+
+    BlendFileWriteParams params = {BLO_WRITE_PATH_REMAP_NONE};
+    EXPECT_TRUE(BLO_write_file(bmain, filepath, 0, &params, nullptr));
+
+    BKE_main_free(bmain);
+  }
+
+  PackedFile *read_packed_file()
+  {
+    BlendFileReadReport bf_reports = {nullptr};
+    bfile = BLO_read_from_file(filepath, BLO_READ_DEFER_PACKED_DATA, &bf_reports);
+    if (bfile == nullptr) {
+      return nullptr;
+    }
+    Image *ima = static_cast<Image *>(bfile->main->images.first);
+    if (ima == nullptr || ima->packedfiles.first == nullptr) {
+      return nullptr;
+    }
+    return static_cast<ImagePackedFile *>(ima->packedfiles.first)->packedfile;
+  }
+
+  static bool packed_data_matches(const PackedFile *pf)
+  {
+    const unsigned char *data = static_cast<const unsigned char *>(pf->data);
+    for (int i = 0; i < packed_data_size; i++) {
+      if (data[i] != expected_byte(i)) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+TEST_F(BlendfileDeferredDataTest, LoadOnFirstAccess)
+{
+  write_packed_image();
+
+  PackedFile *pf = read_packed_file();
+  ASSERT_NE(pf, nullptr);
+  ASSERT_EQ(pf->size, packed_data_size);
+  EXPECT_EQ(pf->data, nullptr);
+  ASSERT_NE(pf->deferred, nullptr);
+
+  /* The copy stays deferred and reads the data by itself. */
+  PackedFile *pf_copy = BKE_packedfile_duplicate(pf);
+  EXPECT_EQ(pf_copy->data, nullptr);
+  EXPECT_NE(pf_copy->deferred, nullptr);
+
+  EXPECT_TRUE(BKE_packedfile_ensure_data(pf));
+  EXPECT_EQ(pf->deferred, nullptr);
+  ASSERT_NE(pf->data, nullptr);
+  EXPECT_TRUE(packed_data_matches(pf));
+
+  /* Loading again is a no-op. */
+  const void *data = pf->data;
+  EXPECT_TRUE(BKE_packedfile_ensure_data(pf));
+  EXPECT_EQ(pf->data, data);
+
+  EXPECT_TRUE(BKE_packedfile_ensure_data(pf_copy));
+  EXPECT_TRUE(packed_data_matches(pf_copy));
+  BKE_packedfile_free(pf_copy);
+
+  /* Duplicating loaded data copies it. */
+  pf_copy = BKE_packedfile_duplicate(pf);
+  EXPECT_EQ(pf_copy->deferred, nullptr);
+  EXPECT_NE(pf_copy->data, pf->data);
+  EXPECT_EQ(memcmp(pf_copy->data, pf->data, packed_data_size), 0);
+  BKE_packedfile_free(pf_copy);
+}
+
+TEST_F(BlendfileDeferredDataTest, ModifiedFileFails)
+{
+  write_packed_image();
+
+  PackedFile *pf = read_packed_file();
+  ASSERT_NE(pf, nullptr);
+  ASSERT_NE(pf->deferred, nullptr);
+
+  /* Overwriting the file with different content of another size invalidates the locations. */
+  FILE *file = BLI_fopen(filepath, "wb");
+  ASSERT_NE(file, nullptr);
+  fputs("BLENDER", file);
+  fclose(file);
+
+  /* Packed files are expected to always have data, so it's zero-filled on failure. */
+  EXPECT_FALSE(BKE_packedfile_ensure_data(pf));
+  EXPECT_EQ(pf->deferred, nullptr);
+  ASSERT_NE(pf->data, nullptr);
+  const unsigned char *data = static_cast<const unsigned char *>(pf->data);
+  EXPECT_EQ(data[0], 0);
+  EXPECT_EQ(data[packed_data_size - 1], 0);
+}
+
+TEST_F(BlendfileDeferredDataTest, ReadWithoutDeferring)
+{
+  write_packed_image();
+
+  /* Without the flag the data is read as usual, the runtime pointer written to the file is not
+   * restored. */
+  BlendFileReadReport bf_reports = {nullptr};
+  bfile = BLO_read_from_file(filepath, BLO_READ_SKIP_NONE, &bf_reports);
+  ASSERT_NE(bfile, nullptr);
+  Image *ima = static_cast<Image *>(bfile->main->images.first);
+  ASSERT_NE(ima, nullptr);
+  ASSERT_NE(ima->packedfiles.first, nullptr);
+  const PackedFile *pf = static_cast<ImagePackedFile *>(ima->packedfiles.first)->packedfile;
+  EXPECT_EQ(pf->deferred, nullptr);
+  ASSERT_NE(pf->data, nullptr);
+  EXPECT_TRUE(packed_data_matches(pf));
+}
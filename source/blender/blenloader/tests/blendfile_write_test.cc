@@ -0,0 +1,169 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The Original Code is Copyright (C) 2021 by Blender Foundation.
+ */
+#include "blendfile_loading_base_test.h"
+
+#include <string>
+#include <vector>
+
+#include "MEM_guardedalloc.h"
+
+#include "BKE_appdir.h"
+#include "BKE_customdata.h"
+#include "BKE_lib_id.h"
+#include "BKE_main.h"
+#include "BKE_mesh.h"
+#include "BKE_packedFile.h"
+
+#include "BLI_fileops.h"
+#include "BLI_listbase.h"
+#include "BLI_path_util.h"
+#include "BLI_threads.h"
+
+#include "BLO_undofile.h"
+#include "BLO_writefile.h"
+
+#include "DNA_image_types.h"
+#include "DNA_mesh_types.h"
+#include "DNA_meshdata_types.h"
+
+class BlendfileWriteTest : public BlendfileLoadingBaseTest {
+ protected:
+  Main *bmain = nullptr;
+
+  void SetUp() override
+  {
+    BlendfileLoadingBaseTest::SetUp();
+    BKE_tempdir_init("");
+    bmain = BKE_main_new();
+  }
+
+  void TearDown() override
+  {
+    BKE_main_free(bmain);
+    BLI_system_num_threads_override_set(0);
+    BlendfileLoadingBaseTest::TearDown();
+  }
+
+  void add_packed_image(const char *name, const int size)
+  {
+    unsigned char *data = static_cast<unsigned char *>(MEM_mallocN(size, __func__));
+    for (int i = 0; i < size; i++) {
+      data[i] = (unsigned char)(i * 13 + size);
+    }
+
+    Image *ima = static_cast<Image *>(BKE_id_new(bmain, ID_IM, name));
+    ImagePackedFile *imapf = static_cast<ImagePackedFile *>(
+        MEM_callocN(sizeof(ImagePackedFile), __func__));
+    imapf->packedfile = BKE_packedfile_new_from_memory(data, size);
+    BLI_addtail(&ima->packedfiles, imapf);
+  }
+
+  void add_mesh(const char *name, const int verts_num)
+  {
+    Mesh *mesh = static_cast<Mesh *>(BKE_id_new(bmain, ID_ME, name));
+    MVert *mvert = static_cast<MVert *>(
+        CustomData_add_layer(&mesh->vdata, CD_MVERT, CD_CALLOC, nullptr, verts_num));
+    for (int i = 0; i < verts_num; i++) {
+      mvert[i].co[0] = (float)i;
+      mvert[i].co[1] = (float)(i * 13 + verts_num);
+    }
+    mesh->totvert = verts_num;
+    BKE_mesh_update_customdata_pointers(mesh, false);
+  }
+
+  /* Many small IDs, and a few which are too large to be captured. Images are always written on
+   * the main thread. */
+  void add_ids()
+  {
+    for (int i = 0; i < 64; i++) {
+      const std::string name = "mesh" + std::to_string(i);
+      add_mesh(name.c_str(), i * 100);
+    }
+    for (int i = 0; i < 3; i++) {
+      /* Larger than the capture size limit. */
+      const std::string name = "large_mesh" + std::to_string(i);
+      add_mesh(name.c_str(), (1 << 20) + (i << 18));
+    }
+    for (int i = 0; i < 32; i++) {
+      const std::string name = "small" + std::to_string(i);
+      add_packed_image(name.c_str(), 1000 + i * 4096);
+    }
+    for (int i = 0; i < 3; i++) {
+      const std::string name = "large" + std::to_string(i);
+      add_packed_image(name.c_str(), (20 << 20) + i);
+    }
+  }
+
+  std::vector<char> write_memfile()
+  {
+    MemFile memfile = {{nullptr}};
+    EXPECT_TRUE(BLO_write_file_mem(bmain, nullptr, &memfile, 0));
+
+    std::vector<char> result;
+    LISTBASE_FOREACH (MemFileChunk *, chunk, &memfile.chunks) {
+      result.insert(result.end(), chunk->buf, chunk->buf + chunk->size);
+    }
+    BLO_memfile_free(&memfile);
+    return result;
+  }
+
+  std::vector<char> write_file()
+  {
+    char filepath[FILE_MAX];
+    BLI_path_join(
+        filepath, sizeof(filepath), BKE_tempdir_session(), "blendfile_write_test.blend", nullptr);
+
+    BlendFileWriteParams params = {BLO_WRITE_PATH_REMAP_NONE};
+    EXPECT_TRUE(BLO_write_file(bmain, filepath, 0, &params, nullptr));
+
+    size_t size = 0;
+    char *data = static_cast<char *>(BLI_file_read_binary_as_mem(filepath, 0, &size));
+    BLI_delete(filepath, false, false);
+    if (data == nullptr) {
+      ADD_FAILURE() << "Unable to read back '" << filepath << "'";
+      return {};
+    }
+
+    std::vector<char> result(data, data + size);
+    MEM_freeN(data);
+    return result;
+  }
+};
+
+/* Writing IDs on multiple threads gives exactly the same bytes as writing them one after the
+ * other on a single thread. */
+TEST_F(BlendfileWriteTest, ParallelMatchesSerial)
+{
+  add_ids();
+
+  BLI_system_num_threads_override_set(1);
+  const std::vector<char> serial_file = write_file();
+  const std::vector<char> serial_memfile = write_memfile();
+
+  BLI_system_num_threads_override_set(8);
+  const std::vector<char> parallel_file = write_file();
+  const std::vector<char> parallel_memfile = write_memfile();
+
+  ASSERT_FALSE(serial_file.empty());
+  EXPECT_EQ(serial_file.size(), parallel_file.size());
+  EXPECT_TRUE(serial_file == parallel_file);
+
+  ASSERT_FALSE(serial_memfile.empty());
+  EXPECT_EQ(serial_memfile.size(), parallel_memfile.size());
+  EXPECT_TRUE(serial_memfile == parallel_memfile);
+}
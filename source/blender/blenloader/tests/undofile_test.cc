@@ -0,0 +1,182 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The Original Code is Copyright (C) 2021 by Blender Foundation.
+ */
+#include "blendfile_loading_base_test.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "MEM_guardedalloc.h"
+
+#include "BKE_appdir.h"
+
+#include "BLI_fileops.h"
+#include "BLI_listbase.h"
+#include "BLI_path_util.h"
+#include "BLI_string.h"
+#include "BLI_utildefines.h"
+
+#include "BLO_undofile.h"
+
+static constexpr size_t chunk_size = 64 * 1024;
+
+class UndofileIncrementalTest : public BlendfileLoadingBaseTest {
+ protected:
+  char filepath[FILE_MAX];
+  char delta_filepath[FILE_MAX];
+  char merged_filepath[FILE_MAX];
+  MemFile memfile_base = {{nullptr}};
+  MemFile memfile_next = {{nullptr}};
+
+  void SetUp() override
+  {
+    BlendfileLoadingBaseTest::SetUp();
+    BKE_tempdir_init("");
+    BLI_path_join(
+        filepath, sizeof(filepath), BKE_tempdir_session(), "undofile_test.blend", nullptr);
+    BLI_snprintf(delta_filepath, sizeof(delta_filepath), "%s.delta", filepath);
+    BLI_path_join(merged_filepath,
+                  sizeof(merged_filepath),
+                  BKE_tempdir_session(),
+                  "undofile_test_merged.blend",
+                  nullptr);
+  }
+
+  void TearDown() override
+  {
+    BLO_memfile_free(&memfile_next);
+    BLO_memfile_free(&memfile_base);
+    BLI_delete(merged_filepath, false, false);
+    BLI_delete(delta_filepath, false, false);
+    BLI_delete(filepath, false, false);
+    BlendfileLoadingBaseTest::TearDown();
+  }
+
+  static std::vector<char> chunk_data(const char seed)
+  {
+    std::vector<char> data(chunk_size);
+    for (size_t i = 0; i < chunk_size; i++) {
+      data[i] = (char)(i * 31 + seed);
+    }
+    return data;
+  }
+
+  static void memfile_write(MemFile *memfile, MemFile *reference, const char *seeds)
+  {
+    MemFileWriteData mem_data = {nullptr};
+    BLO_memfile_write_init(&mem_data, memfile, reference);
+    for (const char *seed = seeds; *seed; seed++) {
+      const std::vector<char> data = chunk_data(*seed);
+      BLO_memfile_chunk_add(&mem_data, data.data(), data.size());
+    }
+    BLO_memfile_write_finalize(&mem_data);
+  }
+
+  static std::vector<char> memfile_data(const MemFile *memfile)
+  {
+    std::vector<char> result;
+    LISTBASE_FOREACH (MemFileChunk *, chunk, &memfile->chunks) {
+      result.insert(result.end(), chunk->buf, chunk->buf + chunk->size);
+    }
+    return result;
+  }
+
+  static std::vector<char> file_data(const char *path)
+  {
+    size_t size = 0;
+    char *data = static_cast<char *>(BLI_file_read_binary_as_mem(path, 0, &size));
+    if (data == nullptr) {
+      ADD_FAILURE() << "Unable to read back '" << path << "'";
+      return {};
+    }
+    std::vector<char> result(data, data + size);
+    MEM_freeN(data);
+    return result;
+  }
+
+  /* Write a base file, then a delta in which one chunk changed and another one moved. */
+  void write_base_and_delta()
+  {
+    memfile_write(&memfile_base, nullptr, "ABC");
+    memfile_write(&memfile_next, &memfile_base, "AXCB");
+
+    MemFileIncrementalWrite *incremental = BLO_memfile_incremental_new();
+    EXPECT_TRUE(BLO_memfile_write_file_incremental(incremental, &memfile_base, filepath));
+    EXPECT_FALSE(BLI_exists(delta_filepath));
+    EXPECT_TRUE(BLO_memfile_write_file_incremental(incremental, &memfile_next, filepath));
+    EXPECT_TRUE(BLI_exists(delta_filepath));
+    BLO_memfile_incremental_free(incremental);
+  }
+};
+
+TEST_F(UndofileIncrementalTest, RecoverMatchesMemfile)
+{
+  write_base_and_delta();
+
+  /* Only the delta was written, the base file is untouched. */
+  const std::vector<char> base = memfile_data(&memfile_base);
+  EXPECT_TRUE(file_data(filepath) == base);
+
+  EXPECT_TRUE(BLO_memfile_incremental_exists(filepath));
+  EXPECT_TRUE(BLO_memfile_incremental_recover(filepath, merged_filepath));
+
+  const std::vector<char> expected = memfile_data(&memfile_next);
+  const std::vector<char> recovered = file_data(merged_filepath);
+  EXPECT_EQ(recovered.size(), expected.size());
+  EXPECT_TRUE(recovered == expected);
+
+  /* Recovering leaves the auto-save files as they are. */
+  EXPECT_TRUE(BLI_exists(delta_filepath));
+  EXPECT_TRUE(file_data(filepath) == base);
+}
+
+TEST_F(UndofileIncrementalTest, StaleDeltaIsRejected)
+{
+  write_base_and_delta();
+
+  /* The base file is written again in another way, leaving the delta behind. */
+  MemFile memfile_other = {{nullptr}};
+  memfile_write(&memfile_other, nullptr, "Z");
+  EXPECT_TRUE(BLO_memfile_write_file(&memfile_other, filepath));
+  const std::vector<char> expected = memfile_data(&memfile_other);
+  BLO_memfile_free(&memfile_other);
+  ASSERT_TRUE(BLI_exists(delta_filepath));
+
+  EXPECT_FALSE(BLO_memfile_incremental_recover(filepath, merged_filepath));
+  EXPECT_FALSE(BLI_exists(merged_filepath));
+  EXPECT_TRUE(BLI_exists(delta_filepath));
+  EXPECT_TRUE(file_data(filepath) == expected);
+}
+
+TEST_F(UndofileIncrementalTest, ForeignDeltaIsRejected)
+{
+  write_base_and_delta();
+
+  /* A delta written with the other byte order, see #MemFileDeltaHeader.endian. */
+  std::vector<char> delta = file_data(delta_filepath);
+  ASSERT_GT(delta.size(), 10u);
+  ASSERT_TRUE(ELEM(delta[9], 'v', 'V'));
+  delta[9] = (delta[9] == 'v') ? 'V' : 'v';
+  FILE *file = BLI_fopen(delta_filepath, "wb");
+  ASSERT_NE(file, nullptr);
+  EXPECT_EQ(fwrite(delta.data(), 1, delta.size(), file), delta.size());
+  fclose(file);
+
+  EXPECT_FALSE(BLO_memfile_incremental_recover(filepath, merged_filepath));
+  EXPECT_FALSE(BLI_exists(merged_filepath));
+}
@@ -0,0 +1,391 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/** \file
+ * \ingroup spfile
+ *
+ * The index is a binary file in the native byte order, it is only used on the machine writing it:
+ * - #FileIndexHeader.
+ * - The linkable groups, #FileIndexerGroup.
+ * - For every asset, in the order of the groups: name, catalog, description and tags.
+ *
+ * Assets with custom properties are not indexed, files containing them are always read.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_blenlib.h"
+#include "BLI_fileops.h"
+#include "BLI_hash_mm2a.h"
+#include "BLI_linklist.h"
+#include "BLI_utildefines.h"
+
+#include "BKE_appdir.h"
+#include "BKE_asset.h"
+#include "BKE_idtype.h"
+
+#include "DNA_asset_types.h"
+
+#include "file_indexer.h"
+
+#define FILE_INDEX_MAGIC "BLENDAIX"
+#define FILE_INDEX_VERSION 2
+
+typedef struct FileIndexHeader {
+  char magic[8];
+  int version;
+  int groups_len;
+  int64_t file_size;
+  int64_t file_mtime;
+  int entries_len;
+  char _pad[4];
+  char filepath[FILE_MAX];
+} FileIndexHeader;
+
+/* -------------------------------------------------------------------- */
+/** \name Indexer Entries
+ * \{ */
+
+static bool file_indexer_file_stat(const char *filepath, int64_t *r_size, int64_t *r_mtime)
+{
+  BLI_stat_t st;
+  if (BLI_stat(filepath, &st) != 0) {
+    return false;
+  }
+  *r_size = (int64_t)st.st_size;
+  *r_mtime = (int64_t)st.st_mtime;
+  return true;
+}
+
+/**
+ * Read the linkable groups and the assets of a file, in the same order as
+ * #BLO_blendhandle_get_linkable_groups and #BLO_blendhandle_get_datablock_info return them.
+ *
+ * \return false when the file can't be opened.
+ */
+bool file_indexer_entries_from_file(FileIndexerEntries *indexer_entries, const char *filepath)
+{
+  /* Get the state before reading, a file modified while reading must not get an index. */
+  if (!file_indexer_file_stat(
+          filepath, &indexer_entries->file_size, &indexer_entries->file_mtime)) {
+    return false;
+  }
+
+  BlendFileReadReport bf_reports = {.reports = NULL};
+  struct BlendHandle *bh = BLO_blendhandle_from_file(filepath, &bf_reports);
+  if (bh == NULL) {
+    return false;
+  }
+
+  LinkNodePair entries = {NULL, NULL};
+  LinkNode *groups = BLO_blendhandle_get_linkable_groups(bh);
+  for (LinkNode *ln = groups; ln; ln = ln->next) {
+    const char *group_name = ln->link;
+    if (indexer_entries->groups_len == ARRAY_SIZE(indexer_entries->groups)) {
+      BLI_assert_unreachable();
+      break;
+    }
+    FileIndexerGroup *group = &indexer_entries->groups[indexer_entries->groups_len++];
+    BLI_strncpy(group->name, group_name, sizeof(group->name));
+    group->idcode = (short)BKE_idtype_idcode_from_name(group_name);
+
+    LinkNode *datablock_infos = BLO_blendhandle_get_datablock_info(
+        bh, group->idcode, true, &group->entries_len);
+    for (LinkNode *ln_info = datablock_infos; ln_info; ln_info = ln_info->next) {
+      const struct BLODataBlockInfo *info = ln_info->link;
+      FileIndexerEntry *entry = MEM_mallocN(sizeof(*entry), __func__);
+      /* Moves ownership of the asset data. */
+      entry->datablock_info = *info;
+      entry->idcode = group->idcode;
+      BLI_linklist_append(&entries, entry);
+    }
+    BLI_linklist_freeN(datablock_infos);
+  }
+  BLI_linklist_freeN(groups);
+  indexer_entries->entries = entries.list;
+
+  BLO_blendhandle_close(bh);
+  return true;
+}
+
+static void file_indexer_entry_free(void *link)
+{
+  FileIndexerEntry *entry = link;
+  if (entry->datablock_info.asset_data) {
+    BKE_asset_metadata_free(&entry->datablock_info.asset_data);
+  }
+  MEM_freeN(entry);
+}
+
+/**
+ * Free the entries, including asset data that wasn't taken by the file list.
+ */
+void file_indexer_entries_clear(FileIndexerEntries *indexer_entries)
+{
+  BLI_linklist_free(indexer_entries->entries, file_indexer_entry_free);
+  indexer_entries->entries = NULL;
+  indexer_entries->groups_len = 0;
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Index Files
+ * \{ */
+
+static bool file_indexer_index_filepath(const char *filepath, char r_index_filepath[FILE_MAX])
+{
+  char caches_dir[FILE_MAX];
+  if (!BKE_appdir_folder_caches(caches_dir, sizeof(caches_dir))) {
+    return false;
+  }
+
+  char filename[16];
+  const uint hash = BLI_hash_mm2((const uchar *)filepath, strlen(filepath), 0);
+  BLI_snprintf(filename, sizeof(filename), "%08x.index", hash);
+  BLI_path_join(r_index_filepath, FILE_MAX, caches_dir, "asset_index", filename, NULL);
+  return true;
+}
+
+typedef struct FileIndexReader {
+  const char *data;
+  size_t size;
+  size_t offset;
+} FileIndexReader;
+
+static bool file_index_read(FileIndexReader *reader, void *r_data, const size_t size)
+{
+  if (size > reader->size - reader->offset) {
+    return false;
+  }
+  memcpy(r_data, reader->data + reader->offset, size);
+  reader->offset += size;
+  return true;
+}
+
+static bool file_index_read_asset_data(FileIndexReader *reader, AssetMetaData *asset_data)
+{
+  int description_len;
+  if (!file_index_read(reader, &asset_data->catalog_id, sizeof(asset_data->catalog_id)) ||
+      !file_index_read(
+          reader, asset_data->catalog_simple_name, sizeof(asset_data->catalog_simple_name)) ||
+      !file_index_read(reader, &description_len, sizeof(description_len))) {
+    return false;
+  }
+  asset_data->catalog_simple_name[sizeof(asset_data->catalog_simple_name) - 1] = '\0';
+
+  if (description_len >= 0) {
+    if ((size_t)description_len > reader->size - reader->offset) {
+      return false;
+    }
+    asset_data->description = BLI_strdupn(reader->data + reader->offset, (size_t)description_len);
+    reader->offset += (size_t)description_len;
+  }
+
+  short active_tag;
+  int tags_len;
+  if (!file_index_read(reader, &active_tag, sizeof(active_tag)) ||
+      !file_index_read(reader, &tags_len, sizeof(tags_len)) || tags_len < 0) {
+    return false;
+  }
+  for (int i = 0; i < tags_len; i++) {
+    char tag_name[MAX_NAME];
+    if (!file_index_read(reader, tag_name, sizeof(tag_name))) {
+      return false;
+    }
+    tag_name[sizeof(tag_name) - 1] = '\0';
+    BKE_asset_metadata_tag_add(asset_data, tag_name);
+  }
+  asset_data->active_tag = active_tag;
+
+  return true;
+}
+
+/**
+ * Read the index of a file.
+ *
+ * \return false when there is no up to date index, \a r_indexer_entries is left empty then.
+ */
+bool file_indexer_read(const char *filepath, FileIndexerEntries *r_indexer_entries)
+{
+  int64_t file_size, file_mtime;
+  char index_filepath[FILE_MAX];
+  if (!file_indexer_file_stat(filepath, &file_size, &file_mtime) ||
+      !file_indexer_index_filepath(filepath, index_filepath)) {
+    return false;
+  }
+
+  size_t index_size;
+  char *index_data = BLI_file_read_binary_as_mem(index_filepath, 0, &index_size);
+  if (index_data == NULL) {
+    return false;
+  }
+
+  FileIndexReader reader = {index_data, index_size, 0};
+  FileIndexHeader header;
+  bool ok = file_index_read(&reader, &header, sizeof(header)) &&
+            (memcmp(header.magic, FILE_INDEX_MAGIC, sizeof(header.magic)) == 0) &&
+            (header.version == FILE_INDEX_VERSION) && (header.file_size == file_size) &&
+            (header.file_mtime == file_mtime) &&
+            (strncmp(header.filepath, filepath, sizeof(header.filepath)) == 0) &&
+            (header.groups_len >= 0) &&
+            (header.groups_len <= ARRAY_SIZE(r_indexer_entries->groups)) &&
+            (header.entries_len >= 0);
+
+  if (ok) {
+    r_indexer_entries->file_size = file_size;
+    r_indexer_entries->file_mtime = file_mtime;
+    r_indexer_entries->groups_len = header.groups_len;
+    ok = file_index_read(&reader,
+                         r_indexer_entries->groups,
+                         sizeof(*r_indexer_entries->groups) * (size_t)header.groups_len);
+  }
+
+  int entries_len = 0;
+  for (int i = 0; ok && i < r_indexer_entries->groups_len; i++) {
+    FileIndexerGroup *group = &r_indexer_entries->groups[i];
+    group->name[sizeof(group->name) - 1] = '\0';
+    ok = (group->idcode == 0 || BKE_idtype_idcode_is_valid(group->idcode)) &&
+         (group->entries_len >= 0) && (group->entries_len <= header.entries_len - entries_len);
+    entries_len += group->entries_len;
+  }
+  ok = ok && (entries_len == header.entries_len);
+
+  LinkNodePair entries = {NULL, NULL};
+  for (int i = 0; ok && i < r_indexer_entries->groups_len; i++) {
+    const FileIndexerGroup *group = &r_indexer_entries->groups[i];
+    for (int j = 0; ok && j < group->entries_len; j++) {
+      FileIndexerEntry *entry = MEM_callocN(sizeof(*entry), __func__);
+      BLI_linklist_append(&entries, entry);
+
+      entry->idcode = group->idcode;
+      ok = file_index_read(
+          &reader, entry->datablock_info.name, sizeof(entry->datablock_info.name));
+      if (ok) {
+        entry->datablock_info.name[sizeof(entry->datablock_info.name) - 1] = '\0';
+        entry->datablock_info.asset_data = BKE_asset_metadata_create();
+        ok = file_index_read_asset_data(&reader, entry->datablock_info.asset_data);
+      }
+    }
+  }
+  r_indexer_entries->entries = entries.list;
+
+  MEM_freeN(index_data);
+
+  if (!ok) {
+    file_indexer_entries_clear(r_indexer_entries);
+    return false;
+  }
+  return true;
+}
+
+static bool file_index_write(FILE *file, const void *data, const size_t size)
+{
+  return (size == 0) || (fwrite(data, size, 1, file) == 1);
+}
+
+static bool file_index_write_asset_data(FILE *file, const AssetMetaData *asset_data)
+{
+  const int description_len = asset_data->description ? (int)strlen(asset_data->description) :
+                                                        -1;
+  if (!file_index_write(file, &asset_data->catalog_id, sizeof(asset_data->catalog_id)) ||
+      !file_index_write(
+          file, asset_data->catalog_simple_name, sizeof(asset_data->catalog_simple_name)) ||
+      !file_index_write(file, &description_len, sizeof(description_len)) ||
+      (description_len > 0 &&
+       !file_index_write(file, asset_data->description, (size_t)description_len))) {
+    return false;
+  }
+
+  const int tags_len = BLI_listbase_count(&asset_data->tags);
+  if (!file_index_write(file, &asset_data->active_tag, sizeof(asset_data->active_tag)) ||
+      !file_index_write(file, &tags_len, sizeof(tags_len))) {
+    return false;
+  }
+  LISTBASE_FOREACH (const AssetTag *, tag, &asset_data->tags) {
+    if (!file_index_write(file, tag->name, sizeof(tag->name))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Write the index of a file, read with #file_indexer_entries_from_file.
+ */
+void file_indexer_write(const char *filepath, const FileIndexerEntries *indexer_entries)
+{
+  char index_filepath[FILE_MAX];
+  if (!file_indexer_index_filepath(filepath, index_filepath)) {
+    return;
+  }
+
+  for (const LinkNode *ln = indexer_entries->entries; ln; ln = ln->next) {
+    const FileIndexerEntry *entry = ln->link;
+    if (entry->datablock_info.asset_data->properties != NULL) {
+      /* Custom properties are not stored, remove an outdated index instead. */
+      if (BLI_exists(index_filepath)) {
+        BLI_delete(index_filepath, false, false);
+      }
+      return;
+    }
+  }
+
+  FileIndexHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, FILE_INDEX_MAGIC, sizeof(header.magic));
+  header.version = FILE_INDEX_VERSION;
+  header.groups_len = indexer_entries->groups_len;
+  header.file_size = indexer_entries->file_size;
+  header.file_mtime = indexer_entries->file_mtime;
+  header.entries_len = BLI_linklist_count(indexer_entries->entries);
+  BLI_strncpy(header.filepath, filepath, sizeof(header.filepath));
+
+  char index_dir[FILE_MAX];
+  BLI_split_dir_part(index_filepath, index_dir, sizeof(index_dir));
+  BLI_dir_create_recursive(index_dir);
+
+  /* Write to a temporary file first, so a partial index is never read. */
+  char tmp_filepath[FILE_MAX + 1];
+  BLI_snprintf(tmp_filepath, sizeof(tmp_filepath), "%s@", index_filepath);
+
+  FILE *file = BLI_fopen(tmp_filepath, "wb");
+  if (file == NULL) {
+    return;
+  }
+
+  bool ok = file_index_write(file, &header, sizeof(header)) &&
+            file_index_write(file,
+                             indexer_entries->groups,
+                             sizeof(*indexer_entries->groups) *
+                                 (size_t)indexer_entries->groups_len);
+  for (const LinkNode *ln = indexer_entries->entries; ok && ln; ln = ln->next) {
+    const FileIndexerEntry *entry = ln->link;
+    ok = file_index_write(
+             file, entry->datablock_info.name, sizeof(entry->datablock_info.name)) &&
+         file_index_write_asset_data(file, entry->datablock_info.asset_data);
+  }
+  ok = (fclose(file) == 0) && ok;
+
+  if (!ok || BLI_rename(tmp_filepath, index_filepath) != 0) {
+    BLI_delete(tmp_filepath, false, false);
+  }
+}
+
+/** \} */
@@ -0,0 +1,72 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/** \file
+ * \ingroup spfile
+ *
+ * Index of the assets in a .blend file, stored in the user cache directory.
+ *
+ * Listing an asset library opens every .blend file in it to read the asset meta-data. The index
+ * stores the result of this per file, invalidated by the size and modification time of the file,
+ * so browsing an unchanged library doesn't need to open the files again.
+ */
+
+#pragma once
+
+#include "BLO_readfile.h"
+
+#include "DNA_ID.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct LinkNode;
+
+typedef struct FileIndexerEntry {
+  struct BLODataBlockInfo datablock_info;
+  short idcode;
+} FileIndexerEntry;
+
+typedef struct FileIndexerGroup {
+  /** Name of a linkable data-block type in the file. */
+  char name[BLO_GROUP_MAX];
+  /** ID code of the type, 0 when it's unknown. */
+  short idcode;
+  /** Number of #FileIndexerEntries.entries of this group. */
+  int entries_len;
+} FileIndexerGroup;
+
+typedef struct FileIndexerEntries {
+  /** Groups in the order they are listed when reading the file. */
+  FileIndexerGroup groups[INDEX_ID_MAX];
+  int groups_len;
+  /** #FileIndexerEntry of the assets in the file, ordered by group. */
+  struct LinkNode *entries;
+  /** State of the file the entries were read from, to invalidate the index. */
+  int64_t file_size;
+  int64_t file_mtime;
+} FileIndexerEntries;
+
+bool file_indexer_entries_from_file(FileIndexerEntries *indexer_entries, const char *filepath);
+void file_indexer_entries_clear(FileIndexerEntries *indexer_entries);
+
+bool file_indexer_read(const char *filepath, FileIndexerEntries *r_indexer_entries);
+void file_indexer_write(const char *filepath, const FileIndexerEntries *indexer_entries);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,225 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The Original Code is Copyright (C) 2021 by Blender Foundation.
+ */
+#include "tests/blendfile_loading_base_test.h"
+
+#include <string>
+#include <vector>
+
+#ifdef WIN32
+#  include <sys/utime.h>
+#else
+#  include <utime.h>
+#endif
+
+#include "MEM_guardedalloc.h"
+
+#include "BKE_appdir.h"
+#include "BKE_asset.h"
+#include "BKE_idtype.h"
+#include "BKE_lib_id.h"
+#include "BKE_main.h"
+
+#include "BLI_fileops.h"
+#include "BLI_linklist.h"
+#include "BLI_path_util.h"
+#include "BLI_string.h"
+
+#include "BLO_readfile.h"
+#include "BLO_writefile.h"
+
+#include "DNA_asset_types.h"
+
+#include "file_indexer.h"
+
+class FileIndexerTest : public BlendfileLoadingBaseTest {
+ protected:
+  char filepath[FILE_MAX];
+  std::string caches_env;
+  bool has_caches_env = false;
+
+  void SetUp() override
+  {
+    BlendfileLoadingBaseTest::SetUp();
+    BKE_tempdir_init("");
+
+    /* Keep the index out of the cache directory of the user (where supported). */
+    const char *env = BLI_getenv("XDG_CACHE_HOME");
+    has_caches_env = env != nullptr;
+    caches_env = env ? env : "";
+    char caches_dir[FILE_MAX];
+    BLI_path_join(caches_dir, sizeof(caches_dir), BKE_tempdir_session(), "cache", nullptr);
+    BLI_setenv("XDG_CACHE_HOME", caches_dir);
+
+    BLI_path_join(
+        filepath, sizeof(filepath), BKE_tempdir_session(), "file_indexer_test.blend", nullptr);
+  }
+
+  void TearDown() override
+  {
+    BLI_delete(filepath, false, false);
+    BLI_setenv("XDG_CACHE_HOME", has_caches_env ? caches_env.c_str() : nullptr);
+    BlendfileLoadingBaseTest::TearDown();
+  }
+
+  static ID *add_asset(Main *bmain, const short idcode, const char *name, const char *description)
+  {
+    ID *id = static_cast<ID *>(BKE_id_new(bmain, idcode, name));
+    id->asset_data = BKE_asset_metadata_create();
+    id->asset_data->description = BLI_strdup(description);
+    return id;
+  }
+
+  /* Write a library with assets of several types, and data-blocks which are not assets. */
+  void write_library(const char *description)
+  {
+    Main *bmain = BKE_main_new();
+
+    add_asset(bmain, ID_MA, "material_b", description);
+    add_asset(bmain, ID_MA, "material_a", description);
+    BKE_id_new(bmain, ID_MA, "material_not_asset");
+    ID *mesh = add_asset(bmain, ID_ME, "mesh", description);
+    BKE_asset_metadata_tag_add(mesh->asset_data, "tag_a");
+    BKE_asset_metadata_tag_add(mesh->asset_data, "tag_b");
+    mesh->asset_data->active_tag = 1;
+    BKE_id_new(bmain, ID_GR, "collection_not_asset");
+
+    BlendFileWriteParams params = {BLO_WRITE_PATH_REMAP_NONE};
+    EXPECT_TRUE(BLO_write_file(bmain, filepath, 0, &params, nullptr));
+    BKE_main_free(bmain);
+  }
+
+  static std::string entry_string(const char *group_name, const BLODataBlockInfo *info)
+  {
+    std::string result = std::string(group_name) + "/" + info->name;
+    if (info->asset_data) {
+      const AssetMetaData *asset_data = info->asset_data;
+      result += std::string(" ") + (asset_data->description ? asset_data->description : "");
+      LISTBASE_FOREACH (const AssetTag *, tag, &asset_data->tags) {
+        result += std::string(" #") + tag->name;
+      }
+      result += " " + std::to_string(asset_data->active_tag);
+    }
+    return result;
+  }
+
+  /* Groups and assets as listed by the file browser when reading the file. */
+  std::vector<std::string> listing_from_file()
+  {
+    std::vector<std::string> result;
+    BlendFileReadReport bf_reports = {nullptr};
+    BlendHandle *bh = BLO_blendhandle_from_file(filepath, &bf_reports);
+    if (bh == nullptr) {
+      ADD_FAILURE() << "Unable to open '" << filepath << "'";
+      return result;
+    }
+
+    LinkNode *groups = BLO_blendhandle_get_linkable_groups(bh);
+    for (LinkNode *ln = groups; ln; ln = ln->next) {
+      const char *group_name = static_cast<const char *>(ln->link);
+      result.push_back(group_name);
+
+      int infos_len;
+      LinkNode *infos = BLO_blendhandle_get_datablock_info(
+          bh, BKE_idtype_idcode_from_name(group_name), true, &infos_len);
+      for (LinkNode *ln_info = infos; ln_info; ln_info = ln_info->next) {
+        BLODataBlockInfo *info = static_cast<BLODataBlockInfo *>(ln_info->link);
+        result.push_back(entry_string(group_name, info));
+        BKE_asset_metadata_free(&info->asset_data);
+      }
+      BLI_linklist_freeN(infos);
+    }
+    BLI_linklist_freeN(groups);
+
+    BLO_blendhandle_close(bh);
+    return result;
+  }
+
+  /* Groups and assets as listed by the file browser from the indexer entries. */
+  static std::vector<std::string> listing_from_entries(const FileIndexerEntries *indexer_entries)
+  {
+    std::vector<std::string> result;
+    const LinkNode *ln = indexer_entries->entries;
+    for (int i = 0; i < indexer_entries->groups_len; i++) {
+      const FileIndexerGroup *group = &indexer_entries->groups[i];
+      EXPECT_EQ(group->idcode, BKE_idtype_idcode_from_name(group->name));
+      result.push_back(group->name);
+      for (int j = 0; j < group->entries_len; j++, ln = ln->next) {
+        if (ln == nullptr) {
+          ADD_FAILURE() << "Missing entries of group " << group->name;
+          return result;
+        }
+        const FileIndexerEntry *entry = static_cast<const FileIndexerEntry *>(ln->link);
+        EXPECT_EQ(entry->idcode, group->idcode);
+        result.push_back(entry_string(group->name, &entry->datablock_info));
+      }
+    }
+    EXPECT_EQ(ln, nullptr);
+    return result;
+  }
+};
+
+TEST_F(FileIndexerTest, WriteRead)
+{
+  write_library("description");
+  const std::vector<std::string> expected = listing_from_file();
+  ASSERT_FALSE(expected.empty());
+
+  FileIndexerEntries entries_from_file = {};
+  ASSERT_TRUE(file_indexer_entries_from_file(&entries_from_file, filepath));
+  EXPECT_EQ(listing_from_entries(&entries_from_file), expected);
+
+  FileIndexerEntries entries_read = {};
+  EXPECT_FALSE(file_indexer_read(filepath, &entries_read));
+  file_indexer_write(filepath, &entries_from_file);
+  ASSERT_TRUE(file_indexer_read(filepath, &entries_read));
+  EXPECT_EQ(listing_from_entries(&entries_read), expected);
+  EXPECT_EQ(entries_read.file_size, entries_from_file.file_size);
+  EXPECT_EQ(entries_read.file_mtime, entries_from_file.file_mtime);
+
+  file_indexer_entries_clear(&entries_read);
+  file_indexer_entries_clear(&entries_from_file);
+}
+
+TEST_F(FileIndexerTest, Invalidate)
+{
+  write_library("description");
+  FileIndexerEntries indexer_entries = {};
+  ASSERT_TRUE(file_indexer_entries_from_file(&indexer_entries, filepath));
+  file_indexer_write(filepath, &indexer_entries);
+  file_indexer_entries_clear(&indexer_entries);
+
+  /* Another size. */
+  write_library("another description");
+  EXPECT_FALSE(file_indexer_read(filepath, &indexer_entries));
+  EXPECT_EQ(indexer_entries.groups_len, 0);
+  EXPECT_EQ(indexer_entries.entries, nullptr);
+
+  ASSERT_TRUE(file_indexer_entries_from_file(&indexer_entries, filepath));
+  file_indexer_write(filepath, &indexer_entries);
+  file_indexer_entries_clear(&indexer_entries);
+  ASSERT_TRUE(file_indexer_read(filepath, &indexer_entries));
+  file_indexer_entries_clear(&indexer_entries);
+
+  /* Same size, another modification time. */
+  BLI_stat_t st;
+  ASSERT_EQ(BLI_stat(filepath, &st), 0);
+  struct utimbuf times = {st.st_mtime + 10, st.st_mtime + 10};
+  ASSERT_EQ(utime(filepath, &times), 0);
+  EXPECT_FALSE(file_indexer_read(filepath, &indexer_entries));
+  EXPECT_EQ(indexer_entries.entries, nullptr);
+}
@@ -88,6 +88,7 @@
 
 #include "atomic_ops.h"
 
+#include "file_indexer.h"
 #include "filelist.h"
 
 #define FILEDIR_NBR_ENTRIES_UNSET -1
@@ -2948,6 +2949,57 @@ static void filelist_readjob_list_lib_add_datablocks(ListBase *entries,
   }
 }
 
+static FileListInternEntry *filelist_readjob_list_lib_parent_create(void)
+{
+  FileListInternEntry *entry = MEM_callocN(sizeof(*entry), __func__);
+  entry->relpath = BLI_strdup(FILENAME_PARENT);
+  entry->typeflag |= (FILE_TYPE_BLENDERLIB | FILE_TYPE_DIR);
+  return entry;
+}
+
+/**
+ * Listing all assets of a library goes through the asset index, see #file_indexer_read.
+ */
+static int filelist_readjob_list_lib_indexed(const char *filepath,
+                                             ListBase *entries,
+                                             const ListLibOptions options)
+{
+  FileIndexerEntries indexer_entries = {{{{0}}}};
+  if (!file_indexer_read(filepath, &indexer_entries)) {
+    if (!file_indexer_entries_from_file(&indexer_entries, filepath)) {
+      return 0;
+    }
+    file_indexer_write(filepath, &indexer_entries);
+  }
+
+  int added_entries_len = 0;
+  if (options & LIST_LIB_ADD_PARENT) {
+    BLI_addtail(entries, filelist_readjob_list_lib_parent_create());
+    added_entries_len++;
+  }
+
+  /* Same order as #filelist_readjob_list_lib, each group followed by its data-blocks. */
+  LinkNode *ln = indexer_entries.entries;
+  for (int i = 0; i < indexer_entries.groups_len; i++) {
+    const FileIndexerGroup *group = &indexer_entries.groups[i];
+    BLI_addtail(entries, filelist_readjob_list_lib_group_create(group->idcode, group->name));
+    added_entries_len++;
+
+    for (int j = 0; j < group->entries_len && ln; j++, ln = ln->next) {
+      FileIndexerEntry *indexer_entry = ln->link;
+      LinkNode datablock_info_link = {NULL, &indexer_entry->datablock_info};
+      filelist_readjob_list_lib_add_datablocks(
+          entries, &datablock_info_link, true, group->idcode, group->name);
+      /* Ownership was moved to the file list entry. */
+      indexer_entry->datablock_info.asset_data = NULL;
+      added_entries_len++;
+    }
+  }
+
+  file_indexer_entries_clear(&indexer_entries);
+  return added_entries_len;
+}
+
 static int filelist_readjob_list_lib(const char *root,
                                      ListBase *entries,
                                      const ListLibOptions options)
@@ -2966,6 +3018,10 @@ static int filelist_readjob_list_lib(const char *root,
     return 0;
   }
 
+  if (group == NULL && (options & LIST_LIB_ASSETS_ONLY) && (options & LIST_LIB_RECURSIVE)) {
+    return filelist_readjob_list_lib_indexed(dir, entries, options);
+  }
+
   /* Open the library file. */
   BlendFileReadReport bf_reports = {.reports = NULL};
   libfiledata = BLO_blendhandle_from_file(dir, &bf_reports);
@@ -2976,10 +3032,7 @@ static int filelist_readjob_list_lib(const char *root,
   /* Add current parent when requested. */
   int parent_len = 0;
   if (options & LIST_LIB_ADD_PARENT) {
-    FileListInternEntry *entry = MEM_callocN(sizeof(*entry), __func__);
-    entry->relpath = BLI_strdup(FILENAME_PARENT);
-    entry->typeflag |= (FILE_TYPE_BLENDERLIB | FILE_TYPE_DIR);
-    BLI_addtail(entries, entry);
+    BLI_addtail(entries, filelist_readjob_list_lib_parent_create());
     parent_len = 1;
   }
 
@@ -30,7 +30,10 @@ extern "C" {
 typedef struct PackedFile {
   int size;
   int seek;
+  /** NULL while the data is deferred, see #BKE_packedfile_ensure_data. */
   void *data;
+  /** Runtime, location of the data in the .blend file it was not read from yet. */
+  struct BlendDeferredData *deferred;
 } PackedFile;
 
 #ifdef __cplusplus
@@ -739,18 +739,18 @@ const char *DNA_struct_get_compareflags(const SDNA *oldsdna, const SDNA *newsdna
  * \param new_type: Type to convert to.
  * \param array_len: Number of elements to convert.
  * \param old_data: Buffer containing the old values.
+ * \param old_stride: Distance in bytes between consecutive old values.
  * \param new_data: Buffer the converted values will be written to.
+ * \param new_stride: Distance in bytes between consecutive new values.
  */
 static void cast_primitive_type(const eSDNA_Type old_type,
                                 const eSDNA_Type new_type,
                                 const int array_len,
                                 const char *old_data,
-                                char *new_data)
+                                const int old_stride,
+                                char *new_data,
+                                const int new_stride)
 {
-  /* define lengths */
-  const int oldlen = DNA_elem_type_size(old_type);
-  const int curlen = DNA_elem_type_size(new_type);
-
   double old_value_f = 0.0;
   uint64_t old_value_i = 0;
 
@@ -836,29 +836,37 @@ static void cast_primitive_type(const eSDNA_Type old_type,
         break;
     }
 
-    old_data += oldlen;
-    new_data += curlen;
+    old_data += old_stride;
+    new_data += new_stride;
   }
 }
 
 static void cast_pointer_32_to_64(const int array_len,
-                                  const uint32_t *old_data,
-                                  uint64_t *new_data)
+                                  const char *old_data,
+                                  const int old_stride,
+                                  char *new_data,
+                                  const int new_stride)
 {
   for (int a = 0; a < array_len; a++) {
-    new_data[a] = old_data[a];
+    *(uint64_t *)new_data = *(const uint32_t *)old_data;
+    old_data += old_stride;
+    new_data += new_stride;
   }
 }
 
 static void cast_pointer_64_to_32(const int array_len,
-                                  const uint64_t *old_data,
-                                  uint32_t *new_data)
+                                  const char *old_data,
+                                  const int old_stride,
+                                  char *new_data,
+                                  const int new_stride)
 {
   /* WARNING: 32-bit Blender trying to load file saved by 64-bit Blender,
    * pointers may lose uniqueness on truncation! (Hopefully this won't
    * happen unless/until we ever get to multi-gigabyte .blend files...) */
   for (int a = 0; a < array_len; a++) {
-    new_data[a] = old_data[a] >> 3;
+    *(uint32_t *)new_data = (uint32_t)(*(const uint64_t *)old_data >> 3);
+    old_data += old_stride;
+    new_data += new_stride;
   }
 }
 
@@ -1141,26 +1149,30 @@ typedef struct DNA_ReconstructInfo {
   ReconstructStep **steps;
 } DNA_ReconstructInfo;
 
-static void reconstruct_structs(const DNA_ReconstructInfo *reconstruct_info,
-                                const int blocks,
-                                const int old_struct_nr,
-                                const int new_struct_nr,
-                                const char *old_blocks,
-                                char *new_blocks);
-
 /**
- * Converts the contents of an entire struct from oldsdna to newsdna format.
+ * Converts the contents of an array of structs from oldsdna to newsdna format.
+ *
+ * Every reconstruct step is executed for all structs in the array before going to the next step,
+ * so that the step is only dispatched once for the entire array. Steps for single values (which
+ * is the common case) are executed as a strided loop over all structs, this also goes for nested
+ * structs.
  *
  * \param reconstruct_info: Preprocessed reconstruct information generated by
  * #DNA_reconstruct_info_create.
+ * \param blocks: Number of structs to reconstruct.
  * \param new_struct_nr: Index in newsdna->structs of the struct that is being reconstructed.
- * \param old_block: Memory buffer containing the old struct.
- * \param new_block: Where to put converted struct contents.
+ * \param old_blocks: Memory buffer containing the old structs.
+ * \param old_stride: Distance in bytes between consecutive old structs.
+ * \param new_blocks: Where to put converted struct contents.
+ * \param new_stride: Distance in bytes between consecutive new structs.
  */
-static void reconstruct_struct(const DNA_ReconstructInfo *reconstruct_info,
-                               const int new_struct_nr,
-                               const char *old_block,
-                               char *new_block)
+static void reconstruct_structs(const DNA_ReconstructInfo *reconstruct_info,
+                                const int blocks,
+                                const int new_struct_nr,
+                                const char *old_blocks,
+                                const int old_stride,
+                                char *new_blocks,
+                                const int new_stride)
 {
   const ReconstructStep *steps = reconstruct_info->steps[new_struct_nr];
   const int step_count = reconstruct_info->step_counts[new_struct_nr];
@@ -1169,36 +1181,104 @@ static void reconstruct_struct(const DNA_ReconstructInfo *reconstruct_info,
   for (int a = 0; a < step_count; a++) {
     const ReconstructStep *step = &steps[a];
     switch (step->type) {
-      case RECONSTRUCT_STEP_MEMCPY:
-        memcpy(new_block + step->data.memcpy.new_offset,
-               old_block + step->data.memcpy.old_offset,
-               step->data.memcpy.size);
+      case RECONSTRUCT_STEP_MEMCPY: {
+        const int size = step->data.memcpy.size;
+        if (size == old_stride && size == new_stride) {
+          /* The struct layout did not change (e.g. only members were added at the end of a
+           * nested struct), copy the entire array at once. */
+          memcpy(new_blocks, old_blocks, (size_t)blocks * (size_t)size);
+          break;
+        }
+        const char *old_data = old_blocks + step->data.memcpy.old_offset;
+        char *new_data = new_blocks + step->data.memcpy.new_offset;
+        for (int b = 0; b < blocks; b++) {
+          memcpy(new_data, old_data, size);
+          old_data += old_stride;
+          new_data += new_stride;
+        }
         break;
-      case RECONSTRUCT_STEP_CAST_PRIMITIVE:
-        cast_primitive_type(step->data.cast_primitive.old_type,
-                            step->data.cast_primitive.new_type,
-                            step->data.cast_primitive.array_len,
-                            old_block + step->data.cast_primitive.old_offset,
-                            new_block + step->data.cast_primitive.new_offset);
+      }
+      case RECONSTRUCT_STEP_CAST_PRIMITIVE: {
+        const eSDNA_Type old_type = step->data.cast_primitive.old_type;
+        const eSDNA_Type new_type = step->data.cast_primitive.new_type;
+        const int array_len = step->data.cast_primitive.array_len;
+        const char *old_data = old_blocks + step->data.cast_primitive.old_offset;
+        char *new_data = new_blocks + step->data.cast_primitive.new_offset;
+        if (array_len == 1) {
+          cast_primitive_type(
+              old_type, new_type, blocks, old_data, old_stride, new_data, new_stride);
+          break;
+        }
+        const int old_elem_size = DNA_elem_type_size(old_type);
+        const int new_elem_size = DNA_elem_type_size(new_type);
+        for (int b = 0; b < blocks; b++) {
+          cast_primitive_type(
+              old_type, new_type, array_len, old_data, old_elem_size, new_data, new_elem_size);
+          old_data += old_stride;
+          new_data += new_stride;
+        }
         break;
+      }
       case RECONSTRUCT_STEP_CAST_POINTER_TO_32:
-        cast_pointer_64_to_32(step->data.cast_pointer.array_len,
-                              (const uint64_t *)(old_block + step->data.cast_pointer.old_offset),
-                              (uint32_t *)(new_block + step->data.cast_pointer.new_offset));
-        break;
-      case RECONSTRUCT_STEP_CAST_POINTER_TO_64:
-        cast_pointer_32_to_64(step->data.cast_pointer.array_len,
-                              (const uint32_t *)(old_block + step->data.cast_pointer.old_offset),
-                              (uint64_t *)(new_block + step->data.cast_pointer.new_offset));
+      case RECONSTRUCT_STEP_CAST_POINTER_TO_64: {
+        const bool to_32 = step->type == RECONSTRUCT_STEP_CAST_POINTER_TO_32;
+        const int array_len = step->data.cast_pointer.array_len;
+        const char *old_data = old_blocks + step->data.cast_pointer.old_offset;
+        char *new_data = new_blocks + step->data.cast_pointer.new_offset;
+        if (array_len == 1) {
+          if (to_32) {
+            cast_pointer_64_to_32(blocks, old_data, old_stride, new_data, new_stride);
+          }
+          else {
+            cast_pointer_32_to_64(blocks, old_data, old_stride, new_data, new_stride);
+          }
+          break;
+        }
+        for (int b = 0; b < blocks; b++) {
+          if (to_32) {
+            cast_pointer_64_to_32(array_len, old_data, 8, new_data, 4);
+          }
+          else {
+            cast_pointer_32_to_64(array_len, old_data, 4, new_data, 8);
+          }
+          old_data += old_stride;
+          new_data += new_stride;
+        }
         break;
-      case RECONSTRUCT_STEP_SUBSTRUCT:
-        reconstruct_structs(reconstruct_info,
-                            step->data.substruct.array_len,
-                            step->data.substruct.old_struct_nr,
-                            step->data.substruct.new_struct_nr,
-                            old_block + step->data.substruct.old_offset,
-                            new_block + step->data.substruct.new_offset);
+      }
+      case RECONSTRUCT_STEP_SUBSTRUCT: {
+        const int array_len = step->data.substruct.array_len;
+        const int sub_struct_nr = step->data.substruct.new_struct_nr;
+        const char *old_data = old_blocks + step->data.substruct.old_offset;
+        char *new_data = new_blocks + step->data.substruct.new_offset;
+        if (array_len == 1) {
+          reconstruct_structs(reconstruct_info,
+                              blocks,
+                              sub_struct_nr,
+                              old_data,
+                              old_stride,
+                              new_data,
+                              new_stride);
+          break;
+        }
+        const SDNA *oldsdna = reconstruct_info->oldsdna;
+        const SDNA *newsdna = reconstruct_info->newsdna;
+        const int old_sub_size =
+            oldsdna->types_size[oldsdna->structs[step->data.substruct.old_struct_nr]->type];
+        const int new_sub_size = newsdna->types_size[newsdna->structs[sub_struct_nr]->type];
+        for (int b = 0; b < blocks; b++) {
+          reconstruct_structs(reconstruct_info,
+                              array_len,
+                              sub_struct_nr,
+                              old_data,
+                              old_sub_size,
+                              new_data,
+                              new_sub_size);
+          old_data += old_stride;
+          new_data += new_stride;
+        }
         break;
+      }
       case RECONSTRUCT_STEP_INIT_ZERO:
         /* Do nothing, because the memory block are zeroed (from #MEM_callocN).
          *
@@ -1209,27 +1289,6 @@ static void reconstruct_struct(const DNA_ReconstructInfo *reconstruct_info,
   }
 }
 
-/** Reconstructs an array of structs. */
-static void reconstruct_structs(const DNA_ReconstructInfo *reconstruct_info,
-                                const int blocks,
-                                const int old_struct_nr,
-                                const int new_struct_nr,
-                                const char *old_blocks,
-                                char *new_blocks)
-{
-  const SDNA_Struct *old_struct = reconstruct_info->oldsdna->structs[old_struct_nr];
-  const SDNA_Struct *new_struct = reconstruct_info->newsdna->structs[new_struct_nr];
-
-  const int old_block_size = reconstruct_info->oldsdna->types_size[old_struct->type];
-  const int new_block_size = reconstruct_info->newsdna->types_size[new_struct->type];
-
-  for (int a = 0; a < blocks; a++) {
-    const char *old_block = old_blocks + a * old_block_size;
-    char *new_block = new_blocks + a * new_block_size;
-    reconstruct_struct(reconstruct_info, new_struct_nr, old_block, new_block);
-  }
-}
-
 /**
  * \param reconstruct_info: Information preprocessed by #DNA_reconstruct_info_create.
  * \param old_struct_nr: Index of struct info within oldsdna.
@@ -1254,11 +1313,17 @@ void *DNA_struct_reconstruct(const DNA_ReconstructInfo *reconstruct_info,
   }
 
   const SDNA_Struct *new_struct = newsdna->structs[new_struct_nr];
+  const int old_block_size = oldsdna->types_size[old_struct->type];
   const int new_block_size = newsdna->types_size[new_struct->type];
 
   char *new_blocks = MEM_callocN(blocks * new_block_size, "reconstruct");
-  reconstruct_structs(
-      reconstruct_info, blocks, old_struct_nr, new_struct_nr, old_blocks, new_blocks);
+  reconstruct_structs(reconstruct_info,
+                      blocks,
+                      new_struct_nr,
+                      old_blocks,
+                      old_block_size,
+                      new_blocks,
+                      new_block_size);
   return new_blocks;
 }
 
@@ -0,0 +1,470 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The Original Code is Copyright (C) 2021 by Blender Foundation.
+ */
+#include "testing/testing.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "MEM_guardedalloc.h"
+
+#include "DNA_genfile.h"
+
+namespace blender::dna::tests {
+
+struct SDNAMember {
+  std::string type;
+  std::string name;
+};
+
+/**
+ * Builds encoded SDNA data, in the same format as the `DNA1` block of .blend files, for a small
+ * set of structs. Members are laid out one after the other without padding.
+ */
+class SDNABuilder {
+ private:
+  struct Struct {
+    std::string name;
+    std::vector<SDNAMember> members;
+  };
+
+  int pointer_size_;
+  std::vector<Struct> structs_;
+
+  static const std::vector<std::pair<std::string, int>> &primitive_types()
+  {
+    /* In the order of #eSDNA_Type. */
+    static const std::vector<std::pair<std::string, int>> types = {
+        {"char", 1},
+        {"uchar", 1},
+        {"short", 2},
+        {"ushort", 2},
+        {"int", 4},
+        {"long", 4},
+        {"ulong", 4},
+        {"float", 4},
+        {"double", 8},
+        {"void", 0},
+        {"int64_t", 8},
+        {"uint64_t", 8},
+        {"int8_t", 1},
+    };
+    return types;
+  }
+
+  static int array_len(const std::string &name)
+  {
+    const size_t start = name.find('[');
+    return (start == std::string::npos) ? 1 : std::stoi(name.substr(start + 1));
+  }
+
+  static short index_of(std::vector<std::string> &list, const std::string &str)
+  {
+    for (size_t i = 0; i < list.size(); i++) {
+      if (list[i] == str) {
+        return (short)i;
+      }
+    }
+    list.push_back(str);
+    return (short)(list.size() - 1);
+  }
+
+  template<typename T> static void append(std::vector<char> &data, const T value)
+  {
+    data.insert(data.end(), (const char *)&value, (const char *)&value + sizeof(value));
+  }
+
+  static void append_string(std::vector<char> &data, const std::string &str)
+  {
+    data.insert(data.end(), str.c_str(), str.c_str() + str.size() + 1);
+  }
+
+  static void pad_4(std::vector<char> &data)
+  {
+    while (data.size() % 4) {
+      data.push_back(0);
+    }
+  }
+
+  int member_size(const SDNAMember &member) const
+  {
+    const int elem_size = (member.name[0] == '*') ? pointer_size_ : size(member.type);
+    return elem_size * array_len(member.name);
+  }
+
+ public:
+  explicit SDNABuilder(const int pointer_size) : pointer_size_(pointer_size)
+  {
+    /* Compare flags of the first struct are never computed, see #DNA_struct_get_compareflags. */
+    add_struct("Link", {{"void", "*next"}, {"void", "*prev"}});
+    /* Used to detect the pointer size. */
+    add_struct("ListBase", {{"void", "*first"}, {"void", "*last"}});
+  }
+
+  void add_struct(const std::string &name, const std::vector<SDNAMember> &members)
+  {
+    structs_.push_back({name, members});
+  }
+
+  int size(const std::string &type) const
+  {
+    for (const auto &primitive : primitive_types()) {
+      if (primitive.first == type) {
+        return primitive.second;
+      }
+    }
+    for (const Struct &struct_info : structs_) {
+      if (struct_info.name == type) {
+        int size = 0;
+        for (const SDNAMember &member : struct_info.members) {
+          size += member_size(member);
+        }
+        return size;
+      }
+    }
+    return 0;
+  }
+
+  int offset(const std::string &struct_name, const std::string &member_name) const
+  {
+    for (const Struct &struct_info : structs_) {
+      if (struct_info.name != struct_name) {
+        continue;
+      }
+      int offset = 0;
+      for (const SDNAMember &member : struct_info.members) {
+        if (member.name == member_name) {
+          return offset;
+        }
+        offset += member_size(member);
+      }
+    }
+    return -1;
+  }
+
+  SDNA *build() const
+  {
+    std::vector<std::string> names;
+    std::vector<std::string> types;
+    for (const auto &primitive : primitive_types()) {
+      types.push_back(primitive.first);
+    }
+    for (const Struct &struct_info : structs_) {
+      types.push_back(struct_info.name);
+    }
+
+    std::vector<short> struct_data;
+    for (const Struct &struct_info : structs_) {
+      struct_data.push_back(index_of(types, struct_info.name));
+      struct_data.push_back((short)struct_info.members.size());
+      for (const SDNAMember &member : struct_info.members) {
+        struct_data.push_back(index_of(types, member.type));
+        struct_data.push_back(index_of(names, member.name));
+      }
+    }
+
+    std::vector<char> data;
+    data.insert(data.end(), {'S', 'D', 'N', 'A', 'N', 'A', 'M', 'E'});
+    append(data, (int)names.size());
+    for (const std::string &name : names) {
+      append_string(data, name);
+    }
+    pad_4(data);
+
+    data.insert(data.end(), {'T', 'Y', 'P', 'E'});
+    append(data, (int)types.size());
+    for (const std::string &type : types) {
+      append_string(data, type);
+    }
+    pad_4(data);
+
+    data.insert(data.end(), {'T', 'L', 'E', 'N'});
+    for (const std::string &type : types) {
+      append(data, (short)size(type));
+    }
+    pad_4(data);
+
+    data.insert(data.end(), {'S', 'T', 'R', 'C'});
+    append(data, (int)structs_.size());
+    for (const short value : struct_data) {
+      append(data, value);
+    }
+
+    const char *error_message = "";
+    SDNA *sdna = DNA_sdna_from_data(data.data(), (int)data.size(), false, true, &error_message);
+    EXPECT_NE(sdna, nullptr) << error_message;
+    return sdna;
+  }
+};
+
+/* Old and new versions of the same structs, which need every kind of reconstruct step. Members
+ * are ordered so that all values are aligned for both pointer sizes. */
+static SDNABuilder old_sdna_builder(const int pointer_size)
+{
+  SDNABuilder builder(pointer_size);
+  builder.add_struct("Sub", {{"int", "a"}, {"float", "b"}});
+  builder.add_struct("Same", {{"int", "a"}, {"int", "b"}});
+  std::vector<SDNAMember> members = {
+      {"double", "d"},
+      {"int", "v[3]"},
+      {"short", "x"},
+      {"short", "removed"},
+      {"Sub", "s"},
+      {"Sub", "arr[2]"},
+      {"Same", "same"},
+      {"Same", "same_arr[2]"},
+      {"void", "*p"},
+      {"void", "*parr[2]"},
+  };
+  if (pointer_size == 4) {
+    members.push_back({"int", "_pad"});
+  }
+  builder.add_struct("Item", members);
+  return builder;
+}
+
+static SDNABuilder new_sdna_builder(const int pointer_size)
+{
+  SDNABuilder builder(pointer_size);
+  /* Cast of the first member, second member copied, new member at the end. */
+  builder.add_struct("Sub", {{"float", "a"}, {"float", "b"}, {"int", "c"}});
+  builder.add_struct("Same", {{"int", "a"}, {"int", "b"}});
+  std::vector<SDNAMember> members = {
+      {"double", "d"},
+      {"int", "v[3]"},
+      {"float", "x"},
+      {"Sub", "s"},
+      {"Sub", "arr[2]"},
+      {"int", "added"},
+      {"Same", "same"},
+      {"Same", "same_arr[2]"},
+      {"void", "*p"},
+      {"void", "*parr[2]"},
+  };
+  if (pointer_size == 4) {
+    members.push_back({"int", "_pad"});
+  }
+  builder.add_struct("Item", members);
+  return builder;
+}
+
+template<typename T> static void set_value(char *data, const int offset, const T value)
+{
+  memcpy(data + offset, &value, sizeof(T));
+}
+
+template<typename T> static T get_value(const char *data, const int offset)
+{
+  T value;
+  memcpy(&value, data + offset, sizeof(T));
+  return value;
+}
+
+static void set_pointer(char *data, const int offset, const int pointer_size, uint64_t value)
+{
+  if (pointer_size == 4) {
+    set_value<uint32_t>(data, offset, (uint32_t)value);
+  }
+  else {
+    set_value<uint64_t>(data, offset, value);
+  }
+}
+
+static uint64_t get_pointer(const char *data, const int offset, const int pointer_size)
+{
+  return (pointer_size == 4) ? get_value<uint32_t>(data, offset) :
+                               get_value<uint64_t>(data, offset);
+}
+
+/* Many blocks, so that every strided loop runs over more than a single struct. */
+static constexpr int num_blocks = 37;
+
+static uint64_t old_pointer(const int block, const int index)
+{
+  return 0x10000 + block * 64 + index * 8;
+}
+
+static void fill_old_blocks(const SDNABuilder &old, std::vector<char> &blocks, const int ptr_size)
+{
+  const int size = old.size("Item");
+  const int sub_size = old.size("Sub");
+  const int same_size = old.size("Same");
+  blocks.assign((size_t)size * num_blocks, 0);
+
+  for (int b = 0; b < num_blocks; b++) {
+    char *item = blocks.data() + (size_t)b * size;
+    set_value<double>(item, old.offset("Item", "d"), b * 1.5);
+    for (int i = 0; i < 3; i++) {
+      set_value<int>(item, old.offset("Item", "v[3]") + i * 4, b * 10 + i);
+    }
+    set_value<short>(item, old.offset("Item", "x"), (short)(b + 3));
+    set_value<short>(item, old.offset("Item", "removed"), 12345);
+
+    char *sub = item + old.offset("Item", "s");
+    set_value<int>(sub, old.offset("Sub", "a"), b * 7);
+    set_value<float>(sub, old.offset("Sub", "b"), b * 0.25f);
+    for (int k = 0; k < 2; k++) {
+      sub = item + old.offset("Item", "arr[2]") + k * sub_size;
+      set_value<int>(sub, old.offset("Sub", "a"), b * 5 + k);
+      set_value<float>(sub, old.offset("Sub", "b"), b + k * 0.5f);
+    }
+
+    char *same = item + old.offset("Item", "same");
+    set_value<int>(same, old.offset("Same", "a"), b);
+    set_value<int>(same, old.offset("Same", "b"), b * 2);
+    for (int k = 0; k < 2; k++) {
+      same = item + old.offset("Item", "same_arr[2]") + k * same_size;
+      set_value<int>(same, old.offset("Same", "a"), b * 3 + k);
+      set_value<int>(same, old.offset("Same", "b"), b * 4 + k);
+    }
+
+    set_pointer(item, old.offset("Item", "*p"), ptr_size, old_pointer(b, 0));
+    for (int k = 0; k < 2; k++) {
+      set_pointer(
+          item, old.offset("Item", "*parr[2]") + k * ptr_size, ptr_size, old_pointer(b, k + 1));
+    }
+  }
+}
+
+static void expect_new_blocks(const SDNABuilder &new_builder,
+                              const char *blocks,
+                              const int old_ptr_size,
+                              const int new_ptr_size)
+{
+  const SDNABuilder &nb = new_builder;
+  const int size = nb.size("Item");
+  const int sub_size = nb.size("Sub");
+  const int same_size = nb.size("Same");
+
+  auto expected_pointer = [&](const uint64_t value) -> uint64_t {
+    if (old_ptr_size == 8 && new_ptr_size == 4) {
+      return value >> 3;
+    }
+    return value;
+  };
+
+  for (int b = 0; b < num_blocks; b++) {
+    const char *item = blocks + (size_t)b * size;
+    EXPECT_EQ(get_value<double>(item, nb.offset("Item", "d")), b * 1.5);
+    for (int i = 0; i < 3; i++) {
+      EXPECT_EQ(get_value<int>(item, nb.offset("Item", "v[3]") + i * 4), b * 10 + i);
+    }
+    EXPECT_EQ(get_value<float>(item, nb.offset("Item", "x")), (float)(b + 3));
+    EXPECT_EQ(get_value<int>(item, nb.offset("Item", "added")), 0);
+
+    const char *sub = item + nb.offset("Item", "s");
+    EXPECT_EQ(get_value<float>(sub, nb.offset("Sub", "a")), (float)(b * 7));
+    EXPECT_EQ(get_value<float>(sub, nb.offset("Sub", "b")), b * 0.25f);
+    EXPECT_EQ(get_value<int>(sub, nb.offset("Sub", "c")), 0);
+    for (int k = 0; k < 2; k++) {
+      sub = item + nb.offset("Item", "arr[2]") + k * sub_size;
+      EXPECT_EQ(get_value<float>(sub, nb.offset("Sub", "a")), (float)(b * 5 + k));
+      EXPECT_EQ(get_value<float>(sub, nb.offset("Sub", "b")), b + k * 0.5f);
+      EXPECT_EQ(get_value<int>(sub, nb.offset("Sub", "c")), 0);
+    }
+
+    const char *same = item + nb.offset("Item", "same");
+    EXPECT_EQ(get_value<int>(same, nb.offset("Same", "a")), b);
+    EXPECT_EQ(get_value<int>(same, nb.offset("Same", "b")), b * 2);
+    for (int k = 0; k < 2; k++) {
+      same = item + nb.offset("Item", "same_arr[2]") + k * same_size;
+      EXPECT_EQ(get_value<int>(same, nb.offset("Same", "a")), b * 3 + k);
+      EXPECT_EQ(get_value<int>(same, nb.offset("Same", "b")), b * 4 + k);
+    }
+
+    EXPECT_EQ(get_pointer(item, nb.offset("Item", "*p"), new_ptr_size),
+              expected_pointer(old_pointer(b, 0)));
+    for (int k = 0; k < 2; k++) {
+      EXPECT_EQ(get_pointer(item, nb.offset("Item", "*parr[2]") + k * new_ptr_size, new_ptr_size),
+                expected_pointer(old_pointer(b, k + 1)));
+    }
+  }
+}
+
+/**
+ * Reconstructing an array of structs at once (which uses strided loops over all structs for every
+ * step) gives the expected values, and the same result as reconstructing them one by one.
+ */
+static void test_reconstruct(const int old_ptr_size, const int new_ptr_size)
+{
+  const SDNABuilder old_builder = old_sdna_builder(old_ptr_size);
+  const SDNABuilder new_builder = new_sdna_builder(new_ptr_size);
+  SDNA *oldsdna = old_builder.build();
+  SDNA *newsdna = new_builder.build();
+  ASSERT_NE(oldsdna, nullptr);
+  ASSERT_NE(newsdna, nullptr);
+
+  const char *compare_flags = DNA_struct_get_compareflags(oldsdna, newsdna);
+  DNA_ReconstructInfo *reconstruct_info = DNA_reconstruct_info_create(
+      oldsdna, newsdna, compare_flags);
+
+  std::vector<char> old_blocks;
+  fill_old_blocks(old_builder, old_blocks, old_ptr_size);
+
+  const int old_size = old_builder.size("Item");
+  const int new_size = new_builder.size("Item");
+  const int old_struct_nr = DNA_struct_find_nr(oldsdna, "Item");
+  ASSERT_NE(old_struct_nr, -1);
+
+  char *new_blocks = static_cast<char *>(
+      DNA_struct_reconstruct(reconstruct_info, old_struct_nr, num_blocks, old_blocks.data()));
+  ASSERT_NE(new_blocks, nullptr);
+  expect_new_blocks(new_builder, new_blocks, old_ptr_size, new_ptr_size);
+
+  for (int b = 0; b < num_blocks; b++) {
+    char *new_block = static_cast<char *>(DNA_struct_reconstruct(
+        reconstruct_info, old_struct_nr, 1, old_blocks.data() + (size_t)b * old_size));
+    EXPECT_EQ(memcmp(new_block, new_blocks + (size_t)b * new_size, new_size), 0);
+    MEM_freeN(new_block);
+  }
+  MEM_freeN(new_blocks);
+
+  /* Unchanged struct, copied as a whole array. */
+  const int same_struct_nr = DNA_struct_find_nr(oldsdna, "Same");
+  const int same_size = old_builder.size("Same");
+  std::vector<int> same_blocks(num_blocks * 2);
+  for (int i = 0; i < num_blocks * 2; i++) {
+    same_blocks[i] = i * 11;
+  }
+  char *new_same_blocks = static_cast<char *>(
+      DNA_struct_reconstruct(reconstruct_info, same_struct_nr, num_blocks, same_blocks.data()));
+  EXPECT_EQ(memcmp(new_same_blocks, same_blocks.data(), (size_t)num_blocks * same_size), 0);
+  MEM_freeN(new_same_blocks);
+
+  DNA_reconstruct_info_free(reconstruct_info);
+  MEM_freeN((void *)compare_flags);
+  DNA_sdna_free(oldsdna);
+  DNA_sdna_free(newsdna);
+}
+
+TEST(dna_genfile, reconstruct_structs_pointer_32_to_64)
+{
+  test_reconstruct(4, 8);
+}
+
+TEST(dna_genfile, reconstruct_structs_pointer_64_to_32)
+{
+  test_reconstruct(8, 4);
+}
+
+TEST(dna_genfile, reconstruct_structs_same_pointer_size)
+{
+  test_reconstruct(8, 8);
+}
+
+}  // namespace blender::dna::tests
@@ -163,8 +163,8 @@ static void rna_def_cachefile(BlenderRNA *brna)
   RNA_def_property_ui_text(
       prop,
       "Prefetch Cache Size",
-      "Memory usage limit in megabytes for the Cycles Procedural cache, if the data does not "
-      "fit within the limit, rendering is aborted");
+      "Memory usage limit in megabytes for the Cycles Procedural cache, objects whose data "
+      "does not fit within the limit are loaded one frame at a time");
   RNA_def_property_update(prop, 0, "rna_CacheFile_update");
 
   /* ----------------- Axis Conversion ----------------- */
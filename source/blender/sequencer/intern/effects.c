@@ -48,6 +48,7 @@
 #include "BKE_fcurve.h"
 #include "BKE_lib_id.h"
 #include "BKE_main.h"
+#include "BKE_packedFile.h"
 
 #include "IMB_colormanagement.h"
 #include "IMB_imbuf.h"
@@ -3793,6 +3794,7 @@ void SEQ_effect_text_font_load(TextVars *data, const bool do_id_user)
     char name[MAX_ID_FULL_NAME];
     BKE_id_full_name_get(name, &vfont->id, 0);
 
+    BKE_packedfile_ensure_data(pf);
     data->text_blf_id = BLF_load_mem(name, pf->data, pf->size);
   }
   else {
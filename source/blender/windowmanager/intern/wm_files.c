@@ -764,6 +764,9 @@ static void wm_file_read_post(bContext *C, const struct wmFileReadPost_Params *p
 static void file_read_reports_finalize(BlendFileReadReport *bf_reports)
 {
   double duration_whole_minutes, duration_whole_seconds;
+  double duration_decode_blocks_minutes, duration_decode_blocks_seconds;
+  double duration_read_data_minutes, duration_read_data_seconds;
+  double duration_versioning_minutes, duration_versioning_seconds;
   double duration_libraries_minutes, duration_libraries_seconds;
   double duration_lib_override_minutes, duration_lib_override_seconds;
   double duration_lib_override_resync_minutes, duration_lib_override_resync_seconds;
@@ -776,6 +779,24 @@ static void file_read_reports_finalize(BlendFileReadReport *bf_reports)
                                   &duration_whole_minutes,
                                   &duration_whole_seconds,
                                   NULL);
+  BLI_math_time_seconds_decompose(bf_reports->duration.decode_blocks,
+                                  NULL,
+                                  NULL,
+                                  &duration_decode_blocks_minutes,
+                                  &duration_decode_blocks_seconds,
+                                  NULL);
+  BLI_math_time_seconds_decompose(bf_reports->duration.read_data,
+                                  NULL,
+                                  NULL,
+                                  &duration_read_data_minutes,
+                                  &duration_read_data_seconds,
+                                  NULL);
+  BLI_math_time_seconds_decompose(bf_reports->duration.versioning,
+                                  NULL,
+                                  NULL,
+                                  &duration_versioning_minutes,
+                                  &duration_versioning_seconds,
+                                  NULL);
   BLI_math_time_seconds_decompose(bf_reports->duration.libraries,
                                   NULL,
                                   NULL,
@@ -803,6 +824,23 @@ static void file_read_reports_finalize(BlendFileReadReport *bf_reports)
 
   CLOG_INFO(
       &LOG, 0, "Blender file read in %.0fm%.2fs", duration_whole_minutes, duration_whole_seconds);
+  CLOG_INFO(&LOG,
+            0,
+            " * Decoding blocks: %.0fm%.2fs (%d of %d blocks in parallel)",
+            duration_decode_blocks_minutes,
+            duration_decode_blocks_seconds,
+            bf_reports->count.decoded_blocks,
+            bf_reports->count.read_blocks);
+  CLOG_INFO(&LOG,
+            0,
+            " * Reading data: %.0fm%.2fs",
+            duration_read_data_minutes,
+            duration_read_data_seconds);
+  CLOG_INFO(&LOG,
+            0,
+            " * Versioning: %.0fm%.2fs",
+            duration_versioning_minutes,
+            duration_versioning_seconds);
   CLOG_INFO(&LOG,
             0,
             " * Loading libraries: %.0fm%.2fs",
@@ -890,6 +928,15 @@ bool WM_file_read(bContext *C, const char *filepath, ReportList *reports)
 
   WM_cursor_wait(true);
 
+  /* Opening a file never modifies it, changes of auto-save files stored separately are only
+   * merged by #WM_OT_recover_auto_save. */
+  if (BLO_memfile_incremental_exists(filepath)) {
+    BKE_reportf(reports,
+                RPT_WARNING,
+                "Later auto-saved changes of '%s' are not loaded, use Recover Auto Save instead",
+                filepath);
+  }
+
   /* first try to append data from exotic file formats... */
   /* it throws error box when file doesn't exist and returns -1 */
   /* NOTE(ton): it should set some error message somewhere. */
@@ -902,7 +949,9 @@ bool WM_file_read(bContext *C, const char *filepath, ReportList *reports)
         /* Loading preferences when the user intended to load a regular file is a security
          * risk, because the excluded path list is also loaded. Further it's just confusing
          * if a user loads a file and various preferences change. */
-        .skip_flags = BLO_READ_SKIP_USERDEF,
+        .skip_flags = BLO_READ_SKIP_USERDEF |
+                      /* Without undo packed files need not be read until they are used. */
+                      (G.background ? BLO_READ_DEFER_PACKED_DATA : 0),
     };
 
     BlendFileReadReport bf_reports = {.reports = reports,
@@ -1882,6 +1931,9 @@ static bool wm_file_write(bContext *C,
 /** \name Auto-Save API
  * \{ */
 
+/** Only the changes since the last full auto-save are written when saving from undo memory. */
+static MemFileIncrementalWrite *wm_autosave_incremental = NULL;
+
 static void wm_autosave_location(char *filepath)
 {
   const int pid = abs(getpid());
@@ -1928,7 +1980,10 @@ static void wm_autosave_write(Main *bmain, wmWindowManager *wm)
   const bool use_memfile = (U.uiflag & USER_GLOBALUNDO) != 0;
   MemFile *memfile = use_memfile ? ED_undosys_stack_memfile_get_active(wm->undo_stack) : NULL;
   if (memfile != NULL) {
-    BLO_memfile_write_file(memfile, filepath);
+    if (wm_autosave_incremental == NULL) {
+      wm_autosave_incremental = BLO_memfile_incremental_new();
+    }
+    BLO_memfile_write_file_incremental(wm_autosave_incremental, memfile, filepath);
   }
   else {
     if (use_memfile) {
@@ -1941,6 +1996,9 @@ static void wm_autosave_write(Main *bmain, wmWindowManager *wm)
 
     ED_editors_flush_edits(bmain);
 
+    /* A delta from a previous incremental save must not be applied to the new file. */
+    BLO_memfile_incremental_discard(filepath);
+
     /* Error reporting into console. */
     BLO_write_file(bmain, filepath, fileflags, &(const struct BlendFileWriteParams){0}, NULL);
   }
@@ -2006,15 +2064,28 @@ void wm_autosave_delete(void)
 
   wm_autosave_location(filename);
 
+  if (wm_autosave_incremental != NULL) {
+    BLO_memfile_incremental_free(wm_autosave_incremental);
+    wm_autosave_incremental = NULL;
+  }
+
   if (BLI_exists(filename)) {
     char str[FILE_MAX];
     BLI_join_dirfile(str, sizeof(str), BKE_tempdir_base(), BLENDER_QUIT_FILE);
 
     /* if global undo; remove tempsave, otherwise rename */
     if (U.uiflag & USER_GLOBALUNDO) {
+      BLO_memfile_incremental_discard(filename);
+      BLI_delete(filename, false, false);
+    }
+    else if (BLO_memfile_incremental_exists(filename) &&
+             BLO_memfile_incremental_recover(filename, str)) {
+      /* Undo was turned off after an incremental auto-save, keep the merged file. */
+      BLO_memfile_incremental_discard(filename);
       BLI_delete(filename, false, false);
     }
     else {
+      BLO_memfile_incremental_discard(filename);
       BLI_rename(filename, str);
     }
   }
@@ -2937,6 +3008,22 @@ static int wm_recover_auto_save_exec(bContext *C, wmOperator *op)
 
   RNA_string_get(op->ptr, "filepath", filepath);
 
+  /* Changes of incremental auto-saves are merged into a copy, the auto-save files are left as
+   * they are. Saving the recovered file is up to the user, as for any other recovered file. */
+  if (BLO_memfile_incremental_exists(filepath)) {
+    char filepath_merged[FILE_MAX];
+    BLI_join_dirfile(
+        filepath_merged, sizeof(filepath_merged), BKE_tempdir_session(), "recover_auto_save.blend");
+    if (BLO_memfile_incremental_recover(filepath, filepath_merged)) {
+      BLI_strncpy(filepath, filepath_merged, sizeof(filepath));
+    }
+    else {
+      BKE_report(op->reports,
+                 RPT_WARNING,
+                 "Unable to apply later auto-saved changes, recovering the last full auto-save");
+    }
+  }
+
   wm_open_init_use_scripts(op, true);
   SET_FLAG_FROM_TEST(G.f, RNA_boolean_get(op->ptr, "use_scripts"), G_FLAG_SCRIPT_AUTOEXEC);
 